@@ -14,8 +14,10 @@ namespace Net {
 #define SAFE_DELETE(p) {if(p){delete (p); (p) = nullptr;}}
 #define SAFE_DELETE_ARRAY(p) {if(p){delete[] (p); (p) = nullptr;}}
 
-	typedef std::function<void(int, char*, unsigned, uint8_t)>  CBAsyncRecv;
-	typedef std::function<void(int, size_t, uint8_t)>	CBAsyncSend;
+	typedef int64_t SessionId;	//the slot of the session in the low 32 bits, the generation of the slot above
+
+	typedef std::function<void(SessionId, char*, unsigned, uint8_t)>  CBAsyncRecv;
+	typedef std::function<void(SessionId, size_t, uint8_t)>	CBAsyncSend;
 	typedef std::function<void(const udp::endpoint&, char*, unsigned, uint8_t)>  CBAsyncRecvUdp;
 	typedef std::function<void(const udp::endpoint&, size_t, uint8_t)>	CBAsyncSendUdp;
 
@@ -27,7 +29,18 @@ namespace Net {
 	constexpr uint16_t PacketSizeUdp = 1024;
 	constexpr int MaxPacketSize = 65535;
 	constexpr int MaxConnNum = 65536;
+	constexpr uint32_t MaxSessionNum = 1024 * 1024;	//the session slots of a server/connector, allocated on use
 	constexpr int MaxRecvSize = 65535;
+	constexpr size_t MaxFrameSize = 1024 * 1024 * 64;	//the max body of a length/newline framed packet
+	constexpr size_t MaxSendBatchBytes = 1024 * 64;	//the max bytes of one gather write
+	constexpr size_t MaxSendBatchBufs = 64;			//the max packets of one gather write
+	constexpr size_t SendQueueSize = 256;			//the slots of a session send queue(a power of 2), a send is refused when it is full
+	constexpr size_t SendHighWaterBytes = 1024 * 1024 * 4;	//a session send queue holding more bytes is paused
+	constexpr size_t SendLowWaterBytes = 1024 * 1024;		//and resumed when it has drained to this
+	constexpr size_t RecvRingSize = 1024 * 16;		//the initial size of the receive ring of a stick session
+	constexpr unsigned TimerTick = 100;				//ms, the tick of the timing wheel
+	constexpr size_t AcceptBurst = 256;				//the most connections the sync accept loop takes in one wakeup
+	constexpr int AcceptWaitMs = 100;				//the wait of the sync accept loop, it sees a stop after this
 
 	//Error type definition:
 	constexpr uint8_t NO_ERR = 0x00;
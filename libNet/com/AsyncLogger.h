@@ -0,0 +1,403 @@
+#pragma once
+//========================================================================
+//[File Name]:AsyncLogger.h
+//[Description]: an asynchronous logger. a write copies its format, its
+// arguments and a timestamp into a lock-free ring of the calling thread,
+// a background thread formats the records of all the rings and writes
+// them to their streams in batches, so the callers neither format nor
+// lock nor flush. the lines of one thread keep their order. the levels
+// below LOG_LEVEL_MIN are compiled out, the levels below SetLevel return
+// before anything is copied.
+//[Author]:Nico Hu
+//[Date]:2020-08-10
+//[Other]:Copyright (c) 2020-2050 Nico Hu
+//========================================================================
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <vector>
+
+
+enum class E_LOG_LEV_T { e_Debug = 0, e_Info, e_Warning, e_Error, e_Off };
+
+#ifndef LOG_LEVEL_MIN
+#define LOG_LEVEL_MIN 0	//the lowest level compiled in(E_LOG_LEV_T), 1 drops the debug logs from the build
+#endif
+
+class AsyncLogger {
+	friend class Gargo;
+	using Formatter = int(*)(const char* format, const char* args, char* out, size_t size);
+
+	//a record in a ring, its arguments follow it. the format and the prefix are string literals.
+	struct Head {
+		uint32_t len{ 0 };					//of the record with its arguments, a multiple of RecordAlign
+		E_LOG_LEV_T level{ E_LOG_LEV_T::e_Info };
+		Formatter formatter{ nullptr };		//nullptr: padding up to the end of the ring
+		const char* format{ nullptr };
+		const char* prefix{ nullptr };
+		std::ostream* ostr{ nullptr };
+		int64_t time{ 0 };					//us since the epoch
+	};
+	//a single producer(the thread of the ring), single consumer(the background thread) ring of records.
+	struct Ring {
+		explicit Ring(size_t size) : buff(new char[size]), mask(size - 1) {}
+		std::unique_ptr<char[]> buff;
+		const size_t mask;
+		alignas(64) std::atomic<size_t> head{ 0 };	//read up to, by the consumer
+		alignas(64) std::atomic<size_t> tail{ 0 };	//written up to, by the producer
+		size_t headCache{ 0 };						//the producer's last view of head
+		std::atomic<uint64_t> dropped{ 0 };
+		std::atomic_bool closed{ false };			//its thread has exited
+	};
+	//the ring of a thread is released by the background thread once its thread has exited and it is drained.
+	struct Local {
+		std::shared_ptr<Ring> ring{ nullptr };
+		~Local() {
+			if (ring)
+				ring->closed = true;
+		}
+	};
+
+	//a string argument is copied as [len][bytes]['\0'] and formatted as a const char*.
+	struct StrArg {
+		using Type = const char*;
+		static size_t Len(const char* str) { return str ? strnlen(str, MaxStrLen) : 0; }
+		static size_t Len(std::string_view str) { return str.size() < MaxStrLen ? str.size() : MaxStrLen; }
+		template<typename S>
+		static size_t Size(const S& str) { return sizeof(uint32_t) + Len(str) + 1; }
+		static char* Put(char* p, const char* str) { return Put(p, str, Len(str)); }
+		static char* Put(char* p, std::string_view str) { return Put(p, str.data(), Len(str)); }
+		static char* Put(char* p, const char* str, size_t len) {
+			const uint32_t n = static_cast<uint32_t>(len);
+			memcpy(p, &n, sizeof(n));
+			if (n > 0)
+				memcpy(p + sizeof(n), str, n);
+			p[sizeof(n) + n] = '\0';
+			return p + sizeof(n) + n + 1;
+		}
+		static const char* Get(const char*& p) {
+			uint32_t n{ 0 };
+			memcpy(&n, p, sizeof(n));
+			const char* str = p + sizeof(n);
+			p += sizeof(n) + n + 1;
+			return str;
+		}
+	};
+	//numbers and pointers are copied as they are.
+	template<typename T, typename = void>
+	struct Arg {
+		static_assert(std::is_arithmetic<T>::value || std::is_enum<T>::value || std::is_pointer<T>::value, \
+			"a log argument is a number, a pointer or a string");
+		using Type = T;
+		static size_t Size(const T&) { return sizeof(T); }
+		static char* Put(char* p, const T& value) {
+			memcpy(p, &value, sizeof(T));
+			return p + sizeof(T);
+		}
+		static T Get(const char*& p) {
+			T value;
+			memcpy(&value, p, sizeof(T));
+			p += sizeof(T);
+			return value;
+		}
+	};
+	template<typename T>
+	struct Arg<T, std::enable_if_t<std::is_same<T, const char*>::value || std::is_same<T, char*>::value || \
+		std::is_same<T, std::string>::value || std::is_same<T, std::string_view>::value>> : StrArg {};
+	template<typename T>
+	using ArgOf = Arg<std::decay_t<T>>;
+
+	template<typename... Args>
+	static int Format(const char* format, [[maybe_unused]] const char* args, char* out, size_t size) {
+		//a braced list decodes the arguments from left to right.
+		std::tuple<typename ArgOf<Args>::Type...> values{ ArgOf<Args>::Get(args)... };
+		return std::apply([&](auto... value) { return snprintf(out, size, format, value...); }, values);
+	}
+
+public:
+	static constexpr size_t RingBytes = 1024 * 256;	//the ring of a thread, a power of 2
+	static constexpr size_t MaxStrLen = 1024 * 2;	//a string argument is cut to this
+	static constexpr size_t RecordAlign = 64;		//>= sizeof(Head), the padding at the end of a ring holds a head
+	static constexpr size_t BatchBytes = 1024 * 64;	//a stream is written when its batch reaches this
+	static constexpr unsigned FlushMs = 2;			//the background thread looks at the rings this often when idle
+
+	static AsyncLogger* Instance() {
+		static std::once_flag once;
+		std::call_once(once, [] { sInstance_ = new AsyncLogger(); });
+		return sInstance_; //nullptr after the exit, the writers then format synchronously
+	}
+	~AsyncLogger() { Stop(); }
+
+	static constexpr bool Compiled(E_LOG_LEV_T level) { return static_cast<int>(level) >= LOG_LEVEL_MIN; }
+	static bool Enabled(E_LOG_LEV_T level) {
+		return Compiled(level) && static_cast<int>(level) >= Level().load(std::memory_order_relaxed);
+	}
+	static void SetLevel(E_LOG_LEV_T level) { Level().store(static_cast<int>(level), std::memory_order_relaxed); }
+	//block the writer while its ring is full, instead of dropping the record(the drops are reported).
+	void SetBlocking(bool b_block) { bBlock_ = b_block; }
+
+	//copy the record into the ring of this thread, the background thread formats it later. ostr must live
+	//until the record is written(Flush).
+	template<typename... Args>
+	void Write(E_LOG_LEV_T level, std::ostream& ostr, const char* prefix, const char* format, const Args&... args) {
+		if (!Enabled(level))
+			return;
+		Ring* ring = LocalRing();
+		const size_t len = Align(sizeof(Head) + (ArgOf<Args>::Size(args) + ... + size_t(0)));
+		size_t tail{ 0 };
+		char* p = Reserve(*ring, len, tail);
+		if (p == nullptr) {
+			ring->dropped.fetch_add(1, std::memory_order_relaxed);
+			return;
+		}
+		Head* head = new (p) Head();
+		head->len = static_cast<uint32_t>(len);
+		head->level = level;
+		head->formatter = &Format<std::decay_t<Args>...>;
+		head->format = format;
+		head->prefix = prefix;
+		head->ostr = &ostr;
+		head->time = Now();
+		[[maybe_unused]] char* arg = p + sizeof(Head);
+		((arg = ArgOf<Args>::Put(arg, args)), ...);
+		ring->tail.store(tail, std::memory_order_release);
+	}
+	//format and write the record now, for the writes after the logger has exited.
+	template<typename... Args>
+	static void WriteSync(std::ostream& ostr, const char* prefix, const char* format, const Args&... args) {
+		std::vector<char> values((ArgOf<Args>::Size(args) + ... + size_t(1)));
+		[[maybe_unused]] char* arg = values.data();
+		((arg = ArgOf<Args>::Put(arg, args)), ...);
+		char buff[1024 * 4] = { 0 };
+		Format<std::decay_t<Args>...>(format, values.data(), buff, sizeof(buff));
+		char stamp[64] = { 0 };
+		time_t t = time(0);
+		strftime(stamp, sizeof(stamp), "[%Y-%m-%d %H:%M:%S] ", localtime(&t));
+		static std::mutex mtx;
+		std::lock_guard<std::mutex> lock(mtx);
+		ostr << prefix << stamp << buff << std::endl;
+	}
+	//wait until the records written before the call are on their streams.
+	void Flush() {
+		std::vector<std::pair<std::shared_ptr<Ring>, size_t>> marks;
+		{
+			std::lock_guard<std::mutex> lock(mtx_);
+			for (auto& var : rings_)
+				marks.emplace_back(var, var->tail.load(std::memory_order_acquire));
+		}
+		cv_.notify_one();
+		for (auto& var : marks) {
+			while (var.first->head.load(std::memory_order_acquire) < var.second && thread_.joinable())
+				std::this_thread::sleep_for(std::chrono::microseconds(100));
+		}
+	}
+	void Stop() {
+		{
+			std::lock_guard<std::mutex> lock(mtx_);
+			bExit_ = true;
+		}
+		cv_.notify_one();
+		if (thread_.joinable())
+			thread_.join();
+	}
+
+protected:
+	AsyncLogger() {
+		static Gargo gargo;
+		thread_ = std::thread([this] { Run(); });
+	}
+	AsyncLogger(const AsyncLogger&) = delete;
+	AsyncLogger& operator=(const AsyncLogger&) = delete;
+	AsyncLogger(AsyncLogger&&) noexcept = delete;
+	AsyncLogger& operator=(AsyncLogger&&) noexcept = delete;
+
+	static std::atomic<int>& Level() {
+		static std::atomic<int> level{ static_cast<int>(E_LOG_LEV_T::e_Debug) };
+		return level;
+	}
+	static size_t Align(size_t len) { return (len + RecordAlign - 1) & ~(RecordAlign - 1); }
+	static int64_t Now() {
+		return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+	}
+
+	Ring* LocalRing() {
+		thread_local Local local;
+		if (!local.ring) {
+			local.ring = std::make_shared<Ring>(RingBytes);
+			std::lock_guard<std::mutex> lock(mtx_);
+			rings_.emplace_back(local.ring);
+		}
+		return local.ring.get();
+	}
+	//a record of len bytes at the tail, tail is set to the end of it. a record doesn't wrap, the end of the
+	//ring is padded instead.
+	char* Reserve(Ring& ring, size_t len, size_t& tail) {
+		const size_t size = ring.mask + 1;
+		if (len > size / 2)
+			return nullptr;
+		tail = ring.tail.load(std::memory_order_relaxed);
+		const size_t pos = tail & ring.mask;
+		const size_t pad = pos + len > size ? size - pos : 0;
+		while (tail + pad + len - ring.headCache > size) {
+			ring.headCache = ring.head.load(std::memory_order_acquire);
+			if (tail + pad + len - ring.headCache <= size)
+				break;
+			if (!bBlock_ || bExit_)
+				return nullptr;
+			std::this_thread::yield();
+		}
+		if (pad > 0) {
+			Head* head = new (&ring.buff[pos]) Head();
+			head->len = static_cast<uint32_t>(pad);
+			tail += pad;
+		}
+		char* p = &ring.buff[tail & ring.mask];
+		tail += len;
+		return p;
+	}
+
+	void Run() {
+		std::vector<std::shared_ptr<Ring>> rings;
+		while (true) {
+			const bool exit = bExit_;
+			{
+				std::lock_guard<std::mutex> lock(mtx_);
+				rings = rings_;
+			}
+			size_t n{ 0 };
+			for (auto& var : rings)
+				n += Drain(*var);
+			WriteBatches();
+			{
+				std::lock_guard<std::mutex> lock(mtx_);
+				for (auto it = rings_.begin(); it != rings_.end();) {
+					if ((*it)->closed && (*it)->head.load(std::memory_order_relaxed) == (*it)->tail.load(std::memory_order_acquire))
+						it = rings_.erase(it);
+					else
+						++it;
+				}
+			}
+			if (exit && n == 0)
+				break;
+			if (n == 0) {
+				std::unique_lock<std::mutex> lock(mtx_);
+				cv_.wait_for(lock, std::chrono::milliseconds(FlushMs), [this] { return bExit_.load(); });
+			}
+		}
+	}
+	//format the records of a ring into the batches of their streams, the ring is released once they are written.
+	size_t Drain(Ring& ring) {
+		size_t head = ring.head.load(std::memory_order_relaxed);
+		const size_t tail = ring.tail.load(std::memory_order_acquire);
+		size_t n{ 0 };
+		while (head != tail) {
+			const Head* record = reinterpret_cast<const Head*>(&ring.buff[head & ring.mask]);
+			if (record->formatter) {
+				int len = record->formatter(record->format, reinterpret_cast<const char*>(record + 1), line_, sizeof(line_));
+				if (len >= 0)
+					Append(*record, len < static_cast<int>(sizeof(line_)) ? len : static_cast<int>(sizeof(line_)) - 1);
+				n++;
+			}
+			head += record->len;
+		}
+		if (n > 0) {
+			WriteBatches();
+			ring.head.store(head, std::memory_order_release);
+		}
+		const uint64_t dropped = ring.dropped.exchange(0, std::memory_order_relaxed);
+		if (dropped > 0)
+			std::cerr << "[AsyncLogger] a ring was full, " << dropped << " records dropped" << std::endl;
+		return n;
+	}
+	void Append(const Head& record, int len) {
+		Batch* batch{ nullptr };
+		for (auto& var : batches_) {
+			if (var.ostr == record.ostr)
+				batch = &var;
+		}
+		if (batch == nullptr) {
+			batches_.emplace_back();
+			batch = &batches_.back();
+			batch->ostr = record.ostr;
+			batch->buff.reserve(BatchBytes * 2);
+		}
+		batch->buff.append(record.prefix);
+		batch->buff.append(Stamp(record.time));
+		batch->buff.append(line_, len);
+		batch->buff.push_back('\n');
+		if (batch->buff.size() >= BatchBytes)
+			WriteBatch(*batch);
+	}
+	void WriteBatches() {
+		for (auto& var : batches_) {
+			if (!var.buff.empty())
+				WriteBatch(var);
+		}
+	}
+	void WriteBatch(std::string& buff, std::ostream& ostr) {
+		try
+		{
+			ostr.write(buff.data(), buff.size());
+			ostr.flush();
+		}
+		catch (const std::exception& e)
+		{
+			std::cerr << "AsyncLogger write raise ex:" << e.what() << std::endl;
+		}
+		buff.clear();
+	}
+	//"[%Y-%m-%d %H:%M:%S] ", formatted once a second.
+	const char* Stamp(int64_t time_us) {
+		const time_t sec = static_cast<time_t>(time_us / 1000000);
+		if (sec != stampSec_) {
+			stampSec_ = sec;
+			strftime(stamp_, sizeof(stamp_), "[%Y-%m-%d %H:%M:%S] ", localtime(&sec));
+		}
+		return stamp_;
+	}
+
+protected:
+	struct Batch {
+		std::ostream* ostr{ nullptr };
+		std::string buff;
+	};
+	void WriteBatch(Batch& batch) { WriteBatch(batch.buff, *batch.ostr); }
+
+	static AsyncLogger* sInstance_;
+	std::mutex mtx_;
+	std::condition_variable cv_;
+	std::vector<std::shared_ptr<Ring>> rings_;
+	std::thread thread_;
+	std::atomic_bool bExit_{ false };
+	std::atomic_bool bBlock_{ false };
+	//the background thread's
+	std::vector<Batch> batches_;
+	char line_[1024 * 4]{ 0 };
+	char stamp_[64]{ 0 };
+	time_t stampSec_{ -1 };
+
+	class Gargo {
+	public:
+		~Gargo() {
+			if (sInstance_ != nullptr) {
+				AsyncLogger* logger = sInstance_;
+				sInstance_ = nullptr;
+				delete logger;
+			}
+		}
+	};
+};
+
+AsyncLogger* AsyncLogger::sInstance_ = nullptr;
@@ -0,0 +1,315 @@
+#pragma once
+//========================================================================
+//[File Name]:BlockArena.h
+//[Description]: the blocks of the memory pools carved from large mapped
+// regions instead of the heap, so the hot buffers share few TLB entries.
+// a region is mapped with MAP_HUGETLB(the huge pages reserved by the
+// system), or else aligned to a huge page and advised MADV_HUGEPAGE(the
+// transparent ones), or else taken from the heap. a region can be touched
+// once it is mapped, so no page fault is left for the traffic. the pages
+// of a block given back are given back to the os(madvise), its range is
+// kept by size for the next one, the regions are unmapped when the arena
+// is gone. the storages made after SetDefault use it.
+//[Author]:Nico Hu
+//[Date]:2020-08-10
+//[Other]:Copyright (c) 2020-2050 Nico Hu
+//========================================================================
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <unordered_map>
+#include <vector>
+#ifdef __linux__
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+
+enum class E_ARENA_PAGE_T : uint8_t {
+	e_Heap = 0,		//operator new, no huge page
+	e_Normal,		//mapped, no huge page asked
+	e_Thp,			//mapped and advised for the transparent huge pages
+	e_HugeTlb,		//mapped on the reserved huge pages
+};
+
+struct BlockArenaInfo_t {
+	size_t regionBytes{ 1024 * 1024 * 64 };		//mapped at a time, rounded up to hugePageBytes
+	size_t hugePageBytes{ 1024 * 1024 * 2 };
+	bool bHugeTlb{ true };		//try the reserved huge pages first
+	bool bThp{ true };			//else advise the transparent ones
+	bool bMap{ true };			//else map the region, false: take it from the heap
+	bool bPrefault{ false };	//touch a region when it is mapped
+	bool bRelease{ true };		//give the whole pages of a freed block back to the os, not those of the heap
+	size_t initBytes{ 0 };		//mapped(and touched if bPrefault) when the arena is made
+};
+
+struct ArenaUsage_t {
+	size_t regions{ 0 };
+	size_t hugeTlbRegions{ 0 };
+	size_t thpRegions{ 0 };
+	size_t normalRegions{ 0 };
+	size_t heapRegions{ 0 };
+	size_t bytesMapped{ 0 };
+	size_t bytesUsed{ 0 };		//in the blocks given out
+	size_t bytesFree{ 0 };		//in the blocks given back, kept for the next ones
+	size_t bytesReleased{ 0 };	//of bytesFree, the pages given back to the os
+	uint64_t fallbacks{ 0 };	//a huge page mapping or advice which failed
+};
+
+class BlockArena {
+public:
+	static constexpr size_t Align = 64;
+
+	explicit BlockArena(const BlockArenaInfo_t& info = BlockArenaInfo_t()) : info_(info) {
+		if (info_.hugePageBytes < Align)
+			info_.hugePageBytes = Align;
+#ifdef __linux__
+		pageBytes_ = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+#endif
+		if (info_.initBytes > 0) {
+			std::lock_guard<std::mutex> lock(mtx_);
+			MapRegion(info_.initBytes);
+		}
+	}
+	~BlockArena() {
+		for (auto& var : regions_)
+			Unmap(var);
+	}
+	BlockArena(const BlockArena&) = delete;
+	BlockArena& operator=(const BlockArena&) = delete;
+
+	//a block aligned to Align(to a page if it is of whole pages), nullptr if no memory.
+	void* Alloc(size_t bytes) {
+		bytes = RoundUp(bytes, Align);
+		std::lock_guard<std::mutex> lock(mtx_);
+		auto find = free_.find(bytes);
+		if (find != free_.end() && !find->second.empty()) {
+			const FreeBlock_t block = find->second.back();
+			find->second.pop_back();
+			usage_.bytesFree -= bytes;
+			usage_.bytesReleased -= block.released;
+			usage_.bytesUsed += bytes;
+			return block.p;
+		}
+		char* p = Carve(bytes);
+		if (p == nullptr) {
+			if (!MapRegion(bytes))
+				return nullptr;
+			p = Carve(bytes);
+		}
+		usage_.bytesUsed += bytes;
+		return p;
+	}
+	//bytes must be those of the Alloc. the whole pages of the block are given back to the os(bRelease).
+	void Free(void* p, size_t bytes) {
+		if (p == nullptr)
+			return;
+		bytes = RoundUp(bytes, Align);
+		std::lock_guard<std::mutex> lock(mtx_);
+		usage_.bytesUsed -= bytes;
+		FreeBlock_t block{ static_cast<char*>(p), 0 };
+		try
+		{
+			std::vector<FreeBlock_t>& blocks = free_[bytes];
+			if (blocks.size() == blocks.capacity())
+				blocks.reserve(blocks.empty() ? 16 : blocks.size() * 2);
+			block.released = Release(block.p, bytes);
+			blocks.emplace_back(block);
+		}
+		catch (const std::bad_alloc&)
+		{
+			return; //the block is lost until the arena is gone
+		}
+		usage_.bytesFree += bytes;
+		usage_.bytesReleased += block.released;
+	}
+	ArenaUsage_t GetUsage() {
+		std::lock_guard<std::mutex> lock(mtx_);
+		return usage_;
+	}
+	const BlockArenaInfo_t& Info() const { return info_; }
+
+	//the arena of the storages made from now on, nullptr: the heap.
+	static std::shared_ptr<BlockArena> Default() {
+		std::lock_guard<std::mutex> lock(DefaultMtx());
+		return DefaultArena();
+	}
+	static void SetDefault(std::shared_ptr<BlockArena> arena) {
+		std::lock_guard<std::mutex> lock(DefaultMtx());
+		DefaultArena() = std::move(arena);
+	}
+
+protected:
+	//kept apart from the block, whose pages may be given back.
+	struct FreeBlock_t {
+		char* p;
+		size_t released;	//the bytes of its pages given back
+	};
+	struct Region_t {
+		void* p{ nullptr };		//as mapped or allocated
+		size_t bytes{ 0 };
+		E_ARENA_PAGE_T page{ E_ARENA_PAGE_T::e_Heap };
+	};
+
+	static size_t RoundUp(size_t value, size_t align) { return (value + align - 1) / align * align; }
+	//the pages of a region which can be given back one by one, 0: none(the heap).
+	size_t PageOf(E_ARENA_PAGE_T page) const {
+		if (!info_.bRelease)
+			return 0;
+		switch (page)
+		{
+		case E_ARENA_PAGE_T::e_HugeTlb: return info_.hugePageBytes;
+		case E_ARENA_PAGE_T::e_Thp:
+		case E_ARENA_PAGE_T::e_Normal: return pageBytes_;
+		default: return 0;
+		}
+	}
+	//a block off the rest of the last region, one of whole pages starts on a page so they can be given back.
+	char* Carve(size_t bytes) {
+		if (curr_ == nullptr)
+			return nullptr;
+		char* p = curr_;
+		if (currPage_ > 0 && bytes % currPage_ == 0)
+			p = reinterpret_cast<char*>(RoundUp(reinterpret_cast<uintptr_t>(curr_), currPage_));
+		if (p > end_ || bytes > static_cast<size_t>(end_ - p))
+			return nullptr;
+		curr_ = p + bytes;
+		return p;
+	}
+	//give the whole pages inside the block back to the os, its range stays mapped. return their bytes.
+	size_t Release(char* p, size_t bytes) {
+#if defined(__linux__) && defined(MADV_DONTNEED)
+		for (auto& var : regions_) {
+			char* base = static_cast<char*>(var.p);
+			if (p < base || p >= base + var.bytes)
+				continue;
+			const size_t page = PageOf(var.page);
+			if (page == 0)
+				return 0;
+			const uintptr_t first = RoundUp(reinterpret_cast<uintptr_t>(p), page);
+			const uintptr_t last = (reinterpret_cast<uintptr_t>(p) + bytes) / page * page;
+			if (last <= first || madvise(reinterpret_cast<void*>(first), last - first, MADV_DONTNEED) != 0)
+				return 0;
+			return last - first;
+		}
+#endif
+		return 0;
+	}
+
+	//a region of regionBytes at least, the last one's tail is left.
+	bool MapRegion(size_t min_bytes) {
+		const size_t bytes = RoundUp(min_bytes > info_.regionBytes ? min_bytes : info_.regionBytes, info_.hugePageBytes);
+		Region_t region;
+		region.bytes = bytes;
+		char* base{ nullptr };
+#ifdef __linux__
+#ifdef MAP_HUGETLB
+		if (info_.bHugeTlb) {
+			void* p = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+			if (p != MAP_FAILED) {
+				region.p = p;
+				region.page = E_ARENA_PAGE_T::e_HugeTlb;
+				base = static_cast<char*>(p);
+			}
+			else
+				usage_.fallbacks++;
+		}
+#endif
+		if (base == nullptr && info_.bMap) {
+			//a huge page aligned range of a larger mapping, the kernel backs only aligned ranges by huge pages
+			const size_t mapped = bytes + info_.hugePageBytes;
+			void* p = mmap(nullptr, mapped, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+			if (p != MAP_FAILED) {
+				char* raw = static_cast<char*>(p);
+				char* aligned = reinterpret_cast<char*>(RoundUp(reinterpret_cast<uintptr_t>(raw), info_.hugePageBytes));
+				if (aligned > raw)
+					munmap(raw, aligned - raw);
+				if (raw + mapped > aligned + bytes)
+					munmap(aligned + bytes, raw + mapped - aligned - bytes);
+				region.p = aligned;
+				region.page = E_ARENA_PAGE_T::e_Normal;
+				base = aligned;
+#ifdef MADV_HUGEPAGE
+				if (info_.bThp) {
+					if (madvise(aligned, bytes, MADV_HUGEPAGE) == 0)
+						region.page = E_ARENA_PAGE_T::e_Thp;
+					else
+						usage_.fallbacks++;
+				}
+#endif
+			}
+		}
+#endif
+		if (base == nullptr) {
+			region.p = ::operator new(bytes + Align, std::nothrow);
+			if (region.p == nullptr)
+				return false;
+			region.page = E_ARENA_PAGE_T::e_Heap;
+			base = reinterpret_cast<char*>(RoundUp(reinterpret_cast<uintptr_t>(region.p), Align));
+		}
+		try
+		{
+			regions_.emplace_back(region);
+		}
+		catch (const std::bad_alloc&)
+		{
+			Unmap(region);
+			return false;
+		}
+		if (info_.bPrefault)
+			Prefault(base, bytes);
+		curr_ = base;
+		end_ = base + bytes;
+		currPage_ = PageOf(region.page);
+		usage_.regions++;
+		usage_.bytesMapped += bytes;
+		switch (region.page)
+		{
+		case E_ARENA_PAGE_T::e_HugeTlb: usage_.hugeTlbRegions++; break;
+		case E_ARENA_PAGE_T::e_Thp: usage_.thpRegions++; break;
+		case E_ARENA_PAGE_T::e_Normal: usage_.normalRegions++; break;
+		default: usage_.heapRegions++; break;
+		}
+		return true;
+	}
+	static void Prefault(char* base, size_t bytes) {
+#ifdef __linux__
+		const size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+#else
+		const size_t page = 4096;
+#endif
+		for (size_t off = 0; off < bytes; off += page)
+			static_cast<volatile char*>(base)[off] = 0;
+	}
+	static void Unmap(const Region_t& region) {
+#ifdef __linux__
+		if (region.page != E_ARENA_PAGE_T::e_Heap) {
+			munmap(region.p, region.bytes);
+			return;
+		}
+#endif
+		::operator delete(region.p);
+	}
+
+	static std::mutex& DefaultMtx() {
+		static std::mutex mtx;
+		return mtx;
+	}
+	static std::shared_ptr<BlockArena>& DefaultArena() {
+		static std::shared_ptr<BlockArena> arena;
+		return arena;
+	}
+
+protected:
+	BlockArenaInfo_t info_;
+	std::vector<Region_t> regions_;
+	std::unordered_map<size_t, std::vector<FreeBlock_t>> free_;		//the blocks given back by size
+	char* curr_{ nullptr };		//the rest of the last region
+	char* end_{ nullptr };
+	size_t currPage_{ 0 };		//the page of the last region given back one by one, 0: none
+	size_t pageBytes_{ 4096 };
+	ArenaUsage_t usage_;
+	std::mutex mtx_;
+};
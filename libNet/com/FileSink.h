@@ -0,0 +1,304 @@
+#pragma once
+//========================================================================
+//[File Name]:FileSink.h
+//[Description]: a log file behind a stream buffer. the writes are only
+// copied into memory, a flusher thread commits them to the file in
+// groups(when CommitBytes are pending or every commitMs), and rotates the
+// file by size or by time. the pending bytes are bounded, the lines over
+// the bound are dropped and counted, so a slow disk doesn't block the
+// writers. on linux the file can be appended through a mapping instead
+// of write calls, its end reads as zeros until it is closed.
+//[Author]:Nico Hu
+//[Date]:2020-08-10
+//[Other]:Copyright (c) 2020-2050 Nico Hu
+//========================================================================
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <streambuf>
+#include <string>
+#include <thread>
+#include <vector>
+#ifdef __linux__
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+
+struct FileSinkInfo_t {
+	std::string path{ "./log.txt" };
+	size_t commitBytes{ 1024 * 64 };		//a group is committed when this is pending
+	unsigned commitMs{ 100 };				//or this long after the last commit
+	size_t maxPendingBytes{ 1024 * 1024 * 8 };	//the lines over this are dropped
+	size_t rotateBytes{ 0 };				//rotate when the file reaches this, 0: never
+	unsigned rotateSec{ 0 };				//rotate this long after the file is opened, 0: never
+	size_t keepFiles{ 0 };					//the rotated files kept, 0: all
+	bool bMmap{ false };					//append through a mapping(linux)
+};
+
+class FileSink : public std::streambuf {
+public:
+	static constexpr size_t MmapChunk = 1024 * 1024 * 4;	//the file grows by this in the mmap mode
+
+	FileSink() = default;
+	explicit FileSink(const FileSinkInfo_t& info) { Open(info); }
+	~FileSink() { Close(); }
+	FileSink(const FileSink&) = delete;
+	FileSink& operator=(const FileSink&) = delete;
+
+	//0: ok, -1: the file can't be opened.
+	int Open(const FileSinkInfo_t& info) {
+		Close();
+		info_ = info;
+		if (OpenFile() < 0)
+			return -1;
+		{
+			std::lock_guard<std::mutex> lock(mtx_);
+			bExit_ = false;
+			bOpen_ = true;
+		}
+		thread_ = std::thread([this] { Run(); });
+		return 0;
+	}
+	//commit what is pending and close the file.
+	void Close() {
+		{
+			std::lock_guard<std::mutex> lock(mtx_);
+			bExit_ = true;
+			bOpen_ = false;
+		}
+		cv_.notify_one();
+		if (thread_.joinable())
+			thread_.join();
+		CloseFile();
+	}
+	//wait until the bytes written before the call are committed.
+	void Commit() {
+		std::unique_lock<std::mutex> lock(mtx_);
+		const uint64_t mark = accepted_;
+		bCommit_ = true;
+		cv_.notify_one();
+		doneCv_.wait(lock, [&] { return committed_ >= mark || !bOpen_; });
+	}
+
+	uint64_t Dropped() const { return dropped_.load(std::memory_order_relaxed); }	//lines
+	uint64_t Written() const { return written_.load(std::memory_order_relaxed); }	//bytes
+	uint64_t Commits() const { return commits_.load(std::memory_order_relaxed); }
+	uint64_t Rotations() const { return rotations_.load(std::memory_order_relaxed); }
+	//the rotated files kept, read it after Close.
+	const std::deque<std::string>& Rotated() const { return rotated_; }
+
+protected:
+	std::streamsize xsputn(const char* s, std::streamsize n) override {
+		if (n <= 0)
+			return 0;
+		std::unique_lock<std::mutex> lock(mtx_);
+		if (pendingBytes_ + n > info_.maxPendingBytes || !bOpen_) {
+			dropped_.fetch_add(std::count(s, s + n, '\n'), std::memory_order_relaxed);
+			return n;
+		}
+		active_.append(s, static_cast<size_t>(n));
+		pendingBytes_ += static_cast<size_t>(n);
+		accepted_ += static_cast<uint64_t>(n);
+		if (active_.size() >= info_.commitBytes) {
+			lock.unlock();
+			cv_.notify_one();
+		}
+		return n;
+	}
+	int_type overflow(int_type c) override {
+		if (traits_type::eq_int_type(c, traits_type::eof()))
+			return traits_type::not_eof(c);
+		const char ch = traits_type::to_char_type(c);
+		xsputn(&ch, 1);
+		return c;
+	}
+	int sync() override { return 0; } //the flusher commits, a flush doesn't wait for the disk
+
+	void Run() {
+		std::string group;
+		auto last = std::chrono::steady_clock::now();
+		while (true) {
+			bool exit{ false };
+			{
+				std::unique_lock<std::mutex> lock(mtx_);
+				cv_.wait_until(lock, last + std::chrono::milliseconds(info_.commitMs), [this] {
+					return bExit_ || bCommit_ || active_.size() >= info_.commitBytes; });
+				exit = bExit_;
+				bCommit_ = false;
+				group.swap(active_);
+			}
+			last = std::chrono::steady_clock::now();
+			if (!group.empty()) {
+				WriteFile(group.data(), group.size());
+				commits_.fetch_add(1, std::memory_order_relaxed);
+				written_.fetch_add(group.size(), std::memory_order_relaxed);
+			}
+			{
+				std::lock_guard<std::mutex> lock(mtx_);
+				pendingBytes_ -= group.size();
+				committed_ += group.size();
+			}
+			doneCv_.notify_all();
+			group.clear();
+			if (exit)
+				break;
+			if (NeedRotate())
+				Rotate();
+		}
+	}
+
+	bool NeedRotate() const {
+		if (info_.rotateBytes > 0 && fileBytes_ >= info_.rotateBytes)
+			return true;
+		return info_.rotateSec > 0 && time(0) - openTime_ >= static_cast<time_t>(info_.rotateSec);
+	}
+	//path -> path.YYYYmmdd-HHMMSS(-N), and a new path.
+	void Rotate() {
+		CloseFile();
+		char stamp[32] = { 0 };
+		time_t t = time(0);
+		strftime(stamp, sizeof(stamp), ".%Y%m%d-%H%M%S", localtime(&t));
+		std::string name = info_.path + stamp;
+		for (int i = 1; Exists(name); i++)
+			name = info_.path + stamp + "-" + std::to_string(i);
+		if (std::rename(info_.path.c_str(), name.c_str()) == 0) {
+			rotated_.emplace_back(name);
+			rotations_.fetch_add(1, std::memory_order_relaxed);
+		}
+		while (info_.keepFiles > 0 && rotated_.size() > info_.keepFiles) {
+			std::remove(rotated_.front().c_str());
+			rotated_.pop_front();
+		}
+		if (OpenFile() < 0)
+			std::cerr << "[FileSink] open " << info_.path << " failed" << std::endl;
+	}
+	static bool Exists(const std::string& name) {
+		FILE* file = fopen(name.c_str(), "rb");
+		if (file)
+			fclose(file);
+		return file != nullptr;
+	}
+
+	int OpenFile() {
+		openTime_ = time(0);
+#ifdef __linux__
+		if (info_.bMmap) {
+			fd_ = ::open(info_.path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+			struct stat st;
+			if (fd_ >= 0 && fstat(fd_, &st) != 0) {
+				::close(fd_);
+				fd_ = -1;
+			}
+			if (fd_ < 0)
+				return -1;
+			fileBytes_ = static_cast<size_t>(st.st_size);
+			const size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+			mapOff_ = fileBytes_ / page * page;
+			mapPos_ = fileBytes_ - mapOff_;
+			return Map();
+		}
+#endif
+		file_ = fopen(info_.path.c_str(), "ab");
+		if (file_ == nullptr)
+			return -1;
+		setvbuf(file_, nullptr, _IONBF, 0); //a group is one write
+		fseek(file_, 0, SEEK_END);
+		fileBytes_ = static_cast<size_t>(ftell(file_));
+		return 0;
+	}
+	void CloseFile() {
+#ifdef __linux__
+		if (fd_ >= 0) {
+			if (map_) {
+				munmap(map_, MmapChunk);
+				map_ = nullptr;
+			}
+			//the mapped chunk is cut back to what was written
+			if (ftruncate(fd_, static_cast<off_t>(mapOff_ + mapPos_)) != 0)
+				std::cerr << "[FileSink] truncate " << info_.path << " failed" << std::endl;
+			::close(fd_);
+			fd_ = -1;
+		}
+#endif
+		if (file_) {
+			fclose(file_);
+			file_ = nullptr;
+		}
+	}
+	void WriteFile(const char* data, size_t len) {
+#ifdef __linux__
+		if (fd_ >= 0) {
+			while (len > 0 && map_) {
+				if (mapPos_ == MmapChunk) {
+					munmap(map_, MmapChunk);
+					map_ = nullptr;
+					mapOff_ += MmapChunk;
+					mapPos_ = 0;
+					if (Map() < 0)
+						break;
+				}
+				const size_t n = std::min(len, MmapChunk - mapPos_);
+				memcpy(static_cast<char*>(map_) + mapPos_, data, n);
+				mapPos_ += n;
+				fileBytes_ += n;
+				data += n;
+				len -= n;
+			}
+			return;
+		}
+#endif
+		if (file_ && fwrite(data, 1, len, file_) == len)
+			fileBytes_ += len;
+	}
+#ifdef __linux__
+	//map the chunk at mapOff_, the file is grown to its end.
+	int Map() {
+		if (ftruncate(fd_, static_cast<off_t>(mapOff_ + MmapChunk)) != 0)
+			return -1;
+		void* p = mmap(nullptr, MmapChunk, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, static_cast<off_t>(mapOff_));
+		if (p == MAP_FAILED)
+			return -1;
+		map_ = p;
+		return 0;
+	}
+#endif
+
+protected:
+	FileSinkInfo_t info_;
+	std::mutex mtx_;
+	std::condition_variable cv_;
+	std::condition_variable doneCv_;
+	std::thread thread_;
+	bool bExit_{ false };
+	bool bOpen_{ false };				//the writes are accepted
+	bool bCommit_{ false };
+	std::string active_;				//the bytes of the next group
+	size_t pendingBytes_{ 0 };			//accepted and not yet committed
+	uint64_t accepted_{ 0 };
+	uint64_t committed_{ 0 };
+	std::atomic<uint64_t> dropped_{ 0 };
+	std::atomic<uint64_t> written_{ 0 };
+	std::atomic<uint64_t> commits_{ 0 };
+	std::atomic<uint64_t> rotations_{ 0 };
+	//the flusher's
+	FILE* file_{ nullptr };
+	size_t fileBytes_{ 0 };
+	time_t openTime_{ 0 };
+	std::deque<std::string> rotated_;
+#ifdef __linux__
+	int fd_{ -1 };
+	void* map_{ nullptr };
+	size_t mapOff_{ 0 };				//the offset of the mapped chunk in the file
+	size_t mapPos_{ 0 };				//the bytes written into it
+#endif
+};
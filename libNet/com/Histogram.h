@@ -0,0 +1,129 @@
+#pragma once
+//========================================================================
+//[File Name]:Histogram.h
+//[Description]: a log-linear(HDR style) histogram of latencies. a value is
+//  counted exactly up to 2^SubBits, above it each power of 2 is cut into
+//  2^(SubBits-1) buckets, so a percentile is off by less than 1/2^(SubBits-1)
+//  of its value. one thread records into a histogram, any thread may read
+//  it or merge it into another one meanwhile.
+//[Author]:Nico Hu
+//[Date]:2020-08-10
+//[Other]:Copyright (c) 2020-2050 Nico Hu
+//========================================================================
+#include <atomic>
+#include <cstdint>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+class Histogram {
+public:
+	static constexpr unsigned SubBits = 7;		//<1.6% off
+	static constexpr unsigned MaxBits = 36;		//the values from 2^MaxBits(68s in ns) are counted in the last bucket
+	static constexpr uint64_t Half = uint64_t(1) << (SubBits - 1);
+	static constexpr size_t BucketNum = static_cast<size_t>((MaxBits - SubBits + 2) * Half);
+
+	Histogram() = default;
+	Histogram(const Histogram& other) { Merge(other); }
+	Histogram& operator=(const Histogram& other) {
+		if (this != &other) {
+			Reset();
+			Merge(other);
+		}
+		return *this;
+	}
+
+	//only the recording thread calls it, the counters are bumped without a locked instruction.
+	void Record(uint64_t value) {
+		Bump(counts_[Index(value)], 1);
+		Bump(count_, 1);
+		Bump(sum_, value);
+		if (value > max_.load(std::memory_order_relaxed))
+			max_.store(value, std::memory_order_relaxed);
+		if (value < min_.load(std::memory_order_relaxed))
+			min_.store(value, std::memory_order_relaxed);
+	}
+	//add the counts of other, nothing else records into this one meanwhile.
+	void Merge(const Histogram& other) {
+		if (other.Count() == 0)
+			return;
+		for (size_t i = 0; i < BucketNum; i++) {
+			const uint64_t n = other.counts_[i].load(std::memory_order_relaxed);
+			if (n > 0)
+				Bump(counts_[i], n);
+		}
+		Bump(count_, other.Count());
+		Bump(sum_, other.sum_.load(std::memory_order_relaxed));
+		if (other.Max() > Max())
+			max_.store(other.Max(), std::memory_order_relaxed);
+		if (other.min_.load(std::memory_order_relaxed) < min_.load(std::memory_order_relaxed))
+			min_.store(other.min_.load(std::memory_order_relaxed), std::memory_order_relaxed);
+	}
+	void Reset() {
+		for (auto& var : counts_)
+			var.store(0, std::memory_order_relaxed);
+		count_.store(0, std::memory_order_relaxed);
+		sum_.store(0, std::memory_order_relaxed);
+		max_.store(0, std::memory_order_relaxed);
+		min_.store(UINT64_MAX, std::memory_order_relaxed);
+	}
+
+	uint64_t Count() const { return count_.load(std::memory_order_relaxed); }
+	uint64_t Max() const { return max_.load(std::memory_order_relaxed); }
+	uint64_t Min() const { return Count() > 0 ? min_.load(std::memory_order_relaxed) : 0; }
+	double Mean() const { return Count() > 0 ? static_cast<double>(sum_.load(std::memory_order_relaxed)) / Count() : 0.0; }
+	//the value under which percent(0-100) of the values are, as the highest value of its bucket.
+	uint64_t Percentile(double percent) const {
+		const uint64_t count = Count();
+		if (count == 0)
+			return 0;
+		uint64_t target = static_cast<uint64_t>(percent / 100.0 * count + 0.5);
+		target = target < 1 ? 1 : (target > count ? count : target);
+		uint64_t acc{ 0 };
+		for (size_t i = 0; i < BucketNum; i++) {
+			acc += counts_[i].load(std::memory_order_relaxed);
+			if (acc >= target) {
+				const uint64_t value = HighestOf(i);
+				return value < Max() ? value : Max();
+			}
+		}
+		return Max();
+	}
+
+	static size_t Index(uint64_t value) {
+		if (value < (uint64_t(1) << SubBits))
+			return static_cast<size_t>(value);
+		if (value >> MaxBits)
+			return BucketNum - 1;
+		const unsigned shift = Msb(value) - SubBits + 1;
+		return static_cast<size_t>(shift * Half + (value >> shift));
+	}
+	static uint64_t HighestOf(size_t index) {
+		if (index < 2 * Half)
+			return index;
+		const uint64_t shift = index / Half - 1;
+		const uint64_t sub = index - shift * Half;
+		return ((sub + 1) << shift) - 1;
+	}
+
+protected:
+	static void Bump(std::atomic<uint64_t>& counter, uint64_t n) {
+		counter.store(counter.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+	}
+	static unsigned Msb(uint64_t value) {
+#ifdef _MSC_VER
+		unsigned long index{ 0 };
+		_BitScanReverse64(&index, value);
+		return static_cast<unsigned>(index);
+#else
+		return 63 - static_cast<unsigned>(__builtin_clzll(value));
+#endif
+	}
+
+protected:
+	std::atomic<uint64_t> counts_[BucketNum]{};
+	std::atomic<uint64_t> count_{ 0 };
+	std::atomic<uint64_t> sum_{ 0 };
+	std::atomic<uint64_t> max_{ 0 };
+	std::atomic<uint64_t> min_{ UINT64_MAX };
+};
@@ -7,10 +7,9 @@
 //[Other]:Copyright (c) 2020-2050 Nico Hu
 //========================================================================
 #include <iostream>
-#include <stdarg.h>
-#include <fstream>
-#include <mutex>
-#include <time.h>
+
+#include "AsyncLogger.h"
+#include "FileSink.h"
 
 
 constexpr char LOG_FILE[] = "./log.txt";
@@ -32,65 +31,76 @@ public:
 		return sInstance_;
 	}
 	~Log() {
-		if (ofs_.is_open())
-			ofs_.close();
+		//the records still in the rings write to ofs_, then the sink commits them.
+		if (AsyncLogger::Instance())
+			AsyncLogger::Instance()->Flush();
+		sink_.Close();
+	}
+
+	//reopen the log with the commit, rotation and memory settings of info. 0: ok, -1: the file can't be opened.
+	int Open(const FileSinkInfo_t& info) {
+		if (AsyncLogger::Instance())
+			AsyncLogger::Instance()->Flush();
+		file_ = info.path;
+		return sink_.Open(info);
+	}
+	//wait until the lines written before the call are in the file.
+	void Commit() {
+		if (AsyncLogger::Instance())
+			AsyncLogger::Instance()->Flush();
+		sink_.Commit();
 	}
+	const FileSink& Sink() const { return sink_; }
 
-	void Write(LOG_LEV log_lev, const char* format, ...) {
-		char lev[16] = {0};
+	//the args are numbers, pointers or strings(copied), the format is a string literal. the line is formatted
+	//and written to the file by the background thread of the AsyncLogger.
+	template<typename... Args>
+	void Write(LOG_LEV log_lev, const char* format, const Args&... args) {
+		const char* lev{ "" };
+		E_LOG_LEV_T level{ E_LOG_LEV_T::e_Info };
 		switch (log_lev) {
-		case LOG_LEV::e_Info: 
-		{
-			sprintf_s(lev, "%s", "[Info] ");
+		case LOG_LEV::e_Info:
+			lev = "[Info] ";
 			break;
-		}
 		case LOG_LEV::e_Verbos:
-		{
-			sprintf_s(lev, "%s", "[Verbos] ");
+			lev = "[Verbos] ";
+			level = E_LOG_LEV_T::e_Debug;
 			break;
-		}
 		case LOG_LEV::e_Warning:
-		{
-			sprintf_s(lev, "%s", "[Warning] ");
+			lev = "[Warning] ";
+			level = E_LOG_LEV_T::e_Warning;
 			break;
-		}
 		case LOG_LEV::e_Error:
-		{
-			sprintf_s(lev, "%s", "[Error] ");
+			lev = "[Error] ";
+			level = E_LOG_LEV_T::e_Error;
 			break;
-		}
 		default:
 			break;
 		}
-		char buff[1024] = { 0 };
-		va_list st;
-		va_start(st, format);
-		vsprintf_s(buff, format, st);
-		time_t t = time(0);
-		char tmp[64];
-		strftime(tmp, sizeof(tmp), "[%Y-%m-%d %H:%M:%S] ", localtime(&t));
+		if (!AsyncLogger::Enabled(level))
+			return;
 		try
 		{
-			if (!ofs_.is_open()) {
-				ofs_.open(file_.c_str(), std::ofstream::out | std::ofstream::app);
-			}
-			{
-				std::lock_guard<std::mutex> lock(mtx_);
-				ofs_ << lev << tmp << buff << std::endl;
-				ofs_.flush();
-			}
+			AsyncLogger* logger = AsyncLogger::Instance();
+			if (logger)
+				logger->Write(level, ofs_, lev, format, args...);
+			else
+				AsyncLogger::WriteSync(ofs_, lev, format, args...);
 		}
 		catch (const std::exception& e)
 		{
 			std::cerr << "Log write raise ex:" << e.what() << std::endl;
-		}		
-		va_end(st);
+		}
 	}
 
 protected:
-	Log() : file_(LOG_FILE) {
+	//the logger is created first, so it exits after the log.
+	Log() : file_(LOG_FILE), ofs_(&sink_) {
+		AsyncLogger::Instance();
 		static Gargo gargo;
-		ofs_.open(file_.c_str(), std::ofstream::out | std::ofstream::app);
+		FileSinkInfo_t info;
+		info.path = file_;
+		sink_.Open(info);
 	}
 	Log(const Log&) = delete;
 	Log& operator=(const Log&) = delete;
@@ -100,8 +110,8 @@ protected:
 protected:
 	static Log* sInstance_;
 	std::string file_;
-	std::ofstream ofs_;
-	std::mutex mtx_;
+	FileSink sink_;			//the file, committed in groups by its flusher
+	std::ostream ofs_;
 
 	class Gargo {
 	public:
@@ -0,0 +1,114 @@
+#pragma once
+//========================================================================
+//[File Name]:MpscQueue.h
+//[Description]:a bounded lock-free multi-producer/single-consumer queue.
+//              the elements live in a ring of cells allocated once, each
+//              cell carries a sequence number which tells whether it is
+//              free for the producer of a lap or ready for the consumer,
+//              so a push is one CAS on the enqueue position and a pop
+//              takes no atomic RMW at all. no heap allocation per element.
+//[Author]:Nico Hu
+//[Date]:2020-08-10
+//[Other]:Copyright (c) 2020-2050 Nico Hu
+//========================================================================
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+template<typename T>
+class MpscQueue
+{
+	enum { e_CacheLine = 64 };
+
+	struct Cell {
+		std::atomic<size_t> seq;
+		T data;
+	};
+
+public:
+	//the capacity is rounded up to a power of 2.
+	explicit MpscQueue(size_t capacity) { Init(capacity); }
+	~MpscQueue() { delete[] cells_; }
+	MpscQueue(const MpscQueue&) = delete;
+	MpscQueue& operator=(const MpscQueue&) = delete;
+
+	//thread safe for any producer, return false if the queue is full(t is left untouched).
+	bool Push(T&& t) {
+		size_t pos = enqueuePos_.load(std::memory_order_relaxed);
+		Cell* cell{ nullptr };
+		while (true) {
+			cell = &cells_[pos & mask_];
+			const size_t seq = cell->seq.load(std::memory_order_acquire);
+			const intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+			if (diff == 0) {
+				if (enqueuePos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+					break;
+			}
+			else if (diff < 0)
+				return false;
+			else
+				pos = enqueuePos_.load(std::memory_order_relaxed);
+		}
+		cell->data = std::move(t);
+		cell->seq.store(pos + 1, std::memory_order_release);
+		return true;
+	}
+	//consumer only, return false if no published element is at the front.
+	bool Pop(T& t) {
+		const size_t pos = dequeuePos_.load(std::memory_order_relaxed);
+		Cell* cell = &cells_[pos & mask_];
+		if (cell->seq.load(std::memory_order_acquire) != pos + 1)
+			return false;
+		t = std::move(cell->data);
+		cell->seq.store(pos + mask_ + 1, std::memory_order_release);
+		dequeuePos_.store(pos + 1, std::memory_order_relaxed);
+		return true;
+	}
+	//consumer only, the element at the front(nullptr if none is published), which stays queued until Pop.
+	T* Front() {
+		const size_t pos = dequeuePos_.load(std::memory_order_relaxed);
+		Cell* cell = &cells_[pos & mask_];
+		if (cell->seq.load(std::memory_order_acquire) != pos + 1)
+			return nullptr;
+		return &cell->data;
+	}
+	//consumer only. it is also the re-check of a consumer which is going to sleep, so it is seq_cst.
+	bool Empty() const {
+		const size_t pos = dequeuePos_.load(std::memory_order_relaxed);
+		return cells_[pos & mask_].seq.load(std::memory_order_seq_cst) != pos + 1;
+	}
+	//approximate, the elements claimed by the producers minus those taken by the consumer.
+	size_t Size() const {
+		const size_t enq = enqueuePos_.load(std::memory_order_relaxed);
+		const size_t deq = dequeuePos_.load(std::memory_order_relaxed);
+		return enq > deq ? enq - deq : 0;
+	}
+	size_t Capacity() const { return mask_ + 1; }
+	//resize an empty queue, not thread safe: only before the producers start.
+	void Reset(size_t capacity) {
+		assert(Size() == 0);
+		delete[] cells_;
+		Init(capacity);
+	}
+
+protected:
+	void Init(size_t capacity) {
+		size_t size{ 2 };
+		while (size < capacity)
+			size <<= 1;
+		cells_ = new Cell[size];
+		for (size_t i = 0; i < size; i++)
+			cells_[i].seq.store(i, std::memory_order_relaxed);
+		mask_ = size - 1;
+		enqueuePos_.store(0, std::memory_order_relaxed);
+		dequeuePos_.store(0, std::memory_order_relaxed);
+	}
+
+protected:
+	Cell* cells_{ nullptr };
+	size_t mask_{ 0 };
+	alignas(e_CacheLine) std::atomic<size_t> enqueuePos_{ 0 };	//contended by the producers
+	alignas(e_CacheLine) std::atomic<size_t> dequeuePos_{ 0 };	//only written by the consumer
+};
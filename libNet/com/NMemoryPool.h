@@ -3,16 +3,39 @@
 //[File Name]:NMemoryPool.h
 //[Description]:A implemetation of memory pool based on linked list,
 //              which allow to alloc any standerd type(like:char,int etc.)
-//               and user-defined struct.
+//               and user-defined struct. a slot is the size tag and the
+//               array, aligned for the link of the free list it is put on.
+//               the blocks whose slots are all free can be given back by Trim.
+//               the blocks come from the heap, or from an arena if given.
 //[Author]:Nico Hu
 //[Date]:2020-07-22
 //[Other]:Copyright (c) 2020-2050 Nico Hu
 //========================================================================
 #include <stdint.h>
+#include <algorithm>
+#include <limits>
 #include <mutex>
+#include <utility>
+#include <vector>
+#include "BlockArena.h"
 
 #define THREAD_SAFE
 
+//the state of a pool. the reserved bytes are of the blocks, the used bytes of the live arrays.
+struct PoolInfo_t {
+    size_t slotSize{ 0 };           //the tag and the array
+    size_t blocks{ 0 };
+    size_t liveSlots{ 0 };
+    size_t freeSlots{ 0 };          //on the free list
+    size_t untouchedSlots{ 0 };     //never allocated, in the last block
+    size_t bytesReserved{ 0 };
+    size_t bytesUsed{ 0 };
+    uint64_t hits{ 0 };             //the allocs served by the free list
+    uint64_t misses{ 0 };           //the allocs which carved a new slot
+    uint64_t trimmedBlocks{ 0 };
+    uint64_t trimmedBytes{ 0 };
+};
+
 template<typename T, typename SizeType = uint16_t, size_t BlockSize = 4096>
 class NMemoryPool
 {
@@ -27,15 +50,16 @@ public:
         typedef NMemoryPool<U> other;
     };
 
-    explicit NMemoryPool(SizeType arr_size) noexcept :ArrSize_(arr_size), 
-        timesB_(ArrSize_ / BlockSize + 1){ Expand(); }
+    //a block must hold the link, the padding and a slot at least.
+    explicit NMemoryPool(SizeType arr_size, BlockArena* arena = nullptr) :ArrSize_(arr_size), slotSize_(HeadSize + AlignUp(ArrSize_ * sizeof(T))),
+        timesB_(static_cast<uint16_t>((slotSize_ + sizeof(SlotPtr_t) + alignof(Slot_t)) / BlockSize + 1)), arena_(arena){ Expand(); }
     ~NMemoryPool() noexcept {
         try
         {
             SlotPtr_t curr = currBlock_;
             while (curr != nullptr) {
                 SlotPtr_t prev = curr->next;
-                operator delete(reinterpret_cast<void*>(curr));
+                FreeBlock(curr);
                 curr = prev;
             }
         }
@@ -49,31 +73,125 @@ public:
 #ifdef THREAD_SAFE
         std::lock_guard<std::mutex> lock(mtx_);
 #endif // THREAD_SAFE   
-        if (freeSlots_ != nullptr) {
-            pT p_r = reinterpret_cast<pT>(freeSlots_);
-            freeSlots_ = freeSlots_->next;
-            return p_r;
+        return AllocSlot();
+    }
+    void Free(pT p) {
+#ifdef THREAD_SAFE
+        std::lock_guard<std::mutex> lock(mtx_);
+#endif // THREAD_SAFE   
+        FreeSlot(p);
+    }
+    //n slots under one lock, return the number got(less than n if the memory is out).
+    size_t AllocBatch(pT* ps, size_t n) {
+#ifdef THREAD_SAFE
+        std::lock_guard<std::mutex> lock(mtx_);
+#endif // THREAD_SAFE   
+        size_t i{ 0 };
+        try
+        {
+            for (; i < n; i++)
+                ps[i] = AllocSlot();
         }
-        else {
-            if(lastSlot_ < currSlot_ )
-                Expand();
-            SizeType* p_mem = reinterpret_cast<SizeType*>(currSlot_);
-            *p_mem = ArrSize_;
-            pT p_r = reinterpret_cast<pT>(p_mem + 1);
-            int size = ArrSize_ * sizeof(Slot_t) + sizeof(SizeType);
-            currSlot_ = currSlot_ + size;
-            return p_r;
+        catch (const std::bad_alloc&)
+        {
         }
+        return i;
     }
-    void Free(pT p) {
+    void FreeBatch(pT* ps, size_t n) {
 #ifdef THREAD_SAFE
         std::lock_guard<std::mutex> lock(mtx_);
 #endif // THREAD_SAFE   
-        if (p != nullptr) {
-            SlotPtr_t p_s = reinterpret_cast<SlotPtr_t>(p);
-            p_s->next = freeSlots_;
-            freeSlots_ = p_s;
+        for (size_t i = 0; i < n; i++)
+            FreeSlot(ps[i]);
+    }
+    SizeType ArrSize() const { return ArrSize_; }
+    PoolInfo_t GetInfo() {
+#ifdef THREAD_SAFE
+        std::lock_guard<std::mutex> lock(mtx_);
+#endif // THREAD_SAFE   
+        PoolInfo_t info;
+        info.slotSize = slotSize_;
+        info.blocks = blocks_;
+        info.liveSlots = carved_ - freeCount_;
+        info.freeSlots = freeCount_;
+        info.untouchedSlots = currSlot_ != nullptr && currSlot_ <= lastSlot_ ? (lastSlot_ - currSlot_) / slotSize_ + 1 : 0;
+        info.bytesReserved = blocks_ * BlockBytes();
+        info.bytesUsed = info.liveSlots * ArrSize_ * sizeof(T);
+        info.hits = hits_;
+        info.misses = misses_;
+        info.trimmedBlocks = trimmedBlocks_;
+        info.trimmedBytes = trimmedBytes_;
+        return info;
+    }
+    //give back the blocks whose slots are all free, but keep_bytes of them. return the bytes given back.
+    size_t Trim(size_t keep_bytes = 0) {
+#ifdef THREAD_SAFE
+        std::lock_guard<std::mutex> lock(mtx_);
+#endif // THREAD_SAFE   
+        if (currBlock_ == nullptr || (freeCount_ == 0 && currSlot_ != FirstSlot(reinterpret_cast<DataPtr_t>(currBlock_))))
+            return 0;
+        //the blocks by address, with the free slots of each
+        std::vector<std::pair<uintptr_t, size_t>> blocks;
+        blocks.reserve(blocks_);
+        for (SlotPtr_t curr = currBlock_; curr != nullptr; curr = curr->next)
+            blocks.emplace_back(reinterpret_cast<uintptr_t>(curr), 0);
+        std::sort(blocks.begin(), blocks.end());
+        for (SlotPtr_t p = freeSlots_; p != nullptr; p = p->next)
+            BlockOf(blocks, p)->second++;
+
+        //the last block is kept first, for its untouched slots
+        const uintptr_t last = reinterpret_cast<uintptr_t>(currBlock_);
+        const size_t released_mark = (std::numeric_limits<size_t>::max)();
+        size_t kept{ 0 }, released{ 0 };
+        auto decide = [&](std::pair<uintptr_t, size_t>& block) {
+            const DataPtr_t start = reinterpret_cast<DataPtr_t>(block.first);
+            //no current slot after the head block was given back: the new head is all carved
+            const size_t carved = block.first == last && currSlot_ != nullptr ? (currSlot_ - FirstSlot(start)) / slotSize_ : SlotsOf(start);
+            if (block.second != carved)
+                return;
+            if (kept + BlockBytes() <= keep_bytes) {
+                kept += BlockBytes();
+                return;
+            }
+            carved_ -= carved;
+            freeCount_ -= block.second;
+            block.second = released_mark;
+            released++;
+        };
+        decide(*BlockOf(blocks, currBlock_));
+        for (auto& var : blocks) {
+            if (var.first != last)
+                decide(var);
+        }
+        if (released == 0)
+            return 0;
+
+        //the free list without the slots of the blocks given back, in its order
+        SlotPtr_t* tail = &freeSlots_;
+        for (SlotPtr_t p = freeSlots_; p != nullptr;) {
+            SlotPtr_t next = p->next;
+            if (BlockOf(blocks, p)->second != released_mark) {
+                *tail = p;
+                tail = &p->next;
+            }
+            p = next;
+        }
+        *tail = nullptr;
+        for (SlotPtr_t* link = &currBlock_; *link != nullptr;) {
+            SlotPtr_t curr = *link;
+            if (BlockOf(blocks, curr)->second != released_mark) {
+                link = &curr->next;
+                continue;
+            }
+            if (reinterpret_cast<uintptr_t>(curr) == last)
+                currSlot_ = lastSlot_ = nullptr;    //the blocks left are all carved, the next slot is of a new block
+            *link = curr->next;
+            FreeBlock(curr);
         }
+        blocks_ -= released;
+        trimmedBlocks_ += released;
+        trimmedBytes_ += released * BlockBytes();
+        return released * BlockBytes();
     }
     template <typename U, typename... Args>
     void Construct(U* p, Args&&... args) {
@@ -87,18 +205,48 @@ public:
     }
 
 protected:
+    //the slots are carved in bytes: the tag right before the array, which starts aligned.
+    pT AllocSlot() {
+        if (freeSlots_ != nullptr) {
+            pT p_r = reinterpret_cast<pT>(freeSlots_);
+            freeSlots_ = freeSlots_->next;
+            freeCount_--;
+            hits_++;
+            return p_r;
+        }
+        if (currSlot_ == nullptr || currSlot_ > lastSlot_)
+            Expand();
+        pT p_r = reinterpret_cast<pT>(currSlot_ + HeadSize);
+        *(reinterpret_cast<SizeType*>(p_r) - 1) = ArrSize_;
+        currSlot_ += slotSize_;
+        carved_++;
+        misses_++;
+        return p_r;
+    }
+    void FreeSlot(pT p) {
+        if (p != nullptr) {
+            SlotPtr_t p_s = reinterpret_cast<SlotPtr_t>(p);
+            p_s->next = freeSlots_;
+            freeSlots_ = p_s;
+            freeCount_++;
+        }
+    }
+    //the array holds the link while the slot is free.
+    static size_t AlignUp(size_t size) {
+        size = size > sizeof(Slot_t) ? size : sizeof(Slot_t);
+        return (size + alignof(Slot_t) - 1) / alignof(Slot_t) * alignof(Slot_t);
+    }
     void Expand() {
         try
         {
-            DataPtr_t newBlock = reinterpret_cast<DataPtr_t>(operator new(BlockSize * timesB_));
+            DataPtr_t newBlock = reinterpret_cast<DataPtr_t>(arena_ ? arena_->Alloc(BlockBytes()) : operator new(BlockBytes()));
+            if (newBlock == nullptr)
+                throw std::bad_alloc();
             reinterpret_cast<SlotPtr_t>(newBlock)->next = currBlock_;
             currBlock_ = reinterpret_cast<SlotPtr_t>(newBlock);
-            DataPtr_t body = newBlock + sizeof(SlotPtr_t);
-            uintptr_t result = reinterpret_cast<uintptr_t>(body);
-            auto n = alignof(Slot_t);
-            size_t bodyPadding = (alignof(Slot_t) - result) % alignof(Slot_t);
-            currSlot_ = reinterpret_cast<SlotPtr_t>(body + bodyPadding);
-            lastSlot_ = reinterpret_cast<SlotPtr_t>(newBlock + BlockSize - (ArrSize_ * sizeof(Slot_t) + sizeof(SizeType)) + 1);
+            currSlot_ = FirstSlot(newBlock);
+            lastSlot_ = newBlock + BlockBytes() - slotSize_;
+            blocks_++;
         }
         catch (std::bad_alloc& e)
         {
@@ -116,14 +264,50 @@ protected:
     typedef Slot Slot_t;
     typedef Slot* SlotPtr_t;
 
+    static constexpr size_t HeadSize = (sizeof(SizeType) + alignof(Slot_t) - 1) / alignof(Slot_t) * alignof(Slot_t);	//the tag, padded so the array is aligned
+
+    size_t BlockBytes() const { return BlockSize * timesB_; }
+    void FreeBlock(SlotPtr_t block) {
+        if (arena_)
+            arena_->Free(block, BlockBytes());
+        else
+            operator delete(reinterpret_cast<void*>(block));
+    }
+    //the first slot of a block is after the link, aligned.
+    static DataPtr_t FirstSlot(DataPtr_t block) {
+        DataPtr_t body = block + sizeof(SlotPtr_t);
+        uintptr_t result = reinterpret_cast<uintptr_t>(body);
+        size_t bodyPadding = (alignof(Slot_t) - result % alignof(Slot_t)) % alignof(Slot_t);
+        return body + bodyPadding;
+    }
+    size_t SlotsOf(DataPtr_t block) const {
+        return (block + BlockBytes() - slotSize_ - FirstSlot(block)) / slotSize_ + 1;
+    }
+    //the block holding p, of the blocks sorted by address.
+    template <typename U>
+    static typename std::vector<std::pair<uintptr_t, size_t>>::iterator BlockOf(std::vector<std::pair<uintptr_t, size_t>>& blocks, U* p) {
+        const uintptr_t addr = reinterpret_cast<uintptr_t>(p);
+        return std::upper_bound(blocks.begin(), blocks.end(), addr, [](uintptr_t v, const std::pair<uintptr_t, size_t>& b) { return v < b.first; }) - 1;
+    }
+
     SlotPtr_t currBlock_{ nullptr };
-    SlotPtr_t currSlot_{ nullptr };
-    SlotPtr_t lastSlot_{ nullptr };
+    DataPtr_t currSlot_{ nullptr };	//the next slot never used, in the last block
+    DataPtr_t lastSlot_{ nullptr };	//the last slot which fits the last block
     SlotPtr_t freeSlots_{ nullptr };
 
     SizeType ArrSize_{ 0 };
+    size_t slotSize_{ 0 };
     uint16_t timesB_{ 1 };
+    BlockArena* arena_{ nullptr };      //not owned, the heap if null
     std::mutex mtx_;
 
+    size_t blocks_{ 0 };
+    size_t carved_{ 0 };        //the slots ever allocated of the blocks held
+    size_t freeCount_{ 0 };
+    uint64_t hits_{ 0 };
+    uint64_t misses_{ 0 };
+    uint64_t trimmedBlocks_{ 0 };
+    uint64_t trimmedBytes_{ 0 };
+
     static_assert(BlockSize >= 2 * sizeof(Slot_t), "[NMemoryPool]:BlockSize is too small!");
 };
\ No newline at end of file
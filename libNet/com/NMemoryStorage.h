@@ -2,131 +2,434 @@
 //========================================================================
 //[File Name]:NMemoryStorage.h
 //[Description]: A implemetation of memory storage based on NMemoryPool,
-//               which allowed to Alloc different size of memorys. for
-//               example: typename T = int, size list = {1, 16, 8, 64, 128, 10},
-//              NMemoryStorage will create all these size of NMemoryPool, and you can
-//              call Alloc(16) to get the memory of sizeof(int)*16. if the input size is
-//              not include in the size list, the NMemoryStorage will create this kind of 
-//              NMemoryPool, and it will aslo return the wanted size of memory.
+//               which allowed to Alloc different size of memorys. a size is
+//               rounded up to a class of a bounded geometric table(4 classes
+//               per power of 2, from MinClass to MaxClass), whose index is
+//               computed from the size. each class is a NMemoryPool, made on
+//               first use, or at once for the sizes of the list given. each
+//               thread keeps a small free list per class, which takes and
+//               gives back slots from/to the pool in batches, so the lock of
+//               a pool is taken once per batch. a size over MaxClass is taken
+//               from the heap and given back to it, no pool is made for it.
+//               the blocks of the pools whose slots are all free are given
+//               back by Trim, on demand or every interval from a thread.
+//               the blocks of the pools are taken from the arena given, by
+//               default the one of BlockArena::SetDefault when it is made.
 //[Author]:Nico Hu
 //[Date]:2020-07-23
 //[Other]:Copyright (c) 2020-2050 Nico Hu
 //========================================================================
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <initializer_list>
+#include <limits>
 #include <memory>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <unordered_map>
+#include <vector>
 #include "NMemoryPool.h"
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
 
 
 #define SAFE_DELETE(p) {if(p){delete (p); (p) = nullptr;}}
 #define SAFE_DELETE_ARRAY(p) {if(p){delete[] (p); (p) = nullptr;}}
 
-//#define THREAD_SAFE
+//the floor of log2, for the class table below.
+constexpr unsigned FloorLog2(size_t value) { return value > 1 ? 1 + FloorLog2(value >> 1) : 0; }
+
+struct StorageClassInfo_t {
+    size_t classSize{ 0 };
+    size_t liveSlots{ 0 };      //allocated by the users
+    size_t cachedSlots{ 0 };    //free, held by the caches of the threads
+    uint64_t hits{ 0 };         //the allocs served by a thread cache
+    uint64_t misses{ 0 };       //the allocs which refilled a thread cache from the pool
+    PoolInfo_t pool;
+};
+struct StorageInfo_t {
+    std::vector<StorageClassInfo_t> classes;    //the classes whose pool is made
+    size_t blocks{ 0 };
+    size_t bytesReserved{ 0 };  //of the pools and the large blocks
+    size_t bytesUsed{ 0 };
+    size_t largeLive{ 0 };
+    size_t largeBytes{ 0 };
+    uint64_t hits{ 0 };
+    uint64_t misses{ 0 };
+    uint64_t trimmedBytes{ 0 };
+};
 
 template<typename T, typename SizeType = uint16_t>
 class NMemoryStorage {
-    struct NMemPoolNode {
-        SizeType sizeType{ 0 };
-        NMemoryPool<T, SizeType>* pMemPool{ nullptr };
-        NMemPoolNode* pNext{ nullptr };
-    };
-
 public:
     typedef T* pT;
 
-    explicit NMemoryStorage(std::initializer_list<size_t> il_type_sizes) {
+    static constexpr size_t MinClass = 16;
+    static constexpr unsigned SubBits = 2;      //a size is rounded up by less than 1/2^SubBits
+    static constexpr size_t MaxClass = (std::numeric_limits<SizeType>::max)() < 65535 ? \
+        (std::numeric_limits<SizeType>::max)() : 65535;    //the largest size the tag holds, MaxPacketSize
+    static constexpr size_t ClassNum = (FloorLog2(MaxClass - 1) - FloorLog2(MinClass)) * (size_t(1) << SubBits) + \
+        (((MaxClass - 1) >> (FloorLog2(MaxClass - 1) - SubBits)) & ((size_t(1) << SubBits) - 1)) + 2;    //Index(MaxClass) + 1
+    static constexpr size_t CacheBytes = 64 * 1024;     //the bytes a thread keeps per class at most
+    static constexpr size_t CacheMax = 64;              //the slots a thread keeps per class at most
+
+    explicit NMemoryStorage(std::initializer_list<size_t> il_type_sizes, std::shared_ptr<BlockArena> arena = BlockArena::Default()) :
+        arena_(std::move(arena)), token_(std::make_shared<Token>()) {
+        for (auto& var : mpMems_)
+            var.store(nullptr, std::memory_order_relaxed);
         for (auto it = il_type_sizes.begin(); it != il_type_sizes.end(); ++it) {
-            auto p_mem_pool_node = new NMemPoolNode();
-            p_mem_pool_node->sizeType = *it;
-            p_mem_pool_node->pMemPool = new NMemoryPool<T, SizeType>(*it);
-            p_mem_pool_node->pNext = nullptr;
-            AddMemPool(&mpMems_, p_mem_pool_node);
+            if (*it > 0 && *it <= MaxClass)
+                GetPool(Index(*it));
         }
     }
     ~NMemoryStorage() { Release(); }
+    NMemoryStorage(const NMemoryStorage&) = delete;
+    NMemoryStorage& operator=(const NMemoryStorage&) = delete;
 
     pT Alloc(size_t size)
     {
-#ifdef THREAD_SAFE
-        std::lock_guard<std::mutex> lock(mtx_);
-#endif // THREAD_SAFE  
         if (size <= 0)
             return nullptr;
-        NMemPoolNode* p_node = mpMems_;
-        while (p_node) {
-            if (p_node->sizeType >= size) {
-                return p_node->pMemPool->Alloc();
-            }
-            p_node = p_node->pNext;
+        if (size > MaxClass)
+            return AllocLarge(size);
+        const size_t index = Index(size);
+        ClassCache& cache = LocalCache().classes[index];
+        if (cache.count == 0) {
+            if (Refill(index, cache) == 0)
+                return nullptr;
+            Bump(cache.misses);
         }
-
-        auto p_mem_pool_node = new NMemPoolNode();
-        p_mem_pool_node->sizeType = size;
-        p_mem_pool_node->pMemPool = new NMemoryPool<T, SizeType>(size);
-        p_mem_pool_node->pNext = nullptr;
-        AddMemPool(&mpMems_, p_mem_pool_node);
-
-        return p_mem_pool_node->pMemPool->Alloc();
+        Bump(cache.allocs);
+        return cache.items[--cache.count];
     }
     int Free(pT p)
     {
-#ifdef THREAD_SAFE
-        std::lock_guard<std::mutex> lock(mtx_);
-#endif // THREAD_SAFE
         if (p == nullptr)
             return -2;
-        SizeType* p_s = reinterpret_cast<SizeType*>(p);
-        SizeType type_size = *(p_s-1);
-        pT p_mem = reinterpret_cast<pT>(p);
-        NMemPoolNode* p_node = mpMems_;
-        while (p_node) {
-            if (p_node->sizeType == type_size) {
-                p_node->pMemPool->Free(p_mem);
-                return 0;
+        const SizeType type_size = *(reinterpret_cast<SizeType*>(p) - 1);
+        if (type_size == LargeTag) {
+            FreeLarge(p);
+            return 0;
+        }
+        const size_t index = Index(type_size);
+        if (type_size < MinClass || ClassSize(index) != type_size || !mpMems_[index].load(std::memory_order_acquire))
+            return -1;
+        ClassCache& cache = LocalCache().classes[index];
+        if (!cache.items)
+            cache.items.reset(new pT[CacheCap(index)]);
+        else if (cache.count == CacheCap(index))
+            Spill(index, cache);
+        cache.items[cache.count++] = p;
+        Bump(cache.frees);
+        return 0;
+    }
+
+    //give back the blocks of the pools whose slots are all free, each pool keeps keep_bytes of them.
+    //with an arena the blocks go back to it, which gives their pages back to the os and keeps their ranges.
+    //the slots in the caches of the other threads are not free to a pool, those of the calling thread are given back first.
+    //return the bytes given back.
+    size_t Trim(size_t keep_bytes = 0) {
+        ThreadCache* cache = FindCache();
+        if (cache)
+            Flush(cache);
+        size_t released{ 0 };
+        for (auto& var : mpMems_) {
+            NMemoryPool<T, SizeType>* pool = var.load(std::memory_order_acquire);
+            if (pool)
+                released += pool->Trim(keep_bytes);
+        }
+#ifdef __GLIBC__
+        if (released > 0)
+            malloc_trim(0);     //the heap keeps the freed blocks else
+#endif
+        return released;
+    }
+    //Trim every interval from a thread, until StopTrim or the storage is gone.
+    void StartTrim(std::chrono::milliseconds interval, size_t keep_bytes = 0) {
+        StopTrim();
+        {
+            std::lock_guard<std::mutex> lock(trimMtx_);
+            bTrimExit_ = false;
+        }
+        trimThd_ = std::thread([this, interval, keep_bytes] {
+            std::unique_lock<std::mutex> lock(trimMtx_);
+            while (!trimCv_.wait_for(lock, interval, [this] { return bTrimExit_; })) {
+                lock.unlock();
+                Trim(keep_bytes);
+                lock.lock();
             }
-            p_node = p_node->pNext;
+            });
+    }
+    void StopTrim() {
+        {
+            std::lock_guard<std::mutex> lock(trimMtx_);
+            bTrimExit_ = true;
         }
-        return -1;
+        trimCv_.notify_one();
+        if (trimThd_.joinable())
+            trimThd_.join();
+    }
+    //the counters of the threads are read as they are, so the live and cached slots are close but not exact while they run.
+    StorageInfo_t GetInfo() {
+        StorageInfo_t info;
+        std::lock_guard<std::mutex> lock(mtx_);
+        for (size_t i = 0; i < ClassNum; i++) {
+            NMemoryPool<T, SizeType>* pool = mpMems_[i].load(std::memory_order_acquire);
+            if (!pool)
+                continue;
+            StorageClassInfo_t var;
+            var.classSize = ClassSize(i);
+            var.pool = pool->GetInfo();
+            uint64_t allocs{ 0 }, frees{ 0 };
+            for (auto& cache : caches_) {
+                const ClassCache& cc = cache->classes[i];
+                allocs += cc.allocs.load(std::memory_order_relaxed);
+                frees += cc.frees.load(std::memory_order_relaxed);
+                var.misses += cc.misses.load(std::memory_order_relaxed);
+            }
+            var.hits = allocs - var.misses;
+            var.liveSlots = allocs > frees ? static_cast<size_t>(allocs - frees) : 0;
+            var.cachedSlots = var.pool.liveSlots > var.liveSlots ? var.pool.liveSlots - var.liveSlots : 0;
+            info.blocks += var.pool.blocks;
+            info.bytesReserved += var.pool.bytesReserved;
+            info.bytesUsed += var.liveSlots * var.classSize * sizeof(T);
+            info.hits += var.hits;
+            info.misses += var.misses;
+            info.trimmedBytes += var.pool.trimmedBytes;
+            info.classes.emplace_back(var);
+        }
+        info.largeLive = largeLive_.load(std::memory_order_relaxed);
+        info.largeBytes = largeBytes_.load(std::memory_order_relaxed);
+        info.bytesReserved += info.largeBytes;
+        info.bytesUsed += info.largeBytes;
+        return info;
+    }
+
+    //the class of a size(1..MaxClass), the first one holds MinClass.
+    static size_t Index(size_t size) {
+        if (size <= MinClass)
+            return 0;
+        const unsigned msb = Msb(size - 1);
+        const size_t sub = ((size - 1) >> (msb - SubBits)) & ((size_t(1) << SubBits) - 1);
+        return (msb - FloorLog2(MinClass)) * (size_t(1) << SubBits) + sub + 1;
+    }
+    static size_t ClassSize(size_t index) {
+        if (index == 0)
+            return MinClass;
+        const unsigned msb = static_cast<unsigned>((index - 1) >> SubBits) + FloorLog2(MinClass);
+        const size_t size = (size_t(1) << msb) + (((index - 1) & ((size_t(1) << SubBits) - 1)) + 1) * (size_t(1) << (msb - SubBits));
+        return size < MaxClass ? size : MaxClass;
     }
 
 protected:
-    void Release() {
-        NMemPoolNode* p_node = mpMems_;
-        while (p_node) {
-            NMemPoolNode* p_delete = p_node;
-            p_node = p_node->pNext;
-            SAFE_DELETE(p_delete->pMemPool);
-            SAFE_DELETE(p_delete);
+    //the free slots a thread keeps of a class, only that thread touches them.
+    struct ClassCache {
+        std::unique_ptr<pT[]> items;
+        size_t count{ 0 };
+        std::atomic<uint64_t> allocs{ 0 };     //written by the thread only, read by GetInfo
+        std::atomic<uint64_t> frees{ 0 };
+        std::atomic<uint64_t> misses{ 0 };
+    };
+    struct ThreadCache {
+        ClassCache classes[ClassNum];
+        bool bOwned{ true };    //under mtx_, a cache left by an ended thread is taken by a new one
+    };
+    //whether the storage is alive, for the threads which end after it.
+    struct Token {
+        std::mutex mtx;
+        std::atomic_bool bAlive{ true };
+    };
+    //the caches of a thread by the id of their storage, an id is never reused.
+    struct LocalCaches {
+        struct Entry {
+            NMemoryStorage* storage{ nullptr };
+            ThreadCache* cache{ nullptr };
+            std::shared_ptr<Token> token;
+        };
+        uint64_t lastId{ 0 };
+        ThreadCache* last{ nullptr };
+        std::unordered_map<uint64_t, Entry> caches;
+
+        //the slots of an ended thread go back to the pools of the storages which are alive.
+        ~LocalCaches() {
+            for (auto& var : caches) {
+                std::lock_guard<std::mutex> lock(var.second.token->mtx);
+                if (var.second.token->bAlive)
+                    var.second.storage->Detach(var.second.cache);
+            }
         }
+    };
+    enum : SizeType { LargeTag = 0 };
+    static constexpr size_t LargeHead = 16;     //the size and the tag of a large block, padded so the array is aligned
+    static_assert(LargeHead >= sizeof(size_t) + sizeof(SizeType), "[NMemoryStorage]:LargeHead is too small!");
+
+    static LocalCaches& Locals() {
+        thread_local LocalCaches local;
+        return local;
     }
-    void AddMemPool(NMemPoolNode** p_head, NMemPoolNode* p_new_node) {
-        if (*p_head == nullptr) {
-            p_new_node->pNext = *p_head;
-            *p_head = p_new_node;
+    //the cache of the thread if it has one.
+    ThreadCache* FindCache() {
+        LocalCaches& local = Locals();
+        if (local.lastId == id_)
+            return local.last;
+        auto find = local.caches.find(id_);
+        return find == local.caches.end() ? nullptr : find->second.cache;
+    }
+    ThreadCache& LocalCache() {
+        LocalCaches& local = Locals();
+        if (local.lastId == id_)
+            return *local.last;
+        auto find = local.caches.find(id_);
+        if (find == local.caches.end()) {
+            //a storage of the thread is gone meanwhile
+            for (auto itr = local.caches.begin(); itr != local.caches.end();) {
+                if (!itr->second.token->bAlive)
+                    itr = local.caches.erase(itr);
+                else
+                    itr++;
+            }
+            typename LocalCaches::Entry entry;
+            entry.storage = this;
+            entry.cache = Attach();
+            entry.token = token_;
+            find = local.caches.emplace(id_, std::move(entry)).first;
+        }
+        local.lastId = id_;
+        local.last = find->second.cache;
+        return *local.last;
+    }
+    ThreadCache* Attach() {
+        std::lock_guard<std::mutex> lock(mtx_);
+        for (auto& var : caches_) {
+            if (!var->bOwned) {
+                var->bOwned = true;
+                return var.get();
+            }
+        }
+        caches_.emplace_back(new ThreadCache());
+        return caches_.back().get();
+    }
+    void Flush(ThreadCache* cache) {
+        for (size_t i = 0; i < ClassNum; i++) {
+            ClassCache& var = cache->classes[i];
+            if (var.count > 0)
+                mpMems_[i].load(std::memory_order_acquire)->FreeBatch(var.items.get(), var.count);
+            var.count = 0;
         }
-        else {
-            NMemPoolNode* p_node = *p_head;
-            NMemPoolNode* p_pre = nullptr;
-            while (p_node) {
-                if (p_node->sizeType > p_new_node->sizeType) {
-                    if (p_pre) {
-                        p_new_node->pNext = p_node;
-                        p_pre->pNext = p_new_node;
-                    }
-                    else {
-                        p_new_node->pNext = p_node;
-                        *p_head = p_new_node;
-                    }
-                    break;
-                }
-                p_pre = p_node;
-                p_node = p_node->pNext;
+    }
+    void Detach(ThreadCache* cache) {
+        Flush(cache);
+        std::lock_guard<std::mutex> lock(mtx_);
+        cache->bOwned = false;
+    }
+    //a batch of a pool into an empty cache.
+    size_t Refill(size_t index, ClassCache& cache) {
+        NMemoryPool<T, SizeType>* pool = GetPool(index);
+        if (!pool)
+            return 0;
+        if (!cache.items)
+            cache.items.reset(new pT[CacheCap(index)]);
+        cache.count = pool->AllocBatch(cache.items.get(), Batch(index));
+        return cache.count;
+    }
+    //the oldest batch of a full cache back to its pool.
+    void Spill(size_t index, ClassCache& cache) {
+        const size_t batch = Batch(index);
+        mpMems_[index].load(std::memory_order_acquire)->FreeBatch(cache.items.get(), batch);
+        for (size_t i = batch; i < cache.count; i++)
+            cache.items[i - batch] = cache.items[i];
+        cache.count -= batch;
+    }
+    NMemoryPool<T, SizeType>* GetPool(size_t index) {
+        NMemoryPool<T, SizeType>* pool = mpMems_[index].load(std::memory_order_acquire);
+        if (pool)
+            return pool;
+        std::lock_guard<std::mutex> lock(mtx_);
+        pool = mpMems_[index].load(std::memory_order_relaxed);
+        if (!pool) {
+            try
+            {
+                pool = new NMemoryPool<T, SizeType>(static_cast<SizeType>(ClassSize(index)), arena_.get());
+            }
+            catch (const std::bad_alloc&)
+            {
+                return nullptr;
             }
-            if (p_node == nullptr)
-                p_pre->pNext = p_new_node;
+            mpMems_[index].store(pool, std::memory_order_release);
         }
+        return pool;
+    }
+    pT AllocLarge(size_t size) {
+        char* p_mem = static_cast<char*>(::operator new(LargeHead + size * sizeof(T), std::nothrow));
+        if (!p_mem)
+            return nullptr;
+        *reinterpret_cast<size_t*>(p_mem) = size * sizeof(T);
+        *(reinterpret_cast<SizeType*>(p_mem + LargeHead) - 1) = LargeTag;
+        largeLive_.fetch_add(1, std::memory_order_relaxed);
+        largeBytes_.fetch_add(size * sizeof(T), std::memory_order_relaxed);
+        return reinterpret_cast<pT>(p_mem + LargeHead);
+    }
+    void FreeLarge(pT p) {
+        char* p_mem = reinterpret_cast<char*>(p) - LargeHead;
+        largeLive_.fetch_sub(1, std::memory_order_relaxed);
+        largeBytes_.fetch_sub(*reinterpret_cast<size_t*>(p_mem), std::memory_order_relaxed);
+        ::operator delete(p_mem);
+    }
+    static size_t CacheCap(size_t index) {
+        const size_t cap = CacheBytes / (ClassSize(index) * sizeof(T));
+        return cap < 2 ? 2 : (cap > CacheMax ? CacheMax : cap);
+    }
+    static size_t Batch(size_t index) { return CacheCap(index) / 2; }
+    static void Bump(std::atomic<uint64_t>& counter) {
+        counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+
+    static unsigned Msb(size_t value) {
+#ifdef _MSC_VER
+        unsigned long index{ 0 };
+        _BitScanReverse64(&index, value);
+        return static_cast<unsigned>(index);
+#else
+        return 63 - static_cast<unsigned>(__builtin_clzll(value));
+#endif
+    }
+    static std::atomic<uint64_t>& NextId() {
+        static std::atomic<uint64_t> id{ 1 };
+        return id;
     }
 
-protected: 
-    NMemPoolNode* mpMems_{ nullptr };
+    void Release() {
+        StopTrim();
+        {
+            std::lock_guard<std::mutex> lock(token_->mtx);
+            token_->bAlive = false;
+        }
+        caches_.clear();
+        for (auto& var : mpMems_) {
+            NMemoryPool<T, SizeType>* pool = var.load(std::memory_order_relaxed);
+            SAFE_DELETE(pool);
+            var.store(nullptr, std::memory_order_relaxed);
+        }
+    }
+
+protected:
+    std::shared_ptr<BlockArena> arena_;     //the pools are gone before it
+    const uint64_t id_{ NextId()++ };
+    std::shared_ptr<Token> token_;
+    std::atomic<NMemoryPool<T, SizeType>*> mpMems_[ClassNum];
+    std::vector<std::unique_ptr<ThreadCache>> caches_;
     std::mutex mtx_;
-};
\ No newline at end of file
+    std::atomic<size_t> largeLive_{ 0 };
+    std::atomic<size_t> largeBytes_{ 0 };
+
+    std::thread trimThd_;
+    std::mutex trimMtx_;
+    std::condition_variable trimCv_;
+    bool bTrimExit_{ false };
+};
@@ -1,61 +1,236 @@
 #pragma once
 //========================================================================
 //[File Name]:ObjectPool.h
-//[Description]:a template implemetation of ObjectPool design pattern.
+//[Description]:a template implemetation of ObjectPool design pattern. the
+// objects of a type are constructed in chunks ahead of the requests and
+// kept on a lock-free free-list, a Get pops one into a move-only handle
+// which resets it(by its Reset(), if it has one) and pushes it back when
+// it is gone. the pool grows by a chunk when the list is empty, up to
+// maxObjects, past them Get gives an empty handle. the handles must be
+// gone before the pool.
 //[Author]:Nico Hu
 //[Date]:2020-07-15
 //[Other]:Copyright (c) 2020-2050 Nico Hu
 //========================================================================
 
-#include <string>
+#include <atomic>
+#include <cstdint>
 #include <functional>
 #include <memory>
 #include <mutex>
-#include <map>
+#include <new>
+#include <type_traits>
+#include <utility>
 #include "NonCopyable.h"
 
 
 namespace DesignPattern {
-#define THREAD_SAFE
+	struct ObjectPoolInfo_t {
+		size_t initObjects{ 32 };		//constructed with the pool
+		size_t chunkObjects{ 32 };		//constructed at a time when the pool is empty
+		size_t maxObjects{ 65536 };		//the capacity, rounded up to chunkObjects
+	};
+
+	struct ObjectPoolUsage_t {
+		size_t objects{ 0 };		//constructed
+		size_t chunks{ 0 };
+		uint64_t exhausted{ 0 };	//the gets which found no object at the capacity
+	};
 
-	constexpr int MaxObjNum = 32;
+	template<typename T, typename = void>
+	struct HasReset : std::false_type {};
+	template<typename T>
+	struct HasReset<T, std::void_t<decltype(std::declval<T&>().Reset())>> : std::true_type {};
 
 	template<typename T>
 	class ObjectPool :public NonCopyable {
-		template<typename... Args>
-		using Constructor = std::function<std::shared_ptr<T>(Args...)>;
+		struct Slot {
+			typename std::aligned_storage<sizeof(T), alignof(T)>::type obj;
+			std::atomic<uint32_t> next{ 0 };
+			uint32_t index{ 0 };
+
+			T* get() { return reinterpret_cast<T*>(&obj); }
+		};
+		static constexpr uint32_t Nil = 0xFFFFFFFF;
+
 	public:
+		class Handle {
+		public:
+			Handle() = default;
+			Handle(Handle&& ref) noexcept : pool_(ref.pool_), slot_(ref.slot_) {
+				ref.pool_ = nullptr;
+				ref.slot_ = nullptr;
+			}
+			Handle& operator=(Handle&& ref) noexcept {
+				if (this != &ref) {
+					reset();
+					std::swap(pool_, ref.pool_);
+					std::swap(slot_, ref.slot_);
+				}
+				return *this;
+			}
+			Handle(const Handle&) = delete;
+			Handle& operator=(const Handle&) = delete;
+			~Handle() { reset(); }
+
+			T* get() const { return slot_ ? slot_->get() : nullptr; }
+			T* operator->() const { return get(); }
+			T& operator*() const { return *get(); }
+			explicit operator bool() const { return slot_ != nullptr; }
+			//the object goes back to the pool.
+			void reset() {
+				if (slot_)
+					pool_->Release(slot_);
+				pool_ = nullptr;
+				slot_ = nullptr;
+			}
+
+		protected:
+			friend class ObjectPool;
+			Handle(ObjectPool* pool, Slot* slot) : pool_(pool), slot_(slot) { }
+
+			ObjectPool* pool_{ nullptr };
+			Slot* slot_{ nullptr };
+		};
+
+		//the objects are constructed by T(args...), args are kept for the chunks to come.
 		template<typename... Args>
-		void Init(size_t num, Args&&... args) {
-			if (num <= 0 || num > MaxObjNum)
-				throw std::logic_error("[ObjectPool] object num out of range.");
+		explicit ObjectPool(const ObjectPoolInfo_t& info, Args... args) : info_(info),
+			construct_([args...](void* p) { new (p) T(args...); }) {
+			if (info_.chunkObjects == 0)
+				info_.chunkObjects = 1;
+			if (info_.maxObjects > Nil - info_.chunkObjects)
+				info_.maxObjects = Nil - info_.chunkObjects;
+			maxChunks_ = (info_.maxObjects + info_.chunkObjects - 1) / info_.chunkObjects;
+			if (maxChunks_ == 0)
+				maxChunks_ = 1;
+			chunks_.reset(new std::atomic<Slot*>[maxChunks_]);
+			for (size_t i = 0; i < maxChunks_; i++)
+				chunks_[i].store(nullptr, std::memory_order_relaxed);
+			std::lock_guard<std::mutex> lock(growMtx_);
+			while (objects_ < info_.initObjects && Grow()) {}
+		}
+		ObjectPool() : ObjectPool(ObjectPoolInfo_t()) { }
+		~ObjectPool() {
+			for (size_t c = 0; c < chunkNum_; c++) {
+				Slot* chunk = chunks_[c].load(std::memory_order_relaxed);
+				for (size_t i = 0; i < info_.chunkObjects; i++) {
+					chunk[i].get()->~T();
+					chunk[i].~Slot();
+				}
+				::operator delete(chunk);
+			}
+		}
 
-			auto c_name = typeid(Constructor<Args...>).name();
-			for (size_t i = 0; i < num; i++) {
-				objMap_.emplace(c_name, std::shared_ptr<T>(new T(std::forward<Args>(args)...), [this, c_name](T* p) {
-					objMap_.emplace(c_name, std::shared_ptr<T>(p));
-					}));
+		//an object off the free-list, empty if the pool is at its capacity(or out of memory).
+		Handle Get() {
+			Slot* slot = Pop();
+			while (slot == nullptr) {
+				{
+					std::lock_guard<std::mutex> lock(growMtx_);
+					//another thread may have grown the pool or given an object back
+					if (Index(head_.load(std::memory_order_acquire)) == Nil && !Grow()) {
+						exhausted_++;
+						return Handle();
+					}
+				}
+				slot = Pop();
 			}
+			return Handle(this, slot);
 		}
-		template<typename... Args>
-		std::shared_ptr<T> Get() {
-#ifdef THREAD_SAFE
-			std::lock_guard<std::mutex> lock(mtx_);
-#endif //THREAD_SAFE
-			std::string c_name = typeid(Constructor<Args...>).name();
-			auto range = objMap_.equal_range(c_name);
-			for (auto it = range.first; it != range.second; ++it) {
-				auto ptr = it->second;
-				objMap_.erase(it);
-				return ptr;
+
+		ObjectPoolUsage_t GetUsage() {
+			std::lock_guard<std::mutex> lock(growMtx_);
+			ObjectPoolUsage_t usage;
+			usage.objects = objects_;
+			usage.chunks = chunkNum_;
+			usage.exhausted = exhausted_;
+			return usage;
+		}
+		const ObjectPoolInfo_t& Info() const { return info_; }
+
+	protected:
+		//the head is the index of the first free slot and a tag, bumped by each change so a
+		//slot popped and pushed back between a load and a CAS doesn't pass for the old head.
+		static uint32_t Index(uint64_t head) { return static_cast<uint32_t>(head); }
+		static uint64_t Pack(uint32_t index, uint64_t head) { return ((head >> 32) + 1) << 32 | index; }
+
+		Slot* SlotOf(uint32_t index) {
+			return chunks_[index / info_.chunkObjects].load(std::memory_order_acquire) + index % info_.chunkObjects;
+		}
+		Slot* Pop() {
+			uint64_t head = head_.load(std::memory_order_acquire);
+			while (Index(head) != Nil) {
+				Slot* slot = SlotOf(Index(head));
+				const uint64_t next = Pack(slot->next.load(std::memory_order_relaxed), head);
+				if (head_.compare_exchange_weak(head, next, std::memory_order_acq_rel, std::memory_order_acquire))
+					return slot;
 			}
 			return nullptr;
 		}
+		//first...last are linked by their next.
+		void Push(Slot* first, Slot* last) {
+			uint64_t head = head_.load(std::memory_order_relaxed);
+			do {
+				last->next.store(Index(head), std::memory_order_relaxed);
+			} while (!head_.compare_exchange_weak(head, Pack(first->index, head), std::memory_order_release, std::memory_order_relaxed));
+		}
+		void Release(Slot* slot) {
+			Reset(*slot->get());
+			Push(slot, slot);
+		}
+		template<typename U = T>
+		static void Reset(U& obj) {
+			if constexpr (HasReset<U>::value)
+				obj.Reset();
+		}
+
+		//a chunk of objects onto the free-list, under growMtx_.
+		bool Grow() {
+			if (chunkNum_ >= maxChunks_)
+				return false;
+			const size_t num = info_.chunkObjects;
+			Slot* chunk = static_cast<Slot*>(::operator new(sizeof(Slot) * num, std::nothrow));
+			if (chunk == nullptr)
+				return false;
+			const uint32_t base = static_cast<uint32_t>(chunkNum_ * num);
+			size_t made{ 0 };
+			try
+			{
+				for (; made < num; made++) {
+					new (&chunk[made]) Slot();
+					chunk[made].index = base + static_cast<uint32_t>(made);
+					chunk[made].next.store(made + 1 < num ? base + static_cast<uint32_t>(made) + 1 : Nil, std::memory_order_relaxed);
+					construct_(&chunk[made].obj);
+				}
+			}
+			catch (...)
+			{
+				chunk[made].~Slot();
+				for (size_t i = 0; i < made; i++) {
+					chunk[i].get()->~T();
+					chunk[i].~Slot();
+				}
+				::operator delete(chunk);
+				return false;
+			}
+			chunks_[chunkNum_].store(chunk, std::memory_order_release);
+			chunkNum_++;
+			objects_ += num;
+			Push(&chunk[0], &chunk[num - 1]);
+			return true;
+		}
 
 	protected:
-		std::multimap<std::string, std::shared_ptr<T>> objMap_;
-#ifdef THREAD_SAFE
-		std::mutex mtx_;
-#endif //THREAD_SAFE
+		ObjectPoolInfo_t info_;
+		std::function<void(void*)> construct_;
+		std::unique_ptr<std::atomic<Slot*>[]> chunks_;
+		size_t maxChunks_{ 0 };
+		std::atomic<uint64_t> head_{ Nil };
+		//the slow path: the chunks and the counters
+		std::mutex growMtx_;
+		size_t chunkNum_{ 0 };
+		size_t objects_{ 0 };
+		uint64_t exhausted_{ 0 };
 	};
-}
\ No newline at end of file
+}
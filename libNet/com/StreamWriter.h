@@ -8,9 +8,16 @@
 //[Other]:Copyright (c) 2020-2050 Nico Hu
 //========================================================================
 #include <iostream>
-#include <stdarg.h>
 #include <mutex>
-#include <time.h>
+
+#include "AsyncLogger.h"
+
+//the arguments are evaluated only when lev is compiled in and enabled, the hot paths log with it.
+#define NET_LOG(lev, ostr, ...) do { \
+	if constexpr (AsyncLogger::Compiled(lev)) { \
+		if (AsyncLogger::Enabled(lev)) \
+			StreamWriter::Instance()->Write(lev, ostr, __VA_ARGS__); \
+	} } while (0)
 
 
 class StreamWriter {
@@ -24,35 +31,38 @@ public:
 	}
 	~StreamWriter() { }
 
-	template<typename T>
-	void Write(T& ostr, const char* format, ...) {
-		char buff[1024] = { 0 };
-		va_list st;
-		va_start(st, format);
-		vsprintf_s(buff, format, st);
-		time_t t = time(0);
-		char tmp[64];
-		strftime(tmp, sizeof(tmp), "[%Y-%m-%d %H:%M:%S] ", localtime(&t));
+	//the args are numbers, pointers or strings(copied), the format is a string literal. the line is formatted
+	//and written by the background thread of the AsyncLogger for the standard streams, which live until the
+	//exit. the other streams are written at once, they may be gone before the background thread writes.
+	template<typename T, typename... Args>
+	void Write(T& ostr, const char* format, const Args&... args) {
+		Write(E_LOG_LEV_T::e_Info, ostr, format, args...);
+	}
+	template<typename T, typename... Args>
+	void Write(E_LOG_LEV_T level, T& ostr, const char* format, const Args&... args) {
+		if (!AsyncLogger::Enabled(level))
+			return;
 		try
 		{
-			/*if (!ostr.is_open()) {
-				ostr.open(file_.c_str(), std::ios::out | std::ios::app);
-			}*/
-			{
-				std::lock_guard<std::mutex> lock(mtx_);
-				ostr << tmp << buff << std::endl;
-				ostr.flush();
-			}
+			AsyncLogger* logger = AsyncLogger::Instance();
+			if (logger && IsStandard(ostr))
+				logger->Write(level, ostr, "", format, args...);
+			else
+				AsyncLogger::WriteSync(ostr, "", format, args...);
 		}
 		catch (const std::exception& e)
 		{
 			std::cerr << "StreamWriter write raise ex:" << e.what() << std::endl;
 		}
-		va_end(st);
 	}
 
 protected:
-	StreamWriter() { static Gargo gargo; }
+	static bool IsStandard(const std::ostream& ostr) { return &ostr == &std::cout || &ostr == &std::cerr || &ostr == &std::clog; }
+	//the logger is created first, so it exits after the writer.
+	StreamWriter() {
+		AsyncLogger::Instance();
+		static Gargo gargo;
+	}
 	StreamWriter(const StreamWriter&) = delete;
 	StreamWriter& operator=(const StreamWriter&) = delete;
 	StreamWriter(StreamWriter&&) noexcept = delete;
@@ -60,7 +70,6 @@ protected:
 
 protected:
 	static StreamWriter* sInstance_;
-	std::mutex mtx_;
 
 	class Gargo {
 	public:
@@ -1,88 +1,450 @@
 #pragma once
 //========================================================================
 //[File Name]:ThreadPool.h
-//[Description]:a implemetation of Thread Pool.
+//[Description]:a implemetation of Thread Pool. each worker has a lock-free
+// deque(WorkStealingQueue) of the tasks it added itself, the tasks of the
+// other threads go to a global injection queue, an idle worker takes a
+// batch of the global ones or steals from the others. it spins a while
+// before it parks, and a task added wakes a parked one only if there is
+// one. nothing is written out on the way. a task is added to a lane, by
+// its priority, each lane has its deques and global queue: a worker looks
+// at the lanes in the order of a cycle drawn from their weights, so a
+// burst of bulk tasks doesn't queue before the realtime ones and the bulk
+// ones still get their share. the wait of the tasks is kept by lane.
 //[Author]:Nico Hu
 //[Date]:2020-07-15
 //[Other]:Copyright (c) 2020-2050 Nico Hu
 //========================================================================
 
-#include <list>
-#include <thread>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
 #include <functional>
 #include <memory>
-#include <atomic>
-#include "SyncTaskQueue.h"
+#include <mutex>
+#include <thread>
+#include <vector>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#include "WorkStealingQueue.h"
+#include "Histogram.h"
 
 namespace Thread {
-	constexpr int16_t MaxTaskCount = 1000;
+	enum class E_TASK_PRI_T : uint8_t {
+		e_Realtime = 0,		//a request waiting for its answer
+		e_Normal,
+		e_Bulk,				//checksums, file chunks, the work no one waits for
+	};
+	constexpr size_t LaneNum = 3;
+
+	struct ThreadPoolInfo_t {
+		unsigned spinRounds{ 64 };		//the looks for a task of an idle worker before it parks
+		size_t dequeCapacity{ 1024 };	//of a worker, doubled when full
+		size_t injectBatch{ 32 };		//taken at most from the global queue at a time
+		//the share of the tasks of a worker for which a lane is looked at first, by E_TASK_PRI_T. when all
+		//the lanes are full, {32, 8, 1} runs a bulk task for 40 others. a lane of weight 0 runs only when
+		//those before it are empty, {1, 0, 0} is strict priority, where the bulk tasks may starve.
+		unsigned laneWeights[LaneNum]{ 32, 8, 1 };
+		//1 of so many tasks of a thread has its wait kept(a clock read at its add and its run), 0: none.
+		unsigned waitSample{ 16 };
+	};
+
+	struct LaneInfo_t {
+		E_TASK_PRI_T pri{ E_TASK_PRI_T::e_Normal };
+		size_t depth{ 0 };		//queued and not taken yet
+		uint64_t run{ 0 };
+		//the wait from the add to the run in ns, of the tasks sampled
+		uint64_t sampled{ 0 };
+		uint64_t p50{ 0 };
+		uint64_t p99{ 0 };
+		uint64_t p999{ 0 };
+		uint64_t max{ 0 };
+		double mean{ 0 };
+	};
 
 	class ThreadPool {
 	public:
 		using Task = std::function<void()>;
-		/*template<class R, typename... Args> //todo
-		using Task = std::function<R(Args...)>;*/
-		explicit ThreadPool() : taskQueue_(MaxTaskCount) {
+
+		explicit ThreadPool(const ThreadPoolInfo_t& info = ThreadPoolInfo_t()) : info_(info) {
+			if (info_.injectBatch == 0)
+				info_.injectBatch = 1;
+			BuildCycle();
 		}
 		~ThreadPool() {
 			Stop();
+			Drop();
 		}
+		ThreadPool(const ThreadPool&) = delete;
+		ThreadPool& operator=(const ThreadPool&) = delete;
 
 		void Start(int num_threads = std::thread::hardware_concurrency()) {
+			if (!workers_.empty())
+				return;
+			if (num_threads <= 0)
+				num_threads = 1;
 			bExit_ = false;
-			for (int i = 0; i < num_threads; ++i) {
-				threadGroup_.emplace_back(std::make_shared<std::thread>([this]() {
-					while (!bExit_) {
-						std::list<Task> list;
-						taskQueue_.Take(list);
-
-						for (auto& task : list) {
-							if (bExit_) return;
-							task();
-						}
-					}
-					}));
+			//all the workers are there before one can steal
+			for (int i = 0; i < num_threads; ++i)
+				workers_.emplace_back(new Worker(this, info_.dequeCapacity, i));
+			for (auto& var : workers_) {
+				Worker* worker = var.get();
+				worker->thread = std::thread([this, worker]() { Run(*worker); });
 			}
 		}
+		//the tasks not run yet are dropped.
 		void Stop() {
 			std::call_once(flag_, [this] { StopThreadGroup(); });
 		}
-		template<class F, class... Args, class = typename std::enable_if<!std::is_member_function_pointer<F>::value>::type>
+		//the tasks without a priority are e_Normal ones.
+		template<class F, class... Args, class = typename std::enable_if<!std::is_member_function_pointer<F>::value && \
+			!std::is_same<typename std::decay<F>::type, E_TASK_PRI_T>::value>::type>
 		void AddTask(F&& f, Args&&... args) {
 			Task t = [=] {return f(args...); };
-			taskQueue_.Put(t);
+			Submit(std::move(t), E_TASK_PRI_T::e_Normal);
 		}
 		template<class C, class... DArgs, class P, class... Args>
 		void AddTask(void(C::* f)(DArgs...) const, P&& p, Args&&... args) {
 			Task t = [=] {return (*p.*f)(args...); };
-			taskQueue_.Put(t);
+			Submit(std::move(t), E_TASK_PRI_T::e_Normal);
 		}
 		template<class C, class... DArgs, class P, class... Args>
 		void AddTask(void(C::* f)(DArgs...), P&& p, Args&&... args) {
 			Task t = [=] {return (*p.*f)(args...); };
-			taskQueue_.Put(t);
+			Submit(std::move(t), E_TASK_PRI_T::e_Normal);
 		}
-		/*void AddTask(Task&& t) {
-			taskQueue_.Put(std::forward<Task>(t));
+		template<class F, class... Args, class = typename std::enable_if<!std::is_member_function_pointer<F>::value>::type>
+		void AddTask(E_TASK_PRI_T pri, F&& f, Args&&... args) {
+			Task t = [=] {return f(args...); };
+			Submit(std::move(t), pri);
+		}
+		template<class C, class... DArgs, class P, class... Args>
+		void AddTask(E_TASK_PRI_T pri, void(C::* f)(DArgs...) const, P&& p, Args&&... args) {
+			Task t = [=] {return (*p.*f)(args...); };
+			Submit(std::move(t), pri);
+		}
+		template<class C, class... DArgs, class P, class... Args>
+		void AddTask(E_TASK_PRI_T pri, void(C::* f)(DArgs...), P&& p, Args&&... args) {
+			Task t = [=] {return (*p.*f)(args...); };
+			Submit(std::move(t), pri);
+		}
+		//the tasks are queued at once(one lock of the global queue), tasks is left empty.
+		void AddTasks(std::vector<Task>&& tasks, E_TASK_PRI_T pri = E_TASK_PRI_T::e_Normal) {
+			if (tasks.empty() || bStopped_.load(std::memory_order_relaxed))
+				return;
+			const size_t lane = LaneOf(pri);
+			const uint64_t now = info_.waitSample > 0 ? Now() : 0;
+			Worker* self = Self();
+			if (self) {
+				for (auto& var : tasks)
+					self->deques[lane]->Push(new Job{ std::move(var), now, static_cast<uint8_t>(lane) });
+			}
+			else {
+				std::vector<Job*> batch;
+				batch.reserve(tasks.size());
+				for (auto& var : tasks)
+					batch.emplace_back(new Job{ std::move(var), now, static_cast<uint8_t>(lane) });
+				Inject& inject = inject_[lane];
+				std::lock_guard<std::mutex> lock(inject.mtx);
+				inject.jobs.insert(inject.jobs.end(), batch.begin(), batch.end());
+				inject.size.store(inject.jobs.size(), std::memory_order_relaxed);
+			}
+			Wake(tasks.size() > 1);
+			tasks.clear();
+		}
+
+		int ThreadNum() const { return static_cast<int>(workers_.size()); }
+		//the tasks queued and not taken yet, approximate while the pool runs.
+		size_t Pending() const {
+			size_t pending{ 0 };
+			for (size_t lane = 0; lane < LaneNum; lane++)
+				pending += Depth(lane);
+			return pending;
+		}
+		//by lane, in the order of E_TASK_PRI_T, approximate while the pool runs.
+		std::vector<LaneInfo_t> GetLaneInfo() const {
+			std::vector<LaneInfo_t> infos(LaneNum);
+			for (size_t lane = 0; lane < LaneNum; lane++) {
+				Histogram wait;
+				LaneInfo_t& info = infos[lane];
+				info.pri = static_cast<E_TASK_PRI_T>(lane);
+				info.depth = Depth(lane);
+				for (auto& var : workers_) {
+					wait.Merge(var->wait[lane]);
+					info.run += var->run[lane].load(std::memory_order_relaxed);
+				}
+				info.sampled = wait.Count();
+				info.p50 = wait.Percentile(50);
+				info.p99 = wait.Percentile(99);
+				info.p999 = wait.Percentile(99.9);
+				info.max = wait.Max();
+				info.mean = wait.Mean();
+			}
+			return infos;
 		}
-		void AddTask(const Task& t) {
-			taskQueue_.Put(t);
-		}*/
 
 	protected:
+		struct Job {
+			Task task;
+			uint64_t queued;	//ns, 0: not sampled
+			uint8_t lane;
+		};
+		struct Worker {
+			Worker(ThreadPool* owner, size_t capacity, int index) : pool(owner), seed(index * 2654435761u + 1) {
+				for (auto& var : deques)
+					var.reset(new WorkStealingQueue<Job>(capacity));
+				for (auto& var : run)
+					var.store(0, std::memory_order_relaxed);
+			}
+
+			ThreadPool* pool;
+			std::unique_ptr<WorkStealingQueue<Job>> deques[LaneNum];
+			uint32_t seed;		//of the victims to steal from
+			size_t tick{ 0 };	//the tasks run, the place in the cycle of the lanes
+			//written by the worker only
+			Histogram wait[LaneNum];
+			std::atomic<uint64_t> run[LaneNum];
+			std::thread thread;
+		};
+		struct Inject {
+			std::mutex mtx;
+			std::deque<Job*> jobs;		//the tasks of the threads out of the pool
+			std::atomic<size_t> size{ 0 };
+		};
+
+		//the worker of this pool running the calling thread, nullptr for the other threads.
+		Worker* Self() const {
+			Worker* worker = Local();
+			return worker && worker->pool == this ? worker : nullptr;
+		}
+		static Worker*& Local() {
+			static thread_local Worker* worker{ nullptr };
+			return worker;
+		}
+
+		static uint64_t Now() {
+			return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+		}
+		//the time of a sampled add, 0 for the others.
+		uint64_t Stamp() const {
+			if (info_.waitSample == 0)
+				return 0;
+			static thread_local unsigned added{ 0 };
+			return added++ % info_.waitSample == 0 ? Now() : 0;
+		}
+		static size_t LaneOf(E_TASK_PRI_T pri) {
+			const size_t lane = static_cast<size_t>(pri);
+			return lane < LaneNum ? lane : LaneNum - 1;
+		}
+		size_t Depth(size_t lane) const {
+			size_t depth = inject_[lane].size.load(std::memory_order_relaxed);
+			for (auto& var : workers_)
+				depth += var->deques[lane]->Size();
+			return depth;
+		}
+		//the lanes by their weights, spread so the heavy one doesn't come in a row(smooth weighted round robin).
+		void BuildCycle() {
+			unsigned total{ 0 };
+			for (auto var : info_.laneWeights)
+				total += var;
+			cycle_.clear();
+			if (total == 0) {
+				cycle_.emplace_back(0);
+				return;
+			}
+			int64_t current[LaneNum] = { 0 };
+			for (unsigned n = 0; n < total; n++) {
+				size_t best = LaneNum;
+				for (size_t lane = 0; lane < LaneNum; lane++) {
+					current[lane] += info_.laneWeights[lane];
+					if (info_.laneWeights[lane] > 0 && (best == LaneNum || current[lane] > current[best]))
+						best = lane;
+				}
+				current[best] -= total;
+				cycle_.emplace_back(static_cast<uint8_t>(best));
+			}
+		}
+
+		void Submit(Task&& task, E_TASK_PRI_T pri) {
+			if (bStopped_.load(std::memory_order_relaxed))
+				return;
+			const size_t lane = LaneOf(pri);
+			Job* job = new Job{ std::move(task), Stamp(), static_cast<uint8_t>(lane) };
+			Worker* self = Self();
+			if (self)
+				self->deques[lane]->Push(job);
+			else {
+				Inject& inject = inject_[lane];
+				std::lock_guard<std::mutex> lock(inject.mtx);
+				inject.jobs.emplace_back(job);
+				inject.size.store(inject.jobs.size(), std::memory_order_relaxed);
+			}
+			Wake(false);
+		}
+		//a worker parks after it has told sleepers_ and found no task, a task is queued before
+		//sleepers_ is read, the fences make one of them see the other.
+		void Wake(bool b_all) {
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			if (sleepers_.load(std::memory_order_relaxed) == 0)
+				return;
+			{
+				std::lock_guard<std::mutex> lock(parkMtx_);
+				epoch_.fetch_add(1, std::memory_order_release);
+			}
+			if (b_all)
+				parkCv_.notify_all();
+			else
+				parkCv_.notify_one();
+		}
+		void Park() {
+			const uint64_t epoch = epoch_.load(std::memory_order_acquire);
+			sleepers_.fetch_add(1, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			if (!HasTask() && !bExit_.load(std::memory_order_relaxed)) {
+				std::unique_lock<std::mutex> lock(parkMtx_);
+				parkCv_.wait(lock, [this, epoch] { return epoch_.load(std::memory_order_relaxed) != epoch || bExit_.load(std::memory_order_relaxed); });
+			}
+			sleepers_.fetch_sub(1, std::memory_order_relaxed);
+		}
+		bool HasTask() const {
+			for (size_t lane = 0; lane < LaneNum; lane++) {
+				if (inject_[lane].size.load(std::memory_order_relaxed) > 0)
+					return true;
+				for (auto& var : workers_) {
+					if (!var->deques[lane]->Empty())
+						return true;
+				}
+			}
+			return false;
+		}
+
+		void Run(Worker& self) {
+			Local() = &self;
+			while (!bExit_.load(std::memory_order_relaxed)) {
+				Job* job = Find(self);
+				for (unsigned i = 0; job == nullptr && i < info_.spinRounds && !bExit_.load(std::memory_order_relaxed); i++) {
+					if (i < info_.spinRounds / 2)
+						CpuRelax();
+					else
+						std::this_thread::yield();
+					job = Find(self);
+				}
+				if (job == nullptr) {
+					Park();
+					continue;
+				}
+				std::unique_ptr<Job> owned(job);
+				if (job->queued > 0) {
+					const uint64_t now = Now();
+					self.wait[job->lane].Record(now > job->queued ? now - job->queued : 0);
+				}
+				self.run[job->lane].store(self.run[job->lane].load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+				job->task();
+			}
+			Local() = nullptr;
+		}
+		//the lane of the cycle first, then the others by priority.
+		Job* Find(Worker& self) {
+			const size_t first = cycle_[self.tick % cycle_.size()];
+			Job* job = FindIn(self, first);
+			for (size_t lane = 0; job == nullptr && lane < LaneNum; lane++) {
+				if (lane != first)
+					job = FindIn(self, lane);
+			}
+			if (job)
+				self.tick++;
+			return job;
+		}
+		//its own newest one, else a batch of the global queue, else the oldest one of another worker.
+		Job* FindIn(Worker& self, size_t lane) {
+			Job* job = self.deques[lane]->Pop();
+			if (job)
+				return job;
+			Inject& inject = inject_[lane];
+			if (inject.size.load(std::memory_order_relaxed) > 0) {
+				size_t moved{ 0 };
+				{
+					std::lock_guard<std::mutex> lock(inject.mtx);
+					if (!inject.jobs.empty()) {
+						//a share of the queue, so the other workers get theirs
+						size_t take = inject.jobs.size() / workers_.size() + 1;
+						take = take < info_.injectBatch ? take : info_.injectBatch;
+						job = inject.jobs.front();
+						inject.jobs.pop_front();
+						for (; moved + 1 < take && !inject.jobs.empty(); moved++) {
+							self.deques[lane]->Push(inject.jobs.front());
+							inject.jobs.pop_front();
+						}
+						inject.size.store(inject.jobs.size(), std::memory_order_relaxed);
+					}
+				}
+				//the rest of the batch can be stolen by a parked one
+				if (moved > 0)
+					Wake(false);
+				if (job)
+					return job;
+			}
+			const size_t num = workers_.size();
+			self.seed ^= self.seed << 13;
+			self.seed ^= self.seed >> 17;
+			self.seed ^= self.seed << 5;
+			for (size_t i = 0, first = self.seed % num; i < num; i++) {
+				Worker& victim = *workers_[(first + i) % num];
+				if (&victim != &self && (job = victim.deques[lane]->Steal()) != nullptr)
+					return job;
+			}
+			return nullptr;
+		}
+		static void CpuRelax() {
+#if defined(_MSC_VER)
+			_mm_pause();
+#elif defined(__i386__) || defined(__x86_64__)
+			__builtin_ia32_pause();
+#endif
+		}
+
 		void StopThreadGroup() {
-			taskQueue_.Stop();
-			bExit_ = true;
-			for (auto thread : threadGroup_) {
-				if (thread && thread->joinable())
-					thread->join();
+			bStopped_ = true;
+			{
+				std::lock_guard<std::mutex> lock(parkMtx_);
+				bExit_ = true;
+			}
+			parkCv_.notify_all();
+			for (auto& var : workers_) {
+				if (var->thread.joinable())
+					var->thread.join();
+			}
+			Drop();
+		}
+		//the tasks left, once no worker runs.
+		void Drop() {
+			for (size_t lane = 0; lane < LaneNum; lane++) {
+				for (auto& var : workers_) {
+					while (Job* job = var->deques[lane]->Pop())
+						delete job;
+				}
+				Inject& inject = inject_[lane];
+				std::lock_guard<std::mutex> lock(inject.mtx);
+				for (auto var : inject.jobs)
+					delete var;
+				inject.jobs.clear();
+				inject.size.store(0, std::memory_order_relaxed);
 			}
-			threadGroup_.clear();
 		}
+
 	protected:
-		std::list<std::shared_ptr<std::thread>> threadGroup_;
-		SyncTaskQueue<Task>		taskQueue_;
-		std::atomic_bool		bExit_{ false };
-		std::once_flag			flag_;
+		ThreadPoolInfo_t info_;
+		std::vector<std::unique_ptr<Worker>> workers_;
+		std::vector<uint8_t> cycle_;		//the lanes by their weights
+		Inject inject_[LaneNum];
+		std::mutex parkMtx_;
+		std::condition_variable parkCv_;
+		std::atomic<uint64_t> epoch_{ 0 };		//bumped by a wake
+		std::atomic<int> sleepers_{ 0 };
+		std::atomic_bool bExit_{ false };
+		std::atomic_bool bStopped_{ false };
+		std::once_flag flag_;
 	};
-}
\ No newline at end of file
+}
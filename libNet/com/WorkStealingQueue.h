@@ -0,0 +1,111 @@
+#pragma once
+//========================================================================
+//[File Name]:WorkStealingQueue.h
+//[Description]:a lock-free work-stealing deque(Chase-Lev) of pointers for
+//              the ThreadPool. its owner pushes and pops at the bottom, the
+//              other threads steal from the top, only the last element is
+//              raced for by a CAS. the ring doubles when it is full, the
+//              rings it outgrew are kept until the deque is gone since a
+//              thief may still read them.
+//[Author]:Nico Hu
+//[Date]:2020-08-10
+//[Other]:Copyright (c) 2020-2050 Nico Hu
+//========================================================================
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace Thread {
+	template<typename T>
+	class WorkStealingQueue
+	{
+		struct Ring {
+			explicit Ring(int64_t capacity) : cap(capacity), mask(capacity - 1), cells(new std::atomic<T*>[capacity]) { }
+
+			T* Get(int64_t i) const { return cells[i & mask].load(std::memory_order_relaxed); }
+			void Put(int64_t i, T* t) { cells[i & mask].store(t, std::memory_order_relaxed); }
+
+			const int64_t cap;
+			const int64_t mask;
+			std::unique_ptr<std::atomic<T*>[]> cells;
+		};
+
+	public:
+		//the capacity is rounded up to a power of 2.
+		explicit WorkStealingQueue(size_t capacity = 1024) {
+			int64_t cap{ 2 };
+			while (cap < static_cast<int64_t>(capacity))
+				cap <<= 1;
+			rings_.emplace_back(new Ring(cap));
+			ring_.store(rings_.back().get(), std::memory_order_relaxed);
+		}
+		WorkStealingQueue(const WorkStealingQueue&) = delete;
+		WorkStealingQueue& operator=(const WorkStealingQueue&) = delete;
+
+		//the owner only.
+		void Push(T* t) {
+			const int64_t b = bottom_.load(std::memory_order_relaxed);
+			const int64_t top = top_.load(std::memory_order_acquire);
+			Ring* ring = ring_.load(std::memory_order_relaxed);
+			if (b - top >= ring->cap)
+				ring = Grow(ring, top, b);
+			ring->Put(b, t);
+			bottom_.store(b + 1, std::memory_order_release);
+		}
+		//the owner only, the last pushed one, nullptr if empty(or a thief took the last one).
+		T* Pop() {
+			const int64_t b = bottom_.load(std::memory_order_relaxed) - 1;
+			Ring* ring = ring_.load(std::memory_order_relaxed);
+			bottom_.store(b, std::memory_order_seq_cst);
+			int64_t top = top_.load(std::memory_order_seq_cst);
+			if (top > b) {
+				bottom_.store(b + 1, std::memory_order_relaxed);
+				return nullptr;
+			}
+			T* t = ring->Get(b);
+			if (top == b) {
+				if (!top_.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+					t = nullptr;
+				bottom_.store(b + 1, std::memory_order_relaxed);
+			}
+			return t;
+		}
+		//any thread, the first pushed one, nullptr if empty or lost to another thread.
+		T* Steal() {
+			int64_t top = top_.load(std::memory_order_seq_cst);
+			const int64_t b = bottom_.load(std::memory_order_seq_cst);
+			if (top >= b)
+				return nullptr;
+			Ring* ring = ring_.load(std::memory_order_acquire);
+			T* t = ring->Get(top);
+			if (!top_.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+				return nullptr;
+			return t;
+		}
+		//approximate while other threads push or steal.
+		size_t Size() const {
+			const int64_t b = bottom_.load(std::memory_order_relaxed);
+			const int64_t top = top_.load(std::memory_order_relaxed);
+			return b > top ? static_cast<size_t>(b - top) : 0;
+		}
+		bool Empty() const { return Size() == 0; }
+
+	protected:
+		Ring* Grow(Ring* ring, int64_t top, int64_t b) {
+			Ring* bigger = new Ring(ring->cap * 2);
+			for (int64_t i = top; i < b; i++)
+				bigger->Put(i, ring->Get(i));
+			rings_.emplace_back(bigger);
+			ring_.store(bigger, std::memory_order_release);
+			return bigger;
+		}
+
+	protected:
+		alignas(64) std::atomic<int64_t> top_{ 0 };
+		alignas(64) std::atomic<int64_t> bottom_{ 0 };
+		alignas(64) std::atomic<Ring*> ring_{ nullptr };
+		std::vector<std::unique_ptr<Ring>> rings_;		//the owner's, with those outgrown
+	};
+}
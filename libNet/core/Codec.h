@@ -0,0 +1,244 @@
+#pragma once
+//========================================================================
+//[File Name]:Codec.h
+//[Description]: the framing codecs of stream packets, which tell how a
+//  body is delimited on a stream: raw(no framing), a 4-byte big-endian
+//  length, a varint length, a newline, a fixed size record, or the legacy
+//  2-char hex length. a codec is chosen per server/connector when it is
+//  constructed, the encode/decode are done by plain integer ops.
+//[Author]:Nico Hu
+//[Date]:2020-08-10
+//[Other]:Copyright (c) 2020-2050 Nico Hu
+//========================================================================
+#include <cstddef>
+#include <cstring>
+
+#include "../Comm.h"
+
+namespace Net {
+//#define PACKET_STICK
+	namespace Core {
+		enum class E_CODEC_T {
+			e_Raw = 0,	//no framing, what a read gets is a packet
+			e_Len32,	//4-byte big-endian body length + body
+			e_Varint,	//LEB128 body length(1~5 bytes) + body
+			e_Line,		//body + '\n'
+			e_Fixed,	//body of a fixed length, no header
+			e_Hex		//legacy: body length as 2 hex chars("%x", '\0' padded) + body
+		};
+
+		//a decoded frame: [head][body][tail]
+		struct Frame {
+			std::size_t headLen{ 0 };
+			std::size_t bodyLen{ 0 };
+			std::size_t frameLen{ 0 }; //when more data is needed, the length the frame needs(0 if unknown)
+		};
+
+		class Codec {
+		public:
+			enum { e_MaxHeadLen = 5 };	//the max header length of all codecs(varint)
+			enum { e_MaxTailLen = 1 };	//the max tail length of all codecs(newline)
+
+		public:
+			explicit Codec(E_CODEC_T type = E_CODEC_T::e_Raw, std::size_t fixed_len = 0) :
+				type_(type), fixedLen_(fixed_len) {
+				assert(type_ != E_CODEC_T::e_Fixed || fixedLen_ > 0);
+			}
+			//the codec of PACKET_STICK builds, which is used when none is given.
+			static Codec Default() {
+#ifdef PACKET_STICK
+				return Codec(E_CODEC_T::e_Hex);
+#else
+				return Codec(E_CODEC_T::e_Raw);
+#endif // PACKET_STICK
+			}
+
+			E_CODEC_T Type() const { return type_; }
+			bool IsFramed() const { return type_ != E_CODEC_T::e_Raw; }
+			//the same framing, what one encodes the other decodes.
+			bool operator==(const Codec& ref) const { return type_ == ref.type_ && fixedLen_ == ref.fixedLen_; }
+			bool operator!=(const Codec& ref) const { return !(*this == ref); }
+			std::size_t MaxBodyLen() const {
+				switch (type_) {
+				case E_CODEC_T::e_Hex:
+					return 0xff;
+				case E_CODEC_T::e_Fixed:
+					return fixedLen_;
+				default:
+					return MaxFrameSize;
+				}
+			}
+			//the header length is fixed(known before the body length is), 0 if it isn't.
+			std::size_t FixedHeadLen() const {
+				switch (type_) {
+				case E_CODEC_T::e_Len32:
+					return 4;
+				case E_CODEC_T::e_Hex:
+					return 2;
+				default:
+					return 0;
+				}
+			}
+			std::size_t HeadLen(std::size_t body_len) const {
+				if (type_ != E_CODEC_T::e_Varint)
+					return FixedHeadLen();
+				std::size_t len{ 1 };
+				while (body_len >= 0x80) {
+					body_len >>= 7;
+					len++;
+				}
+				return len;
+			}
+			std::size_t TailLen() const {
+				return type_ == E_CODEC_T::e_Line ? 1 : 0;
+			}
+			//whether len bytes can be sent as frames of this codec(split by MaxBodyLen).
+			bool Accept(std::size_t len) const {
+				return type_ != E_CODEC_T::e_Fixed || len % fixedLen_ == 0;
+			}
+
+			//encode the header of body_len into head(which holds e_MaxHeadLen bytes), return the header length.
+			int EncodeHead(char* head, std::size_t body_len, uint8_t& ec) const {
+				if (body_len > MaxBodyLen() || (type_ == E_CODEC_T::e_Fixed && body_len != fixedLen_)) {
+					ec = NET_BAD_BODY;
+					return -1;
+				}
+				switch (type_) {
+				case E_CODEC_T::e_Len32:
+					head[0] = static_cast<char>((body_len >> 24) & 0xff);
+					head[1] = static_cast<char>((body_len >> 16) & 0xff);
+					head[2] = static_cast<char>((body_len >> 8) & 0xff);
+					head[3] = static_cast<char>(body_len & 0xff);
+					return 4;
+				case E_CODEC_T::e_Varint: {
+					int len{ 0 };
+					while (body_len >= 0x80) {
+						head[len++] = static_cast<char>((body_len & 0x7f) | 0x80);
+						body_len >>= 7;
+					}
+					head[len++] = static_cast<char>(body_len);
+					return len;
+				}
+				case E_CODEC_T::e_Hex: {
+					static const char digits[] = "0123456789abcdef";
+					if (body_len < 0x10) {
+						head[0] = digits[body_len];
+						head[1] = '\0';
+					}
+					else {
+						head[0] = digits[body_len >> 4];
+						head[1] = digits[body_len & 0x0f];
+					}
+					return 2;
+				}
+				default:
+					return 0;
+				}
+			}
+			//encode the tail into tail(which holds e_MaxTailLen bytes), return the tail length.
+			int EncodeTail(char* tail) const {
+				if (type_ == E_CODEC_T::e_Line) {
+					tail[0] = '\n';
+					return 1;
+				}
+				return 0;
+			}
+			//decode the frame at the front of data[0, avail).
+			//return 1 if a whole frame is there, 0 if more data is needed, -1 if the data is bad.
+			int Decode(const char* data, std::size_t avail, Frame& frame, uint8_t& ec) const {
+				frame = Frame();
+				switch (type_) {
+				case E_CODEC_T::e_Raw:
+					if (avail == 0)
+						return 0;
+					frame.bodyLen = avail;
+					break;
+				case E_CODEC_T::e_Len32:
+					if (avail < 4) {
+						frame.frameLen = 4;
+						return 0;
+					}
+					frame.headLen = 4;
+					frame.bodyLen = (static_cast<std::size_t>(static_cast<uint8_t>(data[0])) << 24) | \
+						(static_cast<std::size_t>(static_cast<uint8_t>(data[1])) << 16) | \
+						(static_cast<std::size_t>(static_cast<uint8_t>(data[2])) << 8) | \
+						static_cast<std::size_t>(static_cast<uint8_t>(data[3]));
+					break;
+				case E_CODEC_T::e_Varint: {
+					std::size_t len{ 0 };
+					int shift{ 0 };
+					while (true) {
+						if (frame.headLen == avail) {
+							frame.frameLen = 0;
+							return 0;
+						}
+						if (frame.headLen == e_MaxHeadLen) {
+							ec = NET_BAD_HEAD;
+							return -1;
+						}
+						const uint8_t byte = static_cast<uint8_t>(data[frame.headLen++]);
+						len |= static_cast<std::size_t>(byte & 0x7f) << shift;
+						shift += 7;
+						if (!(byte & 0x80))
+							break;
+					}
+					frame.bodyLen = len;
+					break;
+				}
+				case E_CODEC_T::e_Line: {
+					const char* end = static_cast<const char*>(memchr(data, '\n', avail));
+					if (!end) {
+						if (avail > MaxBodyLen()) {
+							ec = NET_BAD_BODY;
+							return -1;
+						}
+						frame.frameLen = 0;
+						return 0;
+					}
+					frame.bodyLen = end - data;
+					break;
+				}
+				case E_CODEC_T::e_Fixed:
+					frame.bodyLen = fixedLen_;
+					break;
+				case E_CODEC_T::e_Hex: {
+					if (avail < 2) {
+						frame.frameLen = 2;
+						return 0;
+					}
+					int high = HexValue(data[0]);
+					int low = data[1] == '\0' ? -2 : HexValue(data[1]);
+					if (high < 0 || low == -1) {
+						ec = NET_BAD_HEAD;
+						return -1;
+					}
+					frame.headLen = 2;
+					frame.bodyLen = low == -2 ? high : (high << 4 | low);
+					break;
+				}
+				}
+				if (frame.bodyLen > MaxBodyLen()) {
+					ec = NET_BAD_HEAD;
+					return -1;
+				}
+				frame.frameLen = frame.headLen + frame.bodyLen + TailLen();
+				return avail >= frame.frameLen ? 1 : 0;
+			}
+
+		protected:
+			static int HexValue(char c) {
+				if (c >= '0' && c <= '9')
+					return c - '0';
+				if (c >= 'a' && c <= 'f')
+					return c - 'a' + 10;
+				if (c >= 'A' && c <= 'F')
+					return c - 'A' + 10;
+				return -1;
+			}
+
+		protected:
+			E_CODEC_T type_{ E_CODEC_T::e_Raw };
+			std::size_t fixedLen_{ 0 };
+		};
+	}
+}
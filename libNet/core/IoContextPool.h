@@ -0,0 +1,136 @@
+#pragma once
+//========================================================================
+//[File Name]:IoContextPool.h
+//[Description]: a pool of reactors, one io_context per thread with the
+//  single-threaded concurrency hint, each thread pinned to a core. a
+//  server in pool mode places each accepted session on one reactor(round
+//  robin or the least loaded one), and all the io of the session runs on
+//  the thread of that reactor, so the sessions don't share the locks of
+//  one io_context.
+//[Author]:Nico Hu
+//[Date]:2020-08-10
+//[Other]:Copyright (c) 2020-2050 Nico Hu
+//========================================================================
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include "../asio/asio.hpp"
+#include "../Comm.h"
+
+namespace Net {
+	namespace Core {
+		enum class E_PLACEMENT_T { e_RoundRobin = 0, e_LeastLoaded = 1 };
+
+		class IoContextPool {
+			//a reactor's load counter has a cache line of its own, the reactors update them from their threads.
+			struct alignas(64) Reactor {
+				std::unique_ptr<asio::io_context> ioCtx;
+				std::atomic<size_t> load{ 0 };
+			};
+
+		public:
+			//size: the reactors, placement: of the sessions, b_pin: pin reactor i to core i % cores.
+			explicit IoContextPool(size_t size = std::thread::hardware_concurrency(), E_PLACEMENT_T placement = E_PLACEMENT_T::e_RoundRobin, \
+				bool b_pin = true) : reactors_(size > 0 ? size : 1), placement_(placement), bPin_(b_pin) {
+				for (auto& var : reactors_)
+					var.ioCtx.reset(new asio::io_context(1));
+			}
+			~IoContextPool() { Stop(); }
+			IoContextPool(const IoContextPool&) = delete;
+			IoContextPool& operator=(const IoContextPool&) = delete;
+
+			void Run() {
+				if (!threads_.empty())
+					return;
+				const size_t cores = std::thread::hardware_concurrency();
+				for (size_t i = 0; i < reactors_.size(); i++) {
+					asio::io_context& io_c = *reactors_[i].ioCtx;
+					io_c.restart();
+					works_.emplace_back(asio::make_work_guard(io_c));
+					threads_.emplace_back([&io_c] { io_c.run(); });
+					if (bPin_ && cores > 0)
+						Pin(threads_.back(), i % cores);
+				}
+			}
+			void Stop() {
+				works_.clear();
+				for (auto& var : reactors_)
+					var.ioCtx->stop();
+				for (auto& var : threads_) {
+					if (var.joinable())
+						var.join();
+				}
+				threads_.clear();
+				//run the handlers of the aborted io, they hold sessions which free into their server's pool
+				for (auto& var : reactors_) {
+					var.ioCtx->restart();
+					var.ioCtx->poll();
+				}
+			}
+
+			size_t Size() const { return reactors_.size(); }
+			asio::io_context& Get(size_t index) { return *reactors_[index % reactors_.size()].ioCtx; }
+			//the reactor of the next session.
+			size_t Pick() {
+				if (placement_ == E_PLACEMENT_T::e_RoundRobin)
+					return next_.fetch_add(1, std::memory_order_relaxed) % reactors_.size();
+				size_t index{ 0 };
+				size_t min_load = reactors_[0].load.load(std::memory_order_relaxed);
+				for (size_t i = 1; i < reactors_.size() && min_load > 0; i++) {
+					const size_t load = reactors_[i].load.load(std::memory_order_relaxed);
+					if (load < min_load) {
+						min_load = load;
+						index = i;
+					}
+				}
+				return index;
+			}
+			//the sessions running on io_c, for the least loaded placement.
+			void Attach(const asio::io_context& io_c) {
+				const size_t index = IndexOf(io_c);
+				if (index < reactors_.size())
+					reactors_[index].load.fetch_add(1, std::memory_order_relaxed);
+			}
+			void Detach(const asio::io_context& io_c) {
+				const size_t index = IndexOf(io_c);
+				if (index < reactors_.size())
+					reactors_[index].load.fetch_sub(1, std::memory_order_relaxed);
+			}
+			size_t Load(size_t index) const { return reactors_[index % reactors_.size()].load.load(std::memory_order_relaxed); }
+			//Size() if io_c is not a reactor of the pool.
+			size_t IndexOf(const asio::io_context& io_c) const {
+				for (size_t i = 0; i < reactors_.size(); i++) {
+					if (reactors_[i].ioCtx.get() == &io_c)
+						return i;
+				}
+				return reactors_.size();
+			}
+
+		protected:
+			static void Pin(std::thread& thread, size_t core) {
+#ifdef __linux__
+				cpu_set_t cpu_set;
+				CPU_ZERO(&cpu_set);
+				CPU_SET(core, &cpu_set);
+				pthread_setaffinity_np(thread.native_handle(), sizeof(cpu_set), &cpu_set);
+#elif defined(_WIN32)
+				SetThreadAffinityMask(thread.native_handle(), DWORD_PTR(1) << core);
+#endif
+			}
+
+		protected:
+			std::vector<Reactor> reactors_;
+			std::vector<asio::executor_work_guard<asio::io_context::executor_type>> works_;
+			std::vector<std::thread> threads_;
+			std::atomic<size_t> next_{ 0 };
+			E_PLACEMENT_T placement_{ E_PLACEMENT_T::e_RoundRobin };
+			bool bPin_{ true };
+		};
+	}
+}
@@ -10,10 +10,10 @@
 #include <string>
 
 #include "../Comm.h"
+#include "Codec.h"
 
 
 namespace Net {
-//#define PACKET_STICK
 	namespace Core {
 
 		struct Buffer {
@@ -47,33 +47,44 @@ namespace Net {
 				data_ = nullptr;
 				len_ = 0;
 			}
+			//wrap a memory which is owned by others(e.g. a receive ring), the content is kept.
+			static Buffer Wrap(char* buff, std::size_t len) {
+				Buffer ref;
+				ref.data_ = buff;
+				ref.len_ = len;
+				return ref;
+			}
 		public:
 			char* data_{ nullptr };
 			std::size_t len_{ 0 };
 		};
 
+		//a packet is a frame [head][body][tail] in one buffer, the lengths of the head and tail are given by
+		//the codec which encodes or decodes it.
 		class Packet {
 		public:
 #ifdef PACKET_STICK
-			enum { e_HeadLen = 2 };
+			enum { e_HeadLen = 2 };	//the header length of the default codec
 #else
 			enum { e_HeadLen = 0 };
 #endif // PACKET_STICK
-			enum { e_Max_BodyLen = MaxPacketSize - e_HeadLen };
+			enum { e_Max_BodyLen = MaxPacketSize - Codec::e_MaxHeadLen - Codec::e_MaxTailLen }; //the max body of a pooled packet
 
 		public:
 			explicit Packet() = default;
 			explicit Packet(const Buffer& buff) : buff_(buff) {
 				assert(buff_.data_);
-				assert(buff_.len_ < e_Max_BodyLen);
 			}
 
 			Packet(const Packet&) = default;
 			Packet& operator=(const Packet&) = default;
-			Packet(Packet&& ref) noexcept : bodyLen_(ref.bodyLen_), buff_(std::move(ref.buff_)) { }
+			Packet(Packet&& ref) noexcept : bodyLen_(ref.bodyLen_), headLen_(ref.headLen_), tailLen_(ref.tailLen_), \
+				buff_(std::move(ref.buff_)) { }
 			Packet& operator=(Packet&& ref) noexcept {
 				if (this != &ref) {
 					bodyLen_ = ref.bodyLen_;
+					headLen_ = ref.headLen_;
+					tailLen_ = ref.tailLen_;
 					buff_ = std::move(ref.buff_);
 				}
 				return *this;
@@ -86,74 +97,91 @@ namespace Net {
 				return buff_.data_;
 			}
 			std::size_t length() const {
-				return e_HeadLen + bodyLen_;
+				return headLen_ + bodyLen_ + tailLen_;
 			}
 			std::size_t bufflength() const {
 				return buff_.len_;
 			}
 			const char* body() const {
-				return buff_.data_ + e_HeadLen;
+				return buff_.data_ + headLen_;
 			}
 			char* body() {
-				return buff_.data_ + e_HeadLen;
+				return buff_.data_ + headLen_;
 			}
 			std::size_t bodyLen() const {
 				return bodyLen_;
 			}
+			std::size_t headLen() const {
+				return headLen_;
+			}
 			int setBodyLen(size_t len, uint8_t& ec) {
-				if (len > buff_.len_ - e_HeadLen) {
+				if (headLen_ + len + tailLen_ > buff_.len_) {
 					ec = NET_BAD_BODY;
 					return -1;
 				}
 				bodyLen_ = len;
 				return 0;
 			}
+			//set the frame layout of a decoded frame.
+			int setFrame(const Frame& frame, uint8_t& ec) {
+				headLen_ = frame.headLen;
+				tailLen_ = frame.frameLen - frame.headLen - frame.bodyLen;
+				return setBodyLen(frame.bodyLen, ec);
+			}
 			int decodeData(uint8_t& ec) {
 				return decodeHeader(ec);
 			}
 			int decodeHeader(uint8_t& ec) {
-				if (e_HeadLen > 0) {
-					char header[e_HeadLen + 1] = "";
-					strncat_s(header, buff_.data_, e_HeadLen);
-					sscanf(header, "%x", &bodyLen_);
-					if (bodyLen_ > e_Max_BodyLen) {
-						bodyLen_ = 0;
+				return decodeHeader(Codec::Default(), buff_.len_, ec);
+			}
+			//decode the frame held by the first len bytes of the buffer, return -2 if the codec has no framing.
+			int decodeHeader(const Codec& codec, size_t len, uint8_t& ec) {
+				if (!codec.IsFramed())
+					return -2;
+				Frame frame;
+				if (codec.Decode(buff_.data_, len, frame, ec) < 0 || setFrame(frame, ec) < 0) {
+					bodyLen_ = 0;
+					if (ec == NO_ERR)
 						ec = NET_BAD_HEAD;
-						return -1;
-					}
-					return 0;
+					return -1;
 				}
-				else
-					return -2;
+				return 0;
 			}
 			int encodeData(const char* data, unsigned len, uint8_t& err_code) {
-				if (setBodyLen(len, err_code) < 0)
+				return encodeData(Codec::Default(), data, len, err_code);
+			}
+			int encodeData(const Codec& codec, const char* data, size_t len, uint8_t& err_code) {
+				if (codec.HeadLen(len) + len + codec.TailLen() > buff_.len_) {
+					err_code = NET_BAD_BODY;
 					return -1;
-
-				if (e_HeadLen > 0)
-					encodeHeader();
-				memcpy_s(buff_.data_ + e_HeadLen, buff_.len_ - e_HeadLen, data, len);
+				}
+				int head_len = codec.EncodeHead(buff_.data_, len, err_code);
+				if (head_len < 0)
+					return -1;
+				headLen_ = head_len;
+				bodyLen_ = len;
+				memcpy_s(buff_.data_ + headLen_, buff_.len_ - headLen_, data, len);
+				tailLen_ = codec.EncodeTail(buff_.data_ + headLen_ + bodyLen_);
 				return 0;
 			}
 			void clear() {
 				buff_.clear();
 				bodyLen_ = 0;
+				headLen_ = 0;
+				tailLen_ = 0;
 			}
 			void reset() {
 				buff_.reset();
 				bodyLen_ = 0;
-			}
-
-		protected:
-			void encodeHeader() {
-				char header[e_HeadLen + 1] = "";
-				sprintf_s(header, "%x", bodyLen_);
-				memcpy_s(buff_.data_, buff_.len_, header, e_HeadLen);
+				headLen_ = 0;
+				tailLen_ = 0;
 			}
 
 		protected:
 			Buffer buff_;
 			std::size_t bodyLen_{ 0 };
+			std::size_t headLen_{ 0 };
+			std::size_t tailLen_{ 0 };
 		};
 	}
 }
\ No newline at end of file
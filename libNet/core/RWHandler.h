@@ -8,11 +8,13 @@
 //========================================================================
 #include <functional>
 #include <iostream>
+#include <new>
 
 #include "../asio/asio.hpp"
 #include "Packet.h"
 #include "StreamWriter.h"
 #include "NMemoryStorage.h"
+#include "SessionStats.h"
 
 using namespace asio;
 using namespace asio::ip;
@@ -26,15 +28,28 @@ namespace Net {
 
 		typedef std::function<void(std::size_t, uint8_t)> CBAsyncWrite;
 		typedef std::function<void(Packet*, uint8_t)>  CBAsyncRead;
-		typedef std::function<void(int, uint8_t)> CBErrTcp;
+		typedef std::function<void(SessionId, uint8_t)> CBErrTcp;
 		typedef std::function<void(udp::endpoint endpoint, uint8_t)> CBErrUdp;
 		typedef std::function<void(E_ERR_T, uint8_t)> CBErrRW;
 
+		//a non-owning view of a const_buffer array, used to gather several packets into one write.
+		struct ConstBuffers {
+			typedef asio::const_buffer value_type;
+			typedef const asio::const_buffer* const_iterator;
+
+			const_iterator begin() const { return begin_; }
+			const_iterator end() const { return end_; }
+
+			const_iterator begin_{ nullptr };
+			const_iterator end_{ nullptr };
+		};
+
 		template<typename SocketType>
 		class RWHandlerTcp : public std::enable_shared_from_this<RWHandlerTcp<SocketType>> {
 		public:
-			explicit RWHandlerTcp(io_context& io_c, SocketType& socket, NMemoryStorage<char>& mem_storage) :
-				socket_(socket), memStorage_(mem_storage), readPacket_(), readHPacket_() { }
+			explicit RWHandlerTcp(io_context& io_c, SocketType& socket, NMemoryStorage<char>& mem_storage, \
+				const Codec& codec = Codec::Default()) :
+				socket_(socket), memStorage_(mem_storage), codec_(codec), readPacket_(), readHPacket_() { }
 			virtual ~RWHandlerTcp() {
 				if (readHPacket_.data()) {
 					memStorage_.Free(readHPacket_.data());
@@ -46,10 +61,16 @@ namespace Net {
 
 			virtual Packet* HandleRead(uint8_t& err_code) = 0;
 			virtual void HandleAsyncRead(CBAsyncRead cb = nullptr) = 0;
+			//a complete packet is buffered, HandleRead returns it without reading the socket.
+			virtual bool HasBuffered() const { return false; }
 
 			int HandleWrite(Packet& packet, uint8_t& err_code) {
+				asio::const_buffer buff = asio::buffer(packet.data(), packet.length());
+				return HandleWrite(ConstBuffers{ &buff, &buff + 1 }, err_code);
+			}
+			int HandleWrite(const ConstBuffers& buffers, uint8_t& err_code) {
 				asio::error_code ec;
-				auto size = asio::write(socket_, asio::buffer(packet.data(), packet.length()), ec);
+				auto size = asio::write(socket_, buffers, ec);
 				if (ec == asio::stream_errc::eof) {
 					HandleErr(E_ERR_T::e_Err_R, ec); // Connection closed cleanly by peer.
 					err_code = NET_EOF;
@@ -67,10 +88,25 @@ namespace Net {
 			void HandleAsyncWrite(Packet& packet, CBAsyncWrite cb = nullptr) {
 				AsyncWrite(packet, cb);
 			}
+			//the buffers must stay valid until cb is called, cb is also called on error(with the error code).
+			void HandleAsyncGather(const ConstBuffers& buffers, CBAsyncWrite cb) {
+				auto self = this->shared_from_this();
+				asio::async_write(socket_, buffers, \
+					[self, cb](std::error_code ec, std::size_t size) {
+						if (ec) {
+							self->HandleErr(E_ERR_T::e_Err_W, ec);
+							cb(size, ec == asio::stream_errc::eof ? NET_EOF : NET_OTHER);
+						}
+						else
+							cb(size, NO_ERR);
+					});
+			}
 			template<typename F>
 			void SetCallBackError(F f) {
 				cbErr_ = f;
 			}
+			//the counters of the session, for the failures of the handler itself(allocations).
+			void SetStats(SessionCounters* stats) { stats_ = stats; }
 
 		protected:
 			void HandleErr(E_ERR_T err_t, const asio::error_code& ec) {
@@ -82,15 +118,18 @@ namespace Net {
 						cbErr_(err_t, NET_OTHER);
 				}
 			}
-			int ReadBody() {
+			//read the rest(body and tail) of a frame whose header is in readHPacket_, into a pooled packet,
+			//-4 if the packet can't be allocated.
+			int ReadBody(const Frame& frame) {
 				std::error_code ec;
-				size_t len = readHPacket_.bodyLen();
-				if (len == 0) {//todo
-					StreamWriter::Instance()->Write(std::cout, "[RWHandler] Read Body len=%d", len);
+				if (frame.bodyLen == 0) {//todo
+					StreamWriter::Instance()->Write(std::cout, "[RWHandler] Read Body len=%d", frame.bodyLen);
 					return -3;
 				}
-				Buffer buff(memStorage_.Alloc(Packet::e_HeadLen + len), Packet::e_HeadLen + len);
-				readPacket_ = Packet(buff);
+				const int nret = AllocBody(frame);
+				if (nret < 0)
+					return nret == -2 ? -4 : -2;
+				const size_t len = frame.frameLen - frame.headLen;
 				auto size = asio::read(socket_, asio::buffer(readPacket_.body(), len), transfer_exactly(len), ec);
 				if (ec) {
 					if (readPacket_.data()) {
@@ -102,14 +141,18 @@ namespace Net {
 				}
 				return size;
 			}
-			void AsyncReadBody(CBAsyncRead cb) {
-				size_t len = readHPacket_.bodyLen();
-				if (len == 0) {//todo
-					StreamWriter::Instance()->Write(std::cout, "[RWHandler] Async read Body len=%d", len);
+			void AsyncReadBody(const Frame& frame, CBAsyncRead cb) {
+				if (frame.bodyLen == 0) {//todo
+					StreamWriter::Instance()->Write(std::cout, "[RWHandler] Async read Body len=%d", frame.bodyLen);
 					return;
 				}
-				Buffer buff(memStorage_.Alloc(Packet::e_HeadLen + len), Packet::e_HeadLen + len);
-				readPacket_ = Packet(buff);
+				const int nret = AllocBody(frame);
+				if (nret < 0) {
+					if (cb)
+						cb(nullptr, nret == -2 ? NET_OTHER : NET_BAD_BODY);
+					return;
+				}
+				const size_t len = frame.frameLen - frame.headLen;
 				auto self = this->shared_from_this();
 				asio::async_read(socket_, asio::buffer(readPacket_.body(), len), transfer_exactly(len), \
 					[self, cb](const asio::error_code& ec, std::size_t size) {
@@ -127,6 +170,22 @@ namespace Net {
 					});
 				return;
 			}
+			//-1 for a frame over the pool, -2 if the pool is out of memory.
+			int AllocBody(const Frame& frame) {
+				if (frame.frameLen > MaxPacketSize) //only the frames fit in the pool
+					return -1;
+				char* data = memStorage_.Alloc(frame.frameLen);
+				if (data == nullptr) {
+					if (stats_)
+						stats_->OnAllocFail();
+					return -2;
+				}
+				Buffer buff(data, frame.frameLen);
+				readPacket_ = Packet(buff);
+				memcpy(readPacket_.data(), readHPacket_.data(), frame.headLen);
+				uint8_t err_code{ NO_ERR };
+				return readPacket_.setFrame(frame, err_code);
+			}
 			void AsyncWrite(Packet& packet, CBAsyncWrite cb) {
 				auto self = this->shared_from_this();
 				asio::async_write(socket_, asio::buffer(packet.data(), packet.length()), \
@@ -152,15 +211,18 @@ namespace Net {
 			Packet readHPacket_;
 			Packet readPacket_;
 			CBErrRW cbErr_{ nullptr };
+			SessionCounters* stats_{ nullptr };
 			NMemoryStorage<char>& memStorage_;
+			Codec codec_;
 			//std::array<char, MAX_IP_PACK_SIZE> buff_{};
 		};
 
 		template<typename SocketType>
 		class RWHandlerTcpNS : public RWHandlerTcp<SocketType> {
 		public:
-			explicit RWHandlerTcpNS(io_context& io_c, SocketType& socket, NMemoryStorage<char>& mem_storage) :
-				RWHandlerTcp<SocketType>(io_c, socket, mem_storage) {
+			explicit RWHandlerTcpNS(io_context& io_c, SocketType& socket, NMemoryStorage<char>& mem_storage, \
+				const Codec& codec = Codec::Default()) :
+				RWHandlerTcp<SocketType>(io_c, socket, mem_storage, codec) {
 				this->readPacket_ = Packet(Buffer(this->memStorage_.Alloc(PacketSizeTcp), PacketSizeTcp));
 			}
 
@@ -198,12 +260,16 @@ namespace Net {
 				return;
 			}
 		};
+		//the legacy stick reader: an exact read of the header, then an exact read of the body. it only works with
+		//the codecs of a fixed header length(hex, len32) and frames which fit in the pool.
 		template<typename SocketType>
 		class RWHandlerTcpS : public RWHandlerTcp<SocketType> {
 		public:
-			explicit RWHandlerTcpS(io_context& io_c, tcp::socket& socket, NMemoryStorage<char>& mem_storage) :
-				RWHandlerTcp<SocketType>(io_c, socket, mem_storage) {
-				this->readHPacket_ = Packet(Buffer(this->memStorage_.Alloc(Packet::e_HeadLen), Packet::e_HeadLen));
+			explicit RWHandlerTcpS(io_context& io_c, tcp::socket& socket, NMemoryStorage<char>& mem_storage, \
+				const Codec& codec = Codec::Default()) :
+				RWHandlerTcp<SocketType>(io_c, socket, mem_storage, codec) {
+				assert(this->codec_.FixedHeadLen() > 0);
+				this->readHPacket_ = Packet(Buffer(this->memStorage_.Alloc(Codec::e_MaxHeadLen), Codec::e_MaxHeadLen));
 			}
 
 			virtual Packet* HandleRead(uint8_t& err_code) override {
@@ -214,7 +280,8 @@ namespace Net {
 				}
 
 				std::error_code ec;
-				auto size = asio::read(this->socket_, buffer(this->readHPacket_.data(), Packet::e_HeadLen), transfer_exactly(Packet::e_HeadLen), ec);
+				const size_t head_len = this->codec_.FixedHeadLen();
+				auto size = asio::read(this->socket_, buffer(this->readHPacket_.data(), head_len), transfer_exactly(head_len), ec);
 				if (ec == asio::stream_errc::eof) {
 					this->HandleErr(E_ERR_T::e_Err_R, ec); // Connection closed cleanly by peer.
 					err_code = NET_EOF;
@@ -225,12 +292,13 @@ namespace Net {
 					err_code = NET_OTHER;
 					return nullptr;
 				}
-				if (this->readHPacket_.decodeHeader(err_code) < 0) {
+				Frame frame;
+				if (this->codec_.Decode(this->readHPacket_.data(), head_len, frame, err_code) < 0) {
 					return nullptr;
 				}
-				auto ret = this->ReadBody();
+				auto ret = this->ReadBody(frame);
 				if (ret < 0) {
-					err_code = NET_BAD_BODY;
+					err_code = ret == -4 ? NET_OTHER : NET_BAD_BODY;
 					return nullptr;
 				}
 				return &this->readPacket_;
@@ -243,24 +311,208 @@ namespace Net {
 				}
 
 				auto self = std::dynamic_pointer_cast<RWHandlerTcpS>(this->shared_from_this());
-				asio::async_read(this->socket_, asio::buffer(this->readHPacket_.data(), Packet::e_HeadLen), transfer_exactly(Packet::e_HeadLen), \
-					[self, cb](const asio::error_code& ec, std::size_t size) {
+				const size_t head_len = this->codec_.FixedHeadLen();
+				asio::async_read(this->socket_, asio::buffer(this->readHPacket_.data(), head_len), transfer_exactly(head_len), \
+					[self, cb, head_len](const asio::error_code& ec, std::size_t size) {
 						if (ec) {
 							self->HandleErr(E_ERR_T::e_Err_R, ec);
 							return;
 						}
 						uint8_t err_code{ NO_ERR };
-						if (self->readHPacket_.decodeHeader(err_code) < 0) {
+						Frame frame;
+						if (self->codec_.Decode(self->readHPacket_.data(), head_len, frame, err_code) < 0) {
 							if (cb)
 								cb(nullptr, err_code);
 							return;
 						}
-						self->AsyncReadBody(cb);
+						self->AsyncReadBody(frame, cb);
 					});
 				return;
 			}
 		};
 
+		//a stick reader which reads as much as possible into a receive ring with one read_some, and then
+		//extracts every complete frame(by the codec) of the ring, it only reads again for a partial tail. the
+		//packet returned is a view into the ring, which keeps valid until the next read.
+		template<typename SocketType>
+		class RWHandlerTcpSB : public RWHandlerTcp<SocketType> {
+		public:
+			explicit RWHandlerTcpSB(io_context& io_c, SocketType& socket, NMemoryStorage<char>& mem_storage, \
+				const Codec& codec = Codec::Default()) :
+				RWHandlerTcp<SocketType>(io_c, socket, mem_storage, codec) {
+				assert(this->codec_.IsFramed());
+				//without a ring here, the first read allocates it(and fails if it can't)
+				ring_ = this->memStorage_.Alloc(RecvRingSize);
+				ringLen_ = ring_ ? RecvRingSize : 0;
+			}
+			virtual ~RWHandlerTcpSB() {
+				this->readPacket_.reset(); //a view, not owned
+				FreeRing();
+			}
+
+			virtual Packet* HandleRead(uint8_t& err_code) override {
+				while (true) {
+					int ret = NextFrame(err_code);
+					if (ret > 0)
+						return &this->readPacket_;
+					else if (ret < 0)
+						return nullptr;
+
+					if (Prepare(err_code) < 0)
+						return nullptr;
+					std::error_code ec;
+					auto size = this->socket_.read_some(asio::buffer(ring_ + tail_, ringLen_ - tail_), ec);
+					if (ec == asio::stream_errc::eof) {
+						this->HandleErr(E_ERR_T::e_Err_R, ec); // Connection closed cleanly by peer.
+						err_code = NET_EOF;
+						return nullptr;
+					}
+					else if (ec) {
+						this->HandleErr(E_ERR_T::e_Err_R, ec); // Some other error.
+						err_code = NET_OTHER;
+						return nullptr;
+					}
+					tail_ += size;
+				}
+			}
+			virtual bool HasBuffered() const override {
+				Frame frame;
+				uint8_t err_code{ NO_ERR };
+				return tail_ > head_ && this->codec_.Decode(ring_ + head_, tail_ - head_, frame, err_code) != 0;
+			}
+			virtual void HandleAsyncRead(CBAsyncRead cb = nullptr) override {
+				cbRead_ = cb;
+				bPending_ = true;
+				if (bDelivering_) //called from the callback, the delivering loop below takes it
+					return;
+				Deliver();
+			}
+
+		protected:
+			//deliver the buffered frames one by one in a loop instead of recursion, until no one asks for more.
+			void Deliver() {
+				bDelivering_ = true;
+				while (bPending_) {
+					uint8_t err_code{ NO_ERR };
+					int ret = NextFrame(err_code);
+					if (ret == 0)
+						break;
+					bPending_ = false;
+					auto cb = cbRead_;
+					if (cb)
+						cb(ret > 0 ? &this->readPacket_ : nullptr, err_code);
+				}
+				bDelivering_ = false;
+				if (bPending_)
+					AsyncFill();
+			}
+			void AsyncFill() {
+				uint8_t err_code{ NO_ERR };
+				if (Prepare(err_code) < 0) {
+					bPending_ = false;
+					if (cbRead_)
+						cbRead_(nullptr, err_code);
+					return;
+				}
+				auto self = std::dynamic_pointer_cast<RWHandlerTcpSB>(this->shared_from_this());
+				this->socket_.async_read_some(asio::buffer(ring_ + tail_, ringLen_ - tail_), \
+					[self](const asio::error_code& ec, std::size_t size) {
+						if (ec) {
+							self->bPending_ = false;
+							self->HandleErr(E_ERR_T::e_Err_R, ec);
+							return;
+						}
+						self->tail_ += size;
+						self->Deliver();
+					});
+			}
+			//return 1 if a frame is ready in readPacket_, 0 if more data is needed, -1 if the header is bad.
+			int NextFrame(uint8_t& err_code) {
+				Frame frame;
+				while (true) {
+					int ret = this->codec_.Decode(ring_ + head_, tail_ - head_, frame, err_code);
+					if (ret < 0) {
+						head_ = tail_ = 0; //the stream can't be resynchronized, drop what is buffered
+						need_ = 0;
+						return -1;
+					}
+					else if (ret == 0) {
+						need_ = frame.frameLen > 0 ? frame.frameLen : tail_ - head_ + 1;
+						return 0;
+					}
+					char* data = ring_ + head_;
+					head_ += frame.frameLen;
+					if (frame.bodyLen == 0) //an empty frame carries nothing
+						continue;
+					this->readPacket_ = Packet(Buffer::Wrap(data, frame.frameLen));
+					this->readPacket_.setFrame(frame, err_code);
+					return 1;
+				}
+			}
+			//make room for the next read: move the partial tail to the front, and grow the ring for a big frame.
+			//the ring grows only when the frame's bytes have filled it, at most double per read, not to the
+			//length a header claims. a ring grown over the pool is taken from the heap, and given back once
+			//it is drained.
+			int Prepare(uint8_t& err_code) {
+				this->readPacket_.reset();
+				if (head_ == tail_) {
+					head_ = tail_ = 0;
+					if (ringLen_ > RecvRingSize && need_ <= RecvRingSize)
+						FreeRing();
+				}
+				else if (head_ > 0) {
+					memmove(ring_, ring_ + head_, tail_ - head_);
+					tail_ -= head_;
+					head_ = 0;
+				}
+				if (need_ > MaxFrameSize + Codec::e_MaxHeadLen + Codec::e_MaxTailLen) {
+					err_code = NET_BAD_BODY;
+					return -1;
+				}
+				if (ring_ == nullptr)
+					return Resize(RecvRingSize, err_code);
+				if (need_ > ringLen_ && tail_ == ringLen_)
+					return Resize(ringLen_ * 2 < need_ ? ringLen_ * 2 : need_, err_code);
+				return 0;
+			}
+			//a ring of len bytes with the unread data, the old one is kept if it can't be allocated.
+			int Resize(size_t len, uint8_t& err_code) {
+				char* ring = len > MaxPacketSize ? new (std::nothrow) char[len] : this->memStorage_.Alloc(len);
+				if (ring == nullptr) {
+					if (this->stats_)
+						this->stats_->OnAllocFail();
+					err_code = NET_OTHER;
+					return -1;
+				}
+				if (tail_ > 0)
+					memcpy(ring, ring_, tail_);
+				FreeRing();
+				ring_ = ring;
+				ringLen_ = len;
+				return 0;
+			}
+			void FreeRing() {
+				if (!ring_)
+					return;
+				if (ringLen_ > MaxPacketSize)
+					delete[] ring_;
+				else
+					this->memStorage_.Free(ring_);
+				ring_ = nullptr;
+				ringLen_ = 0;
+			}
+
+		protected:
+			char* ring_{ nullptr };
+			size_t ringLen_{ 0 };
+			size_t head_{ 0 };	//the begin of the unread data
+			size_t tail_{ 0 };	//the end of the unread data
+			size_t need_{ 0 };	//the bytes the next frame needs
+			CBAsyncRead cbRead_{ nullptr };
+			bool bPending_{ false };
+			bool bDelivering_{ false };
+		};
+
 		typedef std::function<void(const udp::endpoint& endpoint, std::size_t, uint8_t)> CBAsyncWriteUdp;
 		typedef std::function<void(const udp::endpoint& endpoint, Packet*, uint8_t)>  CBAsyncReadUdp;
 
@@ -286,7 +538,7 @@ namespace Net {
 					return nullptr;
 				}
 				else {
-					int ret = readHPacket_.decodeHeader(err_code);
+					int ret = readHPacket_.decodeHeader(codec_, size, err_code);
 					if (ret == -1)
 						return nullptr;
 					else if (ret == -2)
@@ -309,7 +561,7 @@ namespace Net {
 							return;
 						}
 						uint8_t err_code{ NO_ERR };
-						int ret = self->readHPacket_.decodeHeader(err_code);
+						int ret = self->readHPacket_.decodeHeader(self->codec_, size, err_code);
 						if (ret == -1) {
 							if (cb)
 								cb(endpoint, nullptr, err_code);
@@ -376,6 +628,7 @@ namespace Net {
 			Packet readPacket_;
 			CBErrRW cbErr_{ nullptr };
 			NMemoryStorage<char>& memStorage_;
+			Codec codec_{ Codec::Default() }; //a datagram is a frame, only the header is checked
 		};
 	}
 }
\ No newline at end of file
@@ -12,8 +12,9 @@ namespace Net {
 	namespace Core {
 		class SessionTcp : public SessionBase<SOCKET_TYPE> {
 		public:
-			explicit SessionTcp(int sess_id, io_context& io_c, Socket_TCP&& socket, NMemoryStorage<char>& mem_storage, unsigned timeout, bool keeplive = false) :
-				SessionBase(sess_id, io_c, std::move(socket), mem_storage, timeout, keeplive)
+			explicit SessionTcp(SessionId sess_id, io_context& io_c, Socket_TCP&& socket, NMemoryStorage<char>& mem_storage, unsigned timeout, bool keeplive = false, \
+				const Codec& codec = Codec::Default()) :
+				SessionBase(sess_id, io_c, std::move(socket), mem_storage, timeout, keeplive, codec)
 			{ Init(); }
 
 		protected:
@@ -21,12 +22,14 @@ namespace Net {
 				rwHandler_ = std::shared_ptr<RWHandlerTcp<SOCKET_TYPE>>(CreateRWHandler());
 			}
 			virtual RWHandlerTcp<SOCKET_TYPE>* CreateRWHandler() override {
-#ifdef PACKET_STICK
-				RWHandlerTcp<SOCKET_TYPE>* handler = new RWHandlerTcpS<SOCKET_TYPE>(ioCtx_, socket_, memStorage_);
-#else
-				RWHandlerTcp<SOCKET_TYPE>* handler = new RWHandlerTcpNS<SOCKET_TYPE>(ioCtx_, socket_, memStorage_);
-#endif //PACKET_STICK
+				RWHandlerTcp<SOCKET_TYPE>* handler{ nullptr };
+				if (codec_.IsFramed())
+					handler = new RWHandlerTcpSB<SOCKET_TYPE>(ioCtx_, socket_, memStorage_, codec_);
+				else
+					handler = new RWHandlerTcpNS<SOCKET_TYPE>(ioCtx_, socket_, memStorage_, codec_);
+				handler->SetStats(&stats_);
 				handler->SetCallBackError([this](E_ERR_T err_t, uint8_t ec) {
+					stats_.OnError(ec);
 					switch (ec) {
 					case NET_EOF:
 						StreamWriter::Instance()->Write(std::cout, "[Session] Net err, eof!");
@@ -50,13 +53,7 @@ namespace Net {
 						asio::error_code ec;
 						socket_.shutdown(tcp::socket::shutdown_send, ec);
 
-						std::lock_guard<std::mutex> lock(this->mtx_);
-						for (auto& var : sendQueue_) {
-							if (var.data()) {
-								memStorage_.Free(var.data());
-							}
-						}
-						sendQueue_.clear();
+						ClearSendQueue();
 					}
 					else if (err_t == E_ERR_T::e_Err_R) {
 						asio::error_code ec;
@@ -73,28 +70,19 @@ namespace Net {
 				socket_.shutdown(tcp::socket::shutdown_both, ec);
 				socket_.close();
 			}
-			virtual void OnTimer() override {
-				if (timeout_ > 0) {
-					auto self = this->shared_from_this();
-					timer_.expires_after(std::chrono::seconds(timeout_));
-					timer_.async_wait(
-						[this, self](const std::error_code& ec)
-						{
-							if (ec != asio::error::operation_aborted)
-								this->socket_.cancel();
-						});
-				}				
-			}
 		};
 
 		class SessionUdp : public std::enable_shared_from_this<SessionUdp> {
 		public:
 			explicit SessionUdp(io_context& io_c, NMemoryStorage<char>& mem_storage, unsigned timeout) :
-				ioCtx_(io_c), socket_(io_c/*, udp::endpoint(udp::v4(), 9900)*/), timer_(io_c), memStorage_(mem_storage), timeout_(timeout)
+				ioCtx_(io_c), socket_(io_c/*, udp::endpoint(udp::v4(), 9900)*/), wheel_(TimingWheel::Of(io_c)), memStorage_(mem_storage), timeout_(timeout)
 			{
 				Init();
 			}
-			~SessionUdp() { Release(); };
+			~SessionUdp() {
+				wheel_.Cancel(ioTimer_);
+				Release();
+			};
 
 			int Open(const std::string& ip, short port, bool b_reuse = false) {
 				endpointLocal_ = udp::endpoint(asio::ip::make_address(ip), port);
@@ -117,18 +105,24 @@ namespace Net {
 			}
 
 			udp::endpoint& GetNetPeer() { return endpointPeer_; }
+			//the traffic counters, read while the io goes on.
+			SessionStats Snapshot() const { return stats_.Snapshot(); }
+			SessionCounters& GetStats() { return stats_; }
 			int Send(const udp::endpoint& endpoint, const char* data, unsigned len, uint8_t& err_code) {
-				Buffer buff;
-				if (len > Packet::e_Max_BodyLen)
-					buff = Buffer(memStorage_.Alloc(MaxPacketSize), MaxPacketSize);
-				else
-					buff = Buffer(memStorage_.Alloc(len + Packet::e_HeadLen), len + Packet::e_HeadLen);
+				const unsigned max_body = MaxBodyLen();
+				const unsigned buff_len = (len > max_body ? max_body : len) + Packet::e_HeadLen;
+				char* p = memStorage_.Alloc(buff_len);
+				if (p == nullptr) {
+					stats_.OnAllocFail();
+					err_code = NET_OTHER;
+					return -2;
+				}
 
-				Packet packet(buff);
+				Packet packet(Buffer(p, buff_len));
 				int nret{ 0 };
 				while (len > 0) {
 					packet.clear();
-					const unsigned send_size = len > Packet::e_Max_BodyLen ? (MaxPacketSize - Packet::e_HeadLen) : len;
+					const unsigned send_size = len > max_body ? max_body : len;
 					if (packet.encodeData(data, send_size, err_code) < 0) {
 						assert(packet.data());
 						auto ret = memStorage_.Free(packet.data());
@@ -136,19 +130,13 @@ namespace Net {
 							assert(0);
 						return -2;//todo return nret?
 					}
-					if (timeout_ > 0) {
-						timer_.expires_after(std::chrono::seconds(timeout_));
-						timer_.async_wait(
-							[this](const std::error_code& ec)
-							{
-								if (ec != asio::error::operation_aborted)
-									socket_.cancel();
-							});
-					}
+					if (timeout_ > 0)
+						wheel_.Arm(ioTimer_, std::chrono::seconds(timeout_));
 					auto ret = rwHandler_->HandleWrite(endpoint, packet, err_code);
 					if (timeout_ > 0)
-						timer_.cancel();
+						wheel_.Cancel(ioTimer_);
 					if (ret > 0) {
+						stats_.OnSend(ret, 1);
 						nret += (ret - Packet::e_HeadLen);
 						len -= (ret - Packet::e_HeadLen);
 						data += (ret - Packet::e_HeadLen);
@@ -168,19 +156,13 @@ namespace Net {
 				return nret;
 			}
 			int Recieve(char** data, uint8_t& err_code) {
-				if (timeout_ > 0) {
-					timer_.expires_after(std::chrono::seconds(timeout_));
-					timer_.async_wait(
-						[this](const std::error_code& ec)
-						{
-							if (ec != asio::error::operation_aborted)
-								socket_.cancel();
-						});
-				}
+				if (timeout_ > 0)
+					wheel_.Arm(ioTimer_, std::chrono::seconds(timeout_));
 				Packet* packet = rwHandler_->HandleRead(endpointPeer_, err_code);
 				if (timeout_ > 0)
-					timer_.cancel();
+					wheel_.Cancel(ioTimer_);
 				if (packet) {
+					stats_.OnRecv(packet->length());
 					*data = packet->body();
 					return packet->bodyLen();
 				}
@@ -188,10 +170,19 @@ namespace Net {
 			}
 			int AsyncSend(const udp::endpoint& endpoint, const char* data, unsigned len, std::function<void(const udp::endpoint&, size_t, uint8_t)> func = nullptr) {
 				uint8_t err_code{ 0 };
+				int nret{ 0 };
+				const unsigned max_body = MaxBodyLen();
 				while (len > 0) {
-					const unsigned send_size = len > Packet::e_Max_BodyLen ? (MaxPacketSize - Packet::e_HeadLen) : len;
-					Buffer buff(memStorage_.Alloc(send_size + Packet::e_HeadLen), send_size + Packet::e_HeadLen);
-					Packet packet(buff);
+					const unsigned send_size = len > max_body ? max_body : len;
+					char* p = memStorage_.Alloc(send_size + Packet::e_HeadLen);
+					if (p == nullptr) {
+						stats_.OnAllocFail();
+						if (func)
+							func(endpointPeer_, -2, NET_OTHER);
+						nret = -2;
+						break;
+					}
+					Packet packet(Buffer(p, send_size + Packet::e_HeadLen));
 					if (packet.encodeData(data, send_size, err_code) < 0) {
 						assert(packet.data());
 						auto ret = memStorage_.Free(packet.data());
@@ -199,49 +190,79 @@ namespace Net {
 							assert(0);
 						if (func)
 							func(endpointPeer_, -2, err_code);
+						nret = -2;
+						break;
 					}
-					{
-						std::lock_guard<std::mutex> lock(mtx_);
-						sendQueue_.emplace_back(packet);//todo
+					if (!sendQueue_.Push(std::move(packet))) {
+						stats_.OnError(E_STAT_ERR_T::e_SendFull);
+						memStorage_.Free(packet.data());
+						if (func)
+							func(endpointPeer_, -3, NET_OTHER);
+						nret = -3;
+						break;
 					}
+					stats_.OnQueued(0, sendQueue_.Size());
 					len -= send_size;
 					data += send_size;
 				}
 
-				if (!bAsyncW_) {
-					bAsyncW_ = true;
+				if (!bAsyncW_.exchange(true))
 					DoAsyncSend(endpoint, func);//todo
-				}
-				return 0;
+				return nret;
 			}
 			int AsyncRecieve(CBAsyncReadUdp cb) {
-				rwHandler_->HandleAsyncRead(endpointPeer_, cb);
+				auto self = this->shared_from_this();
+				rwHandler_->HandleAsyncRead(endpointPeer_, [self, cb](const udp::endpoint& endpoint, Packet* packet, uint8_t ec) {
+					if (packet && ec == NO_ERR)
+						self->stats_.OnRecv(packet->length());
+					if (cb)
+						cb(endpoint, packet, ec);
+					});
 				return 0;
 			}
 			template<typename F>
 			void SetCallBackError(F f) { cbErr_ = f; }
 			udp::socket& GetSocket() { return socket_; }
+			void SetSendBatch(size_t max_bufs) { maxBatchBufs_ = max_bufs > 0 ? max_bufs : 1; }
+			//the slots of the send queue(rounded up to a power of 2), only before anything is sent.
+			void SetSendQueueSize(size_t size) { sendQueue_.Reset(size); }
 
 		protected:
 			void Init() {
 				rwHandler_ = std::shared_ptr<RWHandlerUdp>(CreateRWHandler());
+				ioTimer_.SetCallBack([this] {
+					stats_.OnTimeout();
+					asio::error_code ec;
+					socket_.cancel(ec);
+					});
+			}
+			//a datagram is sent with the header of the default codec.
+			unsigned MaxBodyLen() const {
+				const size_t max_body = Codec::Default().MaxBodyLen();
+				const size_t max_packet = static_cast<size_t>(Packet::e_Max_BodyLen);
+				return static_cast<unsigned>(max_body < max_packet ? max_body : max_packet);
 			}
 			void Release() {
-				{
-					std::lock_guard<std::mutex> lock(this->mtx_);
-					if (!sendQueue_.empty()) {
-						for (auto& var : sendQueue_) {
-							if (var.data())
-								memStorage_.Free(var.data());
-						}
-						sendQueue_.clear();
-					}
+				ClearSendQueue();
+				for (auto& var : sendBatch_) {
+					if (var.data())
+						memStorage_.Free(var.data());
+				}
+				sendBatch_.clear();
+			}
+			//it consumes the queue, so only the active writer(or the owner when no writer can start any more) calls it.
+			void ClearSendQueue() {
+				Packet packet;
+				while (sendQueue_.Pop(packet)) {
+					if (packet.data())
+						memStorage_.Free(packet.data());
 				}
 			}
 			RWHandlerUdp* CreateRWHandler() {
 				RWHandlerUdp* handler = new RWHandlerUdp(ioCtx_, socket_, memStorage_);
 
 				handler->SetCallBackError([this](E_ERR_T err_t, uint8_t ec) {
+					stats_.OnError(ec);
 					switch (ec) {
 					case NET_EOF:
 						StreamWriter::Instance()->Write(std::cout, "[Session] Net err, eof!");
@@ -265,13 +286,7 @@ namespace Net {
 						asio::error_code ec;
 						socket_.shutdown(tcp::socket::shutdown_send, ec);
 
-						std::lock_guard<std::mutex> lock(this->mtx_);
-						for (auto& var : sendQueue_) {
-							if (var.data()) {
-								memStorage_.Free(var.data());
-							}
-						}
-						sendQueue_.clear();
+						ClearSendQueue();
 					}
 					else if (err_t == E_ERR_T::e_Err_R) {
 						asio::error_code ec;
@@ -288,38 +303,35 @@ namespace Net {
 				socket_.shutdown(tcp::socket::shutdown_both, ec);
 				socket_.close();
 			}
+			//datagrams can't be gathered into one send_to, so the queue is drained into a batch
+			//which is sent back to back. only the writer which has set bAsyncW_ consumes sendQueue_.
 			void DoAsyncSend(const udp::endpoint& endpoint, std::function<void(const udp::endpoint&, size_t, uint8_t)> func) {
-				Packet packet;
-				bool b_get{ false };
-				{
-					std::lock_guard<std::mutex> lock(mtx_);
-					if (!sendQueue_.empty()) {
-						packet = sendQueue_.front();
-						b_get = true;
-					}
+				while (batchPos_ >= sendBatch_.size()) {
+					sendBatch_.clear();
+					batchPos_ = 0;
+					Packet packet;
+					while (sendBatch_.size() < maxBatchBufs_ && sendQueue_.Pop(packet))
+						sendBatch_.emplace_back(std::move(packet));
+					if (!sendBatch_.empty())
+						break;
+					bAsyncW_.exchange(false);
+					if (sendQueue_.Empty() || bAsyncW_.exchange(true))
+						return;
 				}
 
-				if (b_get) {
-					auto self = this->shared_from_this();
-					rwHandler_->HandleAsyncWrite(endpoint, packet, [self, func](const udp::endpoint& endpoint, std::size_t size, uint8_t ec) {
-						Packet packet;
-						{
-							std::lock_guard<std::mutex> lock(self->mtx_);
-							if (!self->sendQueue_.empty()) {
-								packet = self->sendQueue_.front();
-								self->sendQueue_.pop_front();
-							}
-						}
-						if (packet.data()) {
-							self->memStorage_.Free(packet.data());
-						}
-						if (func)
-							func(endpoint, size, ec);
-						self->DoAsyncSend(endpoint, func);
-						});
-				}
-				else
-					bAsyncW_ = false;
+				auto self = this->shared_from_this();
+				rwHandler_->HandleAsyncWrite(endpoint, sendBatch_[batchPos_], [self, func](const udp::endpoint& endpoint, std::size_t size, uint8_t ec) {
+					Packet& packet = self->sendBatch_[self->batchPos_++];
+					if (!ec)
+						self->stats_.OnSend(size, 1);
+					if (packet.data()) {
+						self->memStorage_.Free(packet.data());
+						packet.reset();
+					}
+					if (func)
+						func(endpoint, size, ec);
+					self->DoAsyncSend(endpoint, func);
+					});
 			}
 
 		protected:
@@ -329,12 +341,16 @@ namespace Net {
 			udp::endpoint endpointPeer_;
 			NMemoryStorage<char>& memStorage_;
 			std::shared_ptr<RWHandlerUdp> rwHandler_{ nullptr };
-			steady_timer timer_;
+			TimingWheel& wheel_;
+			TimerNode ioTimer_;	//the timeout of a sync Send/Recieve
 			unsigned timeout_{ 0 };
 			CBErrUdp cbErr_{ nullptr }; //params:session id, error_code
-			std::mutex mtx_;
-			std::atomic_bool bAsyncW_{ false };
-			std::list<Packet> sendQueue_;
+			std::atomic_bool bAsyncW_{ false };	//set by the writer, which is the only consumer of sendQueue_
+			MpscQueue<Packet> sendQueue_{ SendQueueSize };
+			std::vector<Packet> sendBatch_;	//datagrams in flight, only touched by the active writer.
+			size_t batchPos_{ 0 };
+			size_t maxBatchBufs_{ MaxSendBatchBufs };
+			SessionCounters stats_;
 		};
 	}
 }
\ No newline at end of file
@@ -6,6 +6,7 @@
 //[Date]:2020-08-10
 //[Other]:Copyright (c) 2020-2050 Nico Hu
 //========================================================================
+#include <mutex>
 #include <unordered_map>
 
 #include "../Comm.h"
@@ -13,6 +14,10 @@
 #include "NMemoryStorage.h"
 #include "StreamWriter.h"
 #include "NonCopyable.h"
+#include "MpscQueue.h"
+#include "TimingWheel.h"
+#include "SessionStats.h"
+#include "SharedBuffer.h"
 
 #ifdef OPENSSL
 #include "../asio/asio/ssl.hpp"
@@ -32,19 +37,106 @@ namespace Net {
 		typedef Socket_TCP_SSL SOCKET_TYPE;
 #endif //OPENSSL
 
+		typedef std::function<void()> CBRelease;
+		typedef std::function<void(SessionId, bool)> CBSendState; //params:session id, paused
+
+		//what a session does with a send which would take its send queue over the hard limit.
+		enum class E_SEND_LIMIT_T {
+			e_Reject = 0,	//refuse the send(-4)
+			e_Disconnect,	//refuse the send and shut the connection down
+			e_DropOldest	//queue the send, the writer drops the oldest queued items to get under the limit
+		};
+
+		//the watermarks of a session send queue, counted in bytes and in queued items(sends), including
+		//the ones being written. crossing a high mark pauses the session(the send returns 1 and the state
+		//callback gets paused), it is resumed when both counts have drained to the low marks. 0 turns a mark off.
+		struct SendWatermark {
+			size_t highBytes{ SendHighWaterBytes };
+			size_t lowBytes{ SendLowWaterBytes };
+			size_t highPackets{ SendQueueSize * 3 / 4 };
+			size_t lowPackets{ SendQueueSize / 4 };
+			size_t hardBytes{ 0 };
+			size_t hardPackets{ 0 };
+			E_SEND_LIMIT_T policy{ E_SEND_LIMIT_T::e_Reject };
+		};
+		//the marks of a live session, each one set and read on its own: a change made while the session sends
+		//may be seen a mark at a time.
+		struct SendWatermarkAtomic {
+			SendWatermarkAtomic() { Store(SendWatermark()); }
+			void Store(const SendWatermark& watermark) {
+				highBytes.store(watermark.highBytes, std::memory_order_relaxed);
+				lowBytes.store(watermark.lowBytes, std::memory_order_relaxed);
+				highPackets.store(watermark.highPackets, std::memory_order_relaxed);
+				lowPackets.store(watermark.lowPackets, std::memory_order_relaxed);
+				hardBytes.store(watermark.hardBytes, std::memory_order_relaxed);
+				hardPackets.store(watermark.hardPackets, std::memory_order_relaxed);
+				policy.store(watermark.policy, std::memory_order_relaxed);
+			}
+			SendWatermark Load() const {
+				SendWatermark watermark;
+				watermark.highBytes = highBytes.load(std::memory_order_relaxed);
+				watermark.lowBytes = lowBytes.load(std::memory_order_relaxed);
+				watermark.highPackets = highPackets.load(std::memory_order_relaxed);
+				watermark.lowPackets = lowPackets.load(std::memory_order_relaxed);
+				watermark.hardBytes = hardBytes.load(std::memory_order_relaxed);
+				watermark.hardPackets = hardPackets.load(std::memory_order_relaxed);
+				watermark.policy = policy.load(std::memory_order_relaxed);
+				return watermark;
+			}
+
+			std::atomic<size_t> highBytes;
+			std::atomic<size_t> lowBytes;
+			std::atomic<size_t> highPackets;
+			std::atomic<size_t> lowPackets;
+			std::atomic<size_t> hardBytes;
+			std::atomic<size_t> hardPackets;
+			std::atomic<E_SEND_LIMIT_T> policy;
+		};
+
+		//an entry of the send queue: a pooled packet, or the buffers to gather(the packet then only holds
+		//the encoded headers/tails, which are already placed in views), or a reference of a shared buffer.
+		//the views point to the caller-owned buffers of a zero-copy send, or to the pooled blocks of a frame
+		//too big for one pooled packet.
+		struct SendItem {
+			Packet packet;
+			std::vector<asio::const_buffer> views;
+			std::vector<char*> blocks;
+			CBRelease release{ nullptr };
+			SharedBuffer shared;
+
+			size_t length() const {
+				if (shared)
+					return shared.length();
+				if (views.empty())
+					return packet.length();
+				size_t len{ 0 };
+				for (auto& var : views)
+					len += var.size();
+				return len;
+			}
+		};
+
 		template<typename SocketType>
 		class SessionBase : public std::enable_shared_from_this<SessionBase<SocketType>> {
 		public:
 #ifndef OPENSSL
-			explicit SessionBase(int sess_id, io_context& io_c, Socket_TCP&& socket, NMemoryStorage<char>& mem_storage, unsigned timeout, bool keeplive) :
-				id_(sess_id), ioCtx_(io_c), socket_(std::move(socket)), timer_(io_c), memStorage_(mem_storage), timeout_(timeout), keeplive_(keeplive)
-			{ }
+			explicit SessionBase(SessionId sess_id, io_context& io_c, Socket_TCP&& socket, NMemoryStorage<char>& mem_storage, unsigned timeout, bool keeplive, \
+				const Codec& codec = Codec::Default()) :
+				id_(sess_id), ioCtx_(io_c), socket_(std::move(socket)), wheel_(TimingWheel::Of(io_c)), memStorage_(mem_storage), timeout_(timeout), keeplive_(keeplive), \
+				codec_(codec)
+			{ InitTimer(); }
 #else
-			explicit SessionBase(int sess_id, io_context& io_c, Socket_TCP&& socket, ssl::context& ssl_c, NMemoryStorage<char>& mem_storage, unsigned timeout, bool keeplive) :
-				id_(sess_id), ioCtx_(io_c), socket_(std::move(socket), ssl_c), timer_(io_c), memStorage_(mem_storage), timeout_(timeout), keeplive_(keeplive)
-			{ }
+			explicit SessionBase(SessionId sess_id, io_context& io_c, Socket_TCP&& socket, ssl::context& ssl_c, NMemoryStorage<char>& mem_storage, unsigned timeout, bool keeplive, \
+				const Codec& codec = Codec::Default()) :
+				id_(sess_id), ioCtx_(io_c), socket_(std::move(socket), ssl_c), wheel_(TimingWheel::Of(io_c)), memStorage_(mem_storage), timeout_(timeout), keeplive_(keeplive), \
+				codec_(codec)
+			{ InitTimer(); }
 #endif //OPENSSL
-			~SessionBase() { Release(); };
+			~SessionBase() {
+				wheel_.Cancel(ioTimer_);
+				wheel_.Cancel(idleTimer_);
+				Release();
+			};
 
 			int Open(const std::string& ip, short port, bool b_reuse = false) {
 				endpointLocal_ = tcp::endpoint(asio::ip::make_address(ip), port);
@@ -65,59 +157,59 @@ namespace Net {
 				socket_.get_option(option, ec);
 			}
 			bool isClosed() { return !socket_.is_open(); }
-			void SetId(int id) { id_ = id; }
-			int GetId() const { return id_; }
+			//the io_context(reactor) the io of the session runs on.
+			io_context& GetIoContext() { return ioCtx_; }
+			void SetId(SessionId id) { id_ = id; }
+			SessionId GetId() const { return id_; }
 			void SetStatus(int status) { State_ = status; }
 			int GetStatus() { return State_; }
 			bool GetKeeplive() { return keeplive_; }
 			void SetKeeplive(bool keeplive) { keeplive_ = keeplive; }
 			tcp::endpoint& GetNetPeer() { return endpointPeer_; }
+			const Codec& GetCodec() const { return codec_; }
+			//the traffic counters, read while the io goes on.
+			SessionStats Snapshot() const { return stats_.Snapshot(); }
+			SessionCounters& GetStats() { return stats_; }
 
 			int Send(const char* data, unsigned len, uint8_t& err_code) {
 				if (!State_)
 					return -1;
+				if (!codec_.Accept(len)) {
+					err_code = NET_BAD_BODY;
+					return -2;
+				}
 
-				Buffer buff;
-				if (len > Packet::e_Max_BodyLen)
-					buff = Buffer(memStorage_.Alloc(MaxPacketSize), MaxPacketSize);
-				else
-					buff = Buffer(memStorage_.Alloc(len + Packet::e_HeadLen), len + Packet::e_HeadLen);
-
-				Packet packet(buff);
+				//the body is written from the caller's buffer directly, only the header and tail are encoded aside.
+				char head[Codec::e_MaxHeadLen]{ 0 };
+				char tail[Codec::e_MaxTailLen]{ 0 };
+				const size_t max_body = codec_.MaxBodyLen();
 				int nret{ 0 };
 				while (len > 0) {
-					packet.clear();
-					const unsigned send_size = len > Packet::e_Max_BodyLen ? (MaxPacketSize - Packet::e_HeadLen) : len;
-					if (packet.encodeData(data, send_size, err_code) < 0) {
-						assert(packet.data());
-						auto ret = memStorage_.Free(packet.data());
-						if (ret < 0)
-							assert(0);
-						return -2;//todo return nret?
-					}
+					const unsigned send_size = len > max_body ? static_cast<unsigned>(max_body) : len;
+					const int head_len = codec_.EncodeHead(head, send_size, err_code);
+					if (head_len < 0)
+						return nret;
+					const int tail_len = codec_.EncodeTail(tail);
+					asio::const_buffer bufs[3] = { asio::buffer(head, head_len), asio::buffer(data, send_size), asio::buffer(tail, tail_len) };
 					OnTimer();
-					auto ret = rwHandler_->HandleWrite(packet, err_code);
+					auto ret = rwHandler_->HandleWrite(ConstBuffers{ bufs, bufs + 3 }, err_code);
 					OffTimer();
 
 					if (ret > 0) {
-						nret += (ret - Packet::e_HeadLen);
-						len -= (ret - Packet::e_HeadLen);
-						data += (ret - Packet::e_HeadLen);
+						Touch();
+						stats_.OnSend(ret, 1);
+						const int body_size = ret - head_len - tail_len;
+						nret += body_size;
+						len -= body_size;
+						data += body_size;
 					}
-					else {//todo return ret?
-						assert(packet.data());
-						auto ret1 = memStorage_.Free(packet.data());
-						if (ret1 < 0)
-							assert(0);
+					else //todo return ret?
 						return nret;
-					}
 				}
-				assert(packet.data());
-				auto ret1 = memStorage_.Free(packet.data());
-				if (ret1 < 0)
-					assert(0);
 				return nret;
 			}
+			//a complete packet is buffered(stick mode), the next Recieve doesn't wait for the socket.
+			bool HasBuffered() const { return rwHandler_ && rwHandler_->HasBuffered(); }
 			int Recieve(char** data, uint8_t& err_code) {
 				if (!State_) {
 					err_code = 1;
@@ -127,110 +219,458 @@ namespace Net {
 				OnTimer();
 				Packet* packet = rwHandler_->HandleRead(err_code);
 				OffTimer();
+				Touch();
 				if (packet) {
-					*data = packet->data();
+					stats_.OnRecv(packet->length());
+					*data = packet->body();
 					return packet->bodyLen();
 				}
 				return -2;
 			}
+			//queue the frames of data for the writer, return 1 if the send queue is over the high watermark(the send
+			//is queued), -3 if the queue is full or -4 if it is over the hard limit(func gets the code too).
 			int AsyncSend(const char* data, unsigned len, std::function<void(size_t, uint8_t)> func = nullptr) {
 				if (!State_)
 					return -1;
 				else {
 					uint8_t err_code{ 0 };
+					if (!codec_.Accept(len)) {
+						if (func)
+							func(-2, NET_BAD_BODY);
+						return -2;
+					}
+					//the frames of one send are queued as one item, so they are never interleaved with another producer's.
+					const size_t max_body = codec_.MaxBodyLen();
+					SendItem item;
+					bool b_first{ true };
 					while (len > 0) {
-						const unsigned send_size = len > Packet::e_Max_BodyLen ? (MaxPacketSize - Packet::e_HeadLen) : len;
-						Buffer buff(memStorage_.Alloc(send_size + Packet::e_HeadLen), send_size + Packet::e_HeadLen);
-						Packet packet(buff);
-						if (packet.encodeData(data, send_size, err_code) < 0) {
-							assert(packet.data());
-							auto ret = memStorage_.Free(packet.data());
-							if (ret < 0)
-								assert(0);
+						const unsigned send_size = len > max_body ? static_cast<unsigned>(max_body) : len;
+						SendItem frame;
+						if (EncodeItem(frame, data, send_size, err_code) < 0) {
+							FreeSendItem(frame);
+							FreeSendItem(item);
 							if (func)
 								func(-2, err_code);
+							return -2;
 						}
-						{
-							std::lock_guard<std::mutex> lock(mtx_);
-							sendQueue_.emplace_back(packet);//todo
-						}
+						if (b_first && send_size == len)
+							item = std::move(frame);
+						else
+							MergeItem(item, frame);
+						b_first = false;
 						len -= send_size;
 						data += send_size;
 					}
+					return PushSendItem(item, func);
+				}
+			}
+			//send the caller-owned buffers without copying them, only the framing headers are allocated.
+			//the buffers must stay valid until release is called, which happens once they are written
+			//or dropped. release is not called if the send is refused(return < 0).
+			int AsyncSendView(const std::vector<asio::const_buffer>& buffers, std::function<void(size_t, uint8_t)> func = nullptr, \
+				CBRelease release = nullptr) {
+				if (!State_)
+					return -1;
 
-					if (!bAsyncW_) {
-						bAsyncW_ = true;
-						DoAsyncSend(func);//todo
+				SendItem item;
+				item.release = release;
+				size_t total{ 0 };
+				for (auto& var : buffers)
+					total += var.size();
+				if (total == 0)
+					return -2;
+
+				if (!codec_.Accept(total))
+					return -2;
+
+				if (codec_.HeadLen(0) > 0 || codec_.TailLen() > 0) {
+					//split into frames of MaxBodyLen, and interleave the headers/tails with the caller's buffers.
+					uint8_t err_code{ NO_ERR };
+					const size_t max_body = codec_.MaxBodyLen();
+					const size_t frames = (total + max_body - 1) / max_body;
+					const size_t meta_len = frames * (Codec::e_MaxHeadLen + Codec::e_MaxTailLen);
+					if (meta_len > MaxPacketSize)
+						return -2;
+					char* meta = memStorage_.Alloc(meta_len);
+					if (meta == nullptr) {
+						stats_.OnAllocFail();
+						return -2;
+					}
+					item.packet = Packet(Buffer(meta, meta_len));
+					char* head = item.packet.data();
+					auto it = buffers.begin();
+					size_t offset{ 0 };
+					while (total > 0) {
+						size_t frame_len = total > max_body ? max_body : total;
+						const int head_len = codec_.EncodeHead(head, frame_len, err_code);
+						if (head_len > 0)
+							item.views.emplace_back(asio::buffer(head, head_len));
+						head += head_len;
+						total -= frame_len;
+						while (frame_len > 0) {
+							const size_t n = std::min(it->size() - offset, frame_len);
+							if (n > 0)
+								item.views.emplace_back(asio::buffer(static_cast<const char*>(it->data()) + offset, n));
+							offset += n;
+							frame_len -= n;
+							if (offset == it->size()) {
+								++it;
+								offset = 0;
+							}
+						}
+						const int tail_len = codec_.EncodeTail(head);
+						if (tail_len > 0)
+							item.views.emplace_back(asio::buffer(head, tail_len));
+						head += tail_len;
+					}
+				}
+				else {
+					for (auto& var : buffers) {
+						if (var.size() > 0)
+							item.views.emplace_back(var);
 					}
-					return 0;
 				}
+
+				return PushSendItem(item, func);
+			}
+			//queue a buffer shared with other sessions, only a reference of it is taken. it must be encoded by
+			//the codec of the session, else -2. the other returns are those of AsyncSend.
+			int AsyncSendShared(const SharedBuffer& buffer, std::function<void(size_t, uint8_t)> func = nullptr) {
+				if (!State_)
+					return -1;
+				if (!buffer.Fits(codec_)) {
+					if (func)
+						func(-2, NET_BAD_BODY);
+					return -2;
+				}
+				SendItem item;
+				item.shared = buffer;
+				return PushSendItem(item, func);
 			}
 			int AsyncRecieve(CBAsyncRead cb) {
 				if (!State_)
 					return -1;
-				rwHandler_->HandleAsyncRead(cb);
+				Touch(); //a read is started again after each packet
+				//the session may be closed and dropped by another thread(reactor) meanwhile. the read doesn't hold
+				//it, a handler keeps the callback of its read(RWHandlerTcpSB) and the session keeps the handler.
+				std::weak_ptr<SessionBase> wk_self = this->shared_from_this();
+				rwHandler_->HandleAsyncRead([wk_self, cb](Packet* packet, uint8_t ec) {
+					auto self = wk_self.lock();
+					if (!self)
+						return;
+					if (packet)
+						self->stats_.OnRecv(packet->length());
+					cb(packet, ec);
+					});
 				return 0;
 			}
 			template<typename F>
 			void SetCallBackError(F f) { cbErr_ = f; }
 			SocketType& GetSocket() { return socket_; }
+			void SetSendBatch(size_t max_bytes, size_t max_bufs) {
+				maxBatchBytes_ = max_bytes;
+				maxBatchBufs_ = max_bufs > 0 ? max_bufs : 1;
+			}
+			//the slots of the send queue(rounded up to a power of 2), only before anything is sent.
+			void SetSendQueueSize(size_t size) { sendQueue_.Reset(size); }
+			//the items waiting in the send queue(approximate).
+			size_t GetSendQueueLen() const { return sendQueue_.Size(); }
+			//the bytes queued or being written.
+			size_t GetSendQueueBytes() const { return queuedBytes_; }
+			//any thread, while the producers and the writer read the marks.
+			void SetSendWatermark(const SendWatermark& watermark) { watermark_.Store(watermark); }
+			SendWatermark GetSendWatermark() const { return watermark_.Load(); }
+			bool IsSendPaused() const { return bPaused_; }
+			template<typename F>
+			void SetCallBackSendState(F f) { cbSendState_ = f; }
+			//shut the connection down when nothing has been sent or received for seconds(0: never).
+			void SetIdleTimeout(unsigned seconds) {
+				idleTicks_ = wheel_.ToTicks(std::chrono::seconds(seconds));
+				if (seconds > 0) {
+					Touch();
+					wheel_.Arm(idleTimer_, std::chrono::seconds(seconds));
+				}
+				else
+					wheel_.Cancel(idleTimer_);
+			}
 
 		protected:
 			void Release() {
-				{
-					std::lock_guard<std::mutex> lock(this->mtx_);
-					if (!sendQueue_.empty()) {
-						for (auto& var : sendQueue_) {
-							if (var.data())
-								memStorage_.Free(var.data());
-						}
-						sendQueue_.clear();
+				ClearSendQueue();
+				for (auto& var : sendBatch_)
+					FreeQueuedItem(var);
+				sendBatch_.clear();
+				sendBufs_.clear();
+			}
+			//it consumes the queue, so only the active writer(or the owner when no writer can start any more) calls it.
+			void ClearSendQueue() {
+				SendItem item;
+				while (sendQueue_.Pop(item))
+					FreeQueuedItem(item);
+				CheckResume();
+			}
+			//queue an encoded item and start the writer if none is active, the item is freed if it is refused.
+			int PushSendItem(SendItem& item, const std::function<void(size_t, uint8_t)>& func) {
+				const size_t len = item.length();
+				int nret{ 0 };
+				if (OverHardLimit(len, 1) && Policy() != E_SEND_LIMIT_T::e_DropOldest)
+					nret = -4;
+				else {
+					queuedBytes_ += len;
+					queuedPackets_++;
+					if (!sendQueue_.Push(std::move(item))) {
+						queuedBytes_ -= len;
+						queuedPackets_--;
+						nret = -3;
 					}
 				}
+				if (nret < 0) {
+					stats_.OnError(nret == -3 ? E_STAT_ERR_T::e_SendFull : E_STAT_ERR_T::e_SendLimit);
+					item.release = nullptr; //a refused view is still the caller's
+					FreeSendItem(item);
+					if (nret == -4 && Policy() == E_SEND_LIMIT_T::e_Disconnect) {
+						StreamWriter::Instance()->Write(std::cout, "[Session] Send queue over the hard limit, disconnect! session_id=%lld", (long long)id_);
+						//the socket is only touched on its io_context, where the reads and writes are in flight
+						auto self = this->shared_from_this();
+						asio::post(socket_.lowest_layer().get_executor(), [self] {
+							asio::error_code ec;
+							self->socket_.lowest_layer().shutdown(tcp::socket::shutdown_both, ec);
+							});
+					}
+					if (func)
+						func(nret, NET_OTHER);
+					return nret;
+				}
+
+				stats_.OnQueued(queuedBytes_, queuedPackets_);
+				if (OverHighWatermark()) {
+					nret = 1;
+					CheckPause();
+				}
+				if (!bAsyncW_.exchange(true))
+					DoAsyncSend(func);//todo
+				return nret;
+			}
+			//whether adding len bytes in packets items takes the queue over the hard limit.
+			bool OverHardLimit(size_t len, size_t packets) const {
+				const size_t hard_bytes = watermark_.hardBytes.load(std::memory_order_relaxed);
+				const size_t hard_packets = watermark_.hardPackets.load(std::memory_order_relaxed);
+				return (hard_bytes > 0 && queuedBytes_ + len > hard_bytes) || (hard_packets > 0 && queuedPackets_ + packets > hard_packets);
+			}
+			bool OverHighWatermark() const {
+				const size_t high_bytes = watermark_.highBytes.load(std::memory_order_relaxed);
+				const size_t high_packets = watermark_.highPackets.load(std::memory_order_relaxed);
+				return (high_bytes > 0 && queuedBytes_ > high_bytes) || (high_packets > 0 && queuedPackets_ > high_packets);
+			}
+			//a mark whose high one is off doesn't hold the session paused.
+			bool UnderLowWatermark() const {
+				return (watermark_.highBytes.load(std::memory_order_relaxed) == 0 || \
+					queuedBytes_ <= watermark_.lowBytes.load(std::memory_order_relaxed)) && \
+					(watermark_.highPackets.load(std::memory_order_relaxed) == 0 || \
+					queuedPackets_ <= watermark_.lowPackets.load(std::memory_order_relaxed));
+			}
+			E_SEND_LIMIT_T Policy() const { return watermark_.policy.load(std::memory_order_relaxed); }
+			//the state changes and their callbacks are serialized by stateMtx_, so the callbacks come in order. a writer
+			//which drained the queue before the pause was set missed it, the pause looks at the queue again after
+			//setting it and resumes at once(bPaused_ and the counts are seq_cst, one side sees the other).
+			void CheckPause() {
+				std::lock_guard<std::recursive_mutex> lock(stateMtx_);
+				if (bPaused_ || !OverHighWatermark())
+					return;
+				bPaused_ = true;
+				if (cbSendState_)
+					cbSendState_(id_, true);
+				if (UnderLowWatermark()) {
+					bPaused_ = false;
+					if (cbSendState_)
+						cbSendState_(id_, false);
+				}
+			}
+			void CheckResume() {
+				if (!bPaused_)
+					return;
+				std::lock_guard<std::recursive_mutex> lock(stateMtx_);
+				if (bPaused_ && UnderLowWatermark()) {
+					bPaused_ = false;
+					if (cbSendState_)
+						cbSendState_(id_, false);
+				}
+			}
+			//free an item which has been counted in the watermarks.
+			void FreeQueuedItem(SendItem& item) {
+				queuedBytes_ -= item.length();
+				queuedPackets_--;
+				FreeSendItem(item);
+			}
+			//append the frame of src to dst as gathered buffers, the pooled packet of src becomes one of dst's blocks.
+			void MergeItem(SendItem& dst, SendItem& src) {
+				if (src.views.empty())
+					dst.views.emplace_back(asio::buffer(src.packet.data(), src.packet.length()));
+				else
+					dst.views.insert(dst.views.end(), src.views.begin(), src.views.end());
+				dst.blocks.emplace_back(src.packet.data());
+				dst.blocks.insert(dst.blocks.end(), src.blocks.begin(), src.blocks.end());
+				src.packet.reset();
+				src.views.clear();
+				src.blocks.clear();
+			}
+			//encode a frame of len bytes into a pooled packet, or into pooled blocks for gathering if it is too big.
+			int EncodeItem(SendItem& item, const char* data, size_t len, uint8_t& err_code) {
+				const size_t frame_len = codec_.HeadLen(len) + len + codec_.TailLen();
+				if (frame_len <= MaxPacketSize) {
+					char* buff = memStorage_.Alloc(frame_len);
+					if (buff == nullptr)
+						return AllocFailed(err_code);
+					item.packet = Packet(Buffer(buff, frame_len));
+					return item.packet.encodeData(codec_, data, len, err_code);
+				}
+
+				const size_t meta_len = Codec::e_MaxHeadLen + Codec::e_MaxTailLen;
+				char* meta = memStorage_.Alloc(meta_len);
+				if (meta == nullptr)
+					return AllocFailed(err_code);
+				item.packet = Packet(Buffer(meta, meta_len));
+				char* head = item.packet.data();
+				const int head_len = codec_.EncodeHead(head, len, err_code);
+				if (head_len < 0)
+					return -1;
+				if (head_len > 0)
+					item.views.emplace_back(asio::buffer(head, head_len));
+				while (len > 0) {
+					const size_t n = len > MaxPacketSize ? MaxPacketSize : len;
+					char* block = memStorage_.Alloc(n);
+					if (block == nullptr)
+						return AllocFailed(err_code);
+					memcpy(block, data, n);
+					item.blocks.emplace_back(block);
+					item.views.emplace_back(asio::buffer(block, n));
+					data += n;
+					len -= n;
+				}
+				const int tail_len = codec_.EncodeTail(head + head_len);
+				if (tail_len > 0)
+					item.views.emplace_back(asio::buffer(head + head_len, tail_len));
+				return 0;
+			}
+			int AllocFailed(uint8_t& err_code) {
+				stats_.OnAllocFail();
+				err_code = NET_OTHER;
+				return -1;
+			}
+			void FreeSendItem(SendItem& item) {
+				if (item.packet.data()) {
+					memStorage_.Free(item.packet.data());
+					item.packet.reset();
+				}
+				for (auto& var : item.blocks)
+					memStorage_.Free(var);
+				item.blocks.clear();
+				item.shared.reset();
+				if (item.release) {
+					item.release();
+					item.release = nullptr;
+				}
 			}
 			virtual RWHandlerTcp<SocketType>* CreateRWHandler() = 0;
 			virtual void CloseSocket() = 0;
+			//drain the queued packets(up to maxBatchBufs_ packets or maxBatchBytes_ bytes) into one gather write.
+			//only the writer which has set bAsyncW_ gets here, it is the single consumer of sendQueue_.
 			void DoAsyncSend(std::function<void(size_t, uint8_t)> func) {
-				Packet packet;
-				bool b_get{ false };
-				{
-					std::lock_guard<std::mutex> lock(mtx_);
-					if (!sendQueue_.empty()) {
-						packet = sendQueue_.front();
-						b_get = true;
+				while (true) {
+					if (Policy() == E_SEND_LIMIT_T::e_DropOldest && OverHardLimit(0, 0)) {
+						SendItem dropped;
+						size_t n{ 0 };
+						while (OverHardLimit(0, 0) && sendQueue_.Pop(dropped)) {
+							FreeQueuedItem(dropped);
+							n++;
+						}
+						stats_.OnError(E_STAT_ERR_T::e_SendLimit, n);
+						StreamWriter::Instance()->Write(std::cout, "[Session] Send queue over the hard limit, %zu dropped! session_id=%lld", n, (long long)id_);
+						CheckResume();
+					}
+					size_t batch_bytes{ 0 };
+					SendItem* item{ nullptr };
+					while ((item = sendQueue_.Front()) != nullptr) {
+						const size_t item_bufs = item->views.empty() ? 1 : item->views.size();
+						if (!sendBatch_.empty() && (batch_bytes + item->length() > maxBatchBytes_ || \
+							sendBufs_.size() + item_bufs > maxBatchBufs_))
+							break;
+						batch_bytes += item->length();
+						if (item->shared)
+							sendBufs_.emplace_back(asio::buffer(item->shared.data(), item->shared.length()));
+						else if (item->views.empty())
+							sendBufs_.emplace_back(asio::buffer(item->packet.data(), item->packet.length()));
+						else
+							sendBufs_.insert(sendBufs_.end(), item->views.begin(), item->views.end());
+						sendBatch_.emplace_back();
+						sendQueue_.Pop(sendBatch_.back());
+					}
+					if (!sendBatch_.empty())
+						break;
+					//give the writer up. a producer which pushed after the queue was found empty either sees
+					//bAsyncW_ false and starts a writer itself, or its item is seen here and this writer goes on.
+					bAsyncW_.exchange(false);
+					if (sendQueue_.Empty() || bAsyncW_.exchange(true)) {
+						CheckResume();
+						return;
 					}
 				}
-				if (b_get) {
-					auto self = this->shared_from_this();
-					rwHandler_->HandleAsyncWrite(packet, [self, func](std::size_t size, uint8_t ec) {
-						Packet packet;
-						{
-							std::lock_guard<std::mutex> lock(self->mtx_);
-							if (!self->sendQueue_.empty()) {
-								packet = self->sendQueue_.front();
-								self->sendQueue_.pop_front();
-							}
-						}
-						if (packet.data()) {
-							self->memStorage_.Free(packet.data());
-						}
-						if (func)
-							func(size, ec);
+				auto self = this->shared_from_this();
+				ConstBuffers buffers{ sendBufs_.data(), sendBufs_.data() + sendBufs_.size() };
+				rwHandler_->HandleAsyncGather(buffers, [self, func](std::size_t size, uint8_t ec) {
+					if (!ec) {
+						self->Touch();
+						self->stats_.OnSend(size, self->sendBatch_.size());
+					}
+					for (auto& var : self->sendBatch_) {
+						const size_t len = var.length();
+						self->FreeQueuedItem(var);
+						if (func && !ec)
+							func(len, ec);
+					}
+					self->sendBatch_.clear();
+					self->sendBufs_.clear();
+					self->CheckResume();
+					if (!ec)
 						self->DoAsyncSend(func);
-						});
-				}
-				else
-					bAsyncW_ = false;
+					});
 			}
 
-			virtual void OnTimer() = 0;
+			//the io timeout cancels the blocked socket operation, the idle one shuts the connection down.
+			//an idle stamp is the wheel tick of the last traffic, the idle timer re-arms itself until it is stale.
+			void InitTimer() {
+				ioTimer_.SetCallBack([this] {
+					stats_.OnTimeout();
+					asio::error_code ec;
+					socket_.lowest_layer().cancel(ec);
+					});
+				idleTimer_.SetCallBack([this] {
+					const uint64_t idle = wheel_.Now() - lastActive_.load(std::memory_order_relaxed);
+					if (idle < idleTicks_) {
+						wheel_.Arm(idleTimer_, wheel_.Tick() * (idleTicks_ - idle));
+						return;
+					}
+					stats_.OnTimeout();
+					StreamWriter::Instance()->Write(std::cout, "[Session] Idle timeout, disconnect! session_id=%lld", (long long)id_);
+					asio::error_code ec;
+					socket_.lowest_layer().shutdown(tcp::socket::shutdown_both, ec);
+					});
+			}
+			void Touch() {
+				if (idleTicks_ > 0)
+					lastActive_.store(wheel_.Now(), std::memory_order_relaxed);
+			}
+			void OnTimer() {
+				if (timeout_ > 0)
+					wheel_.Arm(ioTimer_, std::chrono::seconds(timeout_));
+			}
 			void OffTimer() {
 				if (timeout_ > 0)
-					timer_.cancel();
+					wheel_.Cancel(ioTimer_);
 			}
 
 		protected:
-			int id_{ -1 };
+			SessionId id_{ -1 };
 			tcp::endpoint endpointLocal_;
 			tcp::endpoint endpointPeer_;
 			NMemoryStorage<char>& memStorage_;
@@ -239,12 +679,27 @@ namespace Net {
 			std::shared_ptr<RWHandlerTcp<SocketType>> rwHandler_{ nullptr };
 			int State_{ 0 };  //0: unconnected, 1: connected, ...
 			bool keeplive_{ false };
-			steady_timer timer_;
+			TimingWheel& wheel_;
+			TimerNode ioTimer_;		//the timeout of a sync Send/Recieve
+			TimerNode idleTimer_;
+			std::atomic<uint64_t> lastActive_{ 0 };	//in wheel ticks
+			uint64_t idleTicks_{ 0 };
 			unsigned timeout_{ 0 };
 			CBErrTcp cbErr_{ nullptr }; //params:session id, error_code
-			std::mutex mtx_;
-			std::atomic_bool bAsyncW_{ false };
-			std::list<Packet> sendQueue_;
+			std::atomic_bool bAsyncW_{ false };	//set by the writer, which is the only consumer of sendQueue_
+			MpscQueue<SendItem> sendQueue_{ SendQueueSize };
+			std::atomic<size_t> queuedBytes_{ 0 };		//queued or being written, for the watermarks
+			std::atomic<size_t> queuedPackets_{ 0 };
+			std::atomic_bool bPaused_{ false };
+			std::recursive_mutex stateMtx_;		//the pause and resume, a state callback may send again
+			SendWatermarkAtomic watermark_;
+			CBSendState cbSendState_{ nullptr };
+			std::vector<SendItem> sendBatch_;	//items in flight, only touched by the active writer.
+			std::vector<asio::const_buffer> sendBufs_;
+			size_t maxBatchBytes_{ MaxSendBatchBytes };
+			size_t maxBatchBufs_{ MaxSendBatchBufs };
+			Codec codec_;
+			SessionCounters stats_;
 		};
 	}
 }
\ No newline at end of file
@@ -16,8 +16,9 @@ namespace Net {
 
 			class SessionTcpSSL : public SessionBase<SOCKET_TYPE> {
 			public:
-				explicit SessionTcpSSL(int sess_id, io_context& io_c, Socket_TCP&& socket, ssl::context& ssl_c, NMemoryStorage<char>& mem_storage, unsigned timeout, bool keeplive = false) :
-					SessionBase(sess_id, io_c, std::move(socket), ssl_c, mem_storage, timeout, keeplive)
+				explicit SessionTcpSSL(SessionId sess_id, io_context& io_c, Socket_TCP&& socket, ssl::context& ssl_c, NMemoryStorage<char>& mem_storage, unsigned timeout, bool keeplive = false, \
+					const Codec& codec = Codec::Default()) :
+					SessionBase(sess_id, io_c, std::move(socket), ssl_c, mem_storage, timeout, keeplive, codec)
 				{
 					Init();
 				}
@@ -37,12 +38,14 @@ namespace Net {
 					rwHandler_ = std::shared_ptr<RWHandlerTcp<SOCKET_TYPE>>(CreateRWHandler());
 				}
 				virtual RWHandlerTcp<SOCKET_TYPE>* CreateRWHandler() override {
-#ifdef PACKET_STICK
-					RWHandler_Tcp<SOCKET_TYPE>* handler = new RWHandlerTcpS<SOCKET_TYPE>(ioCtx_, socket_, memStorage_);
-#else
-					RWHandlerTcp<SOCKET_TYPE>* handler = new RWHandlerTcpNS<SOCKET_TYPE>(ioCtx_, socket_, memStorage_);
-#endif //PACKET_STICK
+					RWHandlerTcp<SOCKET_TYPE>* handler{ nullptr };
+					if (codec_.IsFramed())
+						handler = new RWHandlerTcpSB<SOCKET_TYPE>(ioCtx_, socket_, memStorage_, codec_);
+					else
+						handler = new RWHandlerTcpNS<SOCKET_TYPE>(ioCtx_, socket_, memStorage_, codec_);
+					handler->SetStats(&stats_);
 					handler->SetCallBackError([this](E_ERR_T err_t, uint8_t ec) {
+						stats_.OnError(ec);
 						switch (ec) {
 						case NET_EOF:
 							StreamWriter::Instance()->Write(std::cout, "[Session] Net err, eof!");
@@ -66,13 +69,7 @@ namespace Net {
 							asio::error_code ec;
 							socket_.lowest_layer().shutdown(tcp::socket::shutdown_send, ec);
 
-							std::lock_guard<std::mutex> lock(this->mtx_);
-							for (auto& var : sendQueue_) {
-								if (var.data()) {
-									memStorage_.Free(var.data());
-								}
-							}
-							sendQueue_.clear();
+							ClearSendQueue();
 						}
 						else if (err_t == E_ERR_T::e_Err_R) {
 							asio::error_code ec;
@@ -90,18 +87,6 @@ namespace Net {
 					socket_.lowest_layer().shutdown(tcp::socket::shutdown_both, ec);
 					socket_.lowest_layer().close();
 				}
-				virtual void OnTimer() override {
-					if (timeout_ > 0) {
-						auto self = this->shared_from_this();
-						timer_.expires_after(std::chrono::seconds(timeout_));
-						timer_.async_wait(
-							[this, self](const std::error_code& ec)
-							{
-								if (ec != asio::error::operation_aborted)
-									this->socket_.lowest_layer().cancel();
-							});
-					}
-				}
 			};
 		}
 	}
@@ -0,0 +1,162 @@
+#pragma once
+//========================================================================
+//[File Name]:SessionStats.h
+//[Description]: the traffic counters of a session: bytes on the wire and
+//  packets(the frames read, the sends written) in and out, the high-water
+//  marks of the send queue, the
+//  allocation failures, the timeouts and the errors by type. the counters
+//  written by the reader, by the writer and by the producers are on cache
+//  lines of their own, they are relaxed atomics, and a snapshot reads
+//  them without stopping the io.
+//[Author]:Nico Hu
+//[Date]:2020-08-10
+//[Other]:Copyright (c) 2020-2050 Nico Hu
+//========================================================================
+#include <atomic>
+#include <cstdint>
+
+#include "../Comm.h"
+
+namespace Net {
+	namespace Core {
+		enum class E_STAT_ERR_T {
+			e_Eof = 0,		//the peer closed
+			e_Net,			//other socket errors
+			e_BadHead,		//the frames which can't be decoded
+			e_BadBody,
+			e_SendFull,		//the sends refused as the send queue was full
+			e_SendLimit,	//the sends refused or dropped over the hard limit of the send queue
+			e_Count
+		};
+
+		//a snapshot of the counters of a session, or of the sessions of a server summed up.
+		struct SessionStats {
+			uint64_t bytesIn{ 0 };
+			uint64_t packetsIn{ 0 };
+			uint64_t bytesOut{ 0 };
+			uint64_t packetsOut{ 0 };
+			uint64_t queueHighBytes{ 0 };		//the most bytes in the send queue
+			uint64_t queueHighPackets{ 0 };		//the most items in the send queue
+			uint64_t allocFails{ 0 };
+			uint64_t timeouts{ 0 };				//the io and the idle ones
+			uint64_t errors[static_cast<size_t>(E_STAT_ERR_T::e_Count)]{ 0 };
+
+			uint64_t Errors(E_STAT_ERR_T type) const { return errors[static_cast<size_t>(type)]; }
+			uint64_t Errors() const {
+				uint64_t sum{ 0 };
+				for (auto var : errors)
+					sum += var;
+				return sum;
+			}
+			//the counts add up, the high-water marks take the max.
+			SessionStats& operator+=(const SessionStats& other) {
+				bytesIn += other.bytesIn;
+				packetsIn += other.packetsIn;
+				bytesOut += other.bytesOut;
+				packetsOut += other.packetsOut;
+				queueHighBytes = queueHighBytes > other.queueHighBytes ? queueHighBytes : other.queueHighBytes;
+				queueHighPackets = queueHighPackets > other.queueHighPackets ? queueHighPackets : other.queueHighPackets;
+				allocFails += other.allocFails;
+				timeouts += other.timeouts;
+				for (size_t i = 0; i < static_cast<size_t>(E_STAT_ERR_T::e_Count); i++)
+					errors[i] += other.errors[i];
+				return *this;
+			}
+		};
+
+		class SessionCounters {
+		public:
+			void OnRecv(size_t bytes) {
+				in_.bytes.fetch_add(bytes, std::memory_order_relaxed);
+				in_.packets.fetch_add(1, std::memory_order_relaxed);
+			}
+			void OnSend(size_t bytes, size_t packets) {
+				out_.bytes.fetch_add(bytes, std::memory_order_relaxed);
+				out_.packets.fetch_add(packets, std::memory_order_relaxed);
+			}
+			//the depth of the send queue after a push.
+			void OnQueued(size_t bytes, size_t packets) {
+				UpdateMax(queue_.highBytes, bytes);
+				UpdateMax(queue_.highPackets, packets);
+			}
+			void OnAllocFail() { err_.allocFails.fetch_add(1, std::memory_order_relaxed); }
+			void OnTimeout() { err_.timeouts.fetch_add(1, std::memory_order_relaxed); }
+			void OnError(E_STAT_ERR_T type, uint64_t n = 1) {
+				err_.errors[static_cast<size_t>(type)].fetch_add(n, std::memory_order_relaxed);
+			}
+			//an error code of the rw handlers.
+			void OnError(uint8_t ec) {
+				switch (ec) {
+				case NO_ERR:
+					break;
+				case NET_EOF:
+					OnError(E_STAT_ERR_T::e_Eof);
+					break;
+				case NET_BAD_HEAD:
+					OnError(E_STAT_ERR_T::e_BadHead);
+					break;
+				case NET_BAD_DATA:
+				case NET_BAD_BODY:
+					OnError(E_STAT_ERR_T::e_BadBody);
+					break;
+				default:
+					OnError(E_STAT_ERR_T::e_Net);
+					break;
+				}
+			}
+			//fold the counters of a closed session in.
+			void Add(const SessionStats& stats) {
+				in_.bytes.fetch_add(stats.bytesIn, std::memory_order_relaxed);
+				in_.packets.fetch_add(stats.packetsIn, std::memory_order_relaxed);
+				OnSend(stats.bytesOut, stats.packetsOut);
+				OnQueued(stats.queueHighBytes, stats.queueHighPackets);
+				err_.allocFails.fetch_add(stats.allocFails, std::memory_order_relaxed);
+				err_.timeouts.fetch_add(stats.timeouts, std::memory_order_relaxed);
+				for (size_t i = 0; i < static_cast<size_t>(E_STAT_ERR_T::e_Count); i++)
+					err_.errors[i].fetch_add(stats.errors[i], std::memory_order_relaxed);
+			}
+			//each counter is read once, they are not taken at one instant.
+			SessionStats Snapshot() const {
+				SessionStats stats;
+				stats.bytesIn = in_.bytes.load(std::memory_order_relaxed);
+				stats.packetsIn = in_.packets.load(std::memory_order_relaxed);
+				stats.bytesOut = out_.bytes.load(std::memory_order_relaxed);
+				stats.packetsOut = out_.packets.load(std::memory_order_relaxed);
+				stats.queueHighBytes = queue_.highBytes.load(std::memory_order_relaxed);
+				stats.queueHighPackets = queue_.highPackets.load(std::memory_order_relaxed);
+				stats.allocFails = err_.allocFails.load(std::memory_order_relaxed);
+				stats.timeouts = err_.timeouts.load(std::memory_order_relaxed);
+				for (size_t i = 0; i < static_cast<size_t>(E_STAT_ERR_T::e_Count); i++)
+					stats.errors[i] = err_.errors[i].load(std::memory_order_relaxed);
+				return stats;
+			}
+
+		protected:
+			//a mark only grows, the store is skipped when it is not exceeded.
+			static void UpdateMax(std::atomic<uint64_t>& mark, uint64_t value) {
+				uint64_t cur = mark.load(std::memory_order_relaxed);
+				while (value > cur && !mark.compare_exchange_weak(cur, value, std::memory_order_relaxed))
+					;
+			}
+
+		protected:
+			struct alignas(64) In {		//the reader
+				std::atomic<uint64_t> bytes{ 0 };
+				std::atomic<uint64_t> packets{ 0 };
+			} in_;
+			struct alignas(64) Out {	//the writer
+				std::atomic<uint64_t> bytes{ 0 };
+				std::atomic<uint64_t> packets{ 0 };
+			} out_;
+			struct alignas(64) Queue {	//the producers
+				std::atomic<uint64_t> highBytes{ 0 };
+				std::atomic<uint64_t> highPackets{ 0 };
+			} queue_;
+			struct alignas(64) Err {	//rare
+				std::atomic<uint64_t> allocFails{ 0 };
+				std::atomic<uint64_t> timeouts{ 0 };
+				std::atomic<uint64_t> errors[static_cast<size_t>(E_STAT_ERR_T::e_Count)]{};
+			} err_;
+		};
+	}
+}
@@ -0,0 +1,113 @@
+#pragma once
+//========================================================================
+//[File Name]:SharedBuffer.h
+//[Description]: a payload encoded once and written to many sessions. its
+//  frames(headers, bodies and tails) are one block of a storage, after a
+//  small head with the reference count. the handles share the block, it
+//  goes back to the storage when the last one is gone, which is when the
+//  last write of it is done or dropped. the bytes don't change once it
+//  is made, so the sessions write them at the same time.
+//[Author]:Nico Hu
+//[Date]:2020-08-10
+//[Other]:Copyright (c) 2020-2050 Nico Hu
+//========================================================================
+#include <atomic>
+#include <cstring>
+#include <new>
+#include <utility>
+
+#include "../Comm.h"
+#include "Codec.h"
+#include "NMemoryStorage.h"
+
+namespace Net {
+	namespace Core {
+		class SharedBuffer {
+		public:
+			SharedBuffer() = default;
+			SharedBuffer(const SharedBuffer& ref) noexcept : head_(ref.head_) {
+				if (head_)
+					head_->refs.fetch_add(1, std::memory_order_relaxed);
+			}
+			SharedBuffer(SharedBuffer&& ref) noexcept : head_(ref.head_) { ref.head_ = nullptr; }
+			SharedBuffer& operator=(const SharedBuffer& ref) noexcept {
+				SharedBuffer(ref).swap(*this);
+				return *this;
+			}
+			SharedBuffer& operator=(SharedBuffer&& ref) noexcept {
+				SharedBuffer(std::move(ref)).swap(*this);
+				return *this;
+			}
+			~SharedBuffer() { reset(); }
+
+			//the frames of len bytes of data by codec in a block of storage, which must outlive the buffer.
+			//an empty buffer if the codec refuses the length(err_code NET_BAD_BODY) or there is no memory(NET_OTHER).
+			static SharedBuffer Make(NMemoryStorage<char>& storage, const Codec& codec, const char* data, unsigned len, uint8_t& err_code) {
+				if (len == 0 || !codec.Accept(len)) {
+					err_code = NET_BAD_BODY;
+					return SharedBuffer();
+				}
+				const size_t max_body = codec.MaxBodyLen();
+				const size_t frames = (len + max_body - 1) / max_body;
+				size_t frame_len = len + frames * codec.TailLen();
+				for (size_t left = len; left > 0; left -= (left > max_body ? max_body : left))
+					frame_len += codec.HeadLen(left > max_body ? max_body : left);
+				char* block = storage.Alloc(sizeof(Head_t) + frame_len);
+				if (block == nullptr) {
+					err_code = NET_OTHER;
+					return SharedBuffer();
+				}
+				SharedBuffer buffer;
+				buffer.head_ = new (block) Head_t(storage, codec, len, frame_len);
+				char* dst = block + sizeof(Head_t);
+				while (len > 0) {
+					const size_t body_len = len > max_body ? max_body : len;
+					const int head_len = codec.EncodeHead(dst, body_len, err_code);
+					if (head_len < 0)
+						return SharedBuffer();
+					dst += head_len;
+					memcpy(dst, data, body_len);
+					dst += body_len;
+					dst += codec.EncodeTail(dst);
+					data += body_len;
+					len -= static_cast<unsigned>(body_len);
+				}
+				return buffer;
+			}
+
+			explicit operator bool() const { return head_ != nullptr; }
+			//the encoded frames.
+			const char* data() const { return head_ ? reinterpret_cast<const char*>(head_ + 1) : nullptr; }
+			size_t length() const { return head_ ? head_->len : 0; }
+			//the payload.
+			unsigned bodyLen() const { return head_ ? head_->bodyLen : 0; }
+			//whether the frames are those of codec, a session of another codec can't write them.
+			bool Fits(const Codec& codec) const { return head_ && head_->codec == codec; }
+			//the handles of the block(approximate while other threads copy or drop theirs).
+			uint32_t refs() const { return head_ ? head_->refs.load(std::memory_order_relaxed) : 0; }
+			void reset() {
+				if (head_ && head_->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+					NMemoryStorage<char>& storage = head_->storage;
+					head_->~Head_t();
+					storage.Free(reinterpret_cast<char*>(head_));
+				}
+				head_ = nullptr;
+			}
+			void swap(SharedBuffer& ref) noexcept { std::swap(head_, ref.head_); }
+
+		protected:
+			struct Head_t {
+				Head_t(NMemoryStorage<char>& storage_ref, const Codec& codec_ref, unsigned body_len, size_t frame_len) :
+					storage(storage_ref), codec(codec_ref), bodyLen(body_len), len(frame_len) { }
+				std::atomic<uint32_t> refs{ 1 };
+				NMemoryStorage<char>& storage;
+				Codec codec;
+				unsigned bodyLen{ 0 };
+				size_t len{ 0 };
+			};
+
+		protected:
+			Head_t* head_{ nullptr };
+		};
+	}
+}
@@ -0,0 +1,209 @@
+#pragma once
+//========================================================================
+//[File Name]:TimingWheel.h
+//[Description]: a hierarchical timing wheel shared by everything on an
+//  io_context(the sessions' io/idle timeouts, the reconnect checks, the
+//  http connection strategies). a timer is an intrusive node owned by its
+//  user, arming/re-arming/cancelling it is O(1) under one lock, and one
+//  steady_timer ticks the wheel while any node is armed.
+//  levels: 256 slots of 1 tick, then 3 levels of 64 slots, which cover
+//  2^26 ticks(about 77 days of 100ms ticks), longer timeouts are clamped.
+//[Author]:Nico Hu
+//[Date]:2020-08-10
+//[Other]:Copyright (c) 2020-2050 Nico Hu
+//========================================================================
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <mutex>
+
+#include "../asio/asio.hpp"
+#include "../Comm.h"
+
+namespace Net {
+	namespace Core {
+		class TimingWheel;
+
+		//a timer of the wheel, the owner keeps it alive while it is armed and cancels it before it dies.
+		class TimerNode {
+			friend class TimingWheel;
+		public:
+			TimerNode() = default;
+			explicit TimerNode(std::function<void()> cb) : cb_(std::move(cb)) { }
+			TimerNode(const TimerNode&) = delete;
+			TimerNode& operator=(const TimerNode&) = delete;
+
+			//set before the node is armed. it is called on an io thread with the wheel locked, so it may arm or
+			//cancel nodes, but it must not wait for a lock which is held around Arm/Cancel, post such work instead.
+			void SetCallBack(std::function<void()> cb) { cb_ = std::move(cb); }
+			bool IsArmed() const { return slot_ != nullptr; }
+
+		private:
+			TimerNode* prev_{ nullptr };
+			TimerNode* next_{ nullptr };
+			TimerNode** slot_{ nullptr };	//the head of the slot list it is linked in, null if it is not armed
+			uint64_t expire_{ 0 };		//in ticks
+			std::function<void()> cb_{ nullptr };
+		};
+
+		class TimingWheel : public asio::io_context::service {
+			enum { e_RootBits = 8, e_LevelBits = 6, e_Levels = 3 };
+			enum { e_RootSize = 1 << e_RootBits, e_LevelSize = 1 << e_LevelBits };
+			enum { e_RootMask = e_RootSize - 1, e_LevelMask = e_LevelSize - 1 };
+			static constexpr uint64_t e_MaxTicks = (uint64_t(1) << (e_RootBits + e_LevelBits * e_Levels)) - 1;
+
+		public:
+			inline static asio::io_context::id id;
+
+			explicit TimingWheel(asio::io_context& io_c) : asio::io_context::service(io_c), \
+				timer_(new asio::steady_timer(io_c)), tick_(std::chrono::milliseconds(TimerTick)) { }
+			~TimingWheel() = default;
+
+			//the wheel of an io_context.
+			static TimingWheel& Of(asio::io_context& io_c) { return asio::use_service<TimingWheel>(io_c); }
+
+			//arm node to fire after timeout(rounded up to ticks), re-arming an armed node moves it. thread safe.
+			void Arm(TimerNode& node, std::chrono::milliseconds timeout) {
+				uint64_t ticks = (timeout.count() + tick_.count() - 1) / tick_.count();
+				if (ticks == 0)
+					ticks = 1;
+				if (ticks > e_MaxTicks)
+					ticks = e_MaxTicks;
+				std::lock_guard<std::recursive_mutex> lock(mtx_);
+				if (node.slot_)
+					Unlink(node);
+				else
+					armed_++;
+				node.expire_ = now_ + ticks;
+				Link(node);
+				if (!bTicking_)
+					StartTick();
+			}
+			//a cancelled node doesn't fire, nor is its callback running when this returns(unless called from it). thread safe.
+			void Cancel(TimerNode& node) {
+				std::lock_guard<std::recursive_mutex> lock(mtx_);
+				if (node.slot_) {
+					Unlink(node);
+					armed_--;
+				}
+			}
+			//the ticks passed, for the cheap activity stamps of the idle checks.
+			uint64_t Now() const { return nowStamp_.load(std::memory_order_relaxed); }
+			std::chrono::milliseconds Tick() const { return tick_; }
+			uint64_t ToTicks(std::chrono::milliseconds duration) const { return duration.count() / tick_.count(); }
+			size_t ArmedCount() {
+				std::lock_guard<std::recursive_mutex> lock(mtx_);
+				return armed_;
+			}
+
+		private:
+			virtual void shutdown() override {
+				std::lock_guard<std::recursive_mutex> lock(mtx_);
+				bShutdown_ = true;
+				timer_.reset();
+			}
+
+			void Link(TimerNode& node) {
+				const uint64_t delta = node.expire_ - now_;
+				TimerNode** slot{ nullptr };
+				if (delta < e_RootSize)
+					slot = &root_[node.expire_ & e_RootMask];
+				else {
+					int level{ 0 };
+					while (level < e_Levels - 1 && delta >= (uint64_t(1) << (e_RootBits + e_LevelBits * (level + 1))))
+						level++;
+					slot = &levels_[level][(node.expire_ >> (e_RootBits + e_LevelBits * level)) & e_LevelMask];
+				}
+				node.slot_ = slot;
+				node.prev_ = nullptr;
+				node.next_ = *slot;
+				if (*slot)
+					(*slot)->prev_ = &node;
+				*slot = &node;
+			}
+			void Unlink(TimerNode& node) {
+				if (node.prev_)
+					node.prev_->next_ = node.next_;
+				else
+					*node.slot_ = node.next_;
+				if (node.next_)
+					node.next_->prev_ = node.prev_;
+				node.prev_ = node.next_ = nullptr;
+				node.slot_ = nullptr;
+			}
+			//move the nodes of a higher level slot down to where they belong now.
+			void Cascade(int level, size_t index) {
+				TimerNode* node = levels_[level][index];
+				levels_[level][index] = nullptr;
+				while (node) {
+					TimerNode* next = node->next_;
+					Link(*node);
+					node = next;
+				}
+			}
+			void Advance() {
+				now_++;
+				nowStamp_.store(now_, std::memory_order_relaxed);
+				if ((now_ & e_RootMask) == 0) {
+					for (int level = 0; level < e_Levels; level++) {
+						const size_t index = (now_ >> (e_RootBits + e_LevelBits * level)) & e_LevelMask;
+						Cascade(level, index);
+						if (index != 0)
+							break;
+					}
+				}
+				//a callback may arm or cancel nodes, so the slot is popped one node at a time.
+				TimerNode** slot = &root_[now_ & e_RootMask];
+				while (*slot) {
+					TimerNode* node = *slot;
+					Unlink(*node);
+					armed_--;
+					if (node->cb_)
+						node->cb_();
+				}
+			}
+			void StartTick() {
+				if (bShutdown_ || !timer_)
+					return;
+				bTicking_ = true;
+				start_ = std::chrono::steady_clock::now();
+				startTicks_ = now_;
+				WaitTick();
+			}
+			//the deadlines are counted from the start, so a late tick catches up instead of drifting.
+			void WaitTick() {
+				timer_->expires_at(start_ + tick_ * (now_ - startTicks_ + 1));
+				timer_->async_wait([this](const std::error_code& ec) {
+					if (ec == asio::error::operation_aborted)
+						return;
+					std::lock_guard<std::recursive_mutex> lock(mtx_);
+					if (bShutdown_)
+						return;
+					const uint64_t due = static_cast<uint64_t>((std::chrono::steady_clock::now() - start_) / tick_) + startTicks_;
+					while (now_ < due && armed_ > 0)
+						Advance();
+					if (armed_ == 0) {
+						bTicking_ = false;
+						return;
+					}
+					WaitTick();
+					});
+			}
+
+		private:
+			std::recursive_mutex mtx_;
+			std::unique_ptr<asio::steady_timer> timer_;
+			std::chrono::milliseconds tick_;
+			std::chrono::steady_clock::time_point start_;
+			uint64_t startTicks_{ 0 };
+			uint64_t now_{ 0 };
+			std::atomic<uint64_t> nowStamp_{ 0 };
+			size_t armed_{ 0 };
+			bool bTicking_{ false };
+			bool bShutdown_{ false };
+			TimerNode* root_[e_RootSize]{ nullptr };
+			TimerNode* levels_[e_Levels][e_LevelSize]{ { nullptr } };
+		};
+	}
+}
@@ -42,9 +42,9 @@ namespace Http {
 			}
 #ifdef OPENSSL
 			std::string ca = "ca.pem";
-			connector_ = new ConnectorTcpSSL(ioCtx_, "127.0.0.1", 0, ca);
+			connector_ = new ConnectorTcpSSL(ioCtx_, "127.0.0.1", 0, ca, 5, Codec(E_CODEC_T::e_Raw));
 #else
-			connector_ = new ConnectorTcp(ioCtx_, "127.0.0.1", 0);
+			connector_ = new ConnectorTcp(ioCtx_, "127.0.0.1", 0, 5, Codec(E_CODEC_T::e_Raw));
 #endif
 			assert(connector_);
 			SendReqMng_ = new HttpSendRequestMng(connector_);
@@ -75,27 +75,27 @@ namespace Http {
 			}
 		}
 
-		int Open(const char* ip, short port) {
+		SessionId Open(const char* ip, short port) {
 			serverIp_ = ip;
 			ServerPort_ = port;
-			int id = connector_->Open(serverIp_, ServerPort_);
+			SessionId id = connector_->Open(serverIp_, ServerPort_);
 			return id;
 		}
-		void Close(int id) {
+		void Close(SessionId id) {
 			connector_->Close(id);
 		}
 		//req:"GET /lx" 
-		void SendReq(int id, const char* req, unsigned len, OnSendReqCB callback) {
+		void SendReq(SessionId id, const char* req, unsigned len, OnSendReqCB callback) {
 			if (connector_->IsConnected(id) != 1)
 				callback("", 1); // todo error code 1 for unconnected.
 			SendReqMng_->SendReq(id, req, len, keepLive_, callback);
 		}
-		void AsyncSendReq(int id, const char* req, unsigned len, OnSendReqCB callback) {
+		void AsyncSendReq(SessionId id, const char* req, unsigned len, OnSendReqCB callback) {
 			if (connector_->IsConnected(id) != 1)
 				callback("", 1);			
 			SendReqMng_->AsyncSendReq(id, req, len, keepLive_, callback);
 		}
-		int SendChunkFile(int id, const char* chunk, unsigned len, bool b_end, uint8_t& ec) {
+		int SendChunkFile(SessionId id, const char* chunk, unsigned len, bool b_end, uint8_t& ec) {
 			auto find = um_CkFileMng_.find(id);
 			if (find != um_CkFileMng_.end()) {
 				int ret = find->second->SendChunkFile(id, chunk, len, b_end, ec);
@@ -117,7 +117,7 @@ namespace Http {
 		}
 		//todo: usage: to receive the chunk file (entitybody and trailer)
 		template<typename F>  //void(char*, int) param: data, len
-		int RecvChunkFile(int id, F callback, bool b_trailer, uint8_t& ec) {
+		int RecvChunkFile(SessionId id, F callback, bool b_trailer, uint8_t& ec) {
 			if (connector_->IsConnected(id) != 1)
 				return -1;
 			auto find = um_CkFileMng_.find(id);
@@ -142,7 +142,7 @@ namespace Http {
 			connMng_->Run();
 			CreateConnStrategy();
 
-			connector_->SetEventCB([this](int id, const Event& event) {
+			connector_->SetEventCB([this](SessionId id, const Event& event) {
 				switch (event.type) {
 				case Event::eEvent_t::e_connClosed:
 				case Event::eEvent_t::e_netEof:
@@ -171,7 +171,7 @@ namespace Http {
 				}, true);
 		}
 		
-		void UpdateConn(int id, ConnState state) {
+		void UpdateConn(SessionId id, ConnState state) {
 			connMng_->UpdateConn(id, state);
 		}
 
@@ -186,6 +186,6 @@ namespace Http {
 		ConnectorBase* connector_{ nullptr };
 		HttpSendRequestMng* SendReqMng_{ nullptr };
 		HttpConnectionMng* connMng_{ nullptr };
-		std::unordered_map<int, HttpChunkFileMng*> um_CkFileMng_;
+		std::unordered_map<SessionId, HttpChunkFileMng*> um_CkFileMng_;
 	};
 }
\ No newline at end of file
@@ -1,7 +1,9 @@
 #pragma once
 //========================================================================
 //[File Name]:HttpConnectionMng.h
-//[Description]: the implemetation of http connection management.
+//[Description]: the implemetation of http connection management. the timed
+//  strategies run on the timing wheel of the io_context, and before they run
+//  the connections without traffic for a whole interval are marked idle.
 //[Author]:Nico Hu
 //[Date]:2020-08-10
 //[Other]:Copyright (c) 2020-2050 Nico Hu
@@ -10,9 +12,11 @@
 #include <mutex>
 #include <unordered_map>
 #include <functional>
+#include <memory>
 
 #include "asio.hpp"
 #include "../Comm.h"
+#include "../core/TimingWheel.h"
 
 
 using namespace asio;
@@ -25,33 +29,50 @@ namespace Http {
 
     class HttpConnectionMng {
     public:
-        using UM_ConnState = std::unordered_map<int, ConnState>;
+        using UM_ConnState = std::unordered_map<SessionId, ConnState>;
         using HttpStrategy = std::function<void(UM_ConnState&)>;
         using UM_HttpStrategy = std::unordered_map<std::string, HttpStrategy>;
 
     public:
-        explicit HttpConnectionMng(io_context& io_c, int strategy_interval = 10) : timer_(io_c),
-            strategyInterval_(strategy_interval) { }
-        ~HttpConnectionMng() { timer_.cancel(); }
+        explicit HttpConnectionMng(io_context& io_c, int strategy_interval = 10) : ioCtx_(io_c), wheel_(Core::TimingWheel::Of(io_c)),
+            strategyInterval_(strategy_interval) {
+            //the strategies close connections, which locks the server's sessions, so they are posted off the wheel.
+            timer_.SetCallBack([this] {
+                std::weak_ptr<int> alive = alive_;
+                asio::post(ioCtx_, [this, alive] {
+                    if (alive.expired())
+                        return;
+                    RunStrategyTime();
+                    Run();
+                    });
+                });
+        }
+        ~HttpConnectionMng() { wheel_.Cancel(timer_); }
 
-        void UpdateConn(int id, ConnState state) {
-            std::lock_guard<std::mutex> lock(mtx_);
-            auto find = um_ConnState_.find(id);
-            if (find != um_ConnState_.end()) {
-                if (state == ConnState::e_Closed)
-                    um_ConnState_.erase(find);
+        void UpdateConn(SessionId id, ConnState state) {
+            UM_ConnState states;
+            {
+                std::lock_guard<std::mutex> lock(mtx_);
+                auto find = um_ConnState_.find(id);
+                if (find != um_ConnState_.end()) {
+                    if (state == ConnState::e_Closed) {
+                        um_ConnState_.erase(find);
+                        um_ConnActive_.erase(id);
+                    }
+                    else
+                        find->second = state;
+                }
                 else
-                    find->second = state;
-            }
-            else
-                if (state != ConnState::e_Closed)
-                    um_ConnState_.emplace(id, state);
+                    if (state != ConnState::e_Closed)
+                        um_ConnState_.emplace(id, state);
+                if (state == ConnState::e_Active)
+                    um_ConnActive_[id] = wheel_.Now();
 
-            if (um_ConnState_.size() >= MaxConnection - ConnResv) {
-                for (auto var : um_Strategy_) {
-                    var.second(um_ConnState_);
-                }
+                if (um_ConnState_.size() < MaxConnection - ConnResv || um_Strategy_.empty())
+                    return;
+                states = um_ConnState_;
             }
+            RunStrategies(um_Strategy_, std::move(states));
         }
         template<typename F>
         void AddStrategy(const char* name, F f, bool b_time = false) {
@@ -71,34 +92,59 @@ namespace Http {
             }
         }
         void Run() {
-            if (strategyInterval_ > 0) {
-                timer_.expires_after(std::chrono::seconds(strategyInterval_));
-                timer_.async_wait(
-                    [this](const std::error_code& ec)
-                    {
-                        if (ec != asio::error::operation_aborted) {
-                            {
-                                std::lock_guard<std::mutex> lock(mtx_);
-                                for (auto var : um_StrategyTime_) {
-                                    var.second(um_ConnState_);
-                                }
-                            }
-                            Run();
-                        }
-                    });
-            }
+            if (strategyInterval_ > 0)
+                wheel_.Arm(timer_, std::chrono::seconds(strategyInterval_));
         }
         void Stop() {
             if (strategyInterval_ > 0)
-                timer_.cancel();
+                wheel_.Cancel(timer_);
+            std::lock_guard<std::mutex> lock(mtx_);
             um_ConnState_.clear();
+            um_ConnActive_.clear();
+        }
+
+    protected:
+        void RunStrategyTime() {
+            UM_ConnState states;
+            {
+                std::lock_guard<std::mutex> lock(mtx_);
+                const uint64_t now = wheel_.Now();
+                const uint64_t idle_ticks = wheel_.ToTicks(std::chrono::seconds(strategyInterval_));
+                for (auto& var : um_ConnState_) {
+                    if (var.second == ConnState::e_Active && now - um_ConnActive_[var.first] >= idle_ticks)
+                        var.second = ConnState::e_Idle;
+                }
+                if (um_StrategyTime_.empty())
+                    return;
+                states = um_ConnState_;
+            }
+            RunStrategies(um_StrategyTime_, std::move(states));
+        }
+        //the strategies close connections, which locks the server's sessions and gets back to UpdateConn, so
+        //they run on a copy of the states without the lock, and the connections they drop are dropped here after.
+        void RunStrategies(const UM_HttpStrategy& strategies, UM_ConnState states) {
+            const UM_ConnState before(states);
+            for (auto& var : strategies) {
+                var.second(states);
+            }
+            std::lock_guard<std::mutex> lock(mtx_);
+            for (auto& var : before) {
+                if (states.find(var.first) == states.end()) {
+                    um_ConnState_.erase(var.first);
+                    um_ConnActive_.erase(var.first);
+                }
+            }
         }
 
     protected:
         std::mutex mtx_;
+        io_context& ioCtx_;
+        Core::TimingWheel& wheel_;
         int strategyInterval_{ 0 }; //unit: second
-        asio::steady_timer timer_;
+        Core::TimerNode timer_;
+        std::shared_ptr<int> alive_{ std::make_shared<int>(0) };   //the posted strategy runs check it
         UM_ConnState um_ConnState_;
+        std::unordered_map<SessionId, uint64_t> um_ConnActive_;   //the wheel tick of the last activity
         UM_HttpStrategy um_Strategy_;
         UM_HttpStrategy um_StrategyTime_;
     };
@@ -9,6 +9,7 @@
 #include <string>
 #include <sstream>
 #include "../asio/asio.hpp"
+#include "../Comm.h"
 #include "../com/StringTools.h"
 #include "MD5.h"
 
@@ -16,8 +17,8 @@
 namespace Http {
     using OnSendReqCB = std::function<void(std::string, uint8_t)>;
     using OnTranEnCB = std::function<void(std::string, uint8_t)>;
-    using OnRspCB = std::function<void(int, std::string)>;          //session_id, content
-    using OnRecvReqCB = std::function<void(std::string, int, uint8_t, OnRspCB)>; //content, session_id, error_code, callback
+    using OnRspCB = std::function<void(Net::SessionId, std::string)>;          //session_id, content
+    using OnRecvReqCB = std::function<void(std::string, Net::SessionId, uint8_t, OnRspCB)>; //content, session_id, error_code, callback
 
     enum class StatusType
     {
@@ -159,8 +160,8 @@ namespace Http {
         }
     }
     namespace MiscStrings {
-        const char name_value_separator[] = { ':', ' ' };
-        const char crlf[] = { '\r', '\n' };
+        const char name_value_separator[] = ": ";  //streamed, so they end with a nul
+        const char crlf[] = "\r\n";
     }
     namespace StockResps {
         const char ok[] = "";
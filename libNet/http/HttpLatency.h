@@ -0,0 +1,148 @@
+#pragma once
+//========================================================================
+//[File Name]:HttpLatency.h
+//[Description]: the latencies of the requests of a http server by route:
+//  parse, handler, send and end-to-end time. each thread records into
+//  histograms of its own, a report merges them.
+//[Author]:Nico Hu
+//[Date]:2020-08-10
+//[Other]:Copyright (c) 2020-2050 Nico Hu
+//========================================================================
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "../com/Histogram.h"
+
+namespace Http {
+    enum class E_LAT_STAGE_T {
+        e_Parse = 0,
+        e_Handler,
+        e_Send,
+        e_Total,    //from the parse of the last bytes of the request to the response sent
+        e_Count
+    };
+    constexpr size_t LatStageNum = static_cast<size_t>(E_LAT_STAGE_T::e_Count);
+
+    //in ns.
+    struct LatencyInfo_t {
+        uint64_t count{ 0 };
+        uint64_t p50{ 0 };
+        uint64_t p99{ 0 };
+        uint64_t p999{ 0 };
+        uint64_t max{ 0 };
+        double mean{ 0 };
+    };
+    struct RouteLatencyInfo_t {
+        std::string route;      //"METHOD url"
+        LatencyInfo_t stages[LatStageNum];
+    };
+
+    class HttpLatency {
+    public:
+        struct RouteHist {
+            Histogram stages[LatStageNum];
+        };
+
+        HttpLatency() : id_(NextId()++) { }
+        HttpLatency(const HttpLatency&) = delete;
+        HttpLatency& operator=(const HttpLatency&) = delete;
+
+        //the stages of one request, a negative time is not recorded.
+        void Record(const std::string& route, const int64_t(&ns)[LatStageNum]) {
+            Shard& shard = LocalShard();
+            auto find = shard.routes.find(route);
+            if (find == shard.routes.end()) {
+                std::lock_guard<std::mutex> lock(shard.mtx);
+                find = shard.routes.emplace(route, std::unique_ptr<RouteHist>(new RouteHist())).first;
+            }
+            for (size_t i = 0; i < LatStageNum; i++) {
+                if (ns[i] >= 0)
+                    find->second->stages[i].Record(static_cast<uint64_t>(ns[i]));
+            }
+        }
+        //the histograms of a route merged over the threads, false if it has no request.
+        bool Get(const std::string& route, RouteHist& hist) const {
+            bool found{ false };
+            ForEachShard([&](const Shard& shard) {
+                auto find = shard.routes.find(route);
+                if (find == shard.routes.end())
+                    return;
+                found = true;
+                for (size_t i = 0; i < LatStageNum; i++)
+                    hist.stages[i].Merge(find->second->stages[i]);
+                });
+            return found;
+        }
+        std::vector<RouteLatencyInfo_t> Report() const {
+            std::unordered_map<std::string, RouteHist> merged;
+            ForEachShard([&](const Shard& shard) {
+                for (auto& var : shard.routes) {
+                    RouteHist& hist = merged[var.first];
+                    for (size_t i = 0; i < LatStageNum; i++)
+                        hist.stages[i].Merge(var.second->stages[i]);
+                }
+                });
+            std::vector<RouteLatencyInfo_t> report;
+            for (auto& var : merged) {
+                RouteLatencyInfo_t info;
+                info.route = var.first;
+                for (size_t i = 0; i < LatStageNum; i++)
+                    info.stages[i] = ToInfo(var.second.stages[i]);
+                report.emplace_back(std::move(info));
+            }
+            return report;
+        }
+        static LatencyInfo_t ToInfo(const Histogram& hist) {
+            LatencyInfo_t info;
+            info.count = hist.Count();
+            info.p50 = hist.Percentile(50);
+            info.p99 = hist.Percentile(99);
+            info.p999 = hist.Percentile(99.9);
+            info.max = hist.Max();
+            info.mean = hist.Mean();
+            return info;
+        }
+
+    protected:
+        //the routes of a thread. only that thread adds to them(under mtx) or records, the readers hold mtx.
+        struct Shard {
+            std::mutex mtx;
+            std::unordered_map<std::string, std::unique_ptr<RouteHist>> routes;
+        };
+
+        Shard& LocalShard() {
+            //the shards of the thread by the id of their HttpLatency, an id is never reused.
+            thread_local std::vector<std::pair<uint64_t, Shard*>> local;
+            for (auto& var : local) {
+                if (var.first == id_)
+                    return *var.second;
+            }
+            std::lock_guard<std::mutex> lock(mtx_);
+            shards_.emplace_back(new Shard());
+            local.emplace_back(id_, shards_.back().get());
+            return *shards_.back();
+        }
+        template<typename F>
+        void ForEachShard(F f) const {
+            std::lock_guard<std::mutex> lock(mtx_);
+            for (auto& var : shards_) {
+                std::lock_guard<std::mutex> lock_shard(var->mtx);
+                f(*var);
+            }
+        }
+        static std::atomic<uint64_t>& NextId() {
+            static std::atomic<uint64_t> id{ 0 };
+            return id;
+        }
+
+    protected:
+        const uint64_t id_;
+        mutable std::mutex mtx_;
+        std::vector<std::unique_ptr<Shard>> shards_;
+    };
+}
@@ -203,14 +203,18 @@ namespace Http {
 	};
 
 	class HttpSendRequestMng {
-		using SPRespParser = std::shared_ptr<HttpResponseParser>;
+		using RespParser = DesignPattern::ObjectPool<HttpResponseParser>::Handle;
 		struct RespRem {
-			int id{ -1 };
+			SessionId id{ -1 };
 			char* data{ nullptr };
 			unsigned len{ 0 };
 			unsigned buf_len{ 0 };
-			SPRespParser parser;
+			RespParser parser;
 
+			RespRem() = default;
+			RespRem(RespRem&& ref) noexcept : id(ref.id), data(ref.data), len(ref.len), buf_len(ref.buf_len), parser(std::move(ref.parser)) {
+				ref.data = nullptr;
+			}
 			~RespRem() { SAFE_DELETE_ARRAY(data); }
 			void reset() {
 				id = -1; len = 0; buf_len = 0;
@@ -219,8 +223,7 @@ namespace Http {
 		};
 
 	public:
-		explicit HttpSendRequestMng(NetBase<SOCKET_TYPE>* net_base) : netBase_(net_base) {
-			objPool_.Init(16);
+		explicit HttpSendRequestMng(NetBase<SOCKET_TYPE>* net_base) : netBase_(net_base), objPool_(DesignPattern::ObjectPoolInfo_t{ 16, 16 }) {
 		}
 		~HttpSendRequestMng() {
 			for (auto itr = um_Md5Mng_.begin(); itr != um_Md5Mng_.end();) {
@@ -233,15 +236,15 @@ namespace Http {
 			}
 		}
 
-		void SendReq(int id, const char* req, unsigned len, bool keep_live, OnSendReqCB callback) {
+		void SendReq(SessionId id, const char* req, unsigned len, bool keep_live, OnSendReqCB callback) {
 			DoSendReq(id, req, len, keep_live, callback);
 		}
-		void AsyncSendReq(int id, const char* req, unsigned len, bool keep_live, OnSendReqCB callback) {
+		void AsyncSendReq(SessionId id, const char* req, unsigned len, bool keep_live, OnSendReqCB callback) {
 			DoAsyncSendReq(id, req, len, keep_live, callback);
 		}
 
 	protected:
-		void DoSendReq(int id, const char* req, unsigned len, bool keep_live, OnSendReqCB callback) {
+		void DoSendReq(SessionId id, const char* req, unsigned len, bool keep_live, OnSendReqCB callback) {
 			HttpRequest request = CreateRequest(req, len, keep_live);
 
 			uint8_t ec = 0;
@@ -252,11 +255,11 @@ namespace Http {
 			else
 				callback("", ec);
 		}
-		void DoAsyncSendReq(int id, const char* req, unsigned len, bool keep_live, OnSendReqCB callback) {
+		void DoAsyncSendReq(SessionId id, const char* req, unsigned len, bool keep_live, OnSendReqCB callback) {
 			HttpRequest request = CreateRequest(req, len, keep_live);
 
 			std::string data = request.ToString();
-			int nret = netBase_->AsyncSend(id, data.c_str(), data.length(), [this, callback](int id, size_t byte_send, uint8_t ec) {
+			int nret = netBase_->AsyncSend(id, data.c_str(), data.length(), [this, callback](SessionId id, size_t byte_send, uint8_t ec) {
 				if (byte_send > 0)
 					DoAsyncRecvResp(id, callback);//todo if the packet is divided to pieces,and there are several function calback.
 				else
@@ -307,7 +310,7 @@ namespace Http {
 			}
 			return request;
 		}
-		void DoRecvResp(int id, OnSendReqCB callback) {
+		void DoRecvResp(SessionId id, OnSendReqCB callback) {
 			int nret{ 0 };
 			do {
 				char* r_data{ nullptr };
@@ -333,13 +336,11 @@ namespace Http {
 							break;
 					}
 					else {
-						SPRespParser parser{ nullptr };
-						parser = objPool_.Get<>();
-						if (parser == nullptr) {
-							parser = std::make_shared<HttpResponseParser>();
-							assert(parser);
+						RespParser parser = objPool_.Get();
+						if (!parser) {
+							callback("", 1);
+							break;
 						}
-						parser->Reset();
 						if (DoParse(id, parser, r_data, nret, callback) != 1)
 							break;
 					}
@@ -351,8 +352,8 @@ namespace Http {
 			} while (nret > 0);
 			um_RespRem_.erase(id);
 		}
-		void DoAsyncRecvResp(int id, OnSendReqCB callback) {
-			int ret = netBase_->AsyncRecieve(id, [this, callback](int id, char* data, unsigned byte_recv, uint8_t ec) {
+		void DoAsyncRecvResp(SessionId id, OnSendReqCB callback) {
+			int ret = netBase_->AsyncRecieve(id, [this, callback](SessionId id, char* data, unsigned byte_recv, uint8_t ec) {
 				auto find = um_RespRem_.find(id);
 				if (find != um_RespRem_.end()) {
 					if (find->second.len + byte_recv > find->second.buf_len) {
@@ -375,13 +376,11 @@ namespace Http {
 						um_RespRem_.erase(id);
 				}
 				else {
-					SPRespParser parser{ nullptr };
-					parser = objPool_.Get<>();
-					if (parser == nullptr) {
-						parser = std::make_shared<HttpResponseParser>();
-						assert(parser);
+					RespParser parser = objPool_.Get();
+					if (!parser) {
+						callback("", 1);
+						return;
 					}
-					parser->Reset();
 					if (DoParse(id, parser, data, byte_recv, callback) == 1)
 						DoAsyncRecvResp(id, callback);
 				}
@@ -390,7 +389,9 @@ namespace Http {
 				callback("", 1);
 
 		}
-		int DoParse(int id, SPRespParser parser, char* data, int len, OnSendReqCB callback) {
+		//handle is moved to um_RespRem_ if the response is not complete.
+		int DoParse(SessionId id, RespParser& handle, char* data, int len, OnSendReqCB callback) {
+			HttpResponseParser* parser = handle.get();
 			int ret = parser->Parse(data, len);
 			if (ret == -1) {
 				HttpResponse& resp = parser->GetResult();
@@ -447,8 +448,8 @@ namespace Http {
 						memcpy_s(resp_rem.data, data_len, data + ret, data_len);
 					}
 					resp_rem.len = data_len;
-					resp_rem.parser = parser;
-					um_RespRem_.emplace(id, resp_rem);
+					resp_rem.parser = std::move(handle);
+					um_RespRem_.emplace(id, std::move(resp_rem));
 				}
 				//check if it is chunk file encoding transfered?
 				std::string head_value = HttpTools::GetHeaderValue(parser->GetResult(), "Transfer-Encoding");
@@ -479,7 +480,7 @@ namespace Http {
 				return -1;
 			}
 		}
-		void CheckConnection(int id, const HttpResponse& resp) {
+		void CheckConnection(SessionId id, const HttpResponse& resp) {
 			int ret = HttpTools::CheckConnection(resp);
 			if (ret == 0)//close connection
 				netBase_->Close(id);
@@ -495,13 +496,13 @@ namespace Http {
 	protected:
 		NetBase<SOCKET_TYPE>* netBase_{ nullptr };
 		DesignPattern::ObjectPool<HttpResponseParser> objPool_;
-		std::unordered_map<int, RespRem> um_RespRem_;
-		std::unordered_map<int, Md5Mng*> um_Md5Mng_;
+		std::unordered_map<SessionId, RespRem> um_RespRem_;
+		std::unordered_map<SessionId, Md5Mng*> um_Md5Mng_;
 	};
 
 	class HttpChunkFileMng : public Md5Mng {
 		struct ChunkRem {
-			int id{ -1 };
+			SessionId id{ -1 };
 			char* data{ nullptr };
 			unsigned len{ 0 };
 			unsigned buf_len{ 0 };
@@ -519,14 +520,14 @@ namespace Http {
 			memStorage_{ 1024 * 4, 1024 * 8, 1024 * 16, 1024 * 32 }{
 		}
 
-		int SendChunkFile(int id, const char* chunk, unsigned len, bool b_end, uint8_t& ec) {
+		int SendChunkFile(SessionId id, const char* chunk, unsigned len, bool b_end, uint8_t& ec) {
 			return TransferEncoding(id, chunk, len, b_end, ec);
 		}
-		int RecvChunkFile(int id, ChunkRecvCB callback, bool b_trailer, uint8_t& ec) {
+		int RecvChunkFile(SessionId id, ChunkRecvCB callback, bool b_trailer, uint8_t& ec) {
 			return TransferDecoding(id, callback, b_trailer, ec);
 		}
 	protected:
-		int TransferEncoding(int id, const char* chunk, unsigned len, bool b_end, uint8_t& ec) {
+		int TransferEncoding(SessionId id, const char* chunk, unsigned len, bool b_end, uint8_t& ec) {
 			if (chunk) {
 				int PREFIX = 12, pos = 0;
 				int buff_size = std::min(MaxPacketSize - PREFIX, (int)len) + PREFIX;
@@ -564,7 +565,7 @@ namespace Http {
 			return len;
 		}
 
-		int TransferDecoding(int id, ChunkRecvCB callback, bool b_trailer, uint8_t& ec) {
+		int TransferDecoding(SessionId id, ChunkRecvCB callback, bool b_trailer, uint8_t& ec) {
 			assert(callback);
 			int r_len{ 0 };
 			int in_ret{ -1 };
@@ -628,7 +629,7 @@ namespace Http {
 			//sprintf(p_out + len, "%s", "\r\n");
 			o_len = pos;
 		}
-		int DecodingChunk(int id, const char* data, unsigned len, ChunkRecvCB callback) {
+		int DecodingChunk(SessionId id, const char* data, unsigned len, ChunkRecvCB callback) {
 			char* p_data = const_cast<char*>(data);
 			char* chunk{ nullptr };
 			int pos_d = 0;
@@ -684,7 +685,7 @@ namespace Http {
 			} while (1);
 		}
 
-		int VerfyTrailer(int id, const char* data, unsigned len, uint8_t& ec) {
+		int VerfyTrailer(SessionId id, const char* data, unsigned len, uint8_t& ec) {
 			int in_ret = -1;
 			char trailer[128]{ 0 };
 			int len_t{ 0 };
@@ -730,7 +731,7 @@ namespace Http {
 
 	protected:
 		NetBase<SOCKET_TYPE>* netBase_{ nullptr };
-		std::unordered_map<int, ChunkRem> um_ChunkRem_;
+		std::unordered_map<SessionId, ChunkRem> um_ChunkRem_;
 		NMemoryStorage<char>	memStorage_;
 	};
 }
\ No newline at end of file
@@ -27,7 +27,8 @@ namespace Http {
                 umReqHandler_.emplace(req, callback);
             }
         }
-		virtual void HandleRequest(int id, const Request& req, Response& rep) override {
+        bool HasRoute(const std::string& tag) const { return umReqHandler_.find(tag) != umReqHandler_.end(); }
+		virtual void HandleRequest(SessionId id, const Request& req, Response& rep) override {
             HttpRequest& request = dynamic_cast<HttpRequest&>(const_cast<Request&>(req));            
 
             char tag[256]{ 0 };
@@ -37,7 +38,7 @@ namespace Http {
                 uint8_t error_code = 0;
                 if (!HttpTools::GetHeaderValue(request, "Content-MD5").empty())
                     error_code = 0xFF;
-                find->second(request.entityBody_, id, error_code, [this, request, &rep](int session_id, std::string content) {
+                find->second(request.entityBody_, id, error_code, [this, request, &rep](SessionId session_id, std::string content) {
                     HttpResponse& response = dynamic_cast<HttpResponse&>(rep);
                     response.status_ = StatusType::e_ok;
                     response.entityBody_ = content/*StockResps::to_string(StatusType::e_ok)*/;
@@ -18,9 +18,11 @@ using namespace Net::Stream::SSL;
 #endif //OPENSSL
 
 #include "../com/ObjectPool.h"
+#include "../com/Timer.h"
 #include "StreamWriter.h"
 #include "HttpRequestHandler.h"
 #include "HttpConnectionMng.h"
+#include "HttpLatency.h"
 #include "MD5.h"
 
 
@@ -33,14 +35,18 @@ namespace Http {
 
     class HttpServer
     {
-        using SPReqParser = std::shared_ptr<HttpRequestParser>;
+        using ReqParser = DesignPattern::ObjectPool<HttpRequestParser>::Handle;
         struct ReqRem {
-            int id{-1};
+            SessionId id{-1};
             char* data{nullptr};
             unsigned len{0};
             unsigned buf_len{ 0 };
-            SPReqParser parser{nullptr};
+            ReqParser parser;
 
+            ReqRem() = default;
+            ReqRem(ReqRem&& ref) noexcept : id(ref.id), data(ref.data), len(ref.len), buf_len(ref.buf_len), parser(std::move(ref.parser)) {
+                ref.data = nullptr;
+            }
             ~ReqRem() { SAFE_DELETE_ARRAY(data); }
             void reset() {
                 id = -1; len = 0; buf_len = 0;
@@ -48,24 +54,33 @@ namespace Http {
             }
         };
     public:
+        //b_reactors: the connections run on thd_num reactors(an io_context per thread, see IoContextPool), placed on
+        //the least loaded one, instead of on thd_num threads sharing one io_context.
         explicit HttpServer(const char* ip, short port, const std::string& doc_root,
-             unsigned thd_num = std::thread::hardware_concurrency()) :
-            ioCtx_(), workThdNum_(thd_num), worker_(ioCtx_){
+             unsigned thd_num = std::thread::hardware_concurrency(), bool b_reactors = false) :
+            ioCtx_(), workThdNum_(thd_num), worker_(ioCtx_), objPool_(DesignPattern::ObjectPoolInfo_t{ 32, 32 }){
             requestHandler_ = new HttpRequestHandler(doc_root);
             assert(requestHandler_);
-            objPool_.Init(32);
 #ifdef OPENSSL
             SaSSLInfo_t sa_info = {"server.pem", "dh2048.pem", "test"};
-            server_ = new ServerTcpSSL(ioCtx_, ip, port, sa_info);
+            server_ = new ServerTcpSSL(ioCtx_, ip, port, sa_info, 5, Codec(E_CODEC_T::e_Raw)); //http does its own framing
 #else
-            server_ = new ServerTcp(ioCtx_, ip, port);
+            server_ = new ServerTcp(ioCtx_, ip, port, 5, Codec(E_CODEC_T::e_Raw)); //http does its own framing
 #endif //OPENSSL
             assert(server_);
+            if (b_reactors) {
+                reactors_ = std::make_shared<IoContextPool>(thd_num, E_PLACEMENT_T::e_LeastLoaded);
+                server_->SetReactorPool(reactors_);
+                workThdNum_ = 1; //the acceptor and the connection strategies
+            }
             connMng_ = new HttpConnectionMng(ioCtx_);
             assert(connMng_);
             Init();
         }
         ~HttpServer() {
+            if (reactors_)
+                reactors_->Stop();
+            reactors_ = nullptr; //destroyed with server_
             SAFE_DELETE(requestHandler_);
             SAFE_DELETE(connMng_);
             SAFE_DELETE(server_);
@@ -81,6 +96,8 @@ namespace Http {
         }
 
         void Start() {
+            if (reactors_)
+                reactors_->Run();
             for (auto i = 0; i < workThdNum_; ++i) {
                 v_workThd_.emplace_back(std::thread([&]() {
                     ioCtx_.run();
@@ -100,13 +117,21 @@ namespace Http {
                 if (var.joinable())
                     var.join();
             }
+            //the aborted reads of the closed sessions hold handlers which free into the pool of server_
+            ioCtx_.restart();
+            ioCtx_.poll();
+            if (reactors_)
+                reactors_->Stop();
         }
-        void Close(int id) { server_->Close(id); }
+        void Close(SessionId id) { server_->Close(id); }
         void OnRequest(const char* req, OnRecvReqCB callback) {
             requestHandler_->AddReqHandler(req, callback);
         }
+        //the latencies by route("METHOD url" of OnRequest, "unrouted" and "bad request" for the others), in ns.
+        std::vector<RouteLatencyInfo_t> GetLatencyReport() const { return latency_.Report(); }
+        const HttpLatency& GetLatency() const { return latency_; }
 
-        int SendChunkFile(int id, const char* chunk, unsigned len, bool b_end, uint8_t& ec) {
+        int SendChunkFile(SessionId id, const char* chunk, unsigned len, bool b_end, uint8_t& ec) {
             if (server_->IsConnected(id) != 1)
                 return -1;
             auto find = um_CkFileMng_.find(id);
@@ -130,7 +155,7 @@ namespace Http {
         }
         //todo: usage: to receive the chunk file (entitybody and trailer)
         template<typename F>  //void(char*, int) param: data, len
-        int RecvChunkFile(int id, F callback, bool b_trailer, uint8_t& ec) {
+        int RecvChunkFile(SessionId id, F callback, bool b_trailer, uint8_t& ec) {
             if (server_->IsConnected(id) != 1)
                 return -1;
             auto find = um_CkFileMng_.find(id);
@@ -154,7 +179,7 @@ namespace Http {
         void Init() {
             CreateConnStrategy();
 
-            server_->SetEventCB([this](int id, const Event& event) {
+            server_->SetEventCB([this](SessionId id, const Event& event) {
                 switch (event.type) {
                 case Event::eEvent_t::e_connClosed:
                 case Event::eEvent_t::e_netEof:
@@ -168,7 +193,7 @@ namespace Http {
                 }
                 });
 
-            server_->SetReceiveCB([this](int id, const char* data, size_t len, uint8_t ec) {
+            server_->SetReceiveCB([this](SessionId id, const char* data, size_t len, uint8_t ec) {
                 UpdateConn(id, ConnState::e_Active);
 
                 if (data) {
@@ -191,24 +216,29 @@ namespace Http {
                         if (ret != 1) um_ReqRem_.erase(id);
                     }
                     else {
-                        auto parser = objPool_.Get<>();
-                        if (parser == nullptr) {
-                            parser = std::make_shared<HttpRequestParser>();
-                            assert(parser);
+                        auto parser = objPool_.Get();
+                        if (!parser) {
+                            //the pool is at its capacity, the connection is dropped instead of its memory growing
+                            StreamWriter::Instance()->Write(std::cout, "[HttpServer] session id=%lld, no request parser left, closed", (long long)id);
+                            server_->Close(id);
+                            return;
                         }
-                        parser->Reset();
                         int ret = DoReceive(id, parser, data, len);
                     }
                 }
                 else {
                     //todo
-                    StreamWriter::Instance()->Write(std::cout, "[HttpServer] session id=%d, receive data failed, ec=%d", id, (int)ec);
+                    StreamWriter::Instance()->Write(std::cout, "[HttpServer] session id=%lld, receive data failed, ec=%d", (long long)id, (int)ec);
                 }
             });
         }
         
-        int DoReceive(int id, SPReqParser parser, const char* data, int len) {
+        //handle is moved to um_ReqRem_ if the request is not complete.
+        int DoReceive(SessionId id, ReqParser& handle, const char* data, int len) {
+            HttpRequestParser* parser = handle.get();
+            Timer timer;
             int ret = parser->Parse(data, len);
+            const int64_t parse_ns = timer.elapsed_nano();
             if (ret == -1) {
                 HttpRequest& request = parser->GetResult();
                 if (!HttpTools::GetHeaderValue(request, "Transfer-Encoding").empty()) {
@@ -221,11 +251,18 @@ namespace Http {
                 }
 
                 HttpResponse resp;
+                Timer stage;
                 requestHandler_->HandleRequest(id, request, resp);
+                const int64_t handler_ns = stage.elapsed_nano();
                 //resp
                 uint8_t ec = 0;
+                stage.reset();
                 std::string data = resp.ToString();
                 int ret = this->server_->Send(id, data.c_str(), data.length(), ec);//todo if failed?
+                std::string route = request.method_ + " " + request.url_;
+                if (!requestHandler_->HasRoute(route))
+                    route = "unrouted";
+                latency_.Record(route, { parse_ns, handler_ns, stage.elapsed_nano(), timer.elapsed_nano() });
                 return 0;
             }
             else if (ret >= 0) {
@@ -248,8 +285,8 @@ namespace Http {
                         memcpy_s(req_rem.data, data_len, data + ret, data_len);
                     }
                     req_rem.len = data_len;
-                    req_rem.parser = parser;
-                    um_ReqRem_.emplace(id, req_rem);
+                    req_rem.parser = std::move(handle);
+                    um_ReqRem_.emplace(id, std::move(req_rem));
                 }
                 //check if it is chunk file encoding transfered?
                 std::string head_value = HttpTools::GetHeaderValue(parser->GetResult(), "Transfer-Encoding");
@@ -265,8 +302,10 @@ namespace Http {
                 //resp bad request.
                 HttpResponse resp = HttpResponse::defaultResp(StatusType::e_bad_request);
                 uint8_t ec = 0;
+                Timer stage;
                 std::string data = resp.ToString();
                 int ret = this->server_->Send(id, data.c_str(), data.length(), ec);//todo if failed?
+                latency_.Record("bad request", { parse_ns, -1, stage.elapsed_nano(), timer.elapsed_nano() });
                 return -1;
             }
             else
@@ -300,7 +339,7 @@ namespace Http {
                 });
         }
 
-        void UpdateConn(int id, ConnState state) {
+        void UpdateConn(SessionId id, ConnState state) {
             connMng_->UpdateConn(id, state);
         }
 
@@ -309,13 +348,15 @@ namespace Http {
         io_context::work worker_;
         int workThdNum_{ 1 };
         std::vector<std::thread> v_workThd_;
+        std::shared_ptr<IoContextPool> reactors_{ nullptr };
         ServerBase* server_{ nullptr };
         // The signal_set is used to register for process termination notifications.
         //signal_set signals_;
         HttpRequestHandler* requestHandler_{ nullptr };
         DesignPattern::ObjectPool<HttpRequestParser> objPool_;
-        std::unordered_map<int, ReqRem> um_ReqRem_;
+        std::unordered_map<SessionId, ReqRem> um_ReqRem_;
         HttpConnectionMng* connMng_{ nullptr };
-        std::unordered_map<int, HttpChunkFileMng*> um_CkFileMng_;
+        std::unordered_map<SessionId, HttpChunkFileMng*> um_CkFileMng_;
+        HttpLatency latency_;
     };
 }
\ No newline at end of file
@@ -18,11 +18,11 @@ namespace Net {
 	namespace Stream {
 		class Client : public ClientBase<SOCKET_TYPE> {
 		public:
-			explicit Client(io_context& io_c, const std::string& ip, short port, unsigned timeout = 5) :
-				ClientBase<SOCKET_TYPE>(io_c, ip, port, timeout)
+			explicit Client(io_context& io_c, const std::string& ip, short port, unsigned timeout = 5, const Codec& codec = Codec::Default()) :
+				ClientBase<SOCKET_TYPE>(io_c, ip, port, timeout, codec)
 			{ }
 
-			virtual int Open(const std::string& ip, short port, bool keep_live = false) override {
+			virtual SessionId Open(const std::string& ip, short port, bool keep_live = false) override {
 				tcp::endpoint endpoint(address::from_string(ip_), port_);
 				tcp::socket socket(this->ioCtx_, endpoint);
 				this->OnTimer(socket);
@@ -35,21 +35,22 @@ namespace Net {
 					return -1;
 				}
 				else {
-					int id = SessionIdGen<int>::Instance()->GetId();
-					session_ = new SessionTcp(id, ioCtx_, \
-						std::move(socket), memStorage_, timeout_, keep_live);
-					session_->SetCallBackError([this](int session_id, uint8_t ec) {
+					SessionId id = NewId();
+					session_ = std::make_shared<SessionTcp>(id, ioCtx_, \
+						std::move(socket), memStorage_, timeout_, keep_live, codec_);
+					session_->SetCallBackError([this](SessionId session_id, uint8_t ec) {
 						StreamWriter::Instance()->Write(std::cout, "[Client] err code=%d", (int)ec);
 						this->CloseSession();
 						});
+					InitSession(*session_);
 					session_->SetStatus(1);
-					StreamWriter::Instance()->Write(std::cout, "[Client] Connect ok! session_id=%d", id);
+					StreamWriter::Instance()->Write(std::cout, "[Client] Connect ok! session_id=%lld", (long long)id);
 
 					return id;
 				}
 			}
 			virtual void OpenA(const std::string& ip, short port, \
-				std::function<void(int, std::error_code)> func, bool keep_live = false) override {
+				std::function<void(SessionId, std::error_code)> func, bool keep_live = false) override {
 				tcp::endpoint endpoint(address::from_string(ip_), port_);
 				tcp::socket socket(this->ioCtx_, endpoint);
 				tcp::endpoint server_addr(tcp::endpoint(address::from_string(ip), port));
@@ -59,15 +60,16 @@ namespace Net {
 							func(-1, ec);
 					}
 					else {
-						int id = SessionIdGen<int>::Instance()->GetId();
-						session_ = new SessionTcp(id, ioCtx_, \
-							std::move(socket), memStorage_, timeout_, keep_live);
-						session_->SetCallBackError([this](int session_id, uint8_t ec) {
+						SessionId id = NewId();
+						session_ = std::make_shared<SessionTcp>(id, ioCtx_, \
+							std::move(socket), memStorage_, timeout_, keep_live, codec_);
+						session_->SetCallBackError([this](SessionId session_id, uint8_t ec) {
 							StreamWriter::Instance()->Write(std::cout, "[Client] err code=%d", (int)ec);
 							this->CloseSession();
 							});
+						InitSession(*session_);
 						session_->SetStatus(1);
-						StreamWriter::Instance()->Write(std::cout, "[Client] Connect ok! session_id=%d", id);
+						StreamWriter::Instance()->Write(std::cout, "[Client] Connect ok! session_id=%lld", (long long)id);
 
 						if (func != nullptr)
 							func(id, ec);
@@ -21,18 +21,19 @@ namespace Net {
 		namespace SSL {
 			class ClientSSL : public ClientBase<SOCKET_TYPE>, CaSSL {
 			public:
-				explicit ClientSSL(io_context& io_c, const std::string& ip, short port, const std::string& ca, unsigned timeout = 5) :
-					ClientBase<SOCKET_TYPE>(io_c, ip, port, timeout), CaSSL(ca){ }
+				explicit ClientSSL(io_context& io_c, const std::string& ip, short port, const std::string& ca, unsigned timeout = 5, \
+					const Codec& codec = Codec::Default()) : ClientBase<SOCKET_TYPE>(io_c, ip, port, timeout, codec), CaSSL(ca){ }
 
-				virtual int Open(const std::string& ip, short port, bool keep_live = false) override {
+				virtual SessionId Open(const std::string& ip, short port, bool keep_live = false) override {
 					tcp::endpoint endpoint(address::from_string(ip_), port_);
-					int id = SessionIdGen<int>::Instance()->GetId();
-					session_ = new SessionTcpSSL(id, ioCtx_, tcp::socket(this->ioCtx_, endpoint), \
-						sslCtx_, memStorage_, timeout_, keep_live);
-					session_->SetCallBackError([this](int session_id, uint8_t ec) {
+					SessionId id = NewId();
+					session_ = std::make_shared<SessionTcpSSL>(id, ioCtx_, tcp::socket(this->ioCtx_, endpoint), \
+						sslCtx_, memStorage_, timeout_, keep_live, codec_);
+					session_->SetCallBackError([this](SessionId session_id, uint8_t ec) {
 						StreamWriter::Instance()->Write(std::cout, "[Client ssl] err code=%d", (int)ec);
 						this->CloseSession();
 						});
+					InitSession(*session_);
 					this->OnTimer(session_->GetSocket());
 					tcp::endpoint server_addr(tcp::endpoint(address::from_string(ip), port));
 					asio::error_code ec;
@@ -43,22 +44,23 @@ namespace Net {
 						return -1;
 					}
 					else {
-						dynamic_cast<SessionTcpSSL*>(session_)->HandShake(ssl::stream_base::client, ec);
+						dynamic_cast<SessionTcpSSL*>(session_.get())->HandShake(ssl::stream_base::client, ec);
 						session_->SetStatus(1);
-						StreamWriter::Instance()->Write(std::cout, "[Client ssl] Connect ok! session_id=%d", id);
+						StreamWriter::Instance()->Write(std::cout, "[Client ssl] Connect ok! session_id=%lld", (long long)id);
 						return id;
 					}
 				}
 				virtual void OpenA(const std::string& ip, short port, \
-					std::function<void(int, std::error_code)> func, bool keep_live = false) override {
+					std::function<void(SessionId, std::error_code)> func, bool keep_live = false) override {
 					tcp::endpoint endpoint(address::from_string(ip_), port_);
-					int id = SessionIdGen<int>::Instance()->GetId();
-					session_ = new SessionTcpSSL(id, ioCtx_, tcp::socket(ioCtx_, endpoint), \
-						sslCtx_, memStorage_, timeout_, keep_live);
-					session_->SetCallBackError([this](int session_id, uint8_t ec) {
+					SessionId id = NewId();
+					session_ = std::make_shared<SessionTcpSSL>(id, ioCtx_, tcp::socket(ioCtx_, endpoint), \
+						sslCtx_, memStorage_, timeout_, keep_live, codec_);
+					session_->SetCallBackError([this](SessionId session_id, uint8_t ec) {
 						StreamWriter::Instance()->Write(std::cout, "[Client ssl] err code=%d", (int)ec);
 						this->CloseSession();
 						});
+					InitSession(*session_);
 					tcp::endpoint server_addr(tcp::endpoint(address::from_string(ip), port));
 					session_->GetSocket().lowest_layer().async_connect(server_addr, [this, id, func, keep_live](const asio::error_code& ec) {
 						if (ec) {
@@ -66,11 +68,11 @@ namespace Net {
 								func(-1, ec);
 						}
 						else {
-							dynamic_cast<SessionTcpSSL*>(session_)->AsyncHandShake(ssl::stream_base::client, \
+							dynamic_cast<SessionTcpSSL*>(session_.get())->AsyncHandShake(ssl::stream_base::client, \
 								[this, id, func](const std::error_code& err_code) {
 									if (!err_code) {
 										session_->SetStatus(1);
-										StreamWriter::Instance()->Write(std::cout, "[Client ssl] Connect ok! session_id=%d", id);
+										StreamWriter::Instance()->Write(std::cout, "[Client ssl] Connect ok! session_id=%lld", (long long)id);
 
 										if (func != nullptr)
 											func(id, err_code);
@@ -19,10 +19,10 @@ namespace Net {
 
 		class ConnectorTcp : public ConnectorBase {
 		public:
-			explicit ConnectorTcp(io_context& io_c, const std::string& ip, short port, unsigned timeout = 5) : 
-				ConnectorBase(io_c, ip, port, timeout) { }
+			explicit ConnectorTcp(io_context& io_c, const std::string& ip, short port, unsigned timeout = 5, \
+				const Codec& codec = Codec::Default()) : ConnectorBase(io_c, ip, port, timeout, codec) { }
 
-			virtual int Open(const std::string& ip, short port, bool keep_live = false) override {
+			virtual SessionId Open(const std::string& ip, short port, bool keep_live = false) override {
 				tcp::endpoint endpoint(address::from_string(ip_), port_);
 				tcp::socket socket(this->ioCtx_, endpoint);
 				this->OnTimer(socket);
@@ -35,13 +35,19 @@ namespace Net {
 					return -1;
 				}
 				else {
-					int id = SessionIdGen<int>::Instance()->GetId();
+					SessionId id = this->NewId();
+					if (id < 0) {
+						socket.close(ec);
+						StreamWriter::Instance()->Write(std::cout, "[Connector] Session ids are all in use, connection closed!");
+						return -1;
+					}
 					std::shared_ptr<SessionTcp> session = std::make_shared<SessionTcp>(id, this->ioCtx_, \
-						std::move(socket), this->memStorage_, this->timeout_, keep_live);
-					session->SetCallBackError([this](int session_id, uint8_t ec) {
+						std::move(socket), this->memStorage_, this->timeout_, keep_live, this->codec_);
+					session->SetCallBackError([this](SessionId session_id, uint8_t ec) {
 						StreamWriter::Instance()->Write(std::cout, "[Connector] err code=%d", (int)ec);
 						this->CloseSession(session_id);
 						});
+					this->InitSession(*session);
 					session->SetStatus(1);
 					tcp::socket::send_buffer_size sbs(1024 * 32);
 					tcp::socket::receive_buffer_size rbs(1024 * 32);
@@ -49,15 +55,14 @@ namespace Net {
 					session->SetOption(sbs, ec);
 					session->SetOption(rbs, ec);
 
-					StreamWriter::Instance()->Write(std::cout, "[Connector] Connect ok! session_id=%d", id);
+					StreamWriter::Instance()->Write(std::cout, "[Connector] Connect ok! session_id=%lld", (long long)id);
 
-					std::lock_guard<std::mutex> lock(this->mtx_);
-					this->umSessions_.emplace(id, session);
+					this->sessions_.Insert(id, session);
 					return id;
 				}
 			}
 			virtual void OpenA(const std::string& ip, short port, \
-				std::function<void(int, std::error_code)> func, bool keep_live = false) override {
+				std::function<void(SessionId, std::error_code)> func, bool keep_live = false) override {
 				this->bAsyncAc_ = true;
 				tcp::endpoint endpoint(address::from_string(ip_), port_);
 				tcp::socket socket(this->ioCtx_, endpoint);
@@ -68,18 +73,24 @@ namespace Net {
 							func(-1, ec);
 					}
 					else {
-						int id = SessionIdGen<int>::Instance()->GetId();
+						SessionId id = this->NewId();
+						if (id < 0) {
+							asio::error_code close_ec;
+							socket.close(close_ec);
+							StreamWriter::Instance()->Write(std::cout, "[Connector] Session ids are all in use, connection closed!");
+							if (func != nullptr)
+								func(-1, asio::error::no_descriptors);
+							return;
+						}
 						std::shared_ptr<SessionTcp> session = std::make_shared<SessionTcp>(id, this->ioCtx_, \
-							std::move(socket), this->memStorage_, this->timeout_, keep_live);
-						session->SetCallBackError([this](int session_id, uint8_t ec) {
+							std::move(socket), this->memStorage_, this->timeout_, keep_live, this->codec_);
+						session->SetCallBackError([this](SessionId session_id, uint8_t ec) {
 							StreamWriter::Instance()->Write(std::cout, "[Connector] err code=%d", (int)ec);
 							this->CloseSession(session_id);
 							});
+						this->InitSession(*session);
 
-						{
-							std::lock_guard<std::mutex> lock(this->mtx_);
-							this->umSessions_.emplace(id, session);
-						}
+						this->sessions_.Insert(id, session);
 						session->SetStatus(1);
 						tcp::socket::send_buffer_size sbs(1024 * 32);
 						tcp::socket::receive_buffer_size rbs(1024 * 32);
@@ -87,7 +98,7 @@ namespace Net {
 						session->SetOption(sbs, ec);
 						session->SetOption(rbs, ec);
 
-						StreamWriter::Instance()->Write(std::cout, "[Connector] Connect ok! session_id=%d", id);
+						StreamWriter::Instance()->Write(std::cout, "[Connector] Connect ok! session_id=%lld", (long long)id);
 
 						if (func != nullptr)
 							func(id, ec);
@@ -96,18 +107,18 @@ namespace Net {
 			}
 
 		protected:
-			virtual void ReConn(int session_id) override {
-				auto find = this->umSessions_.find(session_id);
-				if (find != this->umSessions_.end()) {
-					find->second->GetSocket().async_connect(find->second->GetNetPeer(), [this, session_id](const asio::error_code& ec) {
+			virtual void ReConn(SessionId session_id) override {
+				auto session = this->sessions_.Find(session_id);
+				if (session) {
+					session->GetSocket().async_connect(session->GetNetPeer(), [this, session_id](const asio::error_code& ec) {
 						if (ec) {
 							this->HandleConnErr(session_id, ec);
 						}
 						else {
-							auto find = this->umSessions_.find(session_id);
-							if (find != this->umSessions_.end()) {
-								find->second->SetStatus(1);
-								StreamWriter::Instance()->Write(std::cout, "[Connector] Reconnect ok!, session_id=%d", session_id);
+							auto session = this->sessions_.Find(session_id);
+							if (session) {
+								session->SetStatus(1);
+								StreamWriter::Instance()->Write(std::cout, "[Connector] Reconnect ok!, session_id=%lld", (long long)session_id);
 							}
 						}
 						});
@@ -19,18 +19,23 @@ namespace Net {
 
 			class ConnectorTcpSSL : public ConnectorBase, CaSSL {
 			public:
-				explicit ConnectorTcpSSL(io_context& io_c, const std::string& ip, short port, const std::string& ca, unsigned timeout = 5) : \
-					ConnectorBase(io_c, ip, port, timeout), CaSSL(ca) { }
+				explicit ConnectorTcpSSL(io_context& io_c, const std::string& ip, short port, const std::string& ca, unsigned timeout = 5, \
+					const Codec& codec = Codec::Default()) : ConnectorBase(io_c, ip, port, timeout, codec), CaSSL(ca) { }
 
-				virtual int Open(const std::string& ip, short port, bool keep_live = false) override {
-					int id = SessionIdGen<int>::Instance()->GetId();
+				virtual SessionId Open(const std::string& ip, short port, bool keep_live = false) override {
+					SessionId id = this->NewId();
+					if (id < 0) {
+						StreamWriter::Instance()->Write(std::cout, "[Connector ssl] Session ids are all in use!");
+						return -1;
+					}
 					tcp::endpoint endpoint(address::from_string(ip_), port_);
 					std::shared_ptr<SessionTcpSSL> session(new SessionTcpSSL(id, this->ioCtx_, \
-						tcp::socket(this->ioCtx_, endpoint), sslCtx_, this->memStorage_, this->timeout_, keep_live));
-					session->SetCallBackError([this](int session_id, uint8_t ec) {
+						tcp::socket(this->ioCtx_, endpoint), sslCtx_, this->memStorage_, this->timeout_, keep_live, this->codec_));
+					session->SetCallBackError([this](SessionId session_id, uint8_t ec) {
 						StreamWriter::Instance()->Write(std::cout, "[Connector ssl] err code=%d", (int)ec);
 						this->CloseSession(session_id);
 						});
+					this->InitSession(*session);
 					SetVerify(session->GetSocket());
 
 					this->OnTimer(session->GetSocket());
@@ -40,6 +45,7 @@ namespace Net {
 					this->OffTimer();
 
 					if (ec) {
+						this->ReleaseId(id);
 						return -1;
 					}
 					else {
@@ -51,56 +57,64 @@ namespace Net {
 							std::error_code ec;
 							session->SetOption(sbs, ec);
 							session->SetOption(rbs, ec);
-							StreamWriter::Instance()->Write(std::cout, "[Connector ssl] Connect ok! session_id=%d", id);
+							StreamWriter::Instance()->Write(std::cout, "[Connector ssl] Connect ok! session_id=%lld", (long long)id);
 
-							std::lock_guard<std::mutex> lock(this->mtx_);
-							this->umSessions_.emplace(id, session);
+							this->sessions_.Insert(id, session);
 							return id;
 						}
+						this->ReleaseId(id);
 						return -2;
 					}
 				}
 				virtual void OpenA(const std::string& ip, short port, \
-					std::function<void(int, std::error_code)> func, bool keep_live = false) override {
+					std::function<void(SessionId, std::error_code)> func, bool keep_live = false) override {
 					this->bAsyncAc_ = true;
 					tcp::endpoint endpoint(address::from_string(ip_), port_);
-					int id = SessionIdGen<int>::Instance()->GetId();
+					SessionId id = this->NewId();
+					if (id < 0) {
+						StreamWriter::Instance()->Write(std::cout, "[Connector ssl] Session ids are all in use!");
+						if (func != nullptr)
+							func(-1, asio::error::no_descriptors);
+						return;
+					}
 					std::shared_ptr<SessionTcpSSL> session(new SessionTcpSSL(id, this->ioCtx_, \
-						tcp::socket(this->ioCtx_, endpoint), sslCtx_, this->memStorage_, this->timeout_, keep_live));
-					session->SetCallBackError([this](int session_id, uint8_t ec) {
+						tcp::socket(this->ioCtx_, endpoint), sslCtx_, this->memStorage_, this->timeout_, keep_live, this->codec_));
+					session->SetCallBackError([this](SessionId session_id, uint8_t ec) {
 						StreamWriter::Instance()->Write(std::cout, "[Connector ssl] err code=%d", (int)ec);
 						this->CloseSession(session_id);
 						});
+					this->InitSession(*session);
 					SetVerify(session->GetSocket());
-					{
-						std::lock_guard<std::mutex> lock(this->mtx_);
-						this->umSessions_.emplace(id, session);
-					}
+					this->sessions_.Insert(id, session);
 
 					tcp::endpoint server_addr(tcp::endpoint(address::from_string(ip), port));
 					session->GetSocket().lowest_layer().async_connect(server_addr, [this, id, func](const asio::error_code& ec) {
-						if (ec) {
-							this->umSessions_.erase(id);
+						auto session = this->sessions_.Find(id);
+						if (ec || !session) {
+							if (this->sessions_.Remove(id))
+								this->ReleaseId(id);
 							if (func != nullptr)
 								func(-1, ec);
 						}
 						else {
-							dynamic_cast<SessionTcpSSL*>(this->umSessions_.at(id).get())->AsyncHandShake(ssl::stream_base::client, \
+							dynamic_cast<SessionTcpSSL*>(session.get())->AsyncHandShake(ssl::stream_base::client, \
 								[this, id, func](const std::error_code& err_code) {
-									if (!err_code) {
-										this->umSessions_.at(id)->SetStatus(1);
+									auto session = this->sessions_.Find(id);
+									if (!err_code && session) {
+										session->SetStatus(1);
 										tcp::socket::send_buffer_size sbs(1024 * 32);
 										tcp::socket::receive_buffer_size rbs(1024 * 32);
 										std::error_code ec;
-										this->umSessions_.at(id)->SetOption(sbs, ec);
-										this->umSessions_.at(id)->SetOption(rbs, ec);
+										session->SetOption(sbs, ec);
+										session->SetOption(rbs, ec);
 
-										StreamWriter::Instance()->Write(std::cout, "[Connector ssl] Connect ok! session_id=%d", id);
+										StreamWriter::Instance()->Write(std::cout, "[Connector ssl] Connect ok! session_id=%lld", (long long)id);
 										if (func != nullptr)
 											func(id, err_code);
 									}
 									else {
-										this->umSessions_.erase(id);
+										if (this->sessions_.Remove(id))
+											this->ReleaseId(id);
 										if (func != nullptr)
 											func(-2, err_code);
 									}
@@ -111,18 +125,18 @@ namespace Net {
 				}
 
 			protected:
-				virtual void ReConn(int session_id) override {
-					auto find = this->umSessions_.find(session_id);
-					if (find != this->umSessions_.end()) {
-						find->second->GetSocket().lowest_layer().async_connect(find->second->GetNetPeer(), [this, session_id](const asio::error_code& ec) {
+				virtual void ReConn(SessionId session_id) override {
+					auto session = this->sessions_.Find(session_id);
+					if (session) {
+						session->GetSocket().lowest_layer().async_connect(session->GetNetPeer(), [this, session_id](const asio::error_code& ec) {
 							if (ec) {
 								this->HandleConnErr(session_id, ec);
 							}
 							else {
-								auto find = this->umSessions_.find(session_id);
-								if (find != this->umSessions_.end()) {
-									find->second->SetStatus(1);
-									StreamWriter::Instance()->Write(std::cout, "[Connector ssl] Reconnect ok!, session_id=%d", session_id);
+								auto session = this->sessions_.Find(session_id);
+								if (session) {
+									session->SetStatus(1);
+									StreamWriter::Instance()->Write(std::cout, "[Connector ssl] Reconnect ok!, session_id=%lld", (long long)session_id);
 								}
 							}
 						});
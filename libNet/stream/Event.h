@@ -9,6 +9,8 @@
 #include <string>
 #include <functional>
 
+#include "../Comm.h"
+
 
 namespace Net {
     namespace Stream {
@@ -19,13 +21,15 @@ namespace Net {
                 e_connClosed,
                 e_connRecon,
                 e_netErr = 10,
-                e_netEof = 12
+                e_netEof = 12,
+                e_sendPaused = 15,  //the send queue is over its high watermark
+                e_sendResumed       //the send queue has drained to its low watermark
             };
 
             eEvent_t type{ eEvent_t::e_undef };
             std::string message;
         };
 
-        typedef std::function<void(int, const Event&)> CBEvent;
+        typedef std::function<void(SessionId, const Event&)> CBEvent;
     }
 }
\ No newline at end of file
@@ -6,6 +6,7 @@
 //[Date]:2020-08-10
 //[Other]:Copyright (c) 2020-2050 Nico Hu
 //========================================================================
+#include "../Comm.h"
 #include "RequestResponse.h"
 
 
@@ -16,7 +17,7 @@ namespace Net {
 		public:
 			explicit RequestHandler() { }
 			virtual ~RequestHandler() = default;
-			virtual void HandleRequest(int id, const Request& req, Response& rep) = 0;
+			virtual void HandleRequest(SessionId id, const Request& req, Response& rep) = 0;
 
 		protected:
 			RequestHandler(const RequestHandler&) = delete;
@@ -22,83 +22,96 @@ namespace Net {
 		class ServerTcp : public ServerBase {
 		public:
 			explicit ServerTcp(io_context& io_c, const std::string& ip, short port, \
-				unsigned timeout = 5) : ServerBase(io_c, ip, port, timeout) { }
+				unsigned timeout = 5, const Codec& codec = Codec::Default(), int backlog = asio::socket_base::max_listen_connections) : \
+				ServerBase(io_c, ip, port, timeout, codec, backlog) { }
 
 		protected:
 			virtual void Accept() override {
-				this->ServThdptr_ = std::make_shared<std::thread>([&] {
-					while (!this->bExit_) {
+				this->ServThdptr_ = std::make_shared<std::thread>([this] {
+					this->AcceptLoop([this](tcp::socket& socket, io_context& io_c) {
 						try
 						{
-							tcp::socket socket(this->ioCtx_);
-							asio::error_code err_code;
-							this->acceptor_.accept(socket, err_code);
-							if (!err_code) {
-								auto id = SessionIdGen<int>::Instance()->GetId();
-								std::shared_ptr<SessionTcp> session = std::make_shared<SessionTcp>(id, this->ioCtx_, \
-									std::move(socket), this->memStorage_, this->timeout_);
-								//auto ret = session->Open("", -1); //todo
-								session->SetCallBackError([this](int session_id, uint8_t ec) {
-									StreamWriter::Instance()->Write(std::cout, "[Server] err code=%d", (int)ec);
-									this->CloseSession(session_id);
-									});
-								session->SetStatus(1);
-								tcp::socket::send_buffer_size sbs(1024 * 32);
-								tcp::socket::receive_buffer_size rbs(1024 * 32);
-								std::error_code ec;
-								session->SetOption(sbs, ec);
-								session->SetOption(rbs, ec);
-
-								this->umSessions_.emplace(id, session);
-								StreamWriter::Instance()->Write(std::cout, "[Server] Current connect count:%d", this->umSessions_.size());
-								this->DoReceive(id);
-							}
-							else {
-								StreamWriter::Instance()->Write(std::cout, "[Server] Accept err message=%s", err_code.message().c_str());
-							}
+							SessionId id = this->AcceptId(socket);
+							if (id < 0)
+								return;
+							std::shared_ptr<SessionTcp> session = std::make_shared<SessionTcp>(id, io_c, \
+								std::move(socket), this->memStorage_, this->timeout_, false, this->codec_);
+							//auto ret = session->Open("", -1); //todo
+							session->SetCallBackError([this](SessionId session_id, uint8_t ec) {
+								StreamWriter::Instance()->Write(std::cout, "[Server] err code=%d", (int)ec);
+								this->CloseSession(session_id);
+								});
+							this->InitSession(*session);
+							session->SetStatus(1);
+							tcp::socket::send_buffer_size sbs(1024 * 32);
+							tcp::socket::receive_buffer_size rbs(1024 * 32);
+							std::error_code ec;
+							session->SetOption(sbs, ec);
+							session->SetOption(rbs, ec);
 
-							std::this_thread::sleep_for(std::chrono::milliseconds(5));
+							this->sessions_.Insert(id, session);
+							this->AttachReactor(*session);
+							NET_LOG(E_LOG_LEV_T::e_Debug, std::cout, "[Server] Current connect count:%zu", this->sessions_.Size());
+							this->DoReceive(id);
 						}
 						catch (const std::exception& e)
 						{
 							StreamWriter::Instance()->Write(std::cout, "[Server] Accept raise ex:%s", e.what());
-							throw e; break; //todo							
 						}
-					}
-				});
+						});
+					});
 			}
 			virtual void AsyncAccept() override {
-				this->acceptor_.async_accept([this](const asio::error_code& ec, tcp::socket socket) {
+				if (this->reuseAcceptors_.empty())
+					AsyncAccept(this->acceptor_, nullptr);
+				else {
+					for (size_t i = 0; i < this->reuseAcceptors_.size(); i++)
+						AsyncAccept(*this->reuseAcceptors_[i], &this->reactors_->Get(i));
+				}
+			}
+			//reactor: the io_context of the acceptor's sessions, nullptr to pick one for each session.
+			void AsyncAccept(tcp::acceptor& acceptor, io_context* reactor) {
+				io_context& io_c = reactor ? *reactor : this->NextReactor();
+				acceptor.async_accept(io_c, [this, &acceptor, reactor, &io_c](const asio::error_code& ec, tcp::socket socket) {
+					this->CountAccept(ec);
 					try
 					{
 						if (ec) {
 							StreamWriter::Instance()->Write(std::cout, "[Server] async_accept err=%s", ec.message().c_str());
-							this->HandleAcpErr(ec);
-							this->AsyncAccept();
+							this->OnAsyncAcpErr(acceptor, ec, [this, &acceptor, reactor] { this->AsyncAccept(acceptor, reactor); });
 							return;
 						}
 						else {
-							int id = SessionIdGen<int>::Instance()->GetId();
+							SessionId id = this->AcceptId(socket);
+							if (id < 0) {
+								this->AsyncAccept(acceptor, reactor);
+								return;
+							}
 							std::shared_ptr<SessionTcp> session = \
-								std::make_shared<SessionTcp>(id, this->ioCtx_, \
-									std::move(socket), this->memStorage_, this->timeout_);
+								std::make_shared<SessionTcp>(id, io_c, \
+									std::move(socket), this->memStorage_, this->timeout_, false, this->codec_);
 							//auto ret = session->Open("", -1);//todo
 							session->SetStatus(1);
-							auto self = std::dynamic_pointer_cast<ServerTcp>(NetBase::shared_from_this());
-							session->SetCallBackError([this, self](int session_id, uint8_t ec) {
+							session->SetCallBackError([this](SessionId session_id, uint8_t ec) {
 								StreamWriter::Instance()->Write(std::cout, "[Server] err code=%d", (int)ec);
 								this->CloseSession(session_id);
 								});
+							this->InitSession(*session);
 							tcp::socket::send_buffer_size sbs(1024 * 32);
 							tcp::socket::receive_buffer_size rbs(1024 * 32);
 							std::error_code ec;
 							session->SetOption(sbs, ec);
 							session->SetOption(rbs, ec);
 
-							this->umSessions_.emplace(id, session);
-							StreamWriter::Instance()->Write(std::cout, "[Server] Current connect count:%d", this->umSessions_.size());
-							this->DoAsyncReceive(id);
-							this->AsyncAccept();
+							this->sessions_.Insert(id, session);
+							this->AttachReactor(*session);
+							NET_LOG(E_LOG_LEV_T::e_Debug, std::cout, "[Server] Current connect count:%zu", this->sessions_.Size());
+							//the reads start on the session's reactor.
+							if (&io_c != &this->ioCtx_)
+								asio::post(io_c, [this, id] { this->DoAsyncReceive(id); });
+							else
+								this->DoAsyncReceive(id);
+							this->AsyncAccept(acceptor, reactor);
 						}
 					}
 					catch (const std::exception& e)
@@ -192,10 +205,10 @@ namespace Net {
 						}
 						else {
 							static int num = 0;
-							auto thd_id = std::this_thread::get_id();
 							auto endpoint = session_->GetNetPeer();
-							StreamWriter::Instance()->Write(std::cout, "[Server] thead id=%d, peer ip=%s, port=%dpacket count=%d, Packet:%s", \
-								thd_id, endpoint.address().to_string().c_str(), endpoint.port(), num++, data);
+							NET_LOG(E_LOG_LEV_T::e_Debug, std::cout, "[Server] thead id=%zu, peer ip=%s, port=%dpacket count=%d, Packet:%s", \
+								std::hash<std::thread::id>()(std::this_thread::get_id()), endpoint.address().to_string(), endpoint.port(), num++, \
+								std::string_view(data, size));
 
 							if (this->cbReceive_)
 								this->cbReceive_(endpoint.address().to_string(), endpoint.port(), data, size, err_code);
@@ -207,11 +220,10 @@ namespace Net {
 				auto self = shared_from_this();
 				session_->AsyncRecieve([self](const udp::endpoint& endpoint, Packet* packet, uint8_t ec) {
 					static int num = 0;
-					auto thd_id = std::this_thread::get_id();
 					if (!ec) {
-						std::string str_packet = std::string(packet->body(), packet->bodyLen());
-						StreamWriter::Instance()->Write(std::cout, "[Server] thead id=%d, peer ip=%s, port=%dpacket count=%d, Packet:%s", \
-							thd_id, endpoint.address().to_string().c_str(), endpoint.port(), num++, str_packet.c_str());
+						NET_LOG(E_LOG_LEV_T::e_Debug, std::cout, "[Server] thead id=%zu, peer ip=%s, port=%dpacket count=%d, Packet:%s", \
+							std::hash<std::thread::id>()(std::this_thread::get_id()), endpoint.address().to_string(), endpoint.port(), num++, \
+							std::string_view(packet->body(), packet->bodyLen()));
 
 						if (self->cbReceive_)
 							self->cbReceive_(endpoint.address().to_string(), endpoint.port(), packet->body(), packet->bodyLen(), ec);
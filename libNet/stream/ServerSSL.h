@@ -57,72 +57,80 @@ namespace Net {
 			class ServerTcpSSL : public ServerBase, SaSSL{
 			public:
 				explicit ServerTcpSSL(io_context& io_c, const std::string& ip, short port, \
-					const SaSSLInfo_t& sa_info, unsigned timeout = 5) :
-					ServerBase(io_c, ip, port, timeout), SaSSL(sa_info) { }
+					const SaSSLInfo_t& sa_info, unsigned timeout = 5, const Codec& codec = Codec::Default(), \
+					int backlog = asio::socket_base::max_listen_connections) : ServerBase(io_c, ip, port, timeout, codec, backlog), SaSSL(sa_info) { }
 
 			protected:				
 				virtual void Accept() override {
-					this->ServThdptr_ = std::make_shared<std::thread>([&] {
-						while (!this->bExit_) {
+					this->ServThdptr_ = std::make_shared<std::thread>([this] {
+						this->AcceptLoop([this](tcp::socket& socket, io_context& io_c) {
 							try
 							{
-								tcp::socket socket(this->ioCtx_);
-								asio::error_code err_code;
-								this->acceptor_.accept(socket, err_code);
-								if (!err_code) {
-									auto id = SessionIdGen<int>::Instance()->GetId();
-									std::shared_ptr<SessionTcpSSL> session = std::make_shared<SessionTcpSSL>(id, this->ioCtx_, \
-										std::move(socket), this->sslCtx_, this->memStorage_, this->timeout_);
-									//auto ret = session->Open("", -1); //todo
-									session->SetCallBackError([this](int session_id, uint8_t ec) {
-										StreamWriter::Instance()->Write(std::cout, "[Server ssl] err code=%d", (int)ec);
-										this->CloseSession(session_id);
-										});
-									session->SetStatus(1);
-									tcp::socket::send_buffer_size sbs(1024 * 32);
-									tcp::socket::receive_buffer_size rbs(1024 * 32);
-									std::error_code ec;
-									session->SetOption(sbs, ec);
-									session->SetOption(rbs, ec);
+								SessionId id = this->AcceptId(socket);
+								if (id < 0)
+									return;
+								std::shared_ptr<SessionTcpSSL> session = std::make_shared<SessionTcpSSL>(id, io_c, \
+									std::move(socket), this->sslCtx_, this->memStorage_, this->timeout_, false, this->codec_);
+								//auto ret = session->Open("", -1); //todo
+								session->SetCallBackError([this](SessionId session_id, uint8_t ec) {
+									StreamWriter::Instance()->Write(std::cout, "[Server ssl] err code=%d", (int)ec);
+									this->CloseSession(session_id);
+									});
+								this->InitSession(*session);
+								session->SetStatus(1);
+								tcp::socket::send_buffer_size sbs(1024 * 32);
+								tcp::socket::receive_buffer_size rbs(1024 * 32);
+								std::error_code ec;
+								session->SetOption(sbs, ec);
+								session->SetOption(rbs, ec);
 
-									std::error_code err_code;
-									session->HandShake(ssl::stream_base::server, err_code);
-									if (!err_code) {
-										this->umSessions_.emplace(id, session);
-										StreamWriter::Instance()->Write(std::cout, "[Server ssl] Current connect count:%d", this->umSessions_.size());
-										this->DoReceive(id);
-									}
-								}
-								else {
-									StreamWriter::Instance()->Write(std::cout, "[Server ssl] Accept err message=%s", err_code.message().c_str());
+								std::error_code err_code;
+								session->HandShake(ssl::stream_base::server, err_code);
+								if (!err_code) {
+									this->sessions_.Insert(id, session);
+									this->AttachReactor(*session);
+									NET_LOG(E_LOG_LEV_T::e_Debug, std::cout, "[Server ssl] Current connect count:%zu", this->sessions_.Size());
+									this->DoReceive(id);
 								}
-
-								std::this_thread::sleep_for(std::chrono::milliseconds(5));
+								else
+									this->ReleaseId(id);
 							}
 							catch (const std::exception& e)
 							{
 								StreamWriter::Instance()->Write(std::cout, "[Server ssl] Accept raise ex:%s", e.what());
-								throw e;//todo
-								break;
 							}
-						}
+							});
 						});
 				}
 				virtual void AsyncAccept() override {
-					this->acceptor_.async_accept([this](const asio::error_code& ec, tcp::socket socket) {
+					if (this->reuseAcceptors_.empty())
+						AsyncAccept(this->acceptor_, nullptr);
+					else {
+						for (size_t i = 0; i < this->reuseAcceptors_.size(); i++)
+							AsyncAccept(*this->reuseAcceptors_[i], &this->reactors_->Get(i));
+					}
+				}
+				//reactor: the io_context of the acceptor's sessions, nullptr to pick one for each session.
+				void AsyncAccept(tcp::acceptor& acceptor, io_context* reactor) {
+					io_context& io_c = reactor ? *reactor : this->NextReactor();
+					acceptor.async_accept(io_c, [this, &acceptor, reactor, &io_c](const asio::error_code& ec, tcp::socket socket) {
+						this->CountAccept(ec);
 						try
 						{
 							if (ec) {
 								StreamWriter::Instance()->Write(std::cout, "[Server ssl] async_accept err=%s", ec.message().c_str());
-								this->HandleAcpErr(ec);
-								this->AsyncAccept();
+								this->OnAsyncAcpErr(acceptor, ec, [this, &acceptor, reactor] { this->AsyncAccept(acceptor, reactor); });
 								return;
 							}
 							else {
-								int id = SessionIdGen<int>::Instance()->GetId();
+								SessionId id = this->AcceptId(socket);
+								if (id < 0) {
+									this->AsyncAccept(acceptor, reactor);
+									return;
+								}
 								std::shared_ptr<SessionTcpSSL> session = \
-									std::make_shared<SessionTcpSSL>(id, this->ioCtx_, \
-										std::move(socket), sslCtx_, this->memStorage_, this->timeout_);
+									std::make_shared<SessionTcpSSL>(id, io_c, \
+										std::move(socket), sslCtx_, this->memStorage_, this->timeout_, false, this->codec_);
 								//auto ret = session->Open("", -1);//todo
 								session->SetStatus(1);
 								tcp::socket::send_buffer_size sbs(1024 * 32);
@@ -131,21 +139,25 @@ namespace Net {
 								session->SetOption(sbs, ec);
 								session->SetOption(rbs, ec);
 
-								session->SetCallBackError([this](int session_id, uint8_t ec) {
+								session->SetCallBackError([this](SessionId session_id, uint8_t ec) {
 									StreamWriter::Instance()->Write(std::cout, "[Server ssl] err code=%d", (int)ec);
 									this->CloseSession(session_id);
 									});
-
+								this->InitSession(*session);
+								//the handshake completes on the session's reactor, the reads start there.
 								session->AsyncHandShake(ssl::stream_base::server, [this, id, session](const std::error_code& err_code) {
 									if (!err_code) {
-										this->umSessions_.emplace(id, session);
-										StreamWriter::Instance()->Write(std::cout, "[Server ssl] Current connect count:%d", this->umSessions_.size());
+										this->sessions_.Insert(id, session);
+										this->AttachReactor(*session);
+										NET_LOG(E_LOG_LEV_T::e_Debug, std::cout, "[Server ssl] Current connect count:%zu", this->sessions_.Size());
 										this->DoAsyncReceive(id);
 									}
-									else
+									else {
 										StreamWriter::Instance()->Write(std::cout, "[Server ssl] handshake err=%s", err_code.message().c_str());
+										this->ReleaseId(id);
+									}
 									});
-								this->AsyncAccept();
+								this->AsyncAccept(acceptor, reactor);
 							}
 						}
 						catch (const std::exception& e)
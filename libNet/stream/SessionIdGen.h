@@ -1,69 +1,137 @@
 #pragma once
 //========================================================================
 //[File Name]:SessionIdGen.h
-//[Description]: a session id generator.
+//[Description]: the session slot allocator of a server/connector. a slot
+//  is taken from the thread's cache, which is refilled from(and flushed
+//  to) a free-index stack in batches under one lock, the slots never used
+//  are bumped from a counter, so nothing is preallocated and the lock is
+//  taken once every e_Batch accepts/closes of a thread.
+//  the session table tags a slot with its generation to make the id.
 //[Author]:Nico Hu
 //[Date]:2020-08-10
 //[Other]:Copyright (c) 2020-2050 Nico Hu
 //========================================================================
+#include <atomic>
+#include <memory>
 #include <mutex>
-#include <list>
-#include <numeric>
+#include <vector>
 #include "../Comm.h"
 
 
 namespace Net {
 	namespace Stream {
-		template<typename T>
 		class SessionIdGen {
-			friend class Gargo;
-		public:
-			static SessionIdGen* Instance() {
-				if (sInstance_ == nullptr) {
-					sInstance_ = new SessionIdGen<T>(MaxConnNum);
+			enum { e_CacheSize = 64, e_Batch = 32, e_Ways = 4 };
+
+			struct Core {
+				std::mutex mtx_;
+				std::vector<uint32_t> freeSlots_;
+				uint32_t next_{ 1 };		//the next slot never used
+				uint32_t capacity_{ 0 };
+				uint64_t serial_{ 0 };		//tells the caches of a dead generator from those of a new one at its address
+				std::atomic<size_t> used_{ 0 };
+			};
+			//the slots a thread holds for one generator.
+			struct Cache {
+				Core* core_{ nullptr };
+				uint64_t serial_{ 0 };
+				std::weak_ptr<Core> owner_;
+				uint32_t n_{ 0 };
+				uint32_t slots_[e_CacheSize];
+			};
+			//a thread gives its cached slots back on exit, if their generators are alive.
+			struct ThreadCaches {
+				Cache caches_[e_Ways];
+				size_t victim_{ 0 };
+				~ThreadCaches() {
+					for (auto& var : caches_)
+						Evict(var);
 				}
-				return sInstance_;
+			};
+
+		public:
+			//slots 1..capacity.
+			explicit SessionIdGen(uint32_t capacity = MaxSessionNum) : core_(std::make_shared<Core>()) {
+				static std::atomic<uint64_t> serial{ 0 };
+				core_->capacity_ = capacity;
+				core_->serial_ = ++serial;
 			}
-			~SessionIdGen() {}
+			~SessionIdGen() = default;
+			SessionIdGen(const SessionIdGen&) = delete;
+			SessionIdGen& operator=(const SessionIdGen&) = delete;
 
-			T GetId() {
-				std::lock_guard<std::mutex> lock(mtx_);
-				T id = idPool_.front();
-				idPool_.pop_front();
-				return id;
+			//a free slot, 0 if they are all in use(or cached by the other threads).
+			uint32_t GetId() {
+				Cache& cache = LocalCache();
+				if (cache.n_ == 0 && Refill(cache) == 0)
+					return 0;
+				core_->used_.fetch_add(1, std::memory_order_relaxed);
+				return cache.slots_[--cache.n_];
 			}
-			void ReleaseId(const T& id) {
-				std::lock_guard<std::mutex> lock(mtx_);
-				idPool_.emplace_back(id);
+			void ReleaseId(uint32_t slot) {
+				if (slot == 0 || slot > core_->capacity_)
+					return;
+				Cache& cache = LocalCache();
+				if (cache.n_ == e_CacheSize)
+					Flush(*core_, cache, e_Batch);
+				cache.slots_[cache.n_++] = slot;
+				core_->used_.fetch_sub(1, std::memory_order_relaxed);
 			}
+			uint32_t Capacity() const { return core_->capacity_; }
+			size_t Used() const { return core_->used_.load(std::memory_order_relaxed); }
 
 		protected:
-			SessionIdGen(const T& max_num) : idPool_(max_num) {
-				static Gargo gargo;
-				idPool_.resize(max_num);
-				std::iota(idPool_.begin(), idPool_.end(), 1);
+			Cache& LocalCache() {
+				thread_local ThreadCaches caches;
+				for (auto& var : caches.caches_) {
+					if (var.core_ == core_.get() && var.serial_ == core_->serial_)
+						return var;
+				}
+				Cache* cache{ nullptr };
+				for (auto& var : caches.caches_) {
+					if (!var.core_) {
+						cache = &var;
+						break;
+					}
+				}
+				if (!cache) {
+					cache = &caches.caches_[caches.victim_++ % e_Ways];
+					Evict(*cache);
+				}
+				cache->core_ = core_.get();
+				cache->serial_ = core_->serial_;
+				cache->owner_ = core_;
+				return *cache;
+			}
+			uint32_t Refill(Cache& cache) {
+				std::lock_guard<std::mutex> lock(core_->mtx_);
+				auto& free_slots = core_->freeSlots_;
+				while (cache.n_ < e_Batch && !free_slots.empty()) {
+					cache.slots_[cache.n_++] = free_slots.back();
+					free_slots.pop_back();
+				}
+				while (cache.n_ < e_Batch && core_->next_ <= core_->capacity_)
+					cache.slots_[cache.n_++] = core_->next_++;
+				return cache.n_;
+			}
+			static void Flush(Core& core, Cache& cache, uint32_t n) {
+				std::lock_guard<std::mutex> lock(core.mtx_);
+				while (n-- > 0 && cache.n_ > 0)
+					core.freeSlots_.emplace_back(cache.slots_[--cache.n_]);
+			}
+			static void Evict(Cache& cache) {
+				if (auto core = cache.owner_.lock()) {
+					if (core->serial_ == cache.serial_)
+						Flush(*core, cache, cache.n_);
+				}
+				cache.core_ = nullptr;
+				cache.serial_ = 0;
+				cache.owner_.reset();
+				cache.n_ = 0;
 			}
-			SessionIdGen(const SessionIdGen&) = delete;
-			SessionIdGen& operator=(const SessionIdGen&) = delete;
-			SessionIdGen(SessionIdGen&&) noexcept = delete;
-			SessionIdGen& operator=(SessionIdGen&&) noexcept = delete;
 
 		protected:
-			static SessionIdGen* sInstance_;
-			std::mutex mtx_;
-			std::list<T> idPool_;
-
-			class Gargo {
-			public:
-				~Gargo() {
-					if (sInstance_ != nullptr) {
-						delete sInstance_;
-						sInstance_ = nullptr;
-					}
-				}
-			};
+			std::shared_ptr<Core> core_;
 		};
-		template<typename T>
-		SessionIdGen<T>* SessionIdGen<T>::sInstance_ = nullptr;
 	}
-}
\ No newline at end of file
+}
@@ -0,0 +1,180 @@
+#pragma once
+//========================================================================
+//[File Name]:SessionTable.h
+//[Description]: the session table of a server/connector, a slot array
+//  indexed by the session id. an id carries the slot in its low 32 bits
+//  and the generation of the slot above, so the id of a closed session is
+//  rejected even after its slot is reused.
+//  a slot has one tag word(generation | readers | live): a lookup pins the
+//  slot with a CAS on the tag, copies the session and unpins it, no lock
+//  and no hash probe. a remove clears the live bit and bumps the generation
+//  in one CAS, then waits for the pinned copies in flight, which take a few
+//  instructions. the slots are allocated in pages on first use.
+//[Author]:Nico Hu
+//[Date]:2020-08-10
+//[Other]:Copyright (c) 2020-2050 Nico Hu
+//========================================================================
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "../Comm.h"
+
+namespace Net {
+	namespace Stream {
+		template<typename T>
+		class SessionTable {
+		public:
+			static constexpr int e_SlotBits = 32;
+			static constexpr SessionId e_SlotMask = 0xFFFFFFFF;
+			static constexpr SessionId e_GenMask = 0x7FFFFFFF;	//an id is positive
+			using Ptr = std::shared_ptr<T>;
+
+		protected:
+			enum { e_PageBits = 10, e_PageSize = 1 << e_PageBits, e_PageMask = e_PageSize - 1 };
+			static constexpr uint64_t e_Live = 1;
+			static constexpr uint64_t e_Reader = 2;
+			static constexpr uint64_t e_ReaderMask = 0xFFFFFFFE;
+			static constexpr int e_GenShift = 32;
+
+			struct Slot {
+				std::atomic<uint64_t> tag{ 0 };
+				Ptr session{ nullptr };
+			};
+
+		public:
+			//slots: the max slot + 1, the slots of SessionIdGen are 1..capacity.
+			explicit SessionTable(size_t slots = MaxSessionNum + 1) : pageNum_((slots + e_PageSize - 1) >> e_PageBits), \
+				pages_(new std::atomic<Slot*>[pageNum_]) {
+				for (size_t i = 0; i < pageNum_; i++)
+					pages_[i].store(nullptr, std::memory_order_relaxed);
+			}
+			~SessionTable() {
+				for (size_t i = 0; i < pageNum_; i++)
+					delete[] pages_[i].load(std::memory_order_relaxed);
+			}
+			SessionTable(const SessionTable&) = delete;
+			SessionTable& operator=(const SessionTable&) = delete;
+
+			static uint32_t SlotOf(SessionId id) { return static_cast<uint32_t>(id & e_SlotMask); }
+			//the id for the next session of slot, -1 if the slot is out of range.
+			SessionId MakeId(uint32_t slot) {
+				Slot* s = GetSlot(slot, true);
+				if (!s)
+					return -1;
+				return MakeId(slot, s->tag.load(std::memory_order_acquire));
+			}
+			//the slot is owned by the caller(got from the id generator), return false if id is stale or the slot is taken.
+			bool Insert(SessionId id, Ptr session) {
+				Slot* s = GetSlot(SlotOf(id), true);
+				if (!s || !session)
+					return false;
+				const uint64_t tag = s->tag.load(std::memory_order_acquire);
+				if ((tag & e_Live) || GenOf(tag) != GenOfId(id))
+					return false;
+				s->session = std::move(session);
+				s->tag.store(tag | e_Live, std::memory_order_release);
+				count_.fetch_add(1, std::memory_order_relaxed);
+				return true;
+			}
+			//lock free, nullptr if the session is closed or the id is stale.
+			Ptr Find(SessionId id) const {
+				const Slot* s = GetSlot(SlotOf(id));
+				if (!s)
+					return nullptr;
+				return Pin(const_cast<Slot&>(*s), GenOfId(id));
+			}
+			//the removed session, nullptr if it is removed already. the generation is bumped, so the id is stale from now on.
+			Ptr Remove(SessionId id) {
+				Slot* s = GetSlot(SlotOf(id));
+				if (!s)
+					return nullptr;
+				uint64_t tag = s->tag.load(std::memory_order_acquire);
+				while (true) {
+					if (!(tag & e_Live) || GenOf(tag) != GenOfId(id))
+						return nullptr;
+					const uint64_t next = (((tag >> e_GenShift) + 1) << e_GenShift) | (tag & e_ReaderMask);
+					if (s->tag.compare_exchange_weak(tag, next, std::memory_order_acq_rel))
+						break;
+				}
+				//the pinned readers are copying the session.
+				while (s->tag.load(std::memory_order_acquire) & e_ReaderMask)
+					std::this_thread::yield();
+				Ptr session = std::move(s->session);
+				s->session = nullptr;
+				count_.fetch_sub(1, std::memory_order_relaxed);
+				return session;
+			}
+			size_t Size() const { return count_.load(std::memory_order_relaxed); }
+			bool Empty() const { return Size() == 0; }
+			//call f(id, session) for the sessions in the table, they may be removed meanwhile.
+			template<typename F>
+			void ForEach(F f) const {
+				for (size_t page = 0; page < pageNum_; page++) {
+					Slot* slots = pages_[page].load(std::memory_order_acquire);
+					if (!slots)
+						continue;
+					for (size_t i = 0; i < e_PageSize; i++) {
+						const uint64_t tag = slots[i].tag.load(std::memory_order_acquire);
+						if (!(tag & e_Live))
+							continue;
+						const uint32_t slot = static_cast<uint32_t>((page << e_PageBits) | i);
+						Ptr session = Pin(slots[i], GenOf(tag));
+						if (session)
+							f(MakeId(slot, tag), session);
+					}
+				}
+			}
+			//remove all and return them(with their ids), for closing them.
+			std::vector<std::pair<SessionId, Ptr>> RemoveAll() {
+				std::vector<std::pair<SessionId, Ptr>> sessions;
+				std::vector<SessionId> ids;
+				ForEach([&ids](SessionId id, const Ptr&) { ids.emplace_back(id); });
+				for (auto id : ids) {
+					Ptr session = Remove(id);
+					if (session)
+						sessions.emplace_back(id, std::move(session));
+				}
+				return sessions;
+			}
+
+		protected:
+			static SessionId GenOf(uint64_t tag) { return static_cast<SessionId>(tag >> e_GenShift) & e_GenMask; }
+			static SessionId GenOfId(SessionId id) { return (id >> e_SlotBits) & e_GenMask; }
+			static SessionId MakeId(uint32_t slot, uint64_t tag) { return (GenOf(tag) << e_SlotBits) | slot; }
+
+			Slot* GetSlot(uint32_t slot, bool b_alloc = false) const {
+				const size_t page = static_cast<size_t>(slot) >> e_PageBits;
+				if (page >= pageNum_)
+					return nullptr;
+				Slot* slots = pages_[page].load(std::memory_order_acquire);
+				if (!slots && b_alloc) {
+					Slot* fresh = new Slot[e_PageSize];
+					if (pages_[page].compare_exchange_strong(slots, fresh, std::memory_order_acq_rel))
+						slots = fresh;
+					else
+						delete[] fresh;
+				}
+				return slots ? &slots[slot & e_PageMask] : nullptr;
+			}
+			static Ptr Pin(Slot& s, SessionId gen) {
+				uint64_t tag = s.tag.load(std::memory_order_acquire);
+				while (true) {
+					if (!(tag & e_Live) || GenOf(tag) != gen)
+						return nullptr;
+					if (s.tag.compare_exchange_weak(tag, tag + e_Reader, std::memory_order_acquire))
+						break;
+				}
+				Ptr session = s.session;
+				s.tag.fetch_sub(e_Reader, std::memory_order_release);
+				return session;
+			}
+
+		protected:
+			const size_t pageNum_;
+			std::unique_ptr<std::atomic<Slot*>[]> pages_;
+			std::atomic<size_t> count_{ 0 };
+		};
+	}
+}
@@ -12,51 +12,67 @@
 #include <iostream>
 #include <thread>
 #include <atomic>
+#include <chrono>
+#ifdef __linux__
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
 
 #include "../core/SessionBase.h"
+#include "../core/IoContextPool.h"
 #include "Event.h"
 #include "SessionIdGen.h"
+#include "SessionTable.h"
 
 
 namespace Net {
 	using namespace Core;
 
 	namespace Stream {
+		//the traffic of a server/connector: the counters of the open sessions and of the closed ones summed up.
+		struct NetStats {
+			SessionStats total;
+			size_t sessions{ 0 };	//open
+			uint64_t closed{ 0 };
+		};
+
 		template<typename SocketType>
 		class NetBase : public std::enable_shared_from_this<NetBase<SocketType>> {
 		public:
-			explicit NetBase(io_context& io_c, unsigned timeout) :ioCtx_(io_c), \
-				memStorage_({ 32, 64, 256, 512, 1024 }), timer_(io_c), timeout_(timeout) { }
+			explicit NetBase(io_context& io_c, unsigned timeout, const Codec& codec = Codec::Default()) :ioCtx_(io_c), \
+				memStorage_({ 32, 64, 256, 512, 1024 }), timer_(io_c), timeout_(timeout), codec_(codec) { }
 			virtual ~NetBase() = default;
 
-			int Close(int session_id) {
+			int Close(SessionId session_id) {
 				this->CloseSession(session_id);
-				StreamWriter::Instance()->Write(std::cout, "[NetBase] disconnect ok! session_id=%d", session_id);
+				NET_LOG(E_LOG_LEV_T::e_Debug, std::cout, "[NetBase] disconnect ok! session_id=%lld", (long long)session_id);
 				return 0;
 			}
-			int IsConnected(int session_id) const {
-				auto find = this->umSessions_.find(session_id);
-				if (find != this->umSessions_.end())
-					return find->second->GetStatus();
+			int IsConnected(SessionId session_id) const {
+				auto session = this->sessions_.Find(session_id);
+				if (session)
+					return session->GetStatus();
 				return -1;
 			}
-			int Send(int session_id, const char* data, unsigned len, uint8_t& err_code) {
-				auto find = this->umSessions_.find(session_id);
-				if (find != this->umSessions_.end()) {
-					if (!find->second->GetStatus())
+			int Send(SessionId session_id, const char* data, unsigned len, uint8_t& err_code) {
+				//the session is held during the call, its error callback may close it.
+				auto session = this->sessions_.Find(session_id);
+				if (session) {
+					if (!session->GetStatus())
 						return -1;
 					else
-						return find->second->Send(data, len, err_code);
+						return session->Send(data, len, err_code);
 				}
 				return -2;
 			}
-			int AsyncSend(int session_id, const char* data, unsigned len, CBAsyncSend callback = nullptr) {
-				auto find = this->umSessions_.find(session_id);
-				if (find != this->umSessions_.end()) {
-					if (!find->second->GetStatus())
+			int AsyncSend(SessionId session_id, const char* data, unsigned len, CBAsyncSend callback = nullptr) {
+				auto session = this->sessions_.Find(session_id);
+				if (session) {
+					if (!session->GetStatus())
 						return -1;
 					else {
-						return find->second->AsyncSend(data, len, [this, session_id, callback](size_t byte_send, uint8_t ec) {
+						return session->AsyncSend(data, len, [this, session_id, callback](size_t byte_send, uint8_t ec) {
 							if (callback)
 								callback(session_id, byte_send, ec);
 							});
@@ -64,23 +80,87 @@ namespace Net {
 				}
 				return -2;
 			}
-			int Recieve(int session_id, char** data, uint8_t& err_code) {
-				auto find = this->umSessions_.find(session_id);
-				if (find != this->umSessions_.end()) {
-					if (!find->second->GetStatus())
+			//data encoded once by the codec of the sessions, to be sent to many of them without a copy each.
+			//it must be gone before this server/connector(its block is of memStorage_), empty if it can't be made.
+			SharedBuffer MakeShared(const char* data, unsigned len, uint8_t& err_code) {
+				return SharedBuffer::Make(memStorage_, codec_, data, len, err_code);
+			}
+			//queue a shared buffer, see SessionBase::AsyncSendShared.
+			int AsyncSend(SessionId session_id, const SharedBuffer& buffer, CBAsyncSend callback = nullptr) {
+				auto session = this->sessions_.Find(session_id);
+				if (!session)
+					return -2;
+				if (!session->GetStatus())
+					return -1;
+				if (!callback)
+					return session->AsyncSendShared(buffer);
+				return session->AsyncSendShared(buffer, [session_id, callback](size_t byte_send, uint8_t ec) {
+					callback(session_id, byte_send, ec);
+					});
+			}
+			//queue a shared buffer on the sessions of session_ids, return the number of sessions it is queued on
+			//(a send which returns 1, over the high watermark, is queued). the ones not found or refused are skipped.
+			size_t Broadcast(const std::vector<SessionId>& session_ids, const SharedBuffer& buffer, CBAsyncSend callback = nullptr) {
+				size_t queued{ 0 };
+				for (auto var : session_ids) {
+					if (AsyncSend(var, buffer, callback) >= 0)
+						queued++;
+				}
+				return queued;
+			}
+			//on all the open sessions.
+			size_t Broadcast(const SharedBuffer& buffer, CBAsyncSend callback = nullptr) {
+				size_t queued{ 0 };
+				sessions_.ForEach([&](SessionId session_id, const std::shared_ptr<SessionBase<SocketType>>& session) {
+					if (!session->GetStatus())
+						return;
+					int ret{ 0 };
+					if (!callback)
+						ret = session->AsyncSendShared(buffer);
+					else {
+						ret = session->AsyncSendShared(buffer, [session_id, callback](size_t byte_send, uint8_t ec) {
+							callback(session_id, byte_send, ec);
+							});
+					}
+					if (ret >= 0)
+						queued++;
+					});
+				return queued;
+			}
+			//zero-copy send, see SessionBase::AsyncSendView.
+			int AsyncSendView(SessionId session_id, const std::vector<asio::const_buffer>& buffers, CBAsyncSend callback = nullptr, \
+				CBRelease release = nullptr) {
+				auto session = this->sessions_.Find(session_id);
+				if (session) {
+					if (!session->GetStatus())
+						return -1;
+					else {
+						return session->AsyncSendView(buffers, [session_id, callback](size_t byte_send, uint8_t ec) {
+							if (callback)
+								callback(session_id, byte_send, ec);
+							}, release);
+					}
+				}
+				return -2;
+			}
+			int Recieve(SessionId session_id, char** data, uint8_t& err_code) {
+				//the session is held during the call, its error callback may close it.
+				auto session = this->sessions_.Find(session_id);
+				if (session) {
+					if (!session->GetStatus())
 						return -1;
 					else
-						return find->second->Recieve(data, err_code);
+						return session->Recieve(data, err_code);
 				}
 				return -2;
 			}
-			int AsyncRecieve(int session_id, CBAsyncRecv callback = nullptr) {
-				auto find = this->umSessions_.find(session_id);
-				if (find != this->umSessions_.end()) {
-					if (!find->second->GetStatus())
+			int AsyncRecieve(SessionId session_id, CBAsyncRecv callback = nullptr) {
+				auto session = this->sessions_.Find(session_id);
+				if (session) {
+					if (!session->GetStatus())
 						return -1;
 					else
-						return find->second->AsyncRecieve([this, callback, session_id](Packet* packet, uint8_t ec) {
+						return session->AsyncRecieve([this, callback, session_id](Packet* packet, uint8_t ec) {
 							if (packet == nullptr) {
 								StreamWriter::Instance()->Write(std::cout, "[NetBase] Async recieve err, code=%d", (int)ec);
 								if (callback)
@@ -99,17 +179,72 @@ namespace Net {
 			void SetEventCB(F f) {
 				cbEvent_ = f;
 			}
+			//the counters of an open session, false if it is not found.
+			bool GetSessionStats(SessionId session_id, SessionStats& stats) const {
+				auto session = this->sessions_.Find(session_id);
+				if (!session)
+					return false;
+				stats = session->Snapshot();
+				return true;
+			}
+			//the bytes waiting in the send queue of an open session, false if it is not found.
+			bool GetSendQueueBytes(SessionId session_id, size_t& bytes) const {
+				auto session = this->sessions_.Find(session_id);
+				if (!session)
+					return false;
+				bytes = session->GetSendQueueBytes();
+				return true;
+			}
+			//the counters are read without stopping the io, so the sum is approximate while sessions close(one
+			//closing meanwhile may be missed or counted twice). per_session gets the ones of the open sessions.
+			NetStats Snapshot(std::vector<std::pair<SessionId, SessionStats>>* per_session = nullptr) const {
+				NetStats stats;
+				stats.total = closedStats_.Snapshot();
+				stats.closed = closedNum_.load(std::memory_order_relaxed);
+				sessions_.ForEach([&](SessionId session_id, const std::shared_ptr<SessionBase<SocketType>>& session) {
+					const SessionStats one = session->Snapshot();
+					stats.total += one;
+					stats.sessions++;
+					if (per_session)
+						per_session->emplace_back(session_id, one);
+					});
+				return stats;
+			}
+			//the send queue watermarks of the sessions opened from now on.
+			void SetSendWatermark(const SendWatermark& watermark) { watermark_ = watermark; }
+			//close the sessions opened from now on after seconds without traffic(0: never).
+			void SetIdleTimeout(unsigned seconds) { idleTimeout_ = seconds; }
+			int SetSendWatermark(SessionId session_id, const SendWatermark& watermark) {
+				auto session = this->sessions_.Find(session_id);
+				if (session) {
+					session->SetSendWatermark(watermark);
+					return 0;
+				}
+				return -2;
+			}
 		protected:
+			//apply the session settings of this server/connector to a new session.
+			void InitSession(SessionBase<SocketType>& session) {
+				session.SetSendWatermark(watermark_);
+				if (idleTimeout_ > 0)
+					session.SetIdleTimeout(idleTimeout_);
+				session.SetCallBackSendState([this](SessionId session_id, bool paused) {
+					Event event;
+					event.type = paused ? Event::eEvent_t::e_sendPaused : Event::eEvent_t::e_sendResumed;
+					if (cbEvent_)
+						cbEvent_(session_id, event);
+					});
+			}
 			int CloseAllSession() {
 				try
 				{
-					std::lock_guard<std::mutex> lock(mtx_);
-					for (auto it = umSessions_.begin(); it != umSessions_.end();) {
-						it->second->Close();
-						SessionIdGen<int>::Instance()->ReleaseId(it->first);
-						it = umSessions_.erase(it);
+					for (auto& it : sessions_.RemoveAll()) {
+						it.second->Close();
+						AddClosedStats(*it.second);
+						OnSessionClosed(*it.second);
+						ReleaseId(it.first);
 
-						StreamWriter::Instance()->Write(std::cout, "[NetBase] Current connect count=%d", umSessions_.size());
+						NET_LOG(E_LOG_LEV_T::e_Debug, std::cout, "[NetBase] Current connect count=%zu", sessions_.Size());
 					}
 					return 0;
 				}
@@ -120,21 +255,23 @@ namespace Net {
 					return -1;
 				}
 			}
-			int CloseSession(int session_id) {
-				std::lock_guard<std::mutex> lock(mtx_);
-				if (umSessions_.find(session_id) != umSessions_.end()) {
+			//the one which removes the session from the table closes it, a concurrent or repeated close does nothing.
+			int CloseSession(SessionId session_id) {
+				auto session = sessions_.Remove(session_id);
+				if (session) {
 					try
 					{
-						umSessions_.at(session_id)->Close();
-						umSessions_.erase(session_id);
-						SessionIdGen<int>::Instance()->ReleaseId(session_id);
+						session->Close();
+						AddClosedStats(*session);
+						OnSessionClosed(*session);
+						ReleaseId(session_id);
 
 						Event event;
 						event.type = Event::eEvent_t::e_connClosed;
 						if (cbEvent_)
 							cbEvent_(session_id, event);
 
-						StreamWriter::Instance()->Write(std::cout, "[NetBase] Current connect count=%d", umSessions_.size());
+						NET_LOG(E_LOG_LEV_T::e_Debug, std::cout, "[NetBase] Current connect count=%zu", sessions_.Size());
 						return 0;
 					}
 					catch (const std::exception& e)
@@ -146,7 +283,21 @@ namespace Net {
 				return 0;
 			}
 
-			virtual void HandleRWErr(int session_id) = 0;
+			//the id of a new session: a slot from the id generator tagged with the slot's generation, -1 if all are in use.
+			SessionId NewId() {
+				const uint32_t slot = idGen_.GetId();
+				return slot > 0 ? sessions_.MakeId(slot) : -1;
+			}
+			void ReleaseId(SessionId session_id) { idGen_.ReleaseId(SessionTable<SessionBase<SocketType>>::SlotOf(session_id)); }
+			//the counters of a closed session are kept in the totals.
+			void AddClosedStats(const SessionBase<SocketType>& session) {
+				closedStats_.Add(session.Snapshot());
+				closedNum_.fetch_add(1, std::memory_order_relaxed);
+			}
+
+			virtual void HandleRWErr(SessionId session_id) = 0;
+			//the session is removed from the table and closed.
+			virtual void OnSessionClosed(SessionBase<SocketType>& session) { }
 
 			virtual void OnTimer(SOCKET_TYPE& socket) = 0;
 			void OffTimer() {
@@ -160,31 +311,129 @@ namespace Net {
 			io_context& ioCtx_;
 			steady_timer timer_;
 			unsigned timeout_{ 0 };
-			//std::unordered_map<int, Session*> umSessions_;
-			std::unordered_map<int, std::shared_ptr<SessionBase<SocketType>>> umSessions_;
+			SessionIdGen idGen_;
+			SessionTable<SessionBase<SocketType>> sessions_;
 			NMemoryStorage<char>	memStorage_;
+			Codec	codec_;	//the framing of all sessions
+			SendWatermark	watermark_;	//of the new sessions
+			unsigned	idleTimeout_{ 0 };
 			CBEvent	  cbEvent_{ nullptr };
-			std::mutex mtx_;
+			SessionCounters	closedStats_;
+			std::atomic<uint64_t>	closedNum_{ 0 };
+		};
+
+		//the counters of the accept path of a server.
+		struct AcceptStats {
+			uint64_t accepted{ 0 };		//connections accepted
+			uint64_t errors{ 0 };		//failed accepts, an empty listen queue is not one
+			uint64_t bursts{ 0 };		//the wakeups of the sync accept loop
+			uint64_t maxBurst{ 0 };		//the most connections accepted in one wakeup
+			uint64_t refused{ 0 };		//accepted and closed at once, the session ids are all in use
+			double rate{ 0 };			//accepts/s since the previous GetAcceptStats
+			int backlog{ -1 };			//the connections waiting in the listen queue now(-1: unknown)
+			int backlogMax{ -1 };		//the size of the listen queue(-1: unknown)
 		};
 
-		using CBReceive = std::function<void(int, const char*, size_t, uint8_t)>;
-		using CBSend = std::function<void(int, size_t, uint8_t)>;
+		using CBReceive = std::function<void(SessionId, const char*, size_t, uint8_t)>;
+		using CBSend = std::function<void(SessionId, size_t, uint8_t)>;
 
 		class ServerBase : public NetBase<SOCKET_TYPE>, public std::enable_shared_from_this<ServerBase> {
 		public:
-			explicit ServerBase(io_context& io_c, const std::string& ip, short port, unsigned timeout) : NetBase<SOCKET_TYPE>(io_c, timeout), \
-				acceptor_(io_c) {
-				tcp::endpoint end_point(asio::ip::make_address(ip), port);
-				acceptor_.open(end_point.protocol());
+			//backlog: the size of the listen queue, a reconnect storm waits there until it is accepted.
+			explicit ServerBase(io_context& io_c, const std::string& ip, short port, unsigned timeout, const Codec& codec = Codec::Default(), \
+				int backlog = asio::socket_base::max_listen_connections) : NetBase<SOCKET_TYPE>(io_c, timeout, codec), \
+				acceptor_(io_c), endpoint_(asio::ip::make_address(ip), port), backlog_(backlog) {
+				acceptor_.open(endpoint_.protocol());
 				acceptor_.set_option(asio::ip::tcp::acceptor::reuse_address(true));
-				acceptor_.bind(end_point);
-				acceptor_.listen();
+				acceptor_.bind(endpoint_);
+				acceptor_.listen(backlog_);
+				lastStatTime_ = std::chrono::steady_clock::now();
+			}
+
+			//pool mode, call it before Start/StartA: the accepted sessions run on the reactors of pool, placed by its
+			//placement, instead of on the io_context of the server. b_reuse_port(StartA only): each reactor accepts on
+			//an acceptor of its own(SO_REUSEPORT, the kernel spreads the connections), ignored where it's not supported.
+			//the pool is run and stopped by the caller, who releases it before the server dies: the handlers of the
+			//sessions pending on a stopped reactor are destroyed with the pool, and they use the server's memory.
+			int SetReactorPool(std::shared_ptr<IoContextPool> pool, bool b_reuse_port = false) {
+				reactors_ = pool;
+				if (!reactors_ || !b_reuse_port)
+					return 0;
+#ifdef SO_REUSEPORT
+				try
+				{
+					using reuse_port = asio::detail::socket_option::boolean<SOL_SOCKET, SO_REUSEPORT>;
+					//all the sockets of the port set the option, so the one of the constructor is replaced.
+					asio::error_code ec;
+					acceptor_.close(ec);
+					for (size_t i = 0; i < reactors_->Size(); i++) {
+						auto acceptor = std::make_shared<tcp::acceptor>(reactors_->Get(i));
+						acceptor->open(endpoint_.protocol());
+						acceptor->set_option(asio::ip::tcp::acceptor::reuse_address(true));
+						acceptor->set_option(reuse_port(true));
+						acceptor->bind(endpoint_);
+						acceptor->listen(backlog_);
+						reuseAcceptors_.emplace_back(acceptor);
+					}
+					return 0;
+				}
+				catch (const std::exception& e)
+				{
+					StreamWriter::Instance()->Write(std::cout, "[ServerBase] reuse port raise ex:%s", e.what());
+					return -1;
+				}
+#else
+				StreamWriter::Instance()->Write(std::cout, "[ServerBase] reuse port is not supported, one acceptor is used");
+				return 0;
+#endif //SO_REUSEPORT
+			}
+
+			//sync mode: the sessions wait for readiness on one io_context run by num workers, the worker a session is
+			//ready on makes the blocking Recieve and calls the receive callback, then the session waits again. so
+			//num threads serve all the connections(in pool mode, the reactors are the workers). call it before Start.
+			void SetSyncWorkers(size_t num) { syncWorkerNum_ = num > 0 ? num : 1; }
+			//sync mode: the most connections accepted in one wakeup(the rest waits for the next one), and accept4
+			//(linux: the accept and close-on-exec in one call) instead of accept. call it before Start.
+			void SetAcceptBurst(size_t burst, bool b_accept4 = false) {
+				acceptBurst_ = burst > 0 ? burst : 1;
+				bAccept4_ = b_accept4;
+			}
+			//the counters of the accept path, and the accept rate since the previous call(call it from one thread).
+			AcceptStats GetAcceptStats() {
+				AcceptStats stats;
+				stats.accepted = accepted_.load(std::memory_order_relaxed);
+				stats.errors = acceptErrs_.load(std::memory_order_relaxed);
+				stats.bursts = acceptBursts_.load(std::memory_order_relaxed);
+				stats.maxBurst = maxBurst_.load(std::memory_order_relaxed);
+				stats.refused = refused_.load(std::memory_order_relaxed);
+				auto now = std::chrono::steady_clock::now();
+				auto us = std::chrono::duration_cast<std::chrono::microseconds>(now - lastStatTime_).count();
+				if (us > 0)
+					stats.rate = (stats.accepted - lastAccepted_) * 1000000.0 / us;
+				lastAccepted_ = stats.accepted;
+				lastStatTime_ = now;
+#ifdef __linux__
+				//a listening socket reports its accept queue in tcp_info: unacked is the length, sacked the limit.
+				struct tcp_info info;
+				socklen_t len = sizeof(info);
+				if (acceptor_.is_open() && getsockopt(acceptor_.native_handle(), IPPROTO_TCP, TCP_INFO, &info, &len) == 0) {
+					stats.backlog = static_cast<int>(info.tcpi_unacked);
+					stats.backlogMax = static_cast<int>(info.tcpi_sacked);
+				}
+#endif
+				return stats;
 			}
 
 			void Start() {
 				this->bAsyncAc_ = false;
 				this->bExit_ = false;
 				StreamWriter::Instance()->Write(std::cout, "[ServerBase] Start listening!");
+				if (!reactors_) {
+					syncCtx_.restart();
+					syncWork_ = std::make_shared<io_context::work>(syncCtx_);
+					for (size_t i = 0; i < syncWorkerNum_; i++)
+						wkThds_.emplace_back(std::make_shared<std::thread>([this] { syncCtx_.run(); }));
+				}
 				Accept();
 			}
 			void StartA() {
@@ -207,11 +456,14 @@ namespace Net {
 				this->CloseAllSession();
 				this->bExit_ = true;
 
+				syncWork_ = nullptr;
+				syncCtx_.stop();
 				for (auto it : wkThds_) {
 					if (it && it->joinable()) {
 						it->join(); it = nullptr;
 					}
 				}
+				wkThds_.clear();
 				StopAccept();
 				if (ServThdptr_ && ServThdptr_->joinable()) {
 					ServThdptr_->join(); ServThdptr_ = nullptr;
@@ -225,50 +477,141 @@ namespace Net {
 			virtual void Accept() = 0;
 			virtual void AsyncAccept() = 0;
 
-			void DoReceive(int id) {
-				std::shared_ptr<std::thread> work_thread = std::make_shared<std::thread>([this, id] {
-					while (!this->bExit_) {
-						try
-						{
-							uint8_t err_code{ 0 };
-							char* data{ nullptr };
-							auto size = this->Recieve(id, &data, err_code);
-							if (size < 0) {
-								if (err_code == 1 || err_code == 2) { //todo
-									StreamWriter::Instance()->Write(std::cout, "[ServerBase] Recieve with err=%d", (int)err_code);
-									break;
-								}
-								else {
-									//todo to process the packet error
-									StreamWriter::Instance()->Write(std::cout, "[ServerBase] Recieve with err=%d", (int)err_code);
-								}
+			//sync mode: wait until the listen queue is readable(waking up every AcceptWaitMs to see bExit_), then
+			//accept without blocking until it is empty or acceptBurst_ connections are taken, on_accept(socket, io_c)
+			//opens the session of each one.
+			template<typename F>
+			void AcceptLoop(F on_accept) {
+				asio::error_code ec;
+				acceptor_.non_blocking(true, ec);
+				while (!this->bExit_) {
+					asio::error_code wait_ec;
+					if (asio::detail::socket_ops::poll_read(acceptor_.native_handle(), 0, AcceptWaitMs, wait_ec) <= 0) {
+						if (wait_ec && wait_ec != asio::error::interrupted && !this->bExit_) {
+							StreamWriter::Instance()->Write(std::cout, "[ServerBase] Accept wait err message=%s", wait_ec.message().c_str());
+							std::this_thread::sleep_for(std::chrono::milliseconds(AcceptWaitMs));
+						}
+						continue;
+					}
+					uint64_t burst{ 0 };
+					while (!this->bExit_ && burst < acceptBurst_) {
+						io_context& io_c = this->NextReactor();
+						tcp::socket socket(io_c);
+						AcceptOne(socket, ec);
+						if (ec == asio::error::would_block || ec == asio::error::try_again)
+							break;
+						else if (ec == asio::error::connection_aborted) //reset while it waited in the queue
+							continue;
+						else if (ec) {
+							acceptErrs_.fetch_add(1, std::memory_order_relaxed);
+							StreamWriter::Instance()->Write(std::cout, "[ServerBase] Accept err message=%s", ec.message().c_str());
+							//out of descriptors(or worse), the queue is left until some are closed
+							std::this_thread::sleep_for(std::chrono::milliseconds(AcceptWaitMs));
+							break;
+						}
+						burst++;
+						accepted_.fetch_add(1, std::memory_order_relaxed);
+						on_accept(socket, io_c);
+					}
+					acceptBursts_.fetch_add(1, std::memory_order_relaxed);
+					if (burst > maxBurst_.load(std::memory_order_relaxed))
+						maxBurst_.store(burst, std::memory_order_relaxed);
+				}
+			}
+			void AcceptOne(tcp::socket& socket, asio::error_code& ec) {
+#ifdef __linux__
+				if (bAccept4_) {
+					int fd = ::accept4(acceptor_.native_handle(), nullptr, nullptr, SOCK_CLOEXEC);
+					if (fd < 0) {
+						ec = asio::error_code(errno, asio::error::get_system_category());
+						return;
+					}
+					ec = asio::error_code();
+					socket.assign(endpoint_.protocol(), fd, ec);
+					if (ec)
+						::close(fd);
+					return;
+				}
+#endif
+				acceptor_.accept(socket, ec);
+			}
+			//the id of an accepted connection, -1 if the ids are all in use: the connection is closed and counted.
+			SessionId AcceptId(tcp::socket& socket) {
+				SessionId id = this->NewId();
+				if (id < 0) {
+					refused_.fetch_add(1, std::memory_order_relaxed);
+					asio::error_code ec;
+					socket.close(ec);
+					StreamWriter::Instance()->Write(std::cout, "[Server] Session ids are all in use, connection refused!");
+				}
+				return id;
+			}
+			//the async accept path counts its accepts.
+			void CountAccept(const asio::error_code& ec) {
+				if (ec)
+					acceptErrs_.fetch_add(1, std::memory_order_relaxed);
+				else
+					accepted_.fetch_add(1, std::memory_order_relaxed);
+			}
+
+			//sync mode: wait until the session is readable, then a worker receives from it.
+			void DoReceive(SessionId id) {
+				auto session = this->sessions_.Find(id);
+				if (!session || this->bExit_)
+					return;
+				session->GetSocket().lowest_layer().async_wait(tcp::socket::wait_read, [this, id](const asio::error_code& ec) {
+					if (ec) {
+						if (ec != asio::error::operation_aborted)
+							StreamWriter::Instance()->Write(std::cout, "[ServerBase] Wait with err=%s", ec.message().c_str());
+						return;
+					}
+					OnReadable(id);
+					});
+			}
+			//the blocking receive of a ready session, and of the packets buffered after it.
+			void OnReadable(SessionId id) {
+				auto session = this->sessions_.Find(id);
+				if (!session)
+					return;
+				do {
+					try
+					{
+						uint8_t err_code{ 0 };
+						char* data{ nullptr };
+						auto size = session->Recieve(&data, err_code);
+						if (size < 0) {
+							if (err_code == 1 || err_code == 2) { //todo
+								StreamWriter::Instance()->Write(std::cout, "[ServerBase] Recieve with err=%d", (int)err_code);
+								return;
 							}
+							else {
+								//todo to process the packet error
+								StreamWriter::Instance()->Write(std::cout, "[ServerBase] Recieve with err=%d", (int)err_code);
+							}
+						}
 
-							static int num = 0;
-							auto thd_id = std::this_thread::get_id();
-							StreamWriter::Instance()->Write(std::cout, "[ServerBase] thead id=%d, Conn Num=%d, session id=%dpacket count=%d, Packet:%s", \
-								thd_id, this->umSessions_.size(), id, num++, data);
+						static int num = 0;
+						NET_LOG(E_LOG_LEV_T::e_Debug, std::cout, "[ServerBase] thead id=%zu, Conn Num=%zu, session id=%lldpacket count=%d, Packet:%s", \
+							std::hash<std::thread::id>()(std::this_thread::get_id()), this->sessions_.Size(), (long long)id, num++, \
+							std::string_view(data ? data : "", data && size > 0 ? size : 0));
 
-							if (cbReceive_)
-								cbReceive_(id, data, size, err_code);
-						}
-						catch (const std::exception& e)
-						{
-							StreamWriter::Instance()->Write(std::cout, "[ServerBase] Recieve raise ex:%s", e.what());
-							throw e; break;
-						}
+						if (cbReceive_)
+							cbReceive_(id, data, size, err_code);
 					}
-				});
-				this->wkThds_.emplace_back(work_thread);
+					catch (const std::exception& e)
+					{
+						StreamWriter::Instance()->Write(std::cout, "[ServerBase] Recieve raise ex:%s", e.what());
+						throw e;
+					}
+				} while (!this->bExit_ && session->HasBuffered());
+				DoReceive(id);
 			}
-			void DoAsyncReceive(int id) {
-				this->AsyncRecieve(id, [this](int id, char* data, unsigned len, uint8_t ec) {
+			void DoAsyncReceive(SessionId id) {
+				this->AsyncRecieve(id, [this](SessionId id, char* data, unsigned len, uint8_t ec) {
 					if (data) {
 						static int num = 0;
-						auto thd_id = std::this_thread::get_id();
-						std::string str_packet = std::string(data, len);
-						StreamWriter::Instance()->Write(std::cout, "[ServerBase] thead id=%d, Conn Num=%d, session id=%dpacket count=%d, Packet:%s", \
-							thd_id, this->umSessions_.size(), id, num++, str_packet.c_str());
+						NET_LOG(E_LOG_LEV_T::e_Debug, std::cout, "[ServerBase] thead id=%zu, Conn Num=%zu, session id=%lldpacket count=%d, Packet:%s", \
+							std::hash<std::thread::id>()(std::this_thread::get_id()), this->sessions_.Size(), (long long)id, num++, std::string_view(data, len));
 
 						if (cbReceive_)
 							cbReceive_(id, data, len, ec);
@@ -280,115 +623,162 @@ namespace Net {
 					this->DoAsyncReceive(id);
 				});
 			}
+			//the io_context of a new session: a reactor of the pool in pool mode, the one of the workers in sync mode.
+			io_context& NextReactor() { return reactors_ ? reactors_->Get(reactors_->Pick()) : (this->bAsyncAc_ ? this->ioCtx_ : syncCtx_); }
+			//count the session on its reactor, after it is in the table.
+			void AttachReactor(SessionBase<SOCKET_TYPE>& session) {
+				if (reactors_)
+					reactors_->Attach(session.GetIoContext());
+			}
+			virtual void OnSessionClosed(SessionBase<SOCKET_TYPE>& session) override {
+				if (reactors_)
+					reactors_->Detach(session.GetIoContext());
+			}
 			void HandleAcpErr(const asio::error_code& ec) {
 				StreamWriter::Instance()->Write(std::cout, "[ServerBase] Err, reason:=%s", ec.message().c_str());
 				StopAccept();
 			}
-			virtual void HandleRWErr(int session_id)  override {
-				StreamWriter::Instance()->Write(std::cout, "[ServerBase] RW err, session id=%d", session_id);
+			//out of descriptors or buffers for now, the listen queue is left until some are freed.
+			static bool IsTransientAcpErr(const asio::error_code& ec) {
+				return ec == asio::error::no_descriptors || ec == std::errc::too_many_files_open_in_system || \
+					ec == asio::error::no_buffer_space || ec == asio::error::no_memory;
+			}
+			//async mode: an accept of acceptor failed. rearm arms it again at once for a connection reset while it waited
+			//in the queue, after AcceptWaitMs on a transient error, the accept stops on any other one(never to be armed again).
+			template<typename F>
+			void OnAsyncAcpErr(tcp::acceptor& acceptor, const asio::error_code& ec, F rearm) {
+				if (this->bExit_ || ec == asio::error::operation_aborted)
+					return;
+				if (ec == asio::error::connection_aborted)
+					rearm();
+				else if (IsTransientAcpErr(ec)) {
+					auto timer = std::make_shared<steady_timer>(acceptor.get_executor(), std::chrono::milliseconds(AcceptWaitMs));
+					timer->async_wait([this, timer, rearm](const asio::error_code& ec) {
+						if (!ec && !this->bExit_)
+							rearm();
+						});
+				}
+				else
+					HandleAcpErr(ec);
+			}
+			virtual void HandleRWErr(SessionId session_id)  override {
+				StreamWriter::Instance()->Write(std::cout, "[ServerBase] RW err, session id=%lld", (long long)session_id);
 				this->CloseSession(session_id);
 			}
 			void StopAccept() {
 				asio::error_code ec;
 				acceptor_.cancel(ec);
 				acceptor_.close(ec);
+				for (auto& var : reuseAcceptors_) {
+					var->cancel(ec);
+					var->close(ec);
+				}
 				this->ioCtx_.stop();
 			}
 
 		protected:
 			tcp::acceptor acceptor_;
+			tcp::endpoint endpoint_;
+			int backlog_{ asio::socket_base::max_listen_connections };
+			size_t acceptBurst_{ AcceptBurst };
+			bool bAccept4_{ false };
+			std::atomic<uint64_t> accepted_{ 0 };
+			std::atomic<uint64_t> acceptErrs_{ 0 };
+			std::atomic<uint64_t> acceptBursts_{ 0 };
+			std::atomic<uint64_t> maxBurst_{ 0 };
+			std::atomic<uint64_t> refused_{ 0 };
+			uint64_t lastAccepted_{ 0 };
+			std::chrono::steady_clock::time_point lastStatTime_;
+			std::shared_ptr<IoContextPool> reactors_{ nullptr };	//pool mode
+			std::vector<std::shared_ptr<tcp::acceptor>> reuseAcceptors_;	//an acceptor per reactor, SO_REUSEPORT
 			std::shared_ptr<std::thread> ServThdptr_{ nullptr };
-			std::list<std::shared_ptr<std::thread>> wkThds_{ nullptr };
+			std::list<std::shared_ptr<std::thread>> wkThds_;	//the workers of the sync mode
+			io_context syncCtx_;	//the readiness of the sync sessions
+			std::shared_ptr<io_context::work> syncWork_{ nullptr };
+			size_t syncWorkerNum_{ std::thread::hardware_concurrency() > 0 ? std::thread::hardware_concurrency() : 1 };	//hardware_concurrency() is 0 if unknown
 			CBReceive cbReceive_{ nullptr };
 		};
 
 		class ConnectorBase : public NetBase<SOCKET_TYPE>, public std::enable_shared_from_this<ConnectorBase> {
 		public:
-			explicit ConnectorBase(io_context& io_c, const std::string& ip, short port, unsigned timeout) : NetBase<SOCKET_TYPE>(io_c, timeout),
-				ip_(ip), port_(port) { CheckConnect(); }
+			explicit ConnectorBase(io_context& io_c, const std::string& ip, short port, unsigned timeout, const Codec& codec = Codec::Default()) : \
+				NetBase<SOCKET_TYPE>(io_c, timeout, codec),
+				ip_(ip), port_(port) {
+				reconnTimer_.SetCallBack([this] { ReConnCheck(); });
+			}
 			virtual ~ConnectorBase() {
-				this->CloseAllSession();
 				this->bExit_ = true;
-
-				if (reconnThread_ && reconnThread_->joinable()) {
-					reconnThread_->join();
-					reconnThread_ = nullptr;
-				}
+				TimingWheel::Of(this->ioCtx_).Cancel(reconnTimer_);
+				this->CloseAllSession();
 			}
 
-			virtual int Open(const std::string& ip, short port, bool keep_live = false) = 0;
-			virtual void OpenA(const std::string& ip, short port, std::function<void(int, std::error_code)> func, bool keep_live = false) = 0;
+			virtual SessionId Open(const std::string& ip, short port, bool keep_live = false) = 0;
+			virtual void OpenA(const std::string& ip, short port, std::function<void(SessionId, std::error_code)> func, bool keep_live = false) = 0;
 
 		protected:
+			//the reconnect check is a timer of the io_context's wheel, armed while a kept-alive session is down.
 			void CheckConnect() {
-				if (reconnThread_ != nullptr)
-					return;
-
-				reconnThread_ = std::make_shared<std::thread>([this] {
-					try
-					{
-						while (!this->bExit_) {
-							{
-								std::lock_guard<std::mutex> lock(this->mtx_);
-								if (!this->umSessions_.empty()) {
-									for (auto it : this->umSessions_) {
-										if (it.second->GetKeeplive() && !it.second->GetStatus()) {
-											//async reconnect
-											ReConn(it.first);
-										}
-										int tm = ((float)this->timeout_ / this->umSessions_.size()) * 1000;
-										std::this_thread::sleep_for(std::chrono::milliseconds(tm > 10 ? tm : 10));
-									}
-								}
-							}
-							std::this_thread::sleep_for(std::chrono::seconds(1));
-						}
-					}
-					catch (const std::exception& e)
-					{
-						StreamWriter::Instance()->Write(std::cout, "[ConnectorBase] reconnect raise ex, reason=%s", e.what());
-						throw e;
+				if (!this->bExit_)
+					TimingWheel::Of(this->ioCtx_).Arm(reconnTimer_, std::chrono::seconds(1));
+			}
+			//on the wheel, the session table is read without a lock.
+			void ReConnCheck() {
+				bool b_down{ false };
+				this->sessions_.ForEach([this, &b_down](SessionId session_id, const std::shared_ptr<SessionBase<SOCKET_TYPE>>& session) {
+					if (session->GetKeeplive() && !session->GetStatus()) {
+						//async reconnect
+						ReConn(session_id);
+						b_down = true;
 					}
 					});
+				if (b_down && !this->bExit_)
+					TimingWheel::Of(this->ioCtx_).Arm(reconnTimer_, std::chrono::seconds(this->timeout_ > 0 ? this->timeout_ : 1));
 			}
-			void HandleConnErr(int session_id, const asio::error_code& ec) {
-				StreamWriter::Instance()->Write(std::cout, "[ConnectorBase] Conn err, session_id=%d, reasion:%s", session_id, ec.message().c_str());
-				auto find = this->umSessions_.find(session_id);
-				if (find != this->umSessions_.end() && find->second->GetKeeplive())
+			void HandleConnErr(SessionId session_id, const asio::error_code& ec) {
+				StreamWriter::Instance()->Write(std::cout, "[ConnectorBase] Conn err, session_id=%lld, reasion:%s", (long long)session_id, ec.message().c_str());
+				auto session = this->sessions_.Find(session_id);
+				if (session && session->GetKeeplive())
 					CheckConnect();
 				else
 					this->CloseSession(session_id);
 			}
-			virtual void HandleRWErr(int session_id)  override {
-				StreamWriter::Instance()->Write(std::cout, "[ConnectorBase] RW err, session id=%d", session_id);
-				auto find = this->umSessions_.find(session_id);
-				if (find != this->umSessions_.end() && find->second->GetKeeplive())
+			virtual void HandleRWErr(SessionId session_id)  override {
+				StreamWriter::Instance()->Write(std::cout, "[ConnectorBase] RW err, session id=%lld", (long long)session_id);
+				auto session = this->sessions_.Find(session_id);
+				if (session && session->GetKeeplive())
 					CheckConnect();
 				else
 					this->CloseSession(session_id);
 			}
-			virtual void ReConn(int session_id) = 0;
+			virtual void ReConn(SessionId session_id) = 0;
 
 		protected:
 			std::string ip_;
 			short port_{ 0 };
-			std::shared_ptr<std::thread> reconnThread_{ nullptr };
+			TimerNode reconnTimer_;
 			std::atomic_bool bAsyncW_{ false };
 		};
 
 		template<typename SOCKET_TYPE>
 		class ClientBase : public std::enable_shared_from_this<ClientBase<SOCKET_TYPE>> {
 		public:
-			explicit ClientBase(io_context& io_c, const std::string& ip, short port, unsigned timeout) : ioCtx_(io_c),
-				timeout_(timeout), timer_(io_c), ip_(ip), port_(port), memStorage_({ 32, 64, 256, 512, 1024 })
-			{ }
+			explicit ClientBase(io_context& io_c, const std::string& ip, short port, unsigned timeout, const Codec& codec = Codec::Default()) : ioCtx_(io_c),
+				timeout_(timeout), timer_(io_c), ip_(ip), port_(port), memStorage_({ 32, 64, 256, 512, 1024 }), codec_(codec)
+			{
+				reconnTimer_.SetCallBack([this] { ReConnCheck(); });
+			}
 			~ClientBase() {
-				SAFE_DELETE(session_);
+				bExit_ = true;
+				TimingWheel::Of(ioCtx_).Cancel(reconnTimer_);
+				//the session frees into memStorage_, which is destroyed before it
+				if (session_)
+					session_->Close();
+				session_ = nullptr;
 			}
 
-			virtual int Open(const std::string& ip, short port, bool keep_live = false) = 0;
+			virtual SessionId Open(const std::string& ip, short port, bool keep_live = false) = 0;
 			virtual void OpenA(const std::string& ip, short port, \
-				std::function<void(int, std::error_code)> func, bool keep_live = false) = 0;
+				std::function<void(SessionId, std::error_code)> func, bool keep_live = false) = 0;
 
 			int Close() {
 				CloseSession();
@@ -407,8 +797,24 @@ namespace Net {
 			int AsyncSend(const char* data, unsigned len, CBAsyncSend cb = nullptr) {
 				if (!session_->GetStatus())
 					return -1;
-				else
-					return session_->AsyncSend(data, len, cb);
+				else {
+					SessionId id = session_->GetId();
+					return session_->AsyncSend(data, len, [id, cb](size_t byte_send, uint8_t ec) {
+						if (cb)
+							cb(id, byte_send, ec);
+						});
+				}
+			}
+			int AsyncSendView(const std::vector<asio::const_buffer>& buffers, CBAsyncSend cb = nullptr, CBRelease release = nullptr) {
+				if (!session_->GetStatus())
+					return -1;
+				else {
+					SessionId id = session_->GetId();
+					return session_->AsyncSendView(buffers, [id, cb](size_t byte_send, uint8_t ec) {
+						if (cb)
+							cb(id, byte_send, ec);
+						}, release);
+				}
 			}
 			int Recieve(char** data, uint8_t& err_code) {
 				if (!session_->GetStatus())
@@ -416,34 +822,59 @@ namespace Net {
 				else
 					return session_->Recieve(data, err_code);
 			}
-			int AsyncRecieve(int session_id, CBAsyncRecv cb = nullptr) {
+			int AsyncRecieve(SessionId session_id, CBAsyncRecv cb = nullptr) {
 				if (!session_->GetStatus())
 					return -1;
 				else
-					return session_->AsyncRecieve([cb](Packet* packet, uint8_t ec) {
+					return session_->AsyncRecieve([cb, session_id](Packet* packet, uint8_t ec) {
 						if (packet == nullptr) {
 							StreamWriter::Instance()->Write(std::cout, "[ClientBase] Async recieve err, code=%d", (int)ec);
 							if (cb)
-								cb(nullptr, 0, ec);
+								cb(session_id, nullptr, 0, ec);
 						}
 						else {
 							if (cb)
-								cb(packet->body(), packet->bodyLen(), ec);
+								cb(session_id, packet->body(), packet->bodyLen(), ec);
 						}
 					});
 			}
 
 			template<typename F>
 			void SetEventCB(F f) { cbEvent_ = f; }
+			//the send queue watermarks of the session, kept for the reconnected ones.
+			void SetSendWatermark(const SendWatermark& watermark) {
+				watermark_ = watermark;
+				if (session_)
+					session_->SetSendWatermark(watermark);
+			}
+			//close the session after seconds without traffic(0: never).
+			void SetIdleTimeout(unsigned seconds) {
+				idleTimeout_ = seconds;
+				if (session_)
+					session_->SetIdleTimeout(seconds);
+			}
 
 		protected:
+			void InitSession(SessionBase<SOCKET_TYPE>& session) {
+				session.SetSendWatermark(watermark_);
+				if (idleTimeout_ > 0)
+					session.SetIdleTimeout(idleTimeout_);
+				session.SetCallBackSendState([this](SessionId session_id, bool paused) {
+					Event event;
+					event.type = paused ? Event::eEvent_t::e_sendPaused : Event::eEvent_t::e_sendResumed;
+					if (cbEvent_)
+						cbEvent_(session_id, event);
+					});
+			}
+			//the session is kept closed, its pending handlers hold it and a kept-alive one reconnects.
 			int CloseSession() {
+				if (!session_)
+					return 0;
 				try
 				{
-					int id = session_->GetId();
+					SessionId id = session_->GetId();
 					session_->Close();
-					SessionIdGen<int>::Instance()->ReleaseId(id);
-					delete session_;
+					session_->SetStatus(0);
 
 					Event event;
 					event.type = Event::eEvent_t::e_connClosed;
@@ -460,35 +891,28 @@ namespace Net {
 				}
 				return 0;
 			}
+			//the reconnect check is a timer of the io_context's wheel, armed while the kept-alive session is down.
 			void CheckConnect() {
-				if (reconnThread_ != nullptr)
-					return;
-
-				reconnThread_ = std::make_shared<std::thread>([this] {
-					try
-					{
-						while (!this->bExit_) {
-							if (this->session_->GetKeeplive() && !this->session_->GetStatus()) {
-								//async reconnect
-								ReConn();
-							}
-							std::this_thread::sleep_for(std::chrono::seconds(this->timeout_));
-						}
-					}
-					catch (const std::exception& e)
-					{
-						StreamWriter::Instance()->Write(std::cout, "[ClientBase] reconnect raise ex, reason=%s", e.what());
-						throw e;
-					}
-				});
+				if (!bExit_)
+					TimingWheel::Of(ioCtx_).Arm(reconnTimer_, std::chrono::seconds(timeout_ > 0 ? timeout_ : 1));
 			}
+			void ReConnCheck() {
+				if (session_ && session_->GetKeeplive() && !session_->GetStatus()) {
+					//async reconnect
+					ReConn();
+					CheckConnect();
+				}
+			}
+
+			//a client has one session at a time, the ids of its sessions differ in the generation.
+			SessionId NewId() { return (static_cast<SessionId>(++generation_ & 0x7FFFFFFF) << 32) | 1; }
 
 			virtual void ReConn() = 0;
 			void HandleConnErr(const asio::error_code& ec) {
 				std::cout << "[ClientBase] Conn Err, reasion : " << ec.message() << std::endl;
 				CheckConnect();
 			}
-			void HandleRWErr(int conn_id) {
+			void HandleRWErr(SessionId conn_id) {
 				std::cout << "[ClientBase] RW err, connect id : " << conn_id << std::endl;
 				CheckConnect();
 			}
@@ -503,13 +927,17 @@ namespace Net {
 			io_context& ioCtx_;
 			std::string ip_;
 			short port_{ 0 };
-			SessionBase<SOCKET_TYPE>* session_{ nullptr };
+			std::shared_ptr<SessionBase<SOCKET_TYPE>> session_{ nullptr };	//shared, its async io holds it
 			steady_timer timer_;
 			unsigned timeout_{ 0 };
 			NMemoryStorage<char> memStorage_;
+			Codec codec_;
+			SendWatermark watermark_;
+			unsigned idleTimeout_{ 0 };
 			CBEvent	cbEvent_{ nullptr };
 			bool bExit_{ false };
-			std::shared_ptr<std::thread> reconnThread_{ nullptr };
+			TimerNode reconnTimer_;
+			uint32_t generation_{ 0 };
 		};
 
 #ifdef OPENSSL
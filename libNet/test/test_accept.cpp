@@ -0,0 +1,91 @@
+//========================================================================
+//[File Name]:test_accept.cpp
+//[Description]: a test of the accept path, connect/close storms against
+//               the sync server(bursts of non-blocking accepts, with and
+//               without accept4) and the async one, the accepts/s and the
+//               counters of the listen queue. the sync server must stop
+//               while its accept loop waits.
+//[Author]:Nico Hu
+//[Date]:2020-08-10
+//[Other]:Copyright (c) 2020-2050 Nico Hu
+//========================================================================
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <cstdio>
+
+#include "../stream/Server.h"
+#include "Timer.h"
+
+using namespace Net;
+using namespace Net::Stream;
+
+#define ClientThreads (4)
+#define ConnPerThread (5000)
+#define Backlog (4096)
+
+//each client thread connects and closes ConnPerThread times, the connects which failed are returned.
+size_t storm(short port) {
+	std::atomic<size_t> failed{ 0 };
+	std::vector<std::thread> clients;
+	for (int c = 0; c < ClientThreads; c++) {
+		clients.emplace_back([&, port] {
+			io_context io_c;
+			const tcp::endpoint endpoint(asio::ip::make_address("127.0.0.1"), port);
+			size_t n_failed{ 0 };
+			for (int i = 0; i < ConnPerThread; i++) {
+				tcp::socket socket(io_c);
+				asio::error_code ec;
+				socket.connect(endpoint, ec);
+				if (ec)
+					n_failed++;
+				//a reset instead of TIME_WAIT, the storm doesn't run out of ports.
+				socket.set_option(socket_base::linger(true, 0), ec);
+				socket.close(ec);
+			}
+			failed += n_failed;
+			});
+	}
+	for (auto& var : clients)
+		var.join();
+	return failed;
+}
+
+//mode: 0 sync, 1 sync with accept4, 2 async.
+void test_accept(int mode, short port) {
+	const char* names[] = { "sync", "sync accept4", "async" };
+	io_context io_c;
+	asio::io_context::work worker(io_c);
+	std::thread io_thread([&] { io_c.run(); });
+	std::shared_ptr<ServerTcp> server(new ServerTcp(io_c, "127.0.0.1", port, 0, Codec(E_CODEC_T::e_Raw), Backlog));
+	server->SetSyncWorkers(1);
+	server->SetAcceptBurst(AcceptBurst, mode == 1);
+	mode == 2 ? server->StartA() : server->Start();
+
+	server->GetAcceptStats();
+	Timer timer;
+	const size_t failed = storm(port);
+	const size_t total = ClientThreads * ConnPerThread - failed;
+	//the last connections may still wait in the listen queue.
+	for (int i = 0; i < 100 && server->GetAcceptStats().accepted < total; i++)
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	auto us = timer.elapsed_micro();
+	auto stats = server->GetAcceptStats();
+
+	timer.reset();
+	server->Stop();
+	auto us_stop = timer.elapsed_micro();
+	io_c.stop();
+	io_thread.join();
+	const bool ok = stats.accepted == total && stats.errors == 0;
+	printf("[%-12s] accepted=%llu failed=%zu errors=%llu bursts=%llu max burst=%llu time=%lldus %.0f accept/s backlog=%d/%d stop=%lldus %s\n", \
+		names[mode], (unsigned long long)stats.accepted, failed, (unsigned long long)stats.errors, (unsigned long long)stats.bursts, \
+		(unsigned long long)stats.maxBurst, (long long)us, us > 0 ? stats.accepted * 1000000.0 / us : 0.0, stats.backlog, \
+		stats.backlogMax, (long long)us_stop, ok ? "ok" : "FAILED");
+}
+
+int main(int argc, char** argv) {
+	for (int mode = 0; mode < 3; mode++)
+		test_accept(mode, 9920 + mode);
+	return 0;
+}
@@ -0,0 +1,130 @@
+//========================================================================
+//[File Name]:test_asyncLogger.cpp
+//[Description]: a test of the async logger, 1/4/8 threads writing the log
+//               line of the receive path to a file, against the formatting
+//               under a mutex with a flush per line which it replaces, the
+//               lines in the file, the cost of a disabled level and the
+//               lines of StreamWriter to a stream which is gone right after.
+//[Author]:Nico Hu
+//[Date]:2020-08-10
+//[Other]:Copyright (c) 2020-2050 Nico Hu
+//========================================================================
+#include <fstream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <stdarg.h>
+#include <cstdio>
+
+#include "../com/StreamWriter.h"
+#include "Timer.h"
+
+#define LineCount (1024 * 256)
+#define LogFile "./test_asyncLogger.txt"
+
+//the writer before: format and stamp on the caller, then write and flush under one mutex.
+class SyncWriter {
+public:
+	void Write(std::ostream& ostr, const char* format, ...) {
+		char buff[1024] = { 0 };
+		va_list st;
+		va_start(st, format);
+		vsnprintf(buff, sizeof(buff), format, st);
+		va_end(st);
+		time_t t = time(0);
+		char tmp[64];
+		strftime(tmp, sizeof(tmp), "[%Y-%m-%d %H:%M:%S] ", localtime(&t));
+		std::lock_guard<std::mutex> lock(mtx_);
+		ostr << tmp << buff << std::endl;
+		ostr.flush();
+	}
+
+private:
+	std::mutex mtx_;
+};
+
+size_t count_lines() {
+	std::ifstream ifs(LogFile);
+	std::string line;
+	size_t n{ 0 };
+	while (std::getline(ifs, line))
+		n++;
+	return n;
+}
+
+//each thread writes LineCount / threads lines, the time is taken until they are on the file.
+template<typename F>
+void test_write(const char* name, size_t threads, F write) {
+	std::ofstream ofs(LogFile, std::ofstream::out | std::ofstream::trunc);
+	std::vector<std::thread> writers;
+	std::atomic_bool start{ false };
+	std::atomic<long long> us_call{ 0 };
+	for (size_t t = 0; t < threads; t++) {
+		writers.emplace_back([&, t] {
+			while (!start)
+				std::this_thread::yield();
+			Timer timer;
+			for (size_t i = 0; i < LineCount / threads; i++)
+				write(ofs, t, i);
+			us_call += timer.elapsed_micro();
+			});
+	}
+	Timer timer;
+	start = true;
+	for (auto& var : writers)
+		var.join();
+	AsyncLogger::Instance()->Flush();
+	auto us = timer.elapsed_micro();
+	ofs.close();
+	const size_t lines = count_lines();
+	printf("%-12s threads=%zu lines=%zu time=%lldus %.0f lines/s, per call=%.0fns %s\n", name, threads, lines, (long long)us, \
+		us > 0 ? lines * 1000000.0 / us : 0.0, us_call * 1000.0 / LineCount, lines == (LineCount / threads) * threads ? "ok" : "FAILED");
+}
+
+//a disabled level must not copy or evaluate its arguments.
+void test_disabled() {
+	AsyncLogger::SetLevel(E_LOG_LEV_T::e_Info);
+	size_t evaluated{ 0 };
+	auto arg = [&] { return (int)++evaluated; };
+	Timer timer;
+	for (int i = 0; i < LineCount; i++)
+		NET_LOG(E_LOG_LEV_T::e_Debug, std::cout, "[test] disabled %d", arg());
+	auto us = timer.elapsed_micro();
+	AsyncLogger::SetLevel(E_LOG_LEV_T::e_Debug);
+	printf("[disabled] calls=%d evaluated=%zu time=%lldus %s\n", LineCount, evaluated, (long long)us, evaluated == 0 ? "ok" : "FAILED");
+}
+
+//a stream but the standard ones is written at once, the background thread would write to it too late.
+void test_short_lived() {
+	std::string line;
+	{
+		std::ostringstream ostr;
+		StreamWriter::Instance()->Write(ostr, "[test] short lived %d %s", 7, "stream");
+		line = ostr.str();
+	}
+	AsyncLogger::Instance()->Flush();
+	printf("[short lived] line=%zu bytes %s\n", line.size(), line.find("[test] short lived 7 stream") != std::string::npos ? "ok" : "FAILED");
+}
+
+int main(int argc, char** argv) {
+	test_disabled();
+	test_short_lived();
+	//a full ring waits for the background thread here, the lines are counted.
+	AsyncLogger::Instance()->SetBlocking(true);
+	SyncWriter sync_writer;
+	for (size_t threads : { 1, 4, 8 }) {
+		test_write("mutex+flush", threads, [&](std::ostream& ostr, size_t t, size_t i) {
+			sync_writer.Write(ostr, "[ServerBase] thead id=%zu, Conn Num=%d, session id=%lld, packet count=%zu, Packet:%s", \
+				t, 1000, (long long)t, i, "hello world, the packet of a session");
+			});
+		//the file lives until the flush, so the logger writes to it directly(StreamWriter writes it at once).
+		test_write("AsyncLogger", threads, [](std::ostream& ostr, size_t t, size_t i) {
+			AsyncLogger::Instance()->Write(E_LOG_LEV_T::e_Info, ostr, "", "[ServerBase] thead id=%zu, Conn Num=%d, session id=%lld, packet count=%zu, Packet:%s", \
+				t, 1000, (long long)t, i, "hello world, the packet of a session");
+			});
+	}
+	remove(LogFile);
+	return 0;
+}
@@ -0,0 +1,419 @@
+//========================================================================
+//[File Name]:test_benchAlloc.cpp
+//[Description]: a benchmark of the allocators: NMemoryStorage<char>(the
+//               size list of the sessions), NMemoryPool and MemoryPool by
+//               power of 2 classes, and malloc. local: each thread allocs
+//               and frees its own blocks in a random order, xthread: half
+//               of the threads alloc and the others free, as the async send
+//               path does(the caller allocs, the io thread frees). the size
+//               mixes are the ones of the library: small {32..1024} packets,
+//               64KiB bodies(65535, the largest size a uint16_t tag holds)
+//               and 4-32KiB chunk buffers(in KiB steps). a case is a csv
+//               line: ns per alloc+free, peak live bytes, peak rss over the
+//               case, fragmentation(rss over live) and the rss kept once all
+//               is freed. the pools are locked(THREAD_SAFE of NMemoryPool.h).
+//               usage: test_benchAlloc [--alloc=storage,pool,mempool,malloc]
+//               [--pattern=local,xthread] [--mix=small,body,chunk]
+//               [--threads=1,2,8,32] [--ops=500000] [--live=64(MB)] [--out=file.csv]
+//[Author]:Nico Hu
+//[Date]:2020-08-10
+//[Other]:Copyright (c) 2020-2050 Nico Hu
+//========================================================================
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#pragma comment(lib, "psapi.lib")
+#else
+#include <unistd.h>
+#endif
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+#include "../com/NMemoryStorage.h"
+#include "../com/MemoryPool.h"
+#include "../com/MpscQueue.h"
+#include "../com/Timer.h"
+
+#define PageSize (4096)
+#define QueueSize (1024)
+#define SampleUs (500)
+
+struct BenchInfo_t {
+	std::vector<std::string> allocs{ "storage", "pool", "mempool", "malloc" };
+	std::vector<std::string> patterns{ "local", "xthread" };
+	std::vector<std::string> mixes{ "small", "body", "chunk" };
+	std::vector<size_t> threads{ 1, 2, 8, 32 };
+	size_t ops{ 500000 };	//alloc+free pairs of a case, over all threads
+	size_t liveMB{ 64 };	//the blocks held at once, over all threads
+	std::string out;
+};
+
+//the rss of the process in bytes.
+size_t rss_bytes() {
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS counters;
+	if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+		return counters.WorkingSetSize;
+	return 0;
+#else
+	size_t pages{ 0 }, resident{ 0 };
+	FILE* file = fopen("/proc/self/statm", "r");
+	if (file) {
+		if (fscanf(file, "%zu %zu", &pages, &resident) != 2)
+			resident = 0;
+		fclose(file);
+	}
+	return resident * sysconf(_SC_PAGESIZE);
+#endif
+}
+
+//the adapters of the allocators, Free takes the size the block was asked with.
+class StorageAlloc {
+public:
+	StorageAlloc() : storage_({ 32, 64, 256, 512, 1024 }) { }
+	char* Alloc(size_t size) { return storage_.Alloc(size); }
+	void Free(char* p, size_t size) { storage_.Free(p); }
+
+private:
+	NMemoryStorage<char> storage_;
+};
+
+//a pool per power of 2 from 32, and the last one of MaxClass.
+template<typename Pool>
+class ClassAlloc {
+public:
+	static constexpr size_t MaxClass = 65535;
+
+	ClassAlloc() {
+		for (size_t size = 32; size < MaxClass; size *= 2)
+			pools_.emplace_back(new Pool(static_cast<uint16_t>(size)));
+		pools_.emplace_back(new Pool(static_cast<uint16_t>(MaxClass)));
+	}
+	char* Alloc(size_t size) {
+		const size_t index = Index(size);
+		return index < pools_.size() ? pools_[index]->Alloc() : nullptr;
+	}
+	void Free(char* p, size_t size) { pools_[Index(size)]->Free(p); }
+
+protected:
+	static size_t Index(size_t size) {
+		size_t index{ 0 };
+		for (size_t class_size = 32; class_size < size && class_size < MaxClass; class_size *= 2)
+			index++;
+		return size > MaxClass ? SIZE_MAX : index;
+	}
+
+protected:
+	std::vector<std::unique_ptr<Pool>> pools_;
+};
+using PoolAlloc = ClassAlloc<NMemoryPool<char>>;
+using MemPoolAlloc = ClassAlloc<MemoryPool<char>>;
+
+class MallocAlloc {
+public:
+	char* Alloc(size_t size) { return static_cast<char*>(malloc(size)); }
+	void Free(char* p, size_t size) { free(p); }
+};
+
+struct Block {
+	char* data{ nullptr };
+	size_t size{ 0 };
+};
+
+//the counters of a thread, read by the sampler.
+struct alignas(64) ThreadStat {
+	std::atomic<int64_t> live{ 0 };		//the bytes it holds, or it has allocated less the ones freed by others
+	std::atomic<uint64_t> fails{ 0 };
+};
+
+struct Sizer {
+	uint64_t state;
+	std::string mix;
+
+	Sizer(const std::string& mix_name, uint64_t seed) : state(seed * 0x9E3779B97F4A7C15ull + 1), mix(mix_name) { }
+	uint64_t Next() {
+		state ^= state << 13;
+		state ^= state >> 7;
+		state ^= state << 17;
+		return state;
+	}
+	size_t Size() {
+		if (mix == "body")
+			return 65535;
+		else if (mix == "chunk")
+			return (4 + Next() % 29) * 1024;
+		return 32 + Next() % (1024 - 32 + 1);
+	}
+	static size_t Mean(const std::string& mix) {
+		if (mix == "body")
+			return 65535;
+		else if (mix == "chunk")
+			return 18 * 1024;
+		return 528;
+	}
+};
+
+//write a byte of each page, so the pages are resident as in real use.
+void touch(char* data, size_t size) {
+	for (size_t i = 0; i < size; i += PageSize)
+		data[i] = static_cast<char>(i);
+	data[size - 1] = 1;
+}
+
+struct CaseResult_t {
+	double secs{ 0 };
+	uint64_t fails{ 0 };
+	int64_t livePeak{ 0 };
+	size_t rssPeak{ 0 };	//over the rss before the case
+	size_t retained{ 0 };	//the rss kept after all is freed
+};
+
+//each thread keeps window blocks, and replaces a random one per op.
+template<typename Alloc>
+void run_local(Alloc& alloc, const std::string& mix, size_t threads, size_t ops, size_t window, std::vector<ThreadStat>& stats) {
+	std::vector<std::thread> workers;
+	for (size_t t = 0; t < threads; t++) {
+		workers.emplace_back([&, t] {
+			Sizer sizer(mix, t + 1);
+			std::vector<Block> blocks(window);
+			ThreadStat& stat = stats[t];
+			int64_t live{ 0 };
+			for (size_t i = 0; i < ops / threads; i++) {
+				Block& block = blocks[sizer.Next() % window];
+				if (block.data) {
+					alloc.Free(block.data, block.size);
+					live -= block.size;
+				}
+				block.size = sizer.Size();
+				block.data = alloc.Alloc(block.size);
+				if (block.data) {
+					touch(block.data, block.size);
+					live += block.size;
+				}
+				else
+					stat.fails.fetch_add(1, std::memory_order_relaxed);
+				stat.live.store(live, std::memory_order_relaxed);
+			}
+			for (auto& var : blocks) {
+				if (var.data)
+					alloc.Free(var.data, var.size);
+			}
+			stat.live.store(0, std::memory_order_relaxed);
+			});
+	}
+	for (auto& var : workers)
+		var.join();
+}
+
+//producer t allocs and hands the blocks to consumer t, which frees them.
+template<typename Alloc>
+void run_xthread(Alloc& alloc, const std::string& mix, size_t threads, size_t ops, size_t window, std::vector<ThreadStat>& stats) {
+	const size_t pairs = std::max<size_t>(1, threads / 2);
+	const size_t per_pair = ops / pairs;
+	std::vector<std::unique_ptr<MpscQueue<Block>>> queues;
+	for (size_t p = 0; p < pairs; p++)
+		queues.emplace_back(new MpscQueue<Block>(std::min<size_t>(QueueSize, window)));
+	std::vector<std::thread> workers;
+	for (size_t p = 0; p < pairs; p++) {
+		workers.emplace_back([&, p] {
+			Sizer sizer(mix, p + 1);
+			ThreadStat& stat = stats[2 * p];
+			int64_t live{ 0 };
+			for (size_t i = 0; i < per_pair; i++) {
+				Block block;
+				block.size = sizer.Size();
+				block.data = alloc.Alloc(block.size);
+				if (block.data) {
+					touch(block.data, block.size);
+					live += block.size;
+				}
+				else
+					stat.fails.fetch_add(1, std::memory_order_relaxed);
+				while (!queues[p]->Push(std::move(block)))
+					std::this_thread::yield();
+				stat.live.store(live, std::memory_order_relaxed);
+			}
+			});
+		workers.emplace_back([&, p] {
+			ThreadStat& stat = stats[2 * p + 1];
+			int64_t freed{ 0 };
+			for (size_t i = 0; i < per_pair;) {
+				Block block;
+				if (!queues[p]->Pop(block)) {
+					std::this_thread::yield();
+					continue;
+				}
+				if (block.data) {
+					alloc.Free(block.data, block.size);
+					freed += block.size;
+				}
+				stat.live.store(-freed, std::memory_order_relaxed);
+				i++;
+			}
+			});
+	}
+	for (auto& var : workers)
+		var.join();
+	for (auto& var : stats)
+		var.live.store(0, std::memory_order_relaxed);
+}
+
+template<typename Alloc>
+CaseResult_t run_case(const BenchInfo_t& info, const std::string& pattern, const std::string& mix, size_t threads) {
+	CaseResult_t result;
+#ifdef __GLIBC__
+	malloc_trim(0); //what the previous cases freed is not taken for this one's
+#endif
+	const size_t rss0 = rss_bytes();
+	std::unique_ptr<Alloc> alloc(new Alloc());
+	std::vector<ThreadStat> stats(threads);
+	const size_t window = std::max<size_t>(8, std::min<size_t>(4096, info.liveMB * 1024 * 1024 / (threads * Sizer::Mean(mix))));
+
+	//the peaks of the live bytes and the rss are sampled meanwhile.
+	std::atomic_bool b_running{ true };
+	std::thread sampler([&] {
+		while (b_running) {
+			int64_t live{ 0 };
+			for (auto& var : stats)
+				live += var.live.load(std::memory_order_relaxed);
+			const size_t rss = rss_bytes();
+			result.livePeak = std::max(result.livePeak, live);
+			result.rssPeak = std::max(result.rssPeak, rss > rss0 ? rss - rss0 : 0);
+			std::this_thread::sleep_for(std::chrono::microseconds(SampleUs));
+		}
+		});
+	Timer timer;
+	if (pattern == "xthread")
+		run_xthread(*alloc, mix, threads, info.ops, window, stats);
+	else
+		run_local(*alloc, mix, threads, info.ops, window, stats);
+	result.secs = timer.elapsed_micro() / 1000000.0;
+	b_running = false;
+	sampler.join();
+
+	const size_t rss = rss_bytes();
+	result.retained = rss > rss0 ? rss - rss0 : 0;
+	for (auto& var : stats)
+		result.fails += var.fails.load();
+	return result;
+}
+
+std::vector<std::string> split(const std::string& str, char sep) {
+	std::vector<std::string> parts;
+	std::stringstream sstr(str);
+	std::string part;
+	while (std::getline(sstr, part, sep))
+		parts.emplace_back(part);
+	return parts;
+}
+
+//--key=value or --key value, 0: ok, -1: a bad option.
+int parse_args(int argc, char** argv, BenchInfo_t& info) {
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		if (arg.compare(0, 2, "--") != 0)
+			return -1;
+		std::string key = arg.substr(2), value;
+		auto pos = key.find('=');
+		if (pos != std::string::npos) {
+			value = key.substr(pos + 1);
+			key = key.substr(0, pos);
+		}
+		else if (i + 1 < argc)
+			value = argv[++i];
+		try
+		{
+			if (key == "alloc")
+				info.allocs = split(value, ',');
+			else if (key == "pattern")
+				info.patterns = split(value, ',');
+			else if (key == "mix")
+				info.mixes = split(value, ',');
+			else if (key == "threads") {
+				info.threads.clear();
+				for (auto& var : split(value, ','))
+					info.threads.emplace_back(std::max<size_t>(1, std::stoull(var)));
+			}
+			else if (key == "ops")
+				info.ops = std::max<size_t>(1, std::stoull(value));
+			else if (key == "live")
+				info.liveMB = std::max<size_t>(1, std::stoull(value));
+			else if (key == "out")
+				info.out = value;
+			else
+				return -1;
+		}
+		catch (const std::exception&)
+		{
+			return -1;
+		}
+	}
+	return 0;
+}
+
+int main(int argc, char** argv) {
+	BenchInfo_t info;
+	if (parse_args(argc, argv, info) < 0) {
+		fprintf(stderr, "usage: %s [--alloc=storage,pool,mempool,malloc] [--pattern=local,xthread] [--mix=small,body,chunk] "
+			"[--threads=1,2,8,32] [--ops=500000] [--live=64] [--out=file.csv]\n", argv[0]);
+		return 2;
+	}
+	std::ofstream ofs;
+	if (!info.out.empty())
+		ofs.open(info.out, std::ofstream::out | std::ofstream::trunc);
+	const char* header = "alloc,pattern,mix,threads,ops,secs,ns_op,mops_s,live_peak_kb,rss_peak_kb,frag_pct,retained_kb,fails";
+	printf("%s\n", header);
+	if (ofs.is_open())
+		ofs << header << std::endl;
+
+	for (auto& alloc : info.allocs) {
+		for (auto& pattern : info.patterns) {
+			for (auto& mix : info.mixes) {
+				for (auto threads : info.threads) {
+					if (pattern == "xthread" && threads < 2)
+						continue; //a producer and a consumer at least
+					CaseResult_t result;
+					if (alloc == "storage")
+						result = run_case<StorageAlloc>(info, pattern, mix, threads);
+					else if (alloc == "pool")
+						result = run_case<PoolAlloc>(info, pattern, mix, threads);
+					else if (alloc == "mempool")
+						result = run_case<MemPoolAlloc>(info, pattern, mix, threads);
+					else if (alloc == "malloc")
+						result = run_case<MallocAlloc>(info, pattern, mix, threads);
+					else {
+						fprintf(stderr, "unknown allocator %s\n", alloc.c_str());
+						return 2;
+					}
+
+					//ns_op is the time of a thread per alloc+free pair, as the threads may share the cores.
+					const size_t ops = pattern == "xthread" ? info.ops / std::max<size_t>(1, threads / 2) * std::max<size_t>(1, threads / 2) : \
+						info.ops / threads * threads;
+					const double ns_op = ops > 0 ? result.secs * 1e9 * threads / ops : 0;
+					const double frag = result.livePeak > 0 ? ((double)result.rssPeak / result.livePeak - 1) * 100 : 0;
+					char line[512] = { 0 };
+					snprintf(line, sizeof(line), "%s,%s,%s,%zu,%zu,%.3f,%.1f,%.2f,%lld,%zu,%.1f,%zu,%llu", alloc.c_str(), pattern.c_str(), \
+						mix.c_str(), threads, ops, result.secs, ns_op, result.secs > 0 ? ops / result.secs / 1e6 : 0, \
+						(long long)(result.livePeak / 1024), result.rssPeak / 1024, frag, result.retained / 1024, (unsigned long long)result.fails);
+					printf("%s\n", line);
+					fflush(stdout);
+					if (ofs.is_open())
+						ofs << line << std::endl;
+				}
+			}
+		}
+	}
+	return 0;
+}
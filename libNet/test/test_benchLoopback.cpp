@@ -0,0 +1,661 @@
+//========================================================================
+//[File Name]:test_benchLoopback.cpp
+//[Description]: a loopback benchmark of the tcp stack. ServerTcp echoes
+//               the messages of ConnectorTcp or Client sessions, in the
+//               sync mode(blocking Send/Recieve, the sync server workers)
+//               or the async one, swept over the message size, the
+//               connections and the messages in flight per connection.
+//               a case is a csv line: msgs/s, MB/s(payload, one way),
+//               cpu us/msg(both ends run in this process) and the rtt
+//               percentiles. --baseline compares with a saved csv, the
+//               exit code is 1 if a case regressed over --tolerance(%).
+//               --arena takes the blocks of all pools from a BlockArena
+//               (heap, mmap, thp or hugetlb), --prefault(MB) maps and
+//               touches it first. the dtlb load misses per message are of
+//               the whole case, empty where the cpu counters can't be read.
+//               usage: test_benchLoopback [--mode=sync,async]
+//               [--client=connector,client] [--sizes=16,1024,65536,1048576]
+//               [--conns=1,100,1000] [--depth=1,16] [--secs=2] [--threads=4]
+//               [--max-inflight=256(MB)] [--out=file.csv] [--baseline=file.csv]
+//               [--tolerance=10] [--port=9950] [--arena=none] [--prefault=0]
+//[Author]:Nico Hu
+//[Date]:2020-08-10
+//[Other]:Copyright (c) 2020-2050 Nico Hu
+//========================================================================
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "../stream/Server.h"
+#include "../stream/Connector.h"
+#include "../stream/Client.h"
+#include "../com/BlockArena.h"
+#include "../com/Histogram.h"
+#include "Timer.h"
+
+using namespace Net;
+using namespace Net::Stream;
+
+#define Backlog (4096)
+#define DrainMs (2000)
+
+struct BenchInfo_t {
+	std::vector<std::string> modes{ "sync", "async" };
+	std::vector<std::string> clients{ "connector" };
+	std::vector<size_t> sizes{ 16, 1024, 1024 * 64, 1024 * 1024 };
+	std::vector<size_t> conns{ 1, 100, 1000 };
+	std::vector<size_t> depths{ 1, 16 };
+	double secs{ 2 };
+	size_t threads{ 4 };		//the io threads of each end, the sync server workers, the client thread pairs in sync mode
+	size_t maxInflightMB{ 256 };	//the cases with more bytes in flight are skipped
+	std::string out;
+	std::string baseline;
+	double tolerance{ 10 };
+	short port{ 9950 };
+	std::string arena{ "none" };	//none: the heap blocks of the pools
+	size_t prefaultMB{ 0 };
+};
+
+struct BenchResult_t {
+	std::string mode;
+	std::string client;
+	size_t size{ 0 };
+	size_t conns{ 0 };
+	size_t depth{ 0 };
+	uint64_t msgs{ 0 };
+	double secs{ 0 };
+	double msgsPerSec{ 0 };
+	double mbPerSec{ 0 };
+	double cpuUsPerMsg{ 0 };
+	double p50{ 0 };	//rtt in us
+	double p99{ 0 };
+	double p999{ 0 };
+	double max{ 0 };
+	uint64_t errors{ 0 };
+	std::string arena;
+	double dtlbPerMsg{ -1 };	//-1: no counter
+
+	std::string Key() const {
+		return mode + "," + client + "," + std::to_string(size) + "," + std::to_string(conns) + "," + std::to_string(depth);
+	}
+};
+
+int64_t now_ns() {
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+//the cpu time of the process in seconds.
+double cpu_seconds() {
+#ifdef __linux__
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1000000.0;
+#else
+	return static_cast<double>(std::clock()) / CLOCKS_PER_SEC;
+#endif
+}
+
+//the dtlb load misses of the process and of the threads it makes from now on, -1 if there is no counter.
+int open_dtlb() {
+#ifdef __linux__
+	struct perf_event_attr attr;
+	memset(&attr, 0, sizeof(attr));
+	attr.size = sizeof(attr);
+	attr.type = PERF_TYPE_HW_CACHE;
+	attr.config = PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+	attr.inherit = 1;
+	attr.exclude_hv = 1;
+	int fd = static_cast<int>(syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0));
+	if (fd < 0) {
+		attr.exclude_kernel = 1;	//the user space only, if the kernel is not allowed
+		fd = static_cast<int>(syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0));
+	}
+	return fd;
+#else
+	return -1;
+#endif
+}
+//the count so far, the threads which ended are in it. the counter is closed.
+int64_t close_dtlb(int fd) {
+	if (fd < 0)
+		return -1;
+	int64_t count{ -1 };
+#ifdef __linux__
+	uint64_t value{ 0 };
+	if (read(fd, &value, sizeof(value)) == static_cast<ssize_t>(sizeof(value)))
+		count = static_cast<int64_t>(value);
+	close(fd);
+#endif
+	return count;
+}
+
+//a connection of the client side. the send stamps of the messages in flight are a ring of depth, the
+//sender adds at tail and the receiver takes at head, a message is echoed when size bytes came back.
+struct Conn {
+	size_t index{ 0 };
+	SessionId id{ -1 };
+	std::vector<int64_t> sent;
+	size_t head{ 0 };
+	size_t tail{ 0 };
+	size_t recvBytes{ 0 };
+	std::atomic<size_t> inflight{ 0 };
+	std::atomic<uint64_t> done{ 0 };
+	std::atomic_bool bDead{ false };
+};
+
+struct Bench {
+	const uint64_t id{ NextId()++ };
+	size_t size{ 0 };
+	size_t depth{ 0 };
+	std::vector<char> msg;
+	std::vector<std::unique_ptr<Conn>> conns;
+	std::atomic_bool bRunning{ true };
+	std::atomic_bool bMeasure{ false };
+	std::atomic<uint64_t> errors{ 0 };
+	std::mutex mtx;
+	std::vector<std::unique_ptr<Histogram>> hists;	//one per thread which takes echoes
+
+	Histogram* NewHist() {
+		std::lock_guard<std::mutex> lock(mtx);
+		hists.emplace_back(new Histogram());
+		return hists.back().get();
+	}
+	uint64_t Done() const {
+		uint64_t n{ 0 };
+		for (auto& var : conns)
+			n += var->done.load(std::memory_order_relaxed);
+		return n;
+	}
+	size_t Inflight() const {
+		size_t n{ 0 };
+		for (auto& var : conns) {
+			if (!var->bDead)
+				n += var->inflight.load(std::memory_order_relaxed);
+		}
+		return n;
+	}
+	void Fail(Conn& conn) {
+		conn.bDead = true;
+		if (bRunning)
+			errors++;
+	}
+	static std::atomic<uint64_t>& NextId() {
+		static std::atomic<uint64_t> id{ 1 };
+		return id;
+	}
+};
+
+//the histogram of the thread for the bench of the case by its id.
+thread_local uint64_t t_bench{ 0 };
+thread_local Histogram* t_hist{ nullptr };
+
+Histogram* local_hist(Bench& bench) {
+	if (t_bench != bench.id) {
+		t_bench = bench.id;
+		t_hist = bench.NewHist();
+	}
+	return t_hist;
+}
+
+void stamp(Bench& bench, Conn& conn) {
+	conn.sent[conn.tail] = now_ns();
+	conn.tail = (conn.tail + 1) % bench.depth;
+	conn.inflight.fetch_add(1, std::memory_order_release);
+}
+
+//len bytes came back on conn, return the messages echoed.
+size_t on_echo(Bench& bench, Conn& conn, size_t len) {
+	conn.recvBytes += len;
+	size_t n{ 0 };
+	while (conn.recvBytes >= bench.size && conn.inflight.load(std::memory_order_acquire) > 0) {
+		conn.recvBytes -= bench.size;
+		const int64_t rtt = now_ns() - conn.sent[conn.head];
+		conn.head = (conn.head + 1) % bench.depth;
+		if (bench.bMeasure)
+			local_hist(bench)->Record(static_cast<uint64_t>(rtt));
+		conn.done.store(conn.done.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+		conn.inflight.fetch_sub(1, std::memory_order_acq_rel);
+		n++;
+	}
+	return n;
+}
+
+class ConnectorDriver {
+public:
+	ConnectorDriver(io_context& io_c, const Codec& codec) :
+		connector_(std::make_shared<ConnectorTcp>(io_c, "127.0.0.1", 0, 0, codec)) { }
+
+	SessionId Open(short port) { return connector_->Open("127.0.0.1", port); }
+	int Send(Conn& conn, const char* data, unsigned len, uint8_t& ec) { return connector_->Send(conn.id, data, len, ec); }
+	int AsyncSend(Conn& conn, const char* data, unsigned len) { return connector_->AsyncSend(conn.id, data, len); }
+	int Recieve(Conn& conn, char** data, uint8_t& ec) { return connector_->Recieve(conn.id, data, ec); }
+	int AsyncRecieve(Conn& conn, CBAsyncRecv cb) { return connector_->AsyncRecieve(conn.id, cb); }
+	void Close(Conn& conn) { connector_->Close(conn.id); }
+
+private:
+	std::shared_ptr<ConnectorTcp> connector_;
+};
+
+//a Client per connection.
+class ClientDriver {
+public:
+	ClientDriver(io_context& io_c, const Codec& codec) : ioCtx_(io_c), codec_(codec) { }
+
+	SessionId Open(short port) {
+		auto client = std::make_shared<Client>(ioCtx_, "127.0.0.1", 0, 0, codec_);
+		SessionId id = client->Open("127.0.0.1", port);
+		if (id >= 0)
+			clients_.emplace_back(client);
+		return id;
+	}
+	int Send(Conn& conn, const char* data, unsigned len, uint8_t& ec) { return clients_[conn.index]->Send(data, len, ec); }
+	int AsyncSend(Conn& conn, const char* data, unsigned len) { return clients_[conn.index]->AsyncSend(data, len); }
+	int Recieve(Conn& conn, char** data, uint8_t& ec) { return clients_[conn.index]->Recieve(data, ec); }
+	int AsyncRecieve(Conn& conn, CBAsyncRecv cb) { return clients_[conn.index]->AsyncRecieve(conn.id, cb); }
+	void Close(Conn& conn) { clients_[conn.index]->Close(); }
+
+private:
+	io_context& ioCtx_;
+	Codec codec_;
+	std::vector<std::shared_ptr<Client>> clients_;
+};
+
+template<typename Driver>
+void async_send(Driver& driver, Bench& bench, Conn& conn) {
+	stamp(bench, conn);
+	if (driver.AsyncSend(conn, bench.msg.data(), static_cast<unsigned>(bench.size)) < 0)
+		bench.Fail(conn);
+}
+
+//the read is armed again from its callback, which sends a message for each one echoed.
+template<typename Driver>
+void async_recieve(Driver& driver, Bench& bench, Conn& conn) {
+	int ret = driver.AsyncRecieve(conn, [&driver, &bench, &conn](SessionId id, char* data, unsigned len, uint8_t ec) {
+		if (data == nullptr) {
+			bench.Fail(conn);
+			return;
+		}
+		const size_t n = on_echo(bench, conn, len);
+		for (size_t i = 0; i < n && bench.bRunning; i++)
+			async_send(driver, bench, conn);
+		async_recieve(driver, bench, conn);
+		});
+	if (ret < 0)
+		bench.Fail(conn);
+}
+
+//a sender keeps depth messages in flight on each of its connections, a receiver takes the echoes of the
+//connections with messages in flight(a blocking writer which doesn't read would fill the socket buffers).
+template<typename Driver>
+void sync_sender(Driver& driver, Bench& bench, const std::vector<Conn*>& conns) {
+	while (bench.bRunning) {
+		bool b_sent{ false };
+		for (auto conn : conns) {
+			if (conn->bDead || conn->inflight.load(std::memory_order_acquire) >= bench.depth)
+				continue;
+			stamp(bench, *conn);
+			uint8_t ec{ 0 };
+			if (driver.Send(*conn, bench.msg.data(), static_cast<unsigned>(bench.size), ec) != static_cast<int>(bench.size))
+				bench.Fail(*conn);
+			b_sent = true;
+		}
+		if (!b_sent)
+			std::this_thread::yield();
+	}
+}
+template<typename Driver>
+void sync_receiver(Driver& driver, Bench& bench, const std::vector<Conn*>& conns) {
+	while (true) {
+		bool b_waiting{ false };
+		for (auto conn : conns) {
+			if (conn->bDead || conn->inflight.load(std::memory_order_acquire) == 0)
+				continue;
+			b_waiting = true;
+			char* data{ nullptr };
+			uint8_t ec{ 0 };
+			const int len = driver.Recieve(*conn, &data, ec);
+			if (len <= 0) {
+				bench.Fail(*conn);
+				continue;
+			}
+			on_echo(bench, *conn, static_cast<size_t>(len));
+		}
+		if (!b_waiting) {
+			if (!bench.bRunning)
+				break;
+			std::this_thread::yield();
+		}
+	}
+}
+
+template<typename Driver>
+BenchResult_t run_case(const BenchInfo_t& info, BenchResult_t result, short port) {
+	const bool b_sync = result.mode == "sync";
+	const Codec codec(E_CODEC_T::e_Len32);
+	const int dtlb_fd = open_dtlb();	//before the threads of the case
+
+	io_context io_server;
+	auto work_server = std::make_shared<io_context::work>(io_server);
+	std::vector<std::thread> server_threads;
+	for (size_t i = 0; i < (b_sync ? 1 : info.threads); i++)
+		server_threads.emplace_back([&] { io_server.run(); });
+	std::shared_ptr<ServerTcp> server(new ServerTcp(io_server, "127.0.0.1", port, 0, codec, Backlog));
+	std::weak_ptr<ServerTcp> wk_server = server;
+	server->SetReceiveCB([wk_server, b_sync](SessionId id, const char* data, size_t len, uint8_t ec) {
+		auto server = wk_server.lock();
+		if (!server || data == nullptr || len == 0)
+			return;
+		uint8_t err_code{ 0 };
+		if (b_sync)
+			server->Send(id, data, static_cast<unsigned>(len), err_code);
+		else
+			server->AsyncSend(id, data, static_cast<unsigned>(len));
+		});
+	if (b_sync) {
+		server->SetSyncWorkers(info.threads);
+		server->Start();
+	}
+	else
+		server->StartA();
+
+	io_context io_client;
+	auto work_client = std::make_shared<io_context::work>(io_client);
+	std::vector<std::thread> client_threads;
+	for (size_t i = 0; i < (b_sync ? 1 : info.threads); i++)
+		client_threads.emplace_back([&] { io_client.run(); });
+	Driver driver(io_client, codec);
+	Bench bench;
+	bench.size = result.size;
+	bench.depth = result.depth;
+	bench.msg.assign(result.size, 'b');
+	for (size_t i = 0; i < result.conns; i++) {
+		SessionId id = driver.Open(port);
+		if (id < 0) {
+			bench.errors++;
+			break;
+		}
+		bench.conns.emplace_back(new Conn());
+		bench.conns.back()->index = i;
+		bench.conns.back()->id = id;
+		bench.conns.back()->sent.resize(result.depth);
+	}
+
+	std::vector<std::thread> sync_threads;
+	if (b_sync) {
+		const size_t groups = std::min(info.threads, bench.conns.size());
+		for (size_t g = 0; g < groups; g++) {
+			std::vector<Conn*> conns;
+			for (size_t i = g; i < bench.conns.size(); i += groups)
+				conns.emplace_back(bench.conns[i].get());
+			sync_threads.emplace_back([&, conns] { sync_sender(driver, bench, conns); });
+			sync_threads.emplace_back([&, conns] { sync_receiver(driver, bench, conns); });
+		}
+	}
+	else {
+		for (auto& var : bench.conns) {
+			for (size_t i = 0; i < bench.depth; i++)
+				async_send(driver, bench, *var);
+			async_recieve(driver, bench, *var);
+		}
+	}
+
+	//a warmup, then the window which is measured.
+	std::this_thread::sleep_for(std::chrono::milliseconds(static_cast<int64_t>(std::min(500.0, info.secs * 200))));
+	const uint64_t msgs0 = bench.Done();
+	const double cpu0 = cpu_seconds();
+	bench.bMeasure = true;
+	Timer timer;
+	std::this_thread::sleep_for(std::chrono::milliseconds(static_cast<int64_t>(info.secs * 1000)));
+	bench.bMeasure = false;
+	const double secs = timer.elapsed_micro() / 1000000.0;
+	const uint64_t msgs = bench.Done() - msgs0;
+	const double cpu = cpu_seconds() - cpu0;
+
+	//the messages in flight are echoed before the connections are closed.
+	bench.bRunning = false;
+	for (int i = 0; i < DrainMs / 10 && bench.Inflight() > 0; i++)
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	for (auto& var : bench.conns) {
+		var->bDead = true;
+		driver.Close(*var);
+	}
+	for (auto& var : sync_threads)
+		var.join();
+	server->Stop();
+	work_client = nullptr;
+	work_server = nullptr;
+	io_client.stop();
+	io_server.stop();
+	for (auto& var : client_threads)
+		var.join();
+	for (auto& var : server_threads)
+		var.join();
+	//the aborted reads of the closed sockets hold their handlers, which free into the pools of the
+	//clients and the server, so they are run before those are gone.
+	io_client.restart();
+	io_client.poll();
+	io_server.restart();
+	io_server.poll();
+	const int64_t dtlb = close_dtlb(dtlb_fd);
+	const uint64_t all_msgs = bench.Done();
+
+	std::unique_ptr<Histogram> rtt(new Histogram());
+	for (auto& var : bench.hists)
+		rtt->Merge(*var);
+	result.msgs = msgs;
+	result.secs = secs;
+	result.msgsPerSec = secs > 0 ? msgs / secs : 0;
+	result.mbPerSec = result.msgsPerSec * result.size / (1024.0 * 1024.0);
+	result.cpuUsPerMsg = msgs > 0 ? cpu * 1000000.0 / msgs : 0;
+	result.p50 = rtt->Percentile(50) / 1000.0;
+	result.p99 = rtt->Percentile(99) / 1000.0;
+	result.p999 = rtt->Percentile(99.9) / 1000.0;
+	result.max = rtt->Max() / 1000.0;
+	result.errors = bench.errors;
+	result.dtlbPerMsg = dtlb >= 0 && all_msgs > 0 ? static_cast<double>(dtlb) / all_msgs : -1;
+	return result;
+}
+
+std::vector<std::string> split(const std::string& str, char sep) {
+	std::vector<std::string> parts;
+	std::stringstream sstr(str);
+	std::string part;
+	while (std::getline(sstr, part, sep))
+		parts.emplace_back(part);
+	return parts;
+}
+std::vector<size_t> split_sizes(const std::string& str) {
+	std::vector<size_t> sizes;
+	for (auto& var : split(str, ','))
+		sizes.emplace_back(std::stoull(var));
+	return sizes;
+}
+
+//--key=value or --key value, 0: ok, -1: a bad option.
+int parse_args(int argc, char** argv, BenchInfo_t& info) {
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		if (arg.compare(0, 2, "--") != 0)
+			return -1;
+		std::string key = arg.substr(2), value;
+		auto pos = key.find('=');
+		if (pos != std::string::npos) {
+			value = key.substr(pos + 1);
+			key = key.substr(0, pos);
+		}
+		else if (i + 1 < argc)
+			value = argv[++i];
+		try
+		{
+			if (key == "mode")
+				info.modes = split(value, ',');
+			else if (key == "client")
+				info.clients = split(value, ',');
+			else if (key == "sizes")
+				info.sizes = split_sizes(value);
+			else if (key == "conns")
+				info.conns = split_sizes(value);
+			else if (key == "depth")
+				info.depths = split_sizes(value);
+			else if (key == "secs")
+				info.secs = std::stod(value);
+			else if (key == "threads")
+				info.threads = std::max<size_t>(1, std::stoull(value));
+			else if (key == "max-inflight")
+				info.maxInflightMB = std::stoull(value);
+			else if (key == "out")
+				info.out = value;
+			else if (key == "baseline")
+				info.baseline = value;
+			else if (key == "tolerance")
+				info.tolerance = std::stod(value);
+			else if (key == "port")
+				info.port = static_cast<short>(std::stoi(value));
+			else if (key == "arena" && (value == "none" || value == "heap" || value == "mmap" || value == "thp" || value == "hugetlb"))
+				info.arena = value;
+			else if (key == "prefault")
+				info.prefaultMB = std::stoull(value);
+			else
+				return -1;
+		}
+		catch (const std::exception&)
+		{
+			return -1;
+		}
+	}
+	return 0;
+}
+
+//the msgs/s and the rtt p99 of the cases of a saved csv by key.
+std::map<std::string, std::pair<double, double>> load_baseline(const std::string& path) {
+	std::map<std::string, std::pair<double, double>> baseline;
+	std::ifstream ifs(path);
+	std::string line;
+	while (std::getline(ifs, line)) {
+		auto fields = split(line, ',');
+		if (fields.size() < 15 || fields[0] == "mode")
+			continue;
+		const std::string key = fields[0] + "," + fields[1] + "," + fields[2] + "," + fields[3] + "," + fields[4];
+		baseline[key] = std::make_pair(std::stod(fields[7]), std::stod(fields[11]));
+	}
+	return baseline;
+}
+
+int main(int argc, char** argv) {
+	BenchInfo_t info;
+	if (parse_args(argc, argv, info) < 0) {
+		fprintf(stderr, "usage: %s [--mode=sync,async] [--client=connector,client] [--sizes=16,1024] [--conns=1,100] [--depth=1,16] "
+			"[--secs=2] [--threads=4] [--max-inflight=256] [--out=file.csv] [--baseline=file.csv] [--tolerance=10] [--port=9950] "
+			"[--arena=none,heap,mmap,thp,hugetlb] [--prefault=0(MB)]\n", argv[0]);
+		return 2;
+	}
+	AsyncLogger::SetLevel(E_LOG_LEV_T::e_Warning); //the connects and closes are not logged
+#ifdef __linux__
+	//a socket per connection on each end
+	struct rlimit limit;
+	if (getrlimit(RLIMIT_NOFILE, &limit) == 0) {
+		limit.rlim_cur = limit.rlim_max;
+		setrlimit(RLIMIT_NOFILE, &limit);
+	}
+#endif
+
+	//the storages of the servers and clients made from now on carve the arena
+	std::shared_ptr<BlockArena> arena;
+	if (info.arena != "none") {
+		BlockArenaInfo_t arena_info;
+		arena_info.bHugeTlb = info.arena == "hugetlb";
+		arena_info.bThp = info.arena == "hugetlb" || info.arena == "thp";
+		arena_info.bMap = info.arena != "heap";
+		arena_info.bPrefault = info.prefaultMB > 0;
+		arena_info.initBytes = info.prefaultMB * 1024 * 1024;
+		arena = std::make_shared<BlockArena>(arena_info);
+		BlockArena::SetDefault(arena);
+	}
+
+	auto baseline = info.baseline.empty() ? std::map<std::string, std::pair<double, double>>() : load_baseline(info.baseline);
+	std::ofstream ofs;
+	if (!info.out.empty())
+		ofs.open(info.out, std::ofstream::out | std::ofstream::trunc);
+	std::string header = "mode,client,size,conns,depth,msgs,secs,msgs_s,mb_s,cpu_us_msg,rtt_p50_us,rtt_p99_us,rtt_p999_us,rtt_max_us,errors,arena,dtlb_miss_msg";
+	if (!baseline.empty())
+		header += ",base_msgs_s,msgs_s_pct,base_rtt_p99_us,rtt_p99_pct,verdict";
+	printf("%s\n", header.c_str());
+	if (ofs.is_open())
+		ofs << header << std::endl;
+
+	int regressed{ 0 };
+	short port = info.port;
+	for (auto& mode : info.modes) {
+		for (auto& client : info.clients) {
+			for (auto size : info.sizes) {
+				for (auto conns : info.conns) {
+					for (auto depth : info.depths) {
+						if (size * conns * depth > info.maxInflightMB * 1024 * 1024 || size == 0 || conns == 0 || depth == 0) {
+							fprintf(stderr, "skip %s,%s,%zu,%zu,%zu: over --max-inflight\n", mode.c_str(), client.c_str(), size, conns, depth);
+							continue;
+						}
+						BenchResult_t result;
+						result.mode = mode;
+						result.client = client;
+						result.size = size;
+						result.conns = conns;
+						result.depth = depth;
+						result.arena = info.arena;
+						//a port per case, the closed connections of the previous one may hold theirs.
+						if (client == "client")
+							result = run_case<ClientDriver>(info, result, port++);
+						else
+							result = run_case<ConnectorDriver>(info, result, port++);
+
+						char line[512] = { 0 };
+						int len = snprintf(line, sizeof(line), "%s,%s,%zu,%zu,%zu,%llu,%.3f,%.1f,%.2f,%.3f,%.1f,%.1f,%.1f,%.1f,%llu,%s,", \
+							result.mode.c_str(), result.client.c_str(), result.size, result.conns, result.depth, (unsigned long long)result.msgs, \
+							result.secs, result.msgsPerSec, result.mbPerSec, result.cpuUsPerMsg, result.p50, result.p99, result.p999, result.max, \
+							(unsigned long long)result.errors, result.arena.c_str());
+						if (result.dtlbPerMsg >= 0)
+							len += snprintf(line + len, sizeof(line) - len, "%.2f", result.dtlbPerMsg);
+						auto find = baseline.find(result.Key());
+						if (find != baseline.end()) {
+							const double msgs_pct = find->second.first > 0 ? (result.msgsPerSec / find->second.first - 1) * 100 : 0;
+							const double p99_pct = find->second.second > 0 ? (result.p99 / find->second.second - 1) * 100 : 0;
+							const bool b_regressed = msgs_pct < -info.tolerance || p99_pct > info.tolerance;
+							regressed += b_regressed ? 1 : 0;
+							snprintf(line + len, sizeof(line) - len, ",%.1f,%.1f,%.1f,%.1f,%s", find->second.first, msgs_pct, find->second.second, \
+								p99_pct, b_regressed ? "REGRESSED" : "ok");
+						}
+						else if (!baseline.empty())
+							snprintf(line + len, sizeof(line) - len, ",,,,,new");
+						printf("%s\n", line);
+						fflush(stdout);
+						if (ofs.is_open())
+							ofs << line << std::endl;
+					}
+				}
+			}
+		}
+	}
+	if (arena) {
+		BlockArena::SetDefault(nullptr);
+		const ArenaUsage_t usage = arena->GetUsage();
+		fprintf(stderr, "arena %s: regions=%zu(hugetlb=%zu thp=%zu mmap=%zu heap=%zu) mapped=%zuMB fallbacks=%llu\n", info.arena.c_str(), \
+			usage.regions, usage.hugeTlbRegions, usage.thpRegions, usage.normalRegions, usage.heapRegions, usage.bytesMapped / (1024 * 1024), \
+			(unsigned long long)usage.fallbacks);
+	}
+	return regressed > 0 ? 1 : 0;
+}
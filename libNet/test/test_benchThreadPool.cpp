@@ -0,0 +1,372 @@
+//========================================================================
+//[File Name]:test_benchThreadPool.cpp
+//[Description]: a benchmark of the work-stealing ThreadPool against the
+//               pool it replaced(all the workers fed by one SyncTaskQueue,
+//               kept here as QueuePool). submit: a thread out of the pool
+//               adds the tasks one by one, bulk: by batches of 256(AddTasks,
+//               one by one for the old pool which has no batch), spawn: each
+//               task adds two more down to a depth, as a divide and conquer
+//               job does(the new pool only, the workers of the old one block
+//               on its full queue and wait for each other), latency: a task
+//               at a time on an idle pool, the delay from its add to its run,
+//               mixed: a burst of bulk tasks of 200us, then realtime tasks at
+//               a time, the delay of the realtime ones(by lanes for the new
+//               pool, all in the normal lane for nolanes, the new pool too).
+//               a case is a csv line: ns per task(the time of all the tasks
+//               over their number), the percentiles of the latency, the
+//               lines the pool wrote to std::cout and the tasks not run.
+//               usage: test_benchThreadPool [--pool=old,new,nolanes]
+//               [--case=submit,bulk,spawn,latency,mixed] [--threads=1,2,4]
+//               [--tasks=200000] [--out=file.csv]
+//[Author]:Nico Hu
+//[Date]:2020-08-10
+//[Other]:Copyright (c) 2020-2050 Nico Hu
+//========================================================================
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <list>
+#include <sstream>
+#include <streambuf>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cstdio>
+
+#include "../com/ThreadPool.h"
+#include "../com/SyncTaskQueue.h"
+#include "../com/Timer.h"
+
+#define BulkSize (256)
+#define LatencyTasks (5000)
+#define LatencyGapUs (20)
+#define MixedBulk (900)		//below the 1000 of the old pool, so its producer doesn't wait
+#define MixedBulkUs (200)
+#define MixedProbes (200)
+#define MixedGapUs (200)
+
+using Thread::E_TASK_PRI_T;
+
+struct BenchInfo_t {
+	std::vector<std::string> pools{ "old", "new", "nolanes" };
+	std::vector<std::string> cases{ "submit", "bulk", "spawn", "latency", "mixed" };
+	std::vector<size_t> threads{ 1, 2, 4 };
+	size_t tasks{ 200000 };
+	std::string out;
+};
+
+//the pool as it was: the workers take the whole queue at a time, a producer waits while 1000 are queued.
+class QueuePool {
+public:
+	using Task = std::function<void()>;
+	QueuePool() : taskQueue_(1000) { }
+	~QueuePool() { Stop(); }
+
+	void Start(int num_threads) {
+		for (int i = 0; i < num_threads; ++i) {
+			threadGroup_.emplace_back(std::make_shared<std::thread>([this]() {
+				while (!bExit_) {
+					std::list<Task> list;
+					taskQueue_.Take(list);
+					for (auto& task : list) {
+						if (bExit_) return;
+						task();
+					}
+				}
+				}));
+		}
+	}
+	void Stop() {
+		std::call_once(flag_, [this] {
+			taskQueue_.Stop();
+			bExit_ = true;
+			for (auto thread : threadGroup_) {
+				if (thread && thread->joinable())
+					thread->join();
+			}
+			});
+	}
+	template<class F>
+	void AddTask(F&& f) {
+		Task t = [=] {return f(); };
+		taskQueue_.Put(t);
+	}
+
+protected:
+	std::list<std::shared_ptr<std::thread>> threadGroup_;
+	Thread::SyncTaskQueue<Task> taskQueue_;
+	std::atomic_bool bExit_{ false };
+	std::once_flag flag_;
+};
+
+//counts the lines written to std::cout instead of writing them.
+class LineCounter : public std::streambuf {
+public:
+	std::atomic<size_t> lines{ 0 };
+protected:
+	int overflow(int c) override {
+		if (c == '\n')
+			lines++;
+		return c;
+	}
+	std::streamsize xsputn(const char* s, std::streamsize n) override {
+		for (std::streamsize i = 0; i < n; i++) {
+			if (s[i] == '\n')
+				lines++;
+		}
+		return n;
+	}
+};
+
+struct CaseResult_t {
+	double secs{ 0 };
+	size_t tasks{ 0 };
+	size_t lost{ 0 };
+	uint64_t p50{ 0 }, p99{ 0 }, p999{ 0 };
+	size_t lines{ 0 };
+};
+
+uint64_t now_ns() {
+	return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+void wait_done(std::atomic<size_t>& done, size_t count, int timeout_ms) {
+	const uint64_t end = now_ns() + uint64_t(timeout_ms) * 1000000;
+	while (done.load(std::memory_order_acquire) < count && now_ns() < end)
+		std::this_thread::yield();
+}
+
+//a task's work: a few hundred ns, so the cost of the pool shows.
+inline void work(std::atomic<size_t>& done) {
+	volatile uint64_t x{ 0 };
+	for (int i = 0; i < 64; i++)
+		x = x + i;
+	done.fetch_add(1, std::memory_order_release);
+}
+
+//the percentiles of the waits, sorted.
+void percentiles(std::vector<uint64_t>& waits, CaseResult_t& result) {
+	if (waits.empty())
+		return;
+	std::sort(waits.begin(), waits.end());
+	auto at = [&waits](double percent) { return waits[std::min(waits.size() - 1, static_cast<size_t>(percent / 100.0 * waits.size()))]; };
+	result.p50 = at(50);
+	result.p99 = at(99);
+	result.p999 = at(99.9);
+}
+
+//the old pool has no priority, nor has the new one without its lanes.
+template<typename F>
+void add_pri(QueuePool& pool, E_TASK_PRI_T pri, bool b_lanes, F&& f) {
+	pool.AddTask(std::forward<F>(f));
+}
+template<typename F>
+void add_pri(Thread::ThreadPool& pool, E_TASK_PRI_T pri, bool b_lanes, F&& f) {
+	pool.AddTask(b_lanes ? pri : E_TASK_PRI_T::e_Normal, std::forward<F>(f));
+}
+
+template<typename Pool>
+void add_bulk(Pool& pool, std::vector<Thread::ThreadPool::Task>& batch) {
+	for (auto& var : batch)
+		pool.AddTask(var);
+	batch.clear();
+}
+template<>
+void add_bulk<Thread::ThreadPool>(Thread::ThreadPool& pool, std::vector<Thread::ThreadPool::Task>& batch) {
+	pool.AddTasks(std::move(batch));
+}
+
+//a task of depth d adds two of depth d - 1, 2^(d+1) - 1 tasks for the first one of depth d.
+void spawn(Thread::ThreadPool& pool, std::atomic<size_t>& done, int depth) {
+	if (depth > 0) {
+		pool.AddTask([&pool, &done, depth] { spawn(pool, done, depth - 1); });
+		pool.AddTask([&pool, &done, depth] { spawn(pool, done, depth - 1); });
+	}
+	work(done);
+}
+
+void spawn_root(Thread::ThreadPool& pool, std::atomic<size_t>& done, int depth) {
+	pool.AddTask([&pool, &done, depth] { spawn(pool, done, depth); });
+}
+void spawn_root(QueuePool& pool, std::atomic<size_t>& done, int depth) { }
+
+template<typename Pool>
+CaseResult_t run_case(const BenchInfo_t& info, const std::string& name, size_t threads, bool b_lanes) {
+	CaseResult_t result;
+	LineCounter counter;
+	std::streambuf* cout_buf = std::cout.rdbuf(&counter);
+	std::atomic<size_t> done{ 0 };
+	{
+		Pool pool;
+		pool.Start(static_cast<int>(threads));
+		//the workers park, or wait on the empty queue
+		std::this_thread::sleep_for(std::chrono::milliseconds(20));
+		Timer timer;
+		if (name == "submit") {
+			result.tasks = info.tasks;
+			for (size_t i = 0; i < result.tasks; i++)
+				pool.AddTask([&done] { work(done); });
+		}
+		else if (name == "bulk") {
+			result.tasks = info.tasks;
+			std::vector<Thread::ThreadPool::Task> batch;
+			for (size_t i = 0; i < result.tasks; i++) {
+				batch.emplace_back([&done] { work(done); });
+				if (batch.size() == BulkSize)
+					add_bulk(pool, batch);
+			}
+			if (!batch.empty())
+				add_bulk(pool, batch);
+		}
+		else if (name == "spawn") {
+			int depth{ 0 };
+			while ((size_t(2) << (depth + 1)) - 1 <= info.tasks)
+				depth++;
+			result.tasks = (size_t(2) << depth) - 1;
+			spawn_root(pool, done, depth);
+		}
+		else if (name == "latency") {
+			result.tasks = LatencyTasks;
+			std::vector<uint64_t> waits(result.tasks);
+			for (size_t i = 0; i < result.tasks; i++) {
+				const uint64_t added = now_ns();
+				pool.AddTask([&done, &waits, added, i] {
+					waits[i] = now_ns() - added;
+					done.fetch_add(1, std::memory_order_release);
+					});
+				std::this_thread::sleep_for(std::chrono::microseconds(LatencyGapUs));
+			}
+			wait_done(done, result.tasks, 10000);
+			percentiles(waits, result);
+		}
+		else if (name == "mixed") {
+			result.tasks = MixedBulk + MixedProbes;
+			for (size_t i = 0; i < MixedBulk; i++) {
+				add_pri(pool, E_TASK_PRI_T::e_Bulk, b_lanes, [&done] {
+					const uint64_t end = now_ns() + MixedBulkUs * 1000;
+					while (now_ns() < end) {}
+					done.fetch_add(1, std::memory_order_release);
+					});
+			}
+			std::vector<uint64_t> waits(MixedProbes);
+			for (size_t i = 0; i < MixedProbes; i++) {
+				const uint64_t added = now_ns();
+				add_pri(pool, E_TASK_PRI_T::e_Realtime, b_lanes, [&done, &waits, added, i] {
+					waits[i] = now_ns() - added;
+					done.fetch_add(1, std::memory_order_release);
+					});
+				std::this_thread::sleep_for(std::chrono::microseconds(MixedGapUs));
+			}
+			wait_done(done, result.tasks, 60000);
+			percentiles(waits, result);
+		}
+		wait_done(done, result.tasks, 60000);
+		result.secs = timer.elapsed_micro() / 1e6;
+		pool.Stop();
+	}
+	std::cout.rdbuf(cout_buf);
+	result.lost = result.tasks - std::min(result.tasks, done.load());
+	result.lines = counter.lines;
+	return result;
+}
+
+//--key=value or --key value, 0: ok, -1: a bad option.
+int parse_args(int argc, char** argv, BenchInfo_t& info) {
+	auto split = [](const std::string& value) {
+		std::vector<std::string> items;
+		std::stringstream ss(value);
+		std::string item;
+		while (std::getline(ss, item, ','))
+			if (!item.empty())
+				items.emplace_back(item);
+		return items;
+	};
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		if (arg.compare(0, 2, "--") != 0)
+			return -1;
+		std::string key = arg.substr(2), value;
+		auto pos = key.find('=');
+		if (pos != std::string::npos) {
+			value = key.substr(pos + 1);
+			key = key.substr(0, pos);
+		}
+		else if (i + 1 < argc)
+			value = argv[++i];
+		try
+		{
+			if (key == "pool")
+				info.pools = split(value);
+			else if (key == "case")
+				info.cases = split(value);
+			else if (key == "threads") {
+				info.threads.clear();
+				for (auto& var : split(value))
+					info.threads.emplace_back(std::max<size_t>(1, std::stoull(var)));
+			}
+			else if (key == "tasks")
+				info.tasks = std::max<size_t>(1, std::stoull(value));
+			else if (key == "out")
+				info.out = value;
+			else
+				return -1;
+		}
+		catch (const std::exception&)
+		{
+			return -1;
+		}
+	}
+	return 0;
+}
+
+int main(int argc, char** argv) {
+	BenchInfo_t info;
+	if (parse_args(argc, argv, info) < 0) {
+		fprintf(stderr, "usage: %s [--pool=old,new,nolanes] [--case=submit,bulk,spawn,latency,mixed] [--threads=1,2,4] [--tasks=200000] "
+			"[--out=file.csv]\n", argv[0]);
+		return 2;
+	}
+	std::ofstream ofs;
+	if (!info.out.empty())
+		ofs.open(info.out, std::ofstream::out | std::ofstream::trunc);
+	const char* header = "pool,case,threads,tasks,secs,ns_task,mtasks_s,p50_ns,p99_ns,p999_ns,console_lines,lost";
+	printf("%s\n", header);
+	if (ofs.is_open())
+		ofs << header << std::endl;
+
+	for (auto& pool : info.pools) {
+		for (auto& name : info.cases) {
+			for (auto threads : info.threads) {
+				CaseResult_t result;
+				if (pool == "old") {
+					if (name == "spawn")
+						continue;
+					result = run_case<QueuePool>(info, name, threads, false);
+				}
+				else if (pool == "new")
+					result = run_case<Thread::ThreadPool>(info, name, threads, true);
+				else if (pool == "nolanes") {
+					if (name != "mixed")
+						continue; //the same as new
+					result = run_case<Thread::ThreadPool>(info, name, threads, false);
+				}
+				else {
+					fprintf(stderr, "unknown pool %s\n", pool.c_str());
+					return 2;
+				}
+				char line[512] = { 0 };
+				snprintf(line, sizeof(line), "%s,%s,%zu,%zu,%.3f,%.1f,%.2f,%llu,%llu,%llu,%zu,%zu", pool.c_str(), name.c_str(), threads, \
+					result.tasks, result.secs, result.tasks > 0 ? result.secs * 1e9 / result.tasks : 0, \
+					result.secs > 0 ? result.tasks / result.secs / 1e6 : 0, (unsigned long long)result.p50, (unsigned long long)result.p99, \
+					(unsigned long long)result.p999, result.lines, result.lost);
+				printf("%s\n", line);
+				fflush(stdout);
+				if (ofs.is_open())
+					ofs << line << std::endl;
+			}
+		}
+	}
+	return 0;
+}
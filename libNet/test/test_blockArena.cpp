@@ -0,0 +1,222 @@
+//========================================================================
+//[File Name]:test_blockArena.cpp
+//[Description]: a test of BlockArena: the blocks, their alignment and
+//               reuse, the region got by each way of mapping and the
+//               fallbacks when the huge pages are not there, a prefaulted
+//               region, the pages of the freed blocks given back to the
+//               os, and a storage whose pools take their blocks from the
+//               default arena.
+//[Author]:Nico Hu
+//[Date]:2020-08-10
+//[Other]:Copyright (c) 2020-2050 Nico Hu
+//========================================================================
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#ifdef __linux__
+#include <unistd.h>
+#endif
+
+#include "../com/BlockArena.h"
+#include "../com/NMemoryStorage.h"
+
+#if defined(__SANITIZE_ADDRESS__) || defined(__SANITIZE_THREAD__)
+#define RssChecked (false)	//the sanitizers map their own shadow
+#else
+#define RssChecked (true)
+#endif
+
+//a field of a /proc file in KB, 0 if unknown.
+size_t proc_kb(const char* path, const char* field) {
+	size_t kb{ 0 };
+#ifdef __linux__
+	FILE* f = fopen(path, "r");
+	if (!f)
+		return 0;
+	char line[256];
+	const size_t len = strlen(field);
+	while (fgets(line, sizeof(line), f)) {
+		if (strncmp(line, field, len) == 0 && line[len] == ':') {
+			kb = strtoull(line + len + 1, nullptr, 10);
+			break;
+		}
+	}
+	fclose(f);
+#endif
+	return kb;
+}
+
+const char* page_name(const ArenaUsage_t& usage) {
+	if (usage.hugeTlbRegions > 0)
+		return "hugetlb";
+	if (usage.thpRegions > 0)
+		return "thp";
+	if (usage.normalRegions > 0)
+		return "normal";
+	return "heap";
+}
+
+void test_blocks() {
+	BlockArenaInfo_t info;
+	info.regionBytes = 1024 * 1024;
+	BlockArena arena(info);
+	bool ok{ true };
+	std::vector<std::pair<void*, size_t>> blocks;
+	for (size_t i = 0; i < 1000; i++) {
+		const size_t bytes = 4096 * (1 + i % 17);
+		void* p = arena.Alloc(bytes);
+		ok = ok && p != nullptr && reinterpret_cast<uintptr_t>(p) % BlockArena::Align == 0;
+		if (p)
+			memset(p, 'a', bytes);
+		blocks.emplace_back(p, bytes);
+	}
+	const ArenaUsage_t used = arena.GetUsage();
+	for (auto& var : blocks)
+		arena.Free(var.first, var.second);
+	const ArenaUsage_t freed = arena.GetUsage();
+	//a block given back is the next one of its size
+	void* again = arena.Alloc(blocks.back().second);
+	const ArenaUsage_t reused = arena.GetUsage();
+	ok = ok && again == blocks.back().first && used.bytesFree == 0 && freed.bytesUsed == 0 && freed.bytesFree == used.bytesUsed && \
+		freed.regions == used.regions && used.bytesMapped >= used.bytesUsed;
+#ifdef __linux__
+	//the blocks are of whole pages, all their pages are given back
+	ok = ok && freed.bytesReleased == freed.bytesFree && reused.bytesReleased == freed.bytesReleased - blocks.back().second;
+#endif
+	arena.Free(again, blocks.back().second);
+	printf("[blocks] used=%zuKB mapped=%zuKB regions=%zu page=%s %s\n", used.bytesUsed / 1024, used.bytesMapped / 1024, used.regions, \
+		page_name(used), ok ? "ok" : "FAILED");
+}
+
+//each way of mapping falls back to the next one, a block is got whatever the system has.
+void test_fallback() {
+	const size_t huge_total = proc_kb("/proc/meminfo", "HugePages_Total");
+	bool ok{ true };
+	struct Case_t {
+		const char* name;
+		bool bHugeTlb;
+		bool bThp;
+		bool bMap;
+	} cases[] = { { "hugetlb", true, true, true }, { "thp", false, true, true }, { "normal", false, false, true }, { "heap", false, false, false } };
+	for (auto& var : cases) {
+		BlockArenaInfo_t info;
+		info.regionBytes = 1024 * 1024 * 4;
+		info.bHugeTlb = var.bHugeTlb;
+		info.bThp = var.bThp;
+		info.bMap = var.bMap;
+		BlockArena arena(info);
+		char* p = static_cast<char*>(arena.Alloc(65536));
+		if (p) {
+			memset(p, 'f', 65536);
+			arena.Free(p, 65536);
+		}
+		const ArenaUsage_t usage = arena.GetUsage();
+		const std::string got = page_name(usage);
+		bool b_case = p != nullptr && usage.regions == 1;
+#ifdef __linux__
+		if (!var.bMap)
+			b_case = b_case && got == "heap";
+		else if (!var.bHugeTlb && !var.bThp)
+			b_case = b_case && got == "normal";
+		else if (var.bHugeTlb && huge_total == 0)
+			b_case = b_case && got != "hugetlb" && usage.fallbacks > 0;
+#endif
+		ok = ok && b_case;
+		printf("[fallback] asked=%-7s got=%-7s fallbacks=%llu\n", var.name, got.c_str(), (unsigned long long)usage.fallbacks);
+	}
+	printf("[fallback] reserved huge pages=%zu %s\n", huge_total, ok ? "ok" : "FAILED");
+}
+
+//a prefaulted region is resident once the arena is made.
+void test_prefault() {
+	const size_t rss0 = proc_kb("/proc/self/status", "VmRSS");
+	const size_t thp0 = proc_kb("/proc/self/smaps_rollup", "AnonHugePages");
+	BlockArenaInfo_t info;
+	info.bHugeTlb = false;
+	info.bPrefault = true;
+	info.initBytes = 1024 * 1024 * 64;
+	BlockArena arena(info);
+	const size_t rss1 = proc_kb("/proc/self/status", "VmRSS");
+	const size_t thp1 = proc_kb("/proc/self/smaps_rollup", "AnonHugePages");
+	const ArenaUsage_t usage = arena.GetUsage();
+	const bool ok = usage.regions == 1 && usage.bytesMapped == info.initBytes && (!RssChecked || rss0 == 0 || rss1 >= rss0 + 60 * 1024);
+	printf("[prefault] mapped=%zuKB page=%s rss +%zuKB thp +%zuKB %s\n", usage.bytesMapped / 1024, page_name(usage), rss1 - rss0, \
+		thp1 > thp0 ? thp1 - thp0 : 0, ok ? "ok" : "FAILED");
+}
+
+//the pages of the blocks freed are not resident any more, their ranges are reused.
+void test_release() {
+	BlockArenaInfo_t info;
+	info.bHugeTlb = false;
+	info.regionBytes = 1024 * 1024 * 64;
+	BlockArena arena(info);
+	std::vector<void*> blocks;
+	for (size_t i = 0; i < 512; i++) {
+		void* p = arena.Alloc(65536);
+		if (p)
+			memset(p, 'r', 65536);
+		blocks.emplace_back(p);
+	}
+	const size_t rss_used = proc_kb("/proc/self/status", "VmRSS");
+	for (auto var : blocks)
+		arena.Free(var, 65536);
+	const size_t rss_freed = proc_kb("/proc/self/status", "VmRSS");
+	const ArenaUsage_t freed = arena.GetUsage();
+	void* p = arena.Alloc(65536);
+	bool ok = p == blocks.back() && freed.regions == 1;
+	if (p) {
+		memset(p, 'a', 65536);
+		arena.Free(p, 65536);
+	}
+#ifdef __linux__
+	ok = ok && freed.bytesReleased == 512 * 65536 && (!RssChecked || rss_used == 0 || rss_freed + 24 * 1024 < rss_used);
+#endif
+	printf("[release] freed=%zuKB released=%zuKB rss %zuKB -> %zuKB page=%s %s\n", freed.bytesFree / 1024, freed.bytesReleased / 1024, \
+		rss_used, rss_freed, page_name(freed), ok ? "ok" : "FAILED");
+}
+
+//the pools of a storage made after SetDefault carve the arena, their trimmed blocks go back to it.
+void test_storage() {
+	BlockArenaInfo_t info;
+	info.regionBytes = 1024 * 1024 * 16;
+	auto arena = std::make_shared<BlockArena>(info);
+	BlockArena::SetDefault(arena);
+	bool ok{ true };
+	{
+		NMemoryStorage<char> storage({ 32, 64, 256, 512, 1024 });
+		BlockArena::SetDefault(nullptr);
+		const ArenaUsage_t made = arena->GetUsage();
+		std::vector<char*> blocks;
+		for (size_t size = 1; size <= 65535; size += 61) {
+			char* p = storage.Alloc(size);
+			ok = ok && p != nullptr;
+			if (p)
+				memset(p, 's', size);
+			blocks.emplace_back(p);
+		}
+		for (auto var : blocks)
+			ok = ok && storage.Free(var) == 0;
+		const ArenaUsage_t used = arena->GetUsage();
+		const size_t trimmed = storage.Trim();
+		const ArenaUsage_t kept = arena->GetUsage();
+		ok = ok && made.bytesUsed > 0 && used.bytesUsed > made.bytesUsed && trimmed > 0 && kept.bytesFree == used.bytesFree + trimmed;
+#ifdef __linux__
+		ok = ok && kept.bytesReleased == used.bytesReleased + trimmed;	//the pool blocks are of whole pages
+#endif
+		printf("[storage] pools made=%zuKB used=%zuKB trimmed to arena=%zuKB regions=%zu page=%s\n", made.bytesUsed / 1024, used.bytesUsed / 1024, \
+			trimmed / 1024, used.regions, page_name(used));
+	}
+	const ArenaUsage_t gone = arena->GetUsage();
+	ok = ok && gone.bytesUsed == 0 && BlockArena::Default() == nullptr;
+	printf("[storage] %s\n", ok ? "ok" : "FAILED");
+}
+
+int main(int argc, char** argv) {
+	test_blocks();
+	test_fallback();
+	test_prefault();
+	test_release();
+	test_storage();
+	return 0;
+}
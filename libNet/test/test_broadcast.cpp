@@ -0,0 +1,192 @@
+//========================================================================
+//[File Name]:test_broadcast.cpp
+//[Description]: a test of the shared buffers: the frames of a payload by
+//               each codec and the references of the handles, the payloads
+//               broadcast by the async server to all its sessions or to a
+//               list of them, the buffer of another codec refused, and the
+//               memory and time to queue a fan-out against a copy per
+//               session.
+//[Author]:Nico Hu
+//[Date]:2020-08-10
+//[Other]:Copyright (c) 2020-2050 Nico Hu
+//========================================================================
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cstdio>
+#include <cstring>
+
+#include "../stream/Server.h"
+#include "Timer.h"
+
+using namespace Net;
+using namespace Net::Stream;
+
+#define ConnCount (100)
+#define MsgCount (32)
+#define MsgSize (4096)
+#define Port (9960)
+
+//the storage of the server is read by the test.
+class TestServer : public ServerTcp {
+public:
+	using ServerTcp::ServerTcp;
+	StorageInfo_t GetStorageInfo() { return memStorage_.GetInfo(); }
+};
+
+//the frames of a buffer decode to the payload, whatever the codec splits it into.
+void test_buffer() {
+	NMemoryStorage<char> storage({ 64 });
+	std::string payload(100000, ' ');
+	for (size_t i = 0; i < payload.size(); i++)
+		payload[i] = static_cast<char>('a' + i % 26);
+	bool ok{ true };
+	for (auto type : { E_CODEC_T::e_Raw, E_CODEC_T::e_Len32, E_CODEC_T::e_Varint, E_CODEC_T::e_Hex }) {
+		const Codec codec(type);
+		uint8_t err_code{ 0 };
+		SharedBuffer buffer = SharedBuffer::Make(storage, codec, payload.data(), static_cast<unsigned>(payload.size()), err_code);
+		std::string decoded;
+		size_t frames{ 0 };
+		if (type == E_CODEC_T::e_Raw)
+			decoded.assign(buffer.data(), buffer.length());
+		else {
+			const char* p = buffer.data();
+			size_t avail = buffer.length();
+			Frame frame;
+			while (avail > 0 && codec.Decode(p, avail, frame, err_code) > 0) {
+				decoded.append(p + frame.headLen, frame.bodyLen);
+				p += frame.frameLen;
+				avail -= frame.frameLen;
+				frames++;
+			}
+		}
+		ok = ok && buffer && decoded == payload && buffer.bodyLen() == payload.size() && buffer.Fits(codec) && !buffer.Fits(Codec(E_CODEC_T::e_Line));
+		printf("[buffer] codec=%d frames=%zu length=%zu\n", static_cast<int>(type), frames, buffer.length());
+	}
+
+	uint8_t err_code{ 0 };
+	SharedBuffer first = SharedBuffer::Make(storage, Codec(E_CODEC_T::e_Len32), payload.data(), 100, err_code);
+	SharedBuffer second = first;
+	const uint32_t copied = first.refs();
+	SharedBuffer third = std::move(second);
+	const uint32_t moved = first.refs();
+	third.reset();
+	const uint32_t dropped = first.refs();
+	first.reset();
+	SharedBuffer refused = SharedBuffer::Make(storage, Codec(E_CODEC_T::e_Fixed, 7), payload.data(), 100, err_code);
+	ok = ok && copied == 2 && moved == 2 && !second && dropped == 1 && !first && !refused && err_code == NET_BAD_BODY && \
+		storage.GetInfo().bytesUsed == 0;
+	printf("[buffer] refs copied=%u moved=%u dropped=%u %s\n", copied, moved, dropped, ok ? "ok" : "FAILED");
+}
+
+//the clients read count frames of MsgSize from each socket, the body of the i-th one is filled by 'a' + i % 26.
+void read_frames(std::vector<std::unique_ptr<tcp::socket>>& sockets, size_t first, size_t count, std::atomic<size_t>& bad) {
+	std::vector<char> frame(4 + MsgSize);
+	for (size_t i = first; i < first + count; i++) {
+		for (auto& var : sockets) {
+			try
+			{
+				asio::read(*var, asio::buffer(frame.data(), frame.size()));
+				const uint32_t len = (uint32_t(uint8_t(frame[0])) << 24) | (uint32_t(uint8_t(frame[1])) << 16) | \
+					(uint32_t(uint8_t(frame[2])) << 8) | uint32_t(uint8_t(frame[3]));
+				if (len != MsgSize || frame[4] != static_cast<char>('a' + i % 26) || frame.back() != static_cast<char>('a' + i % 26))
+					bad++;
+			}
+			catch (const std::exception&)
+			{
+				bad++;
+			}
+		}
+	}
+}
+
+//MsgCount payloads to all the sessions, by a shared buffer each or by a copy per session.
+void test_fanout(TestServer& server, std::vector<std::unique_ptr<tcp::socket>>& sockets) {
+	std::vector<std::pair<SessionId, SessionStats>> per_session;
+	server.Snapshot(&per_session);
+	std::vector<SessionId> ids;
+	for (auto& var : per_session)
+		ids.emplace_back(var.first);
+	std::vector<char> payload(MsgSize);
+
+	for (int b_shared = 1; b_shared >= 0; b_shared--) {
+		std::atomic<size_t> done{ 0 }, bad{ 0 };
+		std::thread reader([&] { read_frames(sockets, 0, MsgCount, bad); });
+		CBAsyncSend on_sent = [&done](SessionId id, size_t len, uint8_t ec) { done++; };
+		size_t queued{ 0 }, peak{ 0 };
+		const size_t live0 = server.GetStorageInfo().bytesUsed;
+		Timer timer;
+		for (int i = 0; i < MsgCount; i++) {
+			memset(payload.data(), 'a' + i % 26, payload.size());
+			if (b_shared) {
+				uint8_t err_code{ 0 };
+				SharedBuffer buffer = server.MakeShared(payload.data(), MsgSize, err_code);
+				//the first half to the list of sessions, with an id which is gone
+				if (i < MsgCount / 2) {
+					std::vector<SessionId> list(ids);
+					list.emplace_back(-1);
+					queued += server.Broadcast(list, buffer, on_sent);
+				}
+				else
+					queued += server.Broadcast(buffer, on_sent);
+			}
+			else {
+				for (auto var : ids) {
+					if (server.AsyncSend(var, payload.data(), MsgSize, on_sent) >= 0)
+						queued++;
+				}
+			}
+			const size_t live = server.GetStorageInfo().bytesUsed;
+			peak = live > peak ? live : peak;
+		}
+		const auto us = timer.elapsed_micro();
+		reader.join();
+		for (int i = 0; i < 200 && done < queued; i++)
+			std::this_thread::sleep_for(std::chrono::milliseconds(5));
+		const auto us_all = timer.elapsed_micro();
+		const bool ok = queued == ConnCount * MsgCount && done == queued && bad == 0;
+		printf("[fanout] %-6s sessions=%zu msgs=%d queue time=%.2fus per send, all written in %lldus, memory held at most=%zuKB %s\n", \
+			b_shared ? "shared" : "copy", ids.size(), MsgCount, (double)us / (ConnCount * MsgCount), (long long)us_all, \
+			(peak > live0 ? peak - live0 : 0) / 1024, ok ? "ok" : "FAILED");
+	}
+}
+
+int main(int argc, char** argv) {
+	test_buffer();
+
+	io_context io_c;
+	asio::io_context::work worker(io_c);
+	std::thread io_thread([&] { io_c.run(); });
+	std::shared_ptr<TestServer> server(new TestServer(io_c, "127.0.0.1", Port, 0, Codec(E_CODEC_T::e_Len32)));
+	server->StartA();
+	{
+		io_context io_client;
+		std::vector<std::unique_ptr<tcp::socket>> sockets;
+		for (int c = 0; c < ConnCount; c++) {
+			sockets.emplace_back(new tcp::socket(io_client));
+			sockets.back()->connect(tcp::endpoint(asio::ip::make_address("127.0.0.1"), Port));
+		}
+		for (int i = 0; i < 200 && server->Snapshot().sessions < ConnCount; i++)
+			std::this_thread::sleep_for(std::chrono::milliseconds(5));
+
+		test_fanout(*server, sockets);
+
+		//a buffer of another codec is not written
+		NMemoryStorage<char> storage({ 64 });
+		uint8_t err_code{ 0 };
+		SharedBuffer line = SharedBuffer::Make(storage, Codec(E_CODEC_T::e_Line), "line", 4, err_code);
+		std::vector<std::pair<SessionId, SessionStats>> per_session;
+		server->Snapshot(&per_session);
+		const int ret = per_session.empty() ? 0 : server->AsyncSend(per_session.front().first, line);
+		const size_t queued = server->Broadcast(line);
+		printf("[refused] send=%d broadcast=%zu %s\n", ret, queued, ret == -2 && queued == 0 ? "ok" : "FAILED");
+	}
+	server->Stop();
+	io_c.stop();
+	io_thread.join();
+	//the aborted reads hold their handlers, which free into the storage of the server, so they are run before it is gone.
+	io_c.restart();
+	io_c.poll();
+	return 0;
+}
@@ -30,7 +30,7 @@ using namespace Net::Stream;
 #pragma comment(lib, "./openssl/lib/libcrypto.lib")
 #endif
 
-void test_connector(ConnectorBase* conn, int session_id) {
+void test_connector(ConnectorBase* conn, SessionId session_id) {
 	if (!conn->IsConnected(session_id)) {
 		std::cout << "[Test Connector] Connect to Server failed! session_id=" << session_id << std::endl;
 		return;
@@ -52,8 +52,8 @@ void test_connector(ConnectorBase* conn, int session_id) {
 		static std::atomic_int num = 0;
 		auto ret = conn->Send(session_id, str.data(), str.length() + 1, err_code);
 		//auto thd_id = std::this_thread::get_id();
-		StreamWriter::Instance()->Write(std::cout, "[Test Connector] session id = %d,\
- Packet num =%d, sent_size=%d, ec=%d", /*thd_id, */session_id, ++num, ret, (int)err_code);
+		StreamWriter::Instance()->Write(std::cout, "[Test Connector] session id = %lld,\
+ Packet num =%d, sent_size=%d, ec=%d", /*thd_id, */(long long)session_id, ++num, ret, (int)err_code);
 	}
 	//conn->Close(session_id);
 }
@@ -77,14 +77,14 @@ int main(int argc, char** argv) {
 #endif //OPENSSL
 
 	int num{0};
-	std::vector<int> v_conn;
+	std::vector<SessionId> v_conn;
 	int port_start = 30000;
 	while (num < ConcurrConntion) {
 		try
 		{
 			num++;
-			int session_id = conn.Open("127.0.0.1", 9900, true);
-			printf("[Test Connector] session_id=%d\n", session_id);
+			SessionId session_id = conn.Open("127.0.0.1", 9900, true);
+			printf("[Test Connector] session_id=%lld\n", (long long)session_id);
 			v_conn.push_back(session_id);
 		}
 		catch (const std::exception& e)
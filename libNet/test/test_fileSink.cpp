@@ -0,0 +1,150 @@
+//========================================================================
+//[File Name]:test_fileSink.cpp
+//[Description]: a test of the log file sink, the latency of a log call
+//               (p50/p99/max) on 4 threads against an ofstream flushed per
+//               line under a mutex, the lines in the file with the write and
+//               the mmap appends, size rotation, and the drops of a bounded
+//               sink whose flusher falls behind.
+//[Author]:Nico Hu
+//[Date]:2020-08-10
+//[Other]:Copyright (c) 2020-2050 Nico Hu
+//========================================================================
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cstdio>
+
+#include "../com/Log.h"
+#include "Timer.h"
+
+#define ThreadNum (4)
+#define LinePerThread (1024 * 32)
+#define SinkFile "./test_fileSink.txt"
+
+//the newlines, a mapped file is zeros after its end while it is open.
+size_t count_lines(const std::string& name) {
+	std::ifstream ifs(name, std::ifstream::binary);
+	return std::count(std::istreambuf_iterator<char>(ifs), std::istreambuf_iterator<char>(), '\n');
+}
+
+//the latencies of the calls of ThreadNum threads, in ns.
+template<typename F>
+void test_latency(const char* name, F write) {
+	std::vector<std::vector<int64_t>> lat(ThreadNum);
+	std::vector<std::thread> threads;
+	Timer total;
+	for (int t = 0; t < ThreadNum; t++) {
+		threads.emplace_back([&, t] {
+			lat[t].reserve(LinePerThread);
+			for (int i = 0; i < LinePerThread; i++) {
+				Timer timer;
+				write(t, i);
+				lat[t].emplace_back(timer.elapsed_nano());
+			}
+			});
+	}
+	for (auto& var : threads)
+		var.join();
+	auto us = total.elapsed_micro();
+	std::vector<int64_t> all;
+	for (auto& var : lat)
+		all.insert(all.end(), var.begin(), var.end());
+	std::sort(all.begin(), all.end());
+	printf("%-14s calls=%zu time=%lldus p50=%lldns p99=%lldns p999=%lldns max=%lldns\n", name, all.size(), (long long)us, \
+		(long long)all[all.size() / 2], (long long)all[all.size() * 99 / 100], (long long)all[all.size() * 999 / 1000], \
+		(long long)all.back());
+}
+
+void test_log(bool b_mmap) {
+	remove(SinkFile);
+	FileSinkInfo_t info;
+	info.path = SinkFile;
+	info.bMmap = b_mmap;
+	Log::Instance()->Open(info);
+	//the sink takes what the logger drains, the latency is the one of the caller
+	AsyncLogger::Instance()->SetBlocking(true);
+	test_latency(b_mmap ? "Log(mmap)" : "Log(write)", [](int t, int i) {
+		Log::Instance()->Write(Log::LOG_LEV::e_Info, "[test] thread=%d line=%d session id=%lld", t, i, (long long)i);
+		});
+	Log::Instance()->Commit();
+	const size_t lines = count_lines(SinkFile);
+	printf("%-14s lines=%zu commits=%llu dropped=%llu %s\n", b_mmap ? "Log(mmap)" : "Log(write)", lines, \
+		(unsigned long long)Log::Instance()->Sink().Commits(), (unsigned long long)Log::Instance()->Sink().Dropped(), \
+		lines == ThreadNum * LinePerThread ? "ok" : "FAILED");
+}
+
+void test_ofstream() {
+	std::ofstream ofs(SinkFile, std::ofstream::out | std::ofstream::trunc);
+	std::mutex mtx;
+	test_latency("ofstream+flush", [&](int t, int i) {
+		char buff[1024] = { 0 };
+		snprintf(buff, sizeof(buff), "[test] thread=%d line=%d session id=%lld", t, i, (long long)i);
+		time_t now = time(0);
+		char tmp[64];
+		strftime(tmp, sizeof(tmp), "[%Y-%m-%d %H:%M:%S] ", localtime(&now));
+		std::lock_guard<std::mutex> lock(mtx);
+		ofs << "[Info] " << tmp << buff << std::endl;
+		ofs.flush();
+		});
+	ofs.close();
+	printf("%-14s lines=%zu\n", "ofstream+flush", count_lines(SinkFile));
+}
+
+//a 64KB file rotated at 16KB keeps 2 rotated files.
+void test_rotate() {
+	remove(SinkFile);
+	FileSinkInfo_t info;
+	info.path = SinkFile;
+	info.commitBytes = 1024;
+	info.commitMs = 1;
+	info.rotateBytes = 1024 * 16;
+	info.keepFiles = 2;
+	FileSink sink(info);
+	std::ostream ostr(&sink);
+	std::string line(63, 'r');
+	for (int i = 0; i < 1024; i++) {
+		ostr << line << '\n';
+		if (i % 64 == 0)
+			sink.Commit();
+	}
+	sink.Close();
+	for (auto& var : sink.Rotated())
+		remove(var.c_str());
+	printf("[rotate] rotations=%llu written=%llu file=%zu lines %s\n", (unsigned long long)sink.Rotations(), \
+		(unsigned long long)sink.Written(), count_lines(SinkFile), sink.Rotations() >= 3 ? "ok" : "FAILED");
+}
+
+//the flusher waits commitMs, the writes over maxPendingBytes are dropped and counted instead of blocking.
+void test_bounded() {
+	remove(SinkFile);
+	FileSinkInfo_t info;
+	info.path = SinkFile;
+	info.commitBytes = 1024 * 1024 * 64;
+	info.commitMs = 1000 * 60;
+	info.maxPendingBytes = 1024 * 64;
+	FileSink sink(info);
+	std::ostream ostr(&sink);
+	std::string line(63, 'b');
+	Timer timer;
+	for (int i = 0; i < 4096; i++)
+		ostr << line << '\n';
+	auto us = timer.elapsed_micro();
+	sink.Close();
+	const size_t lines = count_lines(SinkFile);
+	printf("[bounded] lines=%zu dropped=%llu time=%lldus %s\n", lines, (unsigned long long)sink.Dropped(), (long long)us, \
+		lines == 1024 && sink.Dropped() == 4096 - 1024 ? "ok" : "FAILED");
+}
+
+int main(int argc, char** argv) {
+	test_ofstream();
+	test_log(false);
+	test_log(true);
+	test_rotate();
+	test_bounded();
+	remove(SinkFile);
+	return 0;
+}
@@ -24,12 +24,12 @@ constexpr int ConcurrConntion = 16;
 constexpr int PackerPerConntion = 100;
 
 
-void do_send(int id, int count, HttpClient* client, const char* request) {
+void do_send(SessionId id, int count, HttpClient* client, const char* request) {
 	client->SendReq(id, request, strlen(request) + 1, [id, count, request](std::string content, uint8_t ec) {
-		StreamWriter::Instance()->Write(std::cout, "[test_httpClient] Conn Id=%d, Count=%d, Request=%s, resp content:%s, ec=%d", id, count, request, content.c_str(), (int)ec);
+		StreamWriter::Instance()->Write(std::cout, "[test_httpClient] Conn Id=%lld, Count=%d, Request=%s, resp content:%s, ec=%d", (long long)id, count, request, content.c_str(), (int)ec);
 	});
 }
-void test_httpClient(HttpClient* client, const char* c_req[], int id) {
+void test_httpClient(HttpClient* client, const char* c_req[], SessionId id) {
 	static std::atomic_int count{0};
 	for(int k = 0; k < PackerPerConntion; k++)
 		for (int i = 0; i < 6/*sizeof(c_req)*/; i++) {
@@ -38,7 +38,7 @@ void test_httpClient(HttpClient* client, const char* c_req[], int id) {
 		}
 }
 
-void do_download_file(int id, HttpClient* client, const char* request) {
+void do_download_file(SessionId id, HttpClient* client, const char* request) {
 	std::string req = request;
 	auto pos = req.find_last_of('/');
 	if (pos != std::string::npos) {
@@ -92,7 +92,7 @@ void do_download_file(int id, HttpClient* client, const char* request) {
 	}
 }
 
-void test_httpClient_File(HttpClient* client, const char* c_req[], int id) {
+void test_httpClient_File(HttpClient* client, const char* c_req[], SessionId id) {
 	for (int i = 0; i < 1/*sizeof(c_req)*/; i++) {
 		do_download_file(id, client, c_req[i]);
 		//std::this_thread::sleep_for(std::chrono::milliseconds(1));
@@ -113,16 +113,16 @@ int main(int argc, char* argv[]) {
 	};
 
 	HttpClient client;
-	std::vector<int> v_id;
+	std::vector<SessionId> v_id;
 #ifdef OPENSSL
 	for (int i = 0; i < ConcurrConntion; i++) {
-		int id = client.Open("127.0.0.1", 443);
+		SessionId id = client.Open("127.0.0.1", 443);
 		if (id > 0)
 			v_id.emplace_back(id);
 	}	
 #else
 	for (int i = 0; i < ConcurrConntion; i++) {
-		int id = client.Open("127.0.0.1", 80);
+		SessionId id = client.Open("127.0.0.1", 80);
 		if (id > 0)
 			v_id.emplace_back(id);
 	}
@@ -0,0 +1,157 @@
+//========================================================================
+//[File Name]:test_httpLatency.cpp
+//[Description]: a test of the latency histograms, the percentiles against
+//               the exact ones of the values, the merge of the histograms
+//               recorded by 4 threads, the cost of a record, and the report
+//               of a http server by route.
+//[Author]:Nico Hu
+//[Date]:2020-08-10
+//[Other]:Copyright (c) 2020-2050 Nico Hu
+//========================================================================
+#include <algorithm>
+#include <random>
+#include <thread>
+#include <vector>
+#include <cstdio>
+
+#include "../http/HttpServer.h"
+#include "Timer.h"
+
+using namespace Http;
+
+#define ValueCount (1024 * 1024)
+#define ThreadNum (4)
+#define ReqCount (2000)
+#define Port (9940)
+
+//latency like values in ns: mostly some us, with a long tail.
+std::vector<uint64_t> make_values(unsigned seed) {
+	std::mt19937_64 rng(seed);
+	std::lognormal_distribution<double> dist(9.0, 1.2);
+	std::vector<uint64_t> values(ValueCount);
+	for (auto& var : values)
+		var = static_cast<uint64_t>(dist(rng));
+	return values;
+}
+
+void test_accuracy() {
+	auto values = make_values(1);
+	std::unique_ptr<Histogram> hist(new Histogram());
+	Timer timer;
+	for (auto var : values)
+		hist->Record(var);
+	auto ns = timer.elapsed_nano();
+	std::sort(values.begin(), values.end());
+	bool ok = hist->Count() == values.size() && hist->Max() == values.back() && hist->Min() == values.front();
+	for (double p : { 50.0, 90.0, 99.0, 99.9, 99.99 }) {
+		const uint64_t exact = values[static_cast<size_t>(p / 100.0 * values.size() + 0.5) - 1];
+		const uint64_t got = hist->Percentile(p);
+		const double err = exact > 0 ? ((double)got - exact) / exact : 0.0;
+		ok = ok && err >= 0 && err < 1.0 / Histogram::Half;
+		printf("[accuracy] p%-6g exact=%lluns histogram=%lluns err=%.3f%%\n", p, (unsigned long long)exact, (unsigned long long)got, err * 100);
+	}
+	printf("[accuracy] values=%zu per record=%.1fns buckets=%zu %s\n", values.size(), (double)ns / values.size(), \
+		Histogram::BucketNum, ok ? "ok" : "FAILED");
+}
+
+//ThreadNum threads record the same route while the report is taken, the merge must count all of them.
+void test_merge() {
+	HttpLatency latency;
+	std::vector<std::thread> threads;
+	std::atomic<int> running{ ThreadNum };
+	for (int t = 0; t < ThreadNum; t++) {
+		threads.emplace_back([&, t] {
+			auto values = make_values(t + 2);
+			for (auto var : values) {
+				const int64_t ns = static_cast<int64_t>(var);
+				latency.Record("GET /merge", { ns, ns, ns, ns });
+			}
+			running--;
+			});
+	}
+	size_t reports{ 0 };
+	while (running > 0) {
+		latency.Report();
+		reports++;
+	}
+	for (auto& var : threads)
+		var.join();
+
+	std::unique_ptr<Histogram> all(new Histogram());
+	for (int t = 0; t < ThreadNum; t++) {
+		for (auto var : make_values(t + 2))
+			all->Record(var);
+	}
+	std::unique_ptr<HttpLatency::RouteHist> merged(new HttpLatency::RouteHist());
+	const bool found = latency.Get("GET /merge", *merged);
+	const Histogram& total = merged->stages[static_cast<size_t>(E_LAT_STAGE_T::e_Total)];
+	const bool ok = found && total.Count() == all->Count() && total.Percentile(99) == all->Percentile(99) && \
+		total.Percentile(99.9) == all->Percentile(99.9) && total.Max() == all->Max();
+	printf("[merge] threads=%d count=%llu p99=%lluns p999=%lluns reports meanwhile=%zu %s\n", ThreadNum, (unsigned long long)total.Count(), \
+		(unsigned long long)total.Percentile(99), (unsigned long long)total.Percentile(99.9), reports, ok ? "ok" : "FAILED");
+}
+
+void test_server() {
+	HttpServer server("127.0.0.1", Port, ".", 2);
+	server.OnRequest("GET /user", [](std::string content, SessionId session_id, unsigned error_code, OnRspCB callback) {
+		callback(session_id, "user");
+		});
+	server.Start();
+
+	const char* reqs[] = { "GET /user HTTP/1.1\r\nHost: 127.0.0.1\r\nConnection: keep-alive\r\n\r\n", \
+		"GET /none HTTP/1.1\r\nHost: 127.0.0.1\r\nConnection: keep-alive\r\n\r\n" };
+	size_t answered{ 0 };
+	try
+	{
+		io_context io_c;
+		tcp::socket socket(io_c);
+		socket.connect(tcp::endpoint(asio::ip::make_address("127.0.0.1"), Port));
+		char resp[4096];
+		for (int i = 0; i < ReqCount; i++) {
+			const char* req = reqs[i % 10 == 0 ? 1 : 0];
+			asio::write(socket, asio::buffer(req, strlen(req)));
+			if (socket.read_some(asio::buffer(resp, sizeof(resp))) > 0)
+				answered++;
+		}
+	}
+	catch (const std::exception& e)
+	{
+		printf("client raise ex:%s\n", e.what());
+	}
+
+	//a request is recorded once its response is sent, which may be after the client has read it.
+	std::vector<RouteLatencyInfo_t> report;
+	uint64_t routed{ 0 }, unrouted{ 0 };
+	for (int i = 0; i < 100 && routed + unrouted < ReqCount; i++) {
+		if (i > 0)
+			std::this_thread::sleep_for(std::chrono::milliseconds(10));
+		report = server.GetLatencyReport();
+		routed = unrouted = 0;
+		for (auto& var : report) {
+			const uint64_t count = var.stages[static_cast<size_t>(E_LAT_STAGE_T::e_Total)].count;
+			if (var.route == "GET /user")
+				routed = count;
+			else if (var.route == "unrouted")
+				unrouted = count;
+		}
+	}
+	const char* stages[] = { "parse", "handler", "send", "total" };
+	for (auto& var : report) {
+		for (size_t i = 0; i < LatStageNum; i++) {
+			const LatencyInfo_t& info = var.stages[i];
+			printf("[server] %-10s %-8s count=%llu p50=%lluns p99=%lluns p999=%lluns max=%lluns mean=%.0fns\n", var.route.c_str(), stages[i], \
+				(unsigned long long)info.count, (unsigned long long)info.p50, (unsigned long long)info.p99, (unsigned long long)info.p999, \
+				(unsigned long long)info.max, info.mean);
+		}
+	}
+	server.Stop();
+	printf("[server] requests=%d answered=%zu routed=%llu unrouted=%llu %s\n", ReqCount, answered, (unsigned long long)routed, \
+		(unsigned long long)unrouted, routed == ReqCount * 9 / 10 && unrouted == ReqCount / 10 ? "ok" : "FAILED");
+}
+
+int main(int argc, char** argv) {
+	test_accuracy();
+	test_merge();
+	test_server();
+	return 0;
+}
@@ -51,24 +51,24 @@ carrying out a plan. engineered his son's election to the governorship";
 		";
 
 	//std::atomic_int Count{0};
-	server.OnRequest("GET /user", [user](std::string content, int session_id, unsigned error_code, OnRspCB callback) {
-		StreamWriter::Instance()->Write(std::cout, "[test_httpServer] session id=%d, GET /user content:%s", session_id, content.c_str());
+	server.OnRequest("GET /user", [user](std::string content, SessionId session_id, unsigned error_code, OnRspCB callback) {
+		StreamWriter::Instance()->Write(std::cout, "[test_httpServer] session id=%lld, GET /user content:%s", (long long)session_id, content.c_str());
 		callback(session_id, user);
 		});
-	server.OnRequest("GET /guide", [guide](std::string content, int session_id, unsigned error_code, OnRspCB callback) {
-		StreamWriter::Instance()->Write(std::cout, "[test_httpServer] session id=%d, GET /user content:%s", session_id, content.c_str());
+	server.OnRequest("GET /guide", [guide](std::string content, SessionId session_id, unsigned error_code, OnRspCB callback) {
+		StreamWriter::Instance()->Write(std::cout, "[test_httpServer] session id=%lld, GET /user content:%s", (long long)session_id, content.c_str());
 		callback(session_id, guide);
 		});
-	server.OnRequest("GET /traveral", [traveral](std::string content, int session_id, unsigned error_code, OnRspCB callback) {
-		StreamWriter::Instance()->Write(std::cout, "[test_httpServer] session id=%d, GET /user content:%s", session_id, content.c_str());
+	server.OnRequest("GET /traveral", [traveral](std::string content, SessionId session_id, unsigned error_code, OnRspCB callback) {
+		StreamWriter::Instance()->Write(std::cout, "[test_httpServer] session id=%lld, GET /user content:%s", (long long)session_id, content.c_str());
 		callback(session_id, traveral);
 		});
-	server.OnRequest("GET /kooke", [kooke](std::string content, int session_id, unsigned error_code, OnRspCB callback) {
-		StreamWriter::Instance()->Write(std::cout, "[test_httpServer] session id=%d, GET /user content:%s", session_id, content.c_str());
+	server.OnRequest("GET /kooke", [kooke](std::string content, SessionId session_id, unsigned error_code, OnRspCB callback) {
+		StreamWriter::Instance()->Write(std::cout, "[test_httpServer] session id=%lld, GET /user content:%s", (long long)session_id, content.c_str());
 		callback(session_id, kooke);
 		});
-	server.OnRequest("GET /default", [default_resp](std::string content, int session_id, unsigned error_code, OnRspCB callback) {
-		StreamWriter::Instance()->Write(std::cout, "[test_httpServer] session id=%d, GET /user content:%s", session_id, content.c_str());
+	server.OnRequest("GET /default", [default_resp](std::string content, SessionId session_id, unsigned error_code, OnRspCB callback) {
+		StreamWriter::Instance()->Write(std::cout, "[test_httpServer] session id=%lld, GET /user content:%s", (long long)session_id, content.c_str());
 		callback(session_id, default_resp);
 		});
 
@@ -90,8 +90,8 @@ void test_httpServer_File() {
 
 	std::vector<std::thread*> v_workthd_;
 
-	server.OnRequest("GET /file", [&server, &v_workthd_](std::string content, int session_id, unsigned error_code, OnRspCB callback) {
-		StreamWriter::Instance()->Write(std::cout, "[test_httpServer] session id=%d, GET /file content:%s", session_id, content.c_str());
+	server.OnRequest("GET /file", [&server, &v_workthd_](std::string content, SessionId session_id, unsigned error_code, OnRspCB callback) {
+		StreamWriter::Instance()->Write(std::cout, "[test_httpServer] session id=%lld, GET /file content:%s", (long long)session_id, content.c_str());
 		callback(session_id, "");
 
 		int file_pos{ 0 };
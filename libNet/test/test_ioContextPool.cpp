@@ -0,0 +1,127 @@
+//========================================================================
+//[File Name]:test_ioContextPool.cpp
+//[Description]: a test of the reactor pool, echo round trips of many
+//               connections to a tcp server whose sessions share one
+//               io_context run by N threads, against the server in pool
+//               mode(round robin, least loaded, an acceptor per reactor).
+//[Author]:Nico Hu
+//[Date]:2020-08-10
+//[Other]:Copyright (c) 2020-2050 Nico Hu
+//========================================================================
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cstdio>
+
+#include "../stream/Server.h"
+#include "Timer.h"
+
+using namespace Net;
+using namespace Net::Stream;
+
+#define ConnCount (32)
+#define RoundTrips (2000)
+#define MsgSize (64)
+
+const auto N = std::thread::hardware_concurrency();
+
+//each client thread connects, then sends a message and reads its echo RoundTrips times. the loads of the
+//reactors are taken when all are connected, the time of the round trips is returned.
+long long run_clients(short port, std::shared_ptr<IoContextPool> pool, size_t& done, std::string& loads) {
+	std::atomic<size_t> n_done{ 0 };
+	std::atomic<int> connected{ 0 };
+	std::atomic_bool start{ false };
+	std::vector<std::thread> clients;
+	for (int c = 0; c < ConnCount; c++) {
+		clients.emplace_back([&, port] {
+			try
+			{
+				io_context io_c;
+				tcp::socket socket(io_c);
+				socket.connect(tcp::endpoint(asio::ip::make_address("127.0.0.1"), port));
+				socket.set_option(tcp::no_delay(true));
+				connected++;
+				while (!start)
+					std::this_thread::yield();
+				char msg[MsgSize], echo[MsgSize];
+				memset(msg, 'a', sizeof(msg));
+				for (int i = 0; i < RoundTrips; i++) {
+					asio::write(socket, asio::buffer(msg, sizeof(msg)));
+					asio::read(socket, asio::buffer(echo, sizeof(echo)));
+					n_done++;
+				}
+			}
+			catch (const std::exception& e)
+			{
+				connected++;
+				printf("client raise ex:%s\n", e.what());
+			}
+			});
+	}
+	while (connected < ConnCount)
+		std::this_thread::yield();
+	std::this_thread::sleep_for(std::chrono::milliseconds(200));	//the sessions are placed
+	for (size_t i = 0; pool && i < pool->Size(); i++)
+		loads += std::to_string(pool->Load(i)) + " ";
+
+	Timer timer;
+	start = true;
+	for (auto& var : clients)
+		var.join();
+	done = n_done;
+	return timer.elapsed_micro();
+}
+
+//mode: 0 one io_context, 1 round robin, 2 least loaded, 3 an acceptor per reactor.
+void test_echo(int mode, short port) {
+	const char* names[] = { "shared io_context", "pool round robin", "pool least loaded", "pool reuse port" };
+	io_context io_c;
+	asio::io_context::work worker(io_c);
+	std::vector<std::thread> v_threads;
+	for (size_t i = 0; i < (mode == 0 ? N : 1); ++i) {
+		v_threads.emplace_back(std::thread([&]() {
+			io_c.run();
+			}));
+	}
+	std::shared_ptr<IoContextPool> pool{ nullptr };
+	std::shared_ptr<ServerTcp> server(new ServerTcp(io_c, "127.0.0.1", port, 0, Codec(E_CODEC_T::e_Raw)));
+	if (mode > 0) {
+		pool = std::make_shared<IoContextPool>(N, mode == 2 ? E_PLACEMENT_T::e_LeastLoaded : E_PLACEMENT_T::e_RoundRobin);
+		server->SetReactorPool(pool, mode == 3);
+		pool->Run();
+	}
+	std::weak_ptr<ServerTcp> wk_server = server;
+	server->SetReceiveCB([wk_server](SessionId id, const char* data, size_t len, uint8_t ec) {
+		auto server = wk_server.lock();
+		if (server && data && len > 0)
+			server->AsyncSend(id, data, (unsigned)len);
+		});
+	server->StartA();
+
+	size_t done{ 0 };
+	std::string loads;
+	auto us = run_clients(port, pool, done, loads);
+	printf("[%-17s] reactors=%u conns=%d round trips=%zu time=%lldus %.0f rt/s loads=%s\n", names[mode], N, ConnCount, done, \
+		(long long)us, us > 0 ? done * 1000000.0 / us : 0.0, loads.c_str());
+
+	server->Stop();
+	io_c.stop();
+	for (auto& var : v_threads) {
+		if (var.joinable())
+			var.join();
+	}
+	//the aborted handlers of the closed sessions release them before the server dies(the accept one stops io_c).
+	do {
+		io_c.restart();
+	} while (io_c.poll() > 0);
+	if (pool)
+		pool->Stop();
+	pool.reset(); //the server drops the last reference, before its memory storage
+}
+
+int main(int argc, char** argv) {
+	for (int mode = 0; mode < 4; mode++)
+		test_echo(mode, 9900 + mode);
+	return 0;
+}
@@ -0,0 +1,303 @@
+//========================================================================
+//[File Name]:test_memoryStorage.cpp
+//[Description]: a test of NMemoryStorage: the class of every size up to
+//               MaxClass, the large blocks, the bad frees, the blocks freed
+//               by other threads, the caches of the threads which end before
+//               and after their storage, the cost of an alloc+free against
+//               the pool lock alone, and the blocks given back by Trim.
+//[Author]:Nico Hu
+//[Date]:2020-08-10
+//[Other]:Copyright (c) 2020-2050 Nico Hu
+//========================================================================
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <cstdio>
+#include <cstring>
+#ifdef __linux__
+#include <unistd.h>
+#endif
+
+#include "../com/NMemoryStorage.h"
+#include "../com/MpscQueue.h"
+#include "../com/Timer.h"
+
+#if defined(__SANITIZE_ADDRESS__) || defined(__SANITIZE_THREAD__)
+#define RssChecked (false)	//the sanitizers keep the freed memory
+#else
+#define RssChecked (true)
+#endif
+#define ThreadNum (4)
+#define OpCount (1024 * 1024)
+
+typedef NMemoryStorage<char> Storage;
+
+void test_classes() {
+	Storage storage({ 32, 64, 256, 512, 1024 });
+	bool ok = Storage::ClassNum == Storage::Index(Storage::MaxClass) + 1;
+	for (size_t size = 1; size <= Storage::MaxClass && ok; size++) {
+		const size_t index = Storage::Index(size);
+		//the smallest class which holds the size, rounded up by less than 1/4
+		ok = index < Storage::ClassNum && Storage::ClassSize(index) >= size && (index == 0 || Storage::ClassSize(index - 1) < size) && \
+			(size <= Storage::MinClass || Storage::ClassSize(index) - size < size / 4 + 1);
+		char* p = storage.Alloc(size);
+		ok = ok && p != nullptr && reinterpret_cast<uintptr_t>(p) % alignof(void*) == 0;
+		if (p) {
+			memset(p, 'c', size);
+			ok = ok && storage.Free(p) == 0;
+		}
+	}
+	printf("[classes] classes=%zu min=%zu max=%zu %s\n", Storage::ClassNum, Storage::MinClass, Storage::MaxClass, ok ? "ok" : "FAILED");
+}
+
+void test_large() {
+	Storage storage({ 32 });
+	bool ok{ true };
+	for (size_t size : { Storage::MaxClass + 1, size_t(1024 * 1024), size_t(8 * 1024 * 1024) }) {
+		char* p = storage.Alloc(size);
+		ok = ok && p != nullptr;
+		if (p) {
+			memset(p, 'l', size);
+			ok = ok && storage.Free(p) == 0;
+		}
+	}
+	alignas(16) char bogus[32] = { 0 };
+	bogus[14] = 3; //a tag of no class
+	ok = ok && storage.Free(nullptr) == -2 && storage.Free(bogus + 16) == -1;
+	printf("[large] %s\n", ok ? "ok" : "FAILED");
+}
+
+//the blocks allocated by a thread and freed by another, as the async send does.
+void test_cross_thread() {
+	Storage storage({ 32, 64, 256, 512, 1024 });
+	MpscQueue<char*> queue(1024);
+	std::atomic<size_t> bad{ 0 };
+	std::thread producer([&] {
+		for (size_t i = 0; i < OpCount / 4; i++) {
+			const size_t size = 32 + i % 993;
+			char* p = storage.Alloc(size);
+			memset(p, static_cast<int>(i & 0x7f), size);
+			while (!queue.Push(std::move(p)))
+				std::this_thread::yield();
+		}
+		});
+	std::thread consumer([&] {
+		for (size_t i = 0; i < OpCount / 4;) {
+			char* p{ nullptr };
+			if (!queue.Pop(p)) {
+				std::this_thread::yield();
+				continue;
+			}
+			const size_t size = 32 + i % 993;
+			if (p[0] != static_cast<char>(i & 0x7f) || p[size - 1] != static_cast<char>(i & 0x7f))
+				bad++;
+			if (storage.Free(p) != 0)
+				bad++;
+			i++;
+		}
+		});
+	producer.join();
+	consumer.join();
+	printf("[cross thread] blocks=%d bad=%zu %s\n", OpCount / 4, bad.load(), bad == 0 ? "ok" : "FAILED");
+}
+
+//the caches of ended threads are given back and taken by new threads, and a thread may end after the storage.
+void test_thread_end() {
+	bool ok{ true };
+	{
+		Storage storage({ 64 });
+		for (int round = 0; round < 8; round++) {
+			std::thread worker([&] {
+				std::vector<char*> blocks;
+				for (int i = 0; i < 1000; i++)
+					blocks.emplace_back(storage.Alloc(64));
+				for (auto var : blocks)
+					storage.Free(var);
+				});
+			worker.join();
+		}
+		char* p = storage.Alloc(64);
+		ok = ok && p != nullptr && storage.Free(p) == 0;
+	}
+	std::atomic_bool b_gone{ false };
+	std::thread late([&] {
+		std::unique_ptr<Storage> storage(new Storage({ 64 }));
+		char* p = storage->Alloc(64);
+		storage->Free(p);
+		storage.reset();
+		b_gone = true;
+		//a storage made after it must not be taken for the gone one
+		Storage other({ 64 });
+		char* q = other.Alloc(64);
+		ok = ok && q != nullptr && other.Free(q) == 0;
+		});
+	late.join();
+	printf("[thread end] %s\n", ok && b_gone ? "ok" : "FAILED");
+}
+
+void test_cost() {
+	Storage storage({ 32, 64, 256, 512, 1024 });
+	NMemoryPool<char> pool(256);
+	std::vector<std::thread> threads;
+	std::atomic<long long> ns_storage{ 0 }, ns_pool{ 0 };
+	for (int t = 0; t < ThreadNum; t++) {
+		threads.emplace_back([&] {
+			char* ps[16];
+			Timer timer;
+			for (int i = 0; i < OpCount / ThreadNum / 16; i++) {
+				for (auto& var : ps)
+					var = storage.Alloc(200);
+				for (auto& var : ps)
+					storage.Free(var);
+			}
+			ns_storage += timer.elapsed_nano();
+			timer.reset();
+			for (int i = 0; i < OpCount / ThreadNum / 16; i++) {
+				for (auto& var : ps)
+					var = pool.Alloc();
+				for (auto& var : ps)
+					pool.Free(var);
+			}
+			ns_pool += timer.elapsed_nano();
+			});
+	}
+	for (auto& var : threads)
+		var.join();
+	printf("[cost] threads=%d per alloc+free: storage=%.1fns pool=%.1fns\n", ThreadNum, (double)ns_storage / OpCount, (double)ns_pool / OpCount);
+}
+
+//the resident set in KB, 0 if unknown.
+size_t rss_kb() {
+#ifdef __linux__
+	FILE* f = fopen("/proc/self/statm", "r");
+	if (!f)
+		return 0;
+	unsigned long pages{ 0 }, resident{ 0 };
+	const int got = fscanf(f, "%lu %lu", &pages, &resident);
+	fclose(f);
+	return got == 2 ? resident * sysconf(_SC_PAGESIZE) / 1024 : 0;
+#else
+	return 0;
+#endif
+}
+
+//a block is given back only when all its slots are free, and the pool carves again after its last block is gone.
+void test_pool_trim() {
+	NMemoryPool<char> pool(200);
+	std::vector<char*> slots;
+	for (int i = 0; i < 10000; i++)
+		slots.emplace_back(pool.Alloc());
+	const PoolInfo_t full = pool.GetInfo();
+	for (size_t i = 0; i < slots.size(); i += 2)
+		pool.Free(slots[i]);
+	const size_t half_released = pool.Trim();
+	const PoolInfo_t half = pool.GetInfo();
+	for (size_t i = 1; i < slots.size(); i += 2)
+		pool.Free(slots[i]);
+	const size_t kept_released = pool.Trim(8 * 4096);
+	const PoolInfo_t kept = pool.GetInfo();
+	const size_t all_released = pool.Trim();
+	const PoolInfo_t none = pool.GetInfo();
+	char* p = pool.Alloc();
+	memset(p, 'p', 200);
+	const PoolInfo_t again = pool.GetInfo();
+	pool.Free(p);
+
+	const bool ok = full.liveSlots == 10000 && full.misses == 10000 && full.bytesUsed == 10000 * 200 && \
+		half_released == 0 && half.liveSlots == 5000 && half.freeSlots == 5000 && \
+		kept.blocks == 8 && kept_released == (full.blocks - 8) * 4096 && kept.liveSlots == 0 && \
+		all_released == 8 * 4096 && none.blocks == 0 && none.freeSlots == 0 && none.bytesReserved == 0 && \
+		none.trimmedBytes == full.bytesReserved && again.blocks == 1 && again.liveSlots == 1;
+	printf("[pool trim] blocks=%zu slot=%zu live=%zu reserved=%zuKB -> kept %zu blocks -> %zu blocks %s\n", full.blocks, full.slotSize, \
+		full.liveSlots, full.bytesReserved / 1024, kept.blocks, none.blocks, ok ? "ok" : "FAILED");
+}
+
+//the head block given back leaves no current slot, the next head is all carved and is given back by the next trim.
+void test_head_trim() {
+	NMemoryPool<char> pool(200);
+	std::vector<char*> slots[3];
+	while (slots[2].empty()) {
+		char* p = pool.Alloc();
+		slots[pool.GetInfo().blocks - 1].emplace_back(p);
+	}
+	pool.Free(slots[2][0]);
+	const size_t head_released = pool.Trim();
+	for (auto var : slots[1])
+		pool.Free(var);
+	const size_t next_released = pool.Trim();
+	const PoolInfo_t next = pool.GetInfo();
+	for (auto var : slots[0])
+		pool.Free(var);
+	const size_t first_released = pool.Trim();
+	const PoolInfo_t none = pool.GetInfo();
+
+	const bool ok = head_released == 4096 && next_released == 4096 && next.blocks == 1 && next.liveSlots == slots[0].size() && \
+		first_released == 4096 && none.blocks == 0 && none.liveSlots == 0 && none.freeSlots == 0;
+	printf("[head trim] slots of a block=%zu released=%zu/%zu/%zu %s\n", slots[0].size(), head_released, next_released, \
+		first_released, ok ? "ok" : "FAILED");
+}
+
+//a burst is given back to the os once it is freed, but the retention.
+void test_storage_trim() {
+	Storage storage({ 256 });
+	std::vector<char*> blocks;
+	for (int i = 0; i < 256 * 1024; i++) {
+		blocks.emplace_back(storage.Alloc(256));
+		memset(blocks.back(), 'b', 256);
+	}
+	char* large = storage.Alloc(1024 * 1024);
+	const StorageInfo_t peak = storage.GetInfo();
+	const size_t rss_peak = rss_kb();
+	for (auto var : blocks)
+		storage.Free(var);
+	storage.Free(large);
+	const StorageInfo_t freed = storage.GetInfo();
+	const size_t released = storage.Trim(1024 * 1024);
+	const StorageInfo_t trimmed = storage.GetInfo();
+	const size_t rss_trimmed = rss_kb();
+
+	const bool ok = peak.classes.size() == 1 && peak.classes[0].liveSlots == blocks.size() && peak.largeLive == 1 && \
+		peak.hits + peak.misses == blocks.size() && freed.classes[0].liveSlots == 0 && freed.largeBytes == 0 && \
+		released > 0 && trimmed.bytesReserved <= 1024 * 1024 + 4096 && trimmed.classes[0].cachedSlots == 0 && \
+		(!RssChecked || rss_peak == 0 || rss_trimmed + 32 * 1024 < rss_peak);
+	printf("[storage trim] reserved=%zuKB used=%zuKB rss=%zuKB -> released=%zuKB reserved=%zuKB rss=%zuKB %s\n", peak.bytesReserved / 1024, \
+		peak.bytesUsed / 1024, rss_peak, released / 1024, trimmed.bytesReserved / 1024, rss_trimmed, ok ? "ok" : "FAILED");
+}
+
+//the blocks of a burst on an ended thread are given back from the trim thread.
+void test_trim_tick() {
+	Storage storage({ 1024 });
+	storage.StartTrim(std::chrono::milliseconds(10));
+	std::thread burst([&] {
+		std::vector<char*> blocks;
+		for (int i = 0; i < 16 * 1024; i++)
+			blocks.emplace_back(storage.Alloc(1024));
+		for (auto var : blocks)
+			storage.Free(var);
+		});
+	burst.join();
+	StorageInfo_t info;
+	int waited{ 0 };
+	for (; waited < 200; waited++) {
+		info = storage.GetInfo();
+		if (info.bytesReserved == 0)
+			break;
+		std::this_thread::sleep_for(std::chrono::milliseconds(5));
+	}
+	storage.StopTrim();
+	printf("[trim tick] trimmed=%lluKB waited=%dms %s\n", (unsigned long long)info.trimmedBytes / 1024, waited * 5, \
+		info.bytesReserved == 0 && info.trimmedBytes > 0 ? "ok" : "FAILED");
+}
+
+int main(int argc, char** argv) {
+	test_classes();
+	test_large();
+	test_cross_thread();
+	test_thread_end();
+	test_cost();
+	test_pool_trim();
+	test_head_trim();
+	test_storage_trim();
+	test_trim_tick();
+	return 0;
+}
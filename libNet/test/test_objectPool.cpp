@@ -0,0 +1,209 @@
+//========================================================================
+//[File Name]:test_objectPool.cpp
+//[Description]: a test of ObjectPool: the handles and the objects reset
+//               when they are back, the growth by chunks up to the
+//               capacity, the objects constructed with arguments, the
+//               threads getting and giving back at once with no object
+//               held by two handles, and the cost of a get against
+//               make_shared and a pool keyed by name in a multimap.
+//[Author]:Nico Hu
+//[Date]:2020-08-10
+//[Other]:Copyright (c) 2020-2050 Nico Hu
+//========================================================================
+#include <atomic>
+#include <cstdio>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <typeinfo>
+#include <vector>
+
+#include "../com/ObjectPool.h"
+#include "Timer.h"
+
+using namespace DesignPattern;
+
+#define ThreadNum (4)
+#define Rounds (200000)
+
+struct Parser {
+	Parser() = default;
+	Parser(int v, const std::string& n) : value(v), name(n) { }
+	void Reset() {
+		value = 0;
+		body.clear();
+		resets++;
+	}
+
+	int value{ 0 };
+	std::string name;
+	std::string body;
+	char buf[512];
+	int resets{ 0 };
+	std::atomic<int> owners{ 0 };
+};
+
+struct Plain {
+	int value{ 7 };
+};
+
+void test_handles() {
+	ObjectPool<Parser> pool(ObjectPoolInfo_t{ 4, 4, 10 });
+	bool ok{ true };
+	ObjectPoolUsage_t usage = pool.GetUsage();
+	ok = ok && usage.objects == 4 && usage.chunks == 1;
+
+	auto first = pool.Get();
+	first->value = 5;
+	first->body = "dirty";
+	Parser* p = first.get();
+	auto second = std::move(first);
+	ok = ok && !first && second && second.get() == p;
+	second.reset();
+	//the last one back is the next one out, reset
+	auto again = pool.Get();
+	ok = ok && again.get() == p && again->value == 0 && again->body.empty() && again->resets == 1;
+	again = pool.Get();
+	ok = ok && again.get() != p;
+
+	//the capacity of 10 is 3 chunks of 4, the 13th get is refused
+	std::vector<ObjectPool<Parser>::Handle> held;
+	held.emplace_back(std::move(again));
+	for (int i = 0; i < 12; i++) {
+		auto h = pool.Get();
+		if (h)
+			held.emplace_back(std::move(h));
+	}
+	usage = pool.GetUsage();
+	ok = ok && held.size() == 12 && usage.objects == 12 && usage.chunks == 3 && usage.exhausted == 1;
+	held.clear();
+	auto after = pool.Get();
+	ok = ok && after && pool.GetUsage().objects == 12;
+	printf("[handles] objects=%zu chunks=%zu exhausted=%llu %s\n", usage.objects, usage.chunks, (unsigned long long)usage.exhausted, \
+		ok ? "ok" : "FAILED");
+}
+
+void test_args() {
+	ObjectPool<Parser> pool(ObjectPoolInfo_t{ 2, 2, 64 }, 42, std::string("req"));
+	ObjectPool<Plain> plain;
+	bool ok{ true };
+	std::vector<ObjectPool<Parser>::Handle> held;
+	for (int i = 0; i < 5; i++)
+		held.emplace_back(pool.Get());
+	for (auto& var : held)
+		ok = ok && var && var->value == 42 && var->name == "req";
+	auto h = plain.Get();
+	ok = ok && h && h->value == 7 && plain.GetUsage().objects == ObjectPoolInfo_t().initObjects;
+	printf("[args] grown to=%zu %s\n", pool.GetUsage().objects, ok ? "ok" : "FAILED");
+}
+
+//each thread holds up to 3 handles at a time, an object owned twice is counted.
+void test_threads() {
+	ObjectPool<Parser> pool(ObjectPoolInfo_t{ 4, 4, 4096 });
+	std::atomic<size_t> twice{ 0 }, empty{ 0 };
+	std::vector<std::thread> threads;
+	Timer timer;
+	for (int t = 0; t < ThreadNum; t++) {
+		threads.emplace_back([&, t] {
+			ObjectPool<Parser>::Handle held[3];
+			for (int i = 0; i < Rounds; i++) {
+				auto& slot = held[(i * 7 + t) % 3];
+				slot.reset();
+				slot = pool.Get();
+				if (!slot) {
+					empty++;
+					continue;
+				}
+				if (slot->owners.fetch_add(1) != 0)
+					twice++;
+				slot->value = t;
+				slot->owners.fetch_sub(1);
+			}
+		});
+	}
+	for (auto& var : threads)
+		var.join();
+	const auto us = timer.elapsed_micro();
+	const ObjectPoolUsage_t usage = pool.GetUsage();
+	const bool ok = twice == 0 && empty == 0 && usage.objects <= ThreadNum * 3 + 4 * ThreadNum;
+	printf("[threads] threads=%d gets=%d objects=%zu owned twice=%zu %.1fns per get %s\n", ThreadNum, ThreadNum * Rounds, usage.objects, \
+		(size_t)twice, us * 1000.0 / (ThreadNum * Rounds), ok ? "ok" : "FAILED");
+}
+
+//the pool keyed by the constructor's type name, as it was: an object comes back as a plain
+//shared_ptr, so it is deleted the second time it is gone and the callers fall back to make_shared.
+template<typename T>
+class MapPool {
+public:
+	void Init(size_t num) {
+		const char* name = typeid(std::function<std::shared_ptr<T>()>).name();
+		for (size_t i = 0; i < num; i++)
+			objMap_.emplace(name, std::shared_ptr<T>(new T(), [this, name](T* p) {
+				std::lock_guard<std::mutex> lock(mtx_);
+				objMap_.emplace(name, std::shared_ptr<T>(p));
+			}));
+	}
+	std::shared_ptr<T> Get() {
+		std::lock_guard<std::mutex> lock(mtx_);
+		std::string name = typeid(std::function<std::shared_ptr<T>()>).name();
+		auto it = objMap_.find(name);
+		if (it == objMap_.end())
+			return nullptr;
+		auto ptr = it->second;
+		objMap_.erase(it);
+		return ptr;
+	}
+	~MapPool() {
+		//the objects not got yet give themselves back to objMap_ when they are gone
+		auto objs = std::move(objMap_);
+		objMap_.clear();
+	}
+
+protected:
+	std::multimap<std::string, std::shared_ptr<T>> objMap_;
+	std::mutex mtx_;
+};
+
+void test_cost() {
+	const int n = 1000000;
+	ObjectPool<Parser> pool(ObjectPoolInfo_t{ 32, 32 });
+	Timer timer;
+	for (int i = 0; i < n; i++) {
+		auto h = pool.Get();
+		h->value = i;
+	}
+	const double pool_ns = timer.elapsed_micro() * 1000.0 / n;
+
+	timer.reset();
+	for (int i = 0; i < n; i++) {
+		auto p = std::make_shared<Parser>();
+		p->value = i;
+	}
+	const double make_ns = timer.elapsed_micro() * 1000.0 / n;
+
+	double map_ns{ 0 };
+	{
+		MapPool<Parser> map_pool;
+		map_pool.Init(32);
+		timer.reset();
+		for (int i = 0; i < n; i++) {
+			auto p = map_pool.Get();
+			if (p == nullptr)
+				p = std::make_shared<Parser>();
+			p->Reset();
+			p->value = i;
+		}
+		map_ns = timer.elapsed_micro() * 1000.0 / n;
+	}
+	printf("[cost] get and give back: pool=%.1fns make_shared=%.1fns multimap pool=%.1fns %s\n", pool_ns, make_ns, map_ns, \
+		pool_ns < map_ns ? "ok" : "FAILED");
+}
+
+int main(int argc, char** argv) {
+	test_handles();
+	test_args();
+	test_threads();
+	test_cost();
+	return 0;
+}
@@ -0,0 +1,133 @@
+//========================================================================
+//[File Name]:test_recvFrame.cpp
+//[Description]: a loopback benchmark of the stick readers, the legacy
+//               header+body reader(RWHandlerTcpS) against the buffered
+//               multi-frame reader(RWHandlerTcpSB), with the framing codecs.
+//[Author]:Nico Hu
+//[Date]:2020-08-10
+//[Other]:Copyright (c) 2020-2050 Nico Hu
+//========================================================================
+#include <atomic>
+#include <thread>
+
+#include "../core/RWHandler.h"
+#include "Timer.h"
+
+using namespace Net;
+using namespace Net::Core;
+
+#define FrameCount (200000)
+
+const char* codec_name(const Codec& codec) {
+	switch (codec.Type()) {
+	case E_CODEC_T::e_Len32: return "len32";
+	case E_CODEC_T::e_Varint: return "varint";
+	case E_CODEC_T::e_Line: return "line";
+	case E_CODEC_T::e_Fixed: return "fixed";
+	case E_CODEC_T::e_Hex: return "hex";
+	default: return "raw";
+	}
+}
+
+//write frame_count frames of body_len bytes to the peer, in big chunks as a busy sender does.
+void send_frames(unsigned short port, const Codec& codec, size_t body_len, size_t frame_count) {
+	io_context io_c;
+	tcp::socket socket(io_c);
+	socket.connect(tcp::endpoint(asio::ip::make_address("127.0.0.1"), port));
+
+	uint8_t err_code{ NO_ERR };
+	const size_t frame_len = codec.HeadLen(body_len) + body_len + codec.TailLen();
+	const size_t frames_per_chunk = frame_len < 1024 * 64 ? 1024 * 64 / frame_len : 1;
+	std::vector<char> chunk(frames_per_chunk * frame_len);
+	for (size_t i = 0; i < frames_per_chunk; i++) {
+		char* frame = chunk.data() + i * frame_len;
+		int head_len = codec.EncodeHead(frame, body_len, err_code);
+		memset(frame + head_len, 'a' + i % 26, body_len);
+		codec.EncodeTail(frame + head_len + body_len);
+	}
+
+	size_t sent = 0;
+	while (sent < frame_count) {
+		size_t n = frame_count - sent < frames_per_chunk ? frame_count - sent : frames_per_chunk;
+		asio::write(socket, asio::buffer(chunk.data(), n * frame_len));
+		sent += n;
+	}
+	asio::error_code ec;
+	socket.shutdown(tcp::socket::shutdown_send, ec);
+}
+
+template<typename Handler>
+void test_sync_read(const char* name, const Codec& codec, size_t body_len, size_t frame_count = FrameCount) {
+	io_context io_c;
+	tcp::acceptor acceptor(io_c, tcp::endpoint(asio::ip::make_address("127.0.0.1"), 0));
+	std::thread sender(send_frames, acceptor.local_endpoint().port(), codec, body_len, frame_count);
+	tcp::socket socket(io_c);
+	acceptor.accept(socket);
+
+	NMemoryStorage<char> mem_storage({ 32, 64, 256, 512, 1024 });
+	auto handler = std::make_shared<Handler>(io_c, socket, mem_storage, codec);
+	size_t frames = 0, bytes = 0, bad = 0;
+	Timer timer;
+	while (frames < frame_count) {
+		uint8_t err_code{ NO_ERR };
+		Packet* packet = handler->HandleRead(err_code);
+		if (!packet)
+			break;
+		frames++;
+		bytes += packet->bodyLen();
+		if (packet->bodyLen() != body_len || packet->body()[body_len - 1] != packet->body()[0])
+			bad++;
+	}
+	auto us = timer.elapsed_micro();
+	sender.join();
+	printf("[sync ] %-14s %-6s body=%6zu frames=%zu bytes=%zu bad=%zu time=%lldus %.0f msg/s\n", name, codec_name(codec), \
+		body_len, frames, bytes, bad, (long long)us, us > 0 ? frames * 1e6 / us : 0.0);
+}
+
+template<typename Handler>
+void test_async_read(const char* name, const Codec& codec, size_t body_len, size_t frame_count = FrameCount) {
+	io_context io_c;
+	tcp::acceptor acceptor(io_c, tcp::endpoint(asio::ip::make_address("127.0.0.1"), 0));
+	std::thread sender(send_frames, acceptor.local_endpoint().port(), codec, body_len, frame_count);
+	tcp::socket socket(io_c);
+	acceptor.accept(socket);
+
+	NMemoryStorage<char> mem_storage({ 32, 64, 256, 512, 1024 });
+	auto handler = std::make_shared<Handler>(io_c, socket, mem_storage, codec);
+	size_t frames = 0, bytes = 0, bad = 0;
+	CBAsyncRead on_read = [&](Packet* packet, uint8_t ec) {
+		if (!packet)
+			return;
+		frames++;
+		bytes += packet->bodyLen();
+		if (packet->bodyLen() != body_len || packet->body()[body_len - 1] != packet->body()[0])
+			bad++;
+		if (frames < frame_count)
+			handler->HandleAsyncRead(on_read);
+	};
+	Timer timer;
+	handler->HandleAsyncRead(on_read);
+	io_c.run();
+	auto us = timer.elapsed_micro();
+	sender.join();
+	printf("[async] %-14s %-6s body=%6zu frames=%zu bytes=%zu bad=%zu time=%lldus %.0f msg/s\n", name, codec_name(codec), \
+		body_len, frames, bytes, bad, (long long)us, us > 0 ? frames * 1e6 / us : 0.0);
+}
+
+int main(int argc, char** argv) {
+	for (size_t body_len : { 16, 64, 200 }) {
+		Codec codec(E_CODEC_T::e_Hex);
+		test_sync_read<RWHandlerTcpS<tcp::socket>>("RWHandlerTcpS", codec, body_len);
+		test_sync_read<RWHandlerTcpSB<tcp::socket>>("RWHandlerTcpSB", codec, body_len);
+		test_async_read<RWHandlerTcpS<tcp::socket>>("RWHandlerTcpS", codec, body_len);
+		test_async_read<RWHandlerTcpSB<tcp::socket>>("RWHandlerTcpSB", codec, body_len);
+	}
+	for (auto codec : { Codec(E_CODEC_T::e_Len32), Codec(E_CODEC_T::e_Varint), Codec(E_CODEC_T::e_Line), Codec(E_CODEC_T::e_Fixed, 64) }) {
+		test_sync_read<RWHandlerTcpSB<tcp::socket>>("RWHandlerTcpSB", codec, 64);
+		test_async_read<RWHandlerTcpSB<tcp::socket>>("RWHandlerTcpSB", codec, 64);
+	}
+	//frames over 64KiB, which grow the ring
+	test_sync_read<RWHandlerTcpSB<tcp::socket>>("RWHandlerTcpSB", Codec(E_CODEC_T::e_Len32), 1024 * 256, 200);
+	test_async_read<RWHandlerTcpSB<tcp::socket>>("RWHandlerTcpSB", Codec(E_CODEC_T::e_Varint), 1024 * 256, 200);
+	return 0;
+}
@@ -0,0 +1,122 @@
+//========================================================================
+//[File Name]:test_sendQueue.cpp
+//[Description]: a contention benchmark of the session send queue, the
+//               bounded lock-free MpscQueue against the mutex + std::list
+//               it replaces, with 1/4/16 producers and one consumer which
+//               drains batches as the session writer does.
+//[Author]:Nico Hu
+//[Date]:2020-08-10
+//[Other]:Copyright (c) 2020-2050 Nico Hu
+//========================================================================
+#include <atomic>
+#include <list>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <cstdio>
+
+#include "../com/MpscQueue.h"
+#include "../com/Timer.h"
+
+#define OpCount (1024 * 1024 * 4)
+#define BatchSize (64)
+#define QueueSize (256)
+
+struct Item {
+	size_t producer{ 0 };
+	size_t seq{ 0 };
+	char* data{ nullptr };	//stands for the pooled packet of a SendItem
+};
+
+class ListQueue {
+public:
+	bool Push(Item&& item) {
+		std::lock_guard<std::mutex> lock(mtx_);
+		queue_.emplace_back(std::move(item));
+		return true;
+	}
+	//the writer drains under one lock.
+	size_t PopBatch(Item* items, size_t max) {
+		std::lock_guard<std::mutex> lock(mtx_);
+		size_t n{ 0 };
+		while (n < max && !queue_.empty()) {
+			items[n++] = std::move(queue_.front());
+			queue_.pop_front();
+		}
+		return n;
+	}
+
+private:
+	std::mutex mtx_;
+	std::list<Item> queue_;
+};
+
+class LockFreeQueue {
+public:
+	LockFreeQueue() :queue_(QueueSize) {}
+	bool Push(Item&& item) { return queue_.Push(std::move(item)); }
+	size_t PopBatch(Item* items, size_t max) {
+		size_t n{ 0 };
+		while (n < max && queue_.Pop(items[n]))
+			n++;
+		return n;
+	}
+
+private:
+	MpscQueue<Item> queue_;
+};
+
+template<typename Queue>
+void test_queue(const char* name, size_t producers) {
+	Queue queue;
+	const size_t per_producer = OpCount / producers;
+	const size_t total = per_producer * producers;
+	std::atomic_bool start{ false };
+	std::atomic<size_t> full{ 0 };
+	std::vector<std::thread> threads;
+	for (size_t p = 0; p < producers; p++) {
+		threads.emplace_back([&, p] {
+			while (!start)
+				std::this_thread::yield();
+			size_t n_full{ 0 };
+			for (size_t i = 0; i < per_producer; i++) {
+				Item item{ p, i, nullptr };
+				while (!queue.Push(std::move(item))) {
+					n_full++;
+					std::this_thread::yield();
+				}
+			}
+			full += n_full;
+			});
+	}
+
+	//the consumer checks that every producer's items come out in order.
+	std::vector<size_t> next(producers, 0);
+	Item batch[BatchSize];
+	size_t popped{ 0 }, bad{ 0 };
+	Timer timer;
+	start = true;
+	while (popped < total) {
+		const size_t n = queue.PopBatch(batch, BatchSize);
+		for (size_t i = 0; i < n; i++) {
+			if (batch[i].seq != next[batch[i].producer]++)
+				bad++;
+		}
+		popped += n;
+		if (n == 0)
+			std::this_thread::yield();
+	}
+	auto us = timer.elapsed_micro();
+	for (auto& var : threads)
+		var.join();
+	printf("%-14s producers=%2zu ops=%zu bad=%zu full=%zu time=%lldus %.2f Mops/s\n", name, producers, popped, bad, \
+		(size_t)full, (long long)us, us > 0 ? popped / (double)us : 0.0);
+}
+
+int main(int argc, char** argv) {
+	for (size_t producers : { 1, 4, 16 }) {
+		test_queue<ListQueue>("mutex+list", producers);
+		test_queue<LockFreeQueue>("MpscQueue", producers);
+	}
+	return 0;
+}
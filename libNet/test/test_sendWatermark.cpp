@@ -0,0 +1,215 @@
+//========================================================================
+//[File Name]:test_sendWatermark.cpp
+//[Description]: a test of the send queue watermarks, a connector sends to
+//               a peer which doesn't read. the session pauses over its high
+//               watermark(AsyncSend returns 1) and resumes when the peer
+//               drains it, and over the hard limit e_Reject refuses the
+//               packets(-4), e_Disconnect closes the session and
+//               e_DropOldest drops the queued ones to stay under it.
+//[Author]:Nico Hu
+//[Date]:2020-08-10
+//[Other]:Copyright (c) 2020-2050 Nico Hu
+//========================================================================
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <cstdio>
+
+#include "../stream/Connector.h"
+
+using namespace Net;
+using namespace Net::Stream;
+
+#define IoThreads (2)
+#define MsgSize (16 * 1024)
+#define MsgCount (200)
+#define HighBytes (256 * 1024)
+#define LowBytes (64 * 1024)
+#define HardBytes (1024 * 1024)
+#define WaitMs (3000)
+
+//the results of the sends of a case.
+struct SendResult_t {
+	size_t sent{ 0 };		//0 and 1
+	size_t paused{ 0 };		//1
+	size_t refused{ 0 };	//-4
+	size_t others{ 0 };
+	std::atomic<size_t> cbRefused{ 0 };
+};
+
+//a connector whose session sends to a socket that the test reads at will.
+class Peer {
+public:
+	Peer(short port) : acceptor_(peerCtx_, tcp::endpoint(asio::ip::make_address("127.0.0.1"), port)), socket_(peerCtx_), \
+		worker_(ioCtx_), conn_(ioCtx_, "127.0.0.1", 0, 0, Codec(E_CODEC_T::e_Len32)) {
+		for (int i = 0; i < IoThreads; i++)
+			threads_.emplace_back([this] { ioCtx_.run(); });
+		conn_.SetEventCB([this](SessionId id, const Event& e) {
+			if (e.type == Event::eEvent_t::e_sendPaused)
+				paused_++;
+			else if (e.type == Event::eEvent_t::e_sendResumed)
+				resumed_++;
+			});
+		port_ = port;
+	}
+	~Peer() {
+		if (id_ >= 0)
+			conn_.Close(id_);
+		ioCtx_.stop();
+		for (auto& var : threads_)
+			var.join();
+	}
+	bool Open(const SendWatermark& watermark) {
+		conn_.SetSendWatermark(watermark);
+		id_ = conn_.Open("127.0.0.1", port_);
+		if (id_ < 0)
+			return false;
+		asio::error_code ec;
+		acceptor_.accept(socket_, ec);
+		socket_.non_blocking(true, ec);
+		return !ec;
+	}
+	void Send(SendResult_t& result, size_t count) {
+		std::vector<char> msg(MsgSize, 'x');
+		for (size_t i = 0; i < count; i++) {
+			const int ret = conn_.AsyncSend(id_, msg.data(), MsgSize, [&result](SessionId, size_t len, uint8_t ec) {
+				if ((int)len == -4)
+					result.cbRefused++;
+				});
+			if (ret == 0 || ret == 1)
+				result.sent++;
+			if (ret == 1)
+				result.paused++;
+			else if (ret == -4)
+				result.refused++;
+			else if (ret != 0)
+				result.others++;
+		}
+	}
+	//read until want bytes came, the peer is closed, stop is true or WaitMs passed, the bytes read are returned.
+	template<typename F>
+	size_t Drain(size_t want, bool& eof, F stop) {
+		std::vector<char> buf(64 * 1024);
+		size_t got{ 0 };
+		eof = false;
+		for (int i = 0; i < WaitMs && got < want && !stop(); ) {
+			asio::error_code ec;
+			const size_t n = socket_.read_some(asio::buffer(buf), ec);
+			if (!ec)
+				got += n;
+			else if (ec == asio::error::would_block) {
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+				i++;
+			}
+			else {
+				eof = true;
+				break;
+			}
+		}
+		return got;
+	}
+	size_t Drain(size_t want, bool& eof) { return Drain(want, eof, [] { return false; }); }
+	size_t QueueBytes() {
+		size_t bytes{ 0 };
+		conn_.GetSendQueueBytes(id_, bytes);
+		return bytes;
+	}
+	//wait up to WaitMs for pred.
+	template<typename F>
+	bool WaitFor(F pred) {
+		for (int i = 0; i < WaitMs && !pred(); i++)
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		return pred();
+	}
+
+	std::atomic<size_t> paused_{ 0 };
+	std::atomic<size_t> resumed_{ 0 };
+
+protected:
+	io_context peerCtx_;
+	tcp::acceptor acceptor_;
+	tcp::socket socket_;
+	io_context ioCtx_;
+	asio::io_context::work worker_;
+	ConnectorTcp conn_;
+	std::vector<std::thread> threads_;
+	SessionId id_{ -1 };
+	short port_{ 0 };
+};
+
+SendWatermark make_watermark(size_t hard_bytes, E_SEND_LIMIT_T policy) {
+	SendWatermark watermark;
+	watermark.highBytes = HighBytes;
+	watermark.lowBytes = LowBytes;
+	watermark.highPackets = 0;
+	watermark.hardBytes = hard_bytes;
+	watermark.policy = policy;
+	return watermark;
+}
+
+//no hard limit: every packet is queued, the session pauses once and resumes once it is drained.
+void test_pause(short port) {
+	Peer peer(port);
+	SendResult_t result;
+	bool ok = peer.Open(make_watermark(0, E_SEND_LIMIT_T::e_Reject));
+	peer.Send(result, MsgCount);
+	const bool b_paused = peer.WaitFor([&] { return peer.paused_ > 0; });
+	bool eof{ false };
+	const size_t got = peer.Drain(result.sent * (MsgSize + 4), eof);
+	const bool b_resumed = peer.WaitFor([&] { return peer.resumed_ > 0; });
+	ok = ok && b_paused && b_resumed && result.paused > 0 && result.refused == 0 && result.others == 0 && \
+		got == result.sent * (MsgSize + 4) && !eof && peer.paused_ == 1 && peer.resumed_ == 1;
+	printf("[pause] sent=%zu returned 1=%zu drained=%zu paused=%zu resumed=%zu %s\n", result.sent, result.paused, got, \
+		(size_t)peer.paused_, (size_t)peer.resumed_, ok ? "ok" : "FAILED");
+}
+
+//the packets over the hard limit are refused, the session stays open and the queued ones are all sent.
+void test_reject(short port) {
+	Peer peer(port);
+	SendResult_t result;
+	bool ok = peer.Open(make_watermark(HardBytes, E_SEND_LIMIT_T::e_Reject));
+	peer.Send(result, MsgCount * 2);
+	bool eof{ false };
+	const size_t got = peer.Drain(result.sent * (MsgSize + 4), eof);
+	ok = ok && result.refused > 0 && result.cbRefused == result.refused && result.others == 0 && \
+		got == result.sent * (MsgSize + 4) && !eof;
+	printf("[reject] sent=%zu refused=%zu drained=%zu %s\n", result.sent, result.refused, got, ok ? "ok" : "FAILED");
+}
+
+//the session is closed once a packet is over the hard limit, the peer reads to the end of the stream.
+void test_disconnect(short port) {
+	Peer peer(port);
+	SendResult_t result;
+	bool ok = peer.Open(make_watermark(HardBytes, E_SEND_LIMIT_T::e_Disconnect));
+	peer.Send(result, MsgCount * 2);
+	bool eof{ false };
+	const size_t got = peer.Drain(MsgCount * 2 * (MsgSize + 4), eof);
+	ok = ok && result.refused > 0 && eof && got < result.sent * (MsgSize + 4);
+	printf("[disconnect] sent=%zu refused=%zu drained=%zu closed=%d %s\n", result.sent, result.refused, got, (int)eof, \
+		ok ? "ok" : "FAILED");
+}
+
+//nothing is refused, the queue goes over the hard limit while a write is in flight, the oldest packets are dropped
+//when the writer goes on.
+void test_drop(short port) {
+	Peer peer(port);
+	SendResult_t result;
+	bool ok = peer.Open(make_watermark(HardBytes, E_SEND_LIMIT_T::e_DropOldest));
+	peer.Send(result, MsgCount);
+	const size_t queued = peer.QueueBytes();
+	bool eof{ false };
+	size_t got = peer.Drain(MsgCount * (MsgSize + 4), eof, [&] { return peer.QueueBytes() <= HardBytes; });
+	const bool b_trimmed = peer.QueueBytes() <= HardBytes && got < queued;
+	got += peer.Drain(MsgCount * (MsgSize + 4), eof);
+	ok = ok && result.refused == 0 && result.others == 0 && queued > HardBytes && b_trimmed && \
+		got < result.sent * (MsgSize + 4) && !eof;
+	printf("[drop] sent=%zu queued=%zu trimmed=%d drained=%zu %s\n", result.sent, queued, (int)b_trimmed, got, ok ? "ok" : "FAILED");
+}
+
+int main(int argc, char** argv) {
+	test_pause(9940);
+	test_reject(9941);
+	test_disconnect(9942);
+	test_drop(9943);
+	return 0;
+}
@@ -0,0 +1,131 @@
+//========================================================================
+//[File Name]:test_sessionIdGen.cpp
+//[Description]: a test of the session slot allocator, accept/close churn
+//               on 1/4/16 threads against the mutex + std::list singleton
+//               it replaces, and 1M slots held at once with the tagged ids
+//               of the session table.
+//[Author]:Nico Hu
+//[Date]:2020-08-10
+//[Other]:Copyright (c) 2020-2050 Nico Hu
+//========================================================================
+#include <atomic>
+#include <list>
+#include <mutex>
+#include <numeric>
+#include <thread>
+#include <vector>
+#include <cstdio>
+
+#include "../stream/SessionIdGen.h"
+#include "../stream/SessionTable.h"
+#include "Timer.h"
+
+using namespace Net;
+using namespace Net::Stream;
+
+#define OpCount (1024 * 1024 * 4)
+#define HeldPerThread (64)	//the sessions a thread keeps open while it churns
+
+//the allocator before: a list of all the ids behind one mutex.
+class ListIdGen {
+public:
+	explicit ListIdGen(uint32_t capacity) : idPool_(capacity) { std::iota(idPool_.begin(), idPool_.end(), 1); }
+	uint32_t GetId() {
+		std::lock_guard<std::mutex> lock(mtx_);
+		if (idPool_.empty())
+			return 0;
+		uint32_t id = idPool_.front();
+		idPool_.pop_front();
+		return id;
+	}
+	void ReleaseId(uint32_t id) {
+		std::lock_guard<std::mutex> lock(mtx_);
+		idPool_.emplace_back(id);
+	}
+
+private:
+	std::mutex mtx_;
+	std::list<uint32_t> idPool_;
+};
+
+//each thread keeps HeldPerThread sessions open, closing the oldest half whenever it is full.
+template<typename Gen>
+void test_churn(const char* name, size_t threads) {
+	Gen gen(MaxConnNum);
+	const size_t per_thread = OpCount / threads;
+	std::atomic_bool start{ false };
+	std::atomic<size_t> failed{ 0 };
+	std::vector<std::thread> workers;
+	for (size_t t = 0; t < threads; t++) {
+		workers.emplace_back([&] {
+			while (!start)
+				std::this_thread::yield();
+			std::vector<uint32_t> held;
+			held.reserve(HeldPerThread);
+			size_t n_failed{ 0 };
+			for (size_t i = 0; i < per_thread; i++) {
+				const uint32_t slot = gen.GetId();
+				if (slot == 0) {
+					n_failed++;
+					continue;
+				}
+				held.emplace_back(slot);
+				if (held.size() == HeldPerThread) {
+					for (size_t j = 0; j < HeldPerThread / 2; j++)
+						gen.ReleaseId(held[j]);
+					held.erase(held.begin(), held.begin() + HeldPerThread / 2);
+				}
+			}
+			for (auto var : held)
+				gen.ReleaseId(var);
+			failed += n_failed;
+			});
+	}
+	Timer timer;
+	start = true;
+	for (auto& var : workers)
+		var.join();
+	auto us = timer.elapsed_micro();
+	printf("%-14s threads=%2zu ops=%d failed=%zu time=%lldus %.2f Mops/s\n", name, threads, OpCount, (size_t)failed, \
+		(long long)us, us > 0 ? OpCount / (double)us : 0.0);
+}
+
+//hold 1M slots at once, make their ids, then check that each slot is unique and the ids of a reused slot differ.
+void test_million() {
+	const uint32_t capacity = MaxSessionNum;
+	SessionIdGen gen(capacity);
+	SessionTable<int> table(capacity + 1);
+	std::vector<uint32_t> slots;
+	slots.reserve(capacity);
+	Timer timer;
+	uint32_t slot{ 0 };
+	while ((slot = gen.GetId()) != 0)
+		slots.emplace_back(slot);
+	auto us = timer.elapsed_micro();
+
+	std::vector<bool> seen(capacity + 1, false);
+	size_t dup{ 0 };
+	for (auto var : slots) {
+		if (seen[var])
+			dup++;
+		seen[var] = true;
+	}
+	const SessionId old_id = table.MakeId(slots.back());
+	table.Insert(old_id, std::make_shared<int>(0));
+	table.Remove(old_id);
+	gen.ReleaseId(slots.back());
+	const uint32_t reused = gen.GetId();
+	const SessionId new_id = table.MakeId(reused);
+	const bool ok = slots.size() == capacity && dup == 0 && gen.Used() == capacity && reused == slots.back() && new_id != old_id;
+	printf("[million] slots=%zu dup=%zu used=%zu get=%lldus old id=%lld new id=%lld %s\n", slots.size(), dup, gen.Used(), \
+		(long long)us, (long long)old_id, (long long)new_id, ok ? "ok" : "FAILED");
+}
+
+int main(int argc, char** argv) {
+	test_million();
+	for (size_t threads : { 1, 4, 16 }) {
+		test_churn<ListIdGen>("mutex+list", threads);
+		test_churn<SessionIdGen>("SessionIdGen", threads);
+	}
+	return 0;
+}
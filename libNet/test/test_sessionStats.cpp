@@ -0,0 +1,136 @@
+//========================================================================
+//[File Name]:test_sessionStats.cpp
+//[Description]: a test of the traffic counters, clients echoed by the async
+//               server. the bytes in and out of the sessions must match what
+//               the clients sent, the totals must be kept when they close,
+//               and the cost of a snapshot is taken while the echo runs.
+//[Author]:Nico Hu
+//[Date]:2020-08-10
+//[Other]:Copyright (c) 2020-2050 Nico Hu
+//========================================================================
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <cstdio>
+
+#include "../stream/Server.h"
+#include "Timer.h"
+
+using namespace Net;
+using namespace Net::Stream;
+
+#define ConnCount (16)
+#define Rounds (2000)
+#define MsgSize (128)
+#define Port (9930)
+
+int main(int argc, char** argv) {
+	io_context io_c;
+	asio::io_context::work worker(io_c);
+	std::thread io_thread([&] { io_c.run(); });
+	std::shared_ptr<ServerTcp> server(new ServerTcp(io_c, "127.0.0.1", Port, 0, Codec(E_CODEC_T::e_Raw)));
+	std::weak_ptr<ServerTcp> wk_server = server;
+	server->SetReceiveCB([wk_server](SessionId id, const char* data, size_t len, uint8_t ec) {
+		auto server = wk_server.lock();
+		if (server && data && len > 0)
+			server->AsyncSend(id, data, (unsigned)len);
+		});
+	server->StartA();
+
+	//a thread takes snapshots while the clients are echoed.
+	std::atomic_bool b_done{ false };
+	std::atomic<size_t> snapshots{ 0 };
+	std::atomic<long long> us_snapshot{ 0 };
+	std::thread observer([&] {
+		while (!b_done) {
+			Timer timer;
+			server->Snapshot();
+			us_snapshot += timer.elapsed_micro();
+			snapshots++;
+			std::this_thread::sleep_for(std::chrono::microseconds(100));
+		}
+		});
+
+	std::vector<std::thread> clients;
+	std::atomic<size_t> echoed{ 0 };
+	Timer timer;
+	for (int c = 0; c < ConnCount; c++) {
+		clients.emplace_back([&, c] {
+			try
+			{
+				io_context io_client;
+				tcp::socket socket(io_client);
+				socket.connect(tcp::endpoint(asio::ip::make_address("127.0.0.1"), Port));
+				char msg[MsgSize], echo[MsgSize];
+				memset(msg, 'a' + c % 26, sizeof(msg));
+				//the later connections send less, so the top sessions can be told apart.
+				const int rounds = Rounds / (c + 1);
+				for (int r = 0; r < rounds; r++) {
+					asio::write(socket, asio::buffer(msg, sizeof(msg)));
+					asio::read(socket, asio::buffer(echo, sizeof(echo)));
+					echoed += sizeof(echo);
+				}
+				socket.close();
+			}
+			catch (const std::exception& e)
+			{
+				printf("client raise ex:%s\n", e.what());
+			}
+			});
+	}
+	for (auto& var : clients)
+		var.join();
+	auto us = timer.elapsed_micro();
+	b_done = true;
+	observer.join();
+
+	size_t expected{ 0 };
+	for (int c = 0; c < ConnCount; c++)
+		expected += Rounds / (c + 1) * MsgSize;
+	//the closes are seen by the server after the clients are gone.
+	NetStats stats = server->Snapshot();
+	for (int i = 0; i < 200 && stats.closed < ConnCount; i++) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+		stats = server->Snapshot();
+	}
+	printf("[echo] conns=%d bytes=%zu time=%lldus snapshots=%zu per snapshot=%.2fus\n", ConnCount, echoed.load(), (long long)us, \
+		snapshots.load(), snapshots > 0 ? (double)us_snapshot / snapshots : 0.0);
+	const SessionStats& total = stats.total;
+	printf("[total] open=%zu closed=%llu in=%llu/%llu packets out=%llu/%llu packets queue high=%llu bytes/%llu items eof=%llu errors=%llu %s\n", \
+		stats.sessions, (unsigned long long)stats.closed, (unsigned long long)total.bytesIn, (unsigned long long)total.packetsIn, \
+		(unsigned long long)total.bytesOut, (unsigned long long)total.packetsOut, (unsigned long long)total.queueHighBytes, \
+		(unsigned long long)total.queueHighPackets, (unsigned long long)total.Errors(E_STAT_ERR_T::e_Eof), \
+		(unsigned long long)total.Errors(), total.bytesIn == expected && total.bytesOut == expected && \
+		stats.closed == ConnCount && stats.sessions == 0 ? "ok" : "FAILED");
+
+	//the top sessions by bytes in, taken while they are open.
+	std::vector<std::pair<SessionId, SessionStats>> per_session;
+	{
+		io_context io_client;
+		std::vector<std::unique_ptr<tcp::socket>> sockets;
+		char msg[MsgSize], echo[MsgSize];
+		memset(msg, 't', sizeof(msg));
+		for (int c = 0; c < 4; c++) {
+			sockets.emplace_back(new tcp::socket(io_client));
+			sockets.back()->connect(tcp::endpoint(asio::ip::make_address("127.0.0.1"), Port));
+			for (int r = 0; r <= c; r++) {
+				asio::write(*sockets.back(), asio::buffer(msg, sizeof(msg)));
+				asio::read(*sockets.back(), asio::buffer(echo, sizeof(echo)));
+			}
+		}
+		server->Snapshot(&per_session);
+	}
+	std::sort(per_session.begin(), per_session.end(), [](const std::pair<SessionId, SessionStats>& a, \
+		const std::pair<SessionId, SessionStats>& b) { return a.second.bytesIn > b.second.bytesIn; });
+	for (auto& var : per_session)
+		printf("[top] session id=%lld in=%llu out=%llu\n", (long long)var.first, (unsigned long long)var.second.bytesIn, \
+			(unsigned long long)var.second.bytesOut);
+	printf("[top] sessions=%zu %s\n", per_session.size(), per_session.size() == 4 && \
+		per_session.front().second.bytesIn == 4 * MsgSize ? "ok" : "FAILED");
+
+	server->Stop();
+	io_c.stop();
+	io_thread.join();
+	return 0;
+}
@@ -0,0 +1,141 @@
+//========================================================================
+//[File Name]:test_sessionTable.cpp
+//[Description]: a test of the session table, the lookups of the send path
+//               against the unordered_map(+mutex) it replaces, while other
+//               threads open and close sessions, and the rejection of the
+//               ids of closed sessions.
+//[Author]:Nico Hu
+//[Date]:2020-08-10
+//[Other]:Copyright (c) 2020-2050 Nico Hu
+//========================================================================
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <cstdio>
+
+#include "../stream/SessionTable.h"
+#include "Timer.h"
+
+using namespace Net;
+using namespace Net::Stream;
+
+#define SessionCount (10000)
+#define LookupCount (1024 * 1024 * 4)
+
+struct FakeSession {
+	explicit FakeSession(SessionId id) : id_(id) {}
+	SessionId id_{ 0 };
+};
+using Ptr = std::shared_ptr<FakeSession>;
+
+class MapTable {
+public:
+	SessionId MakeId(uint32_t slot) { return slot; }
+	bool Insert(SessionId id, Ptr session) {
+		std::lock_guard<std::mutex> lock(mtx_);
+		return map_.emplace(id, std::move(session)).second;
+	}
+	Ptr Find(SessionId id) {
+		std::lock_guard<std::mutex> lock(mtx_);
+		auto find = map_.find(id);
+		return find != map_.end() ? find->second : nullptr;
+	}
+	Ptr Remove(SessionId id) {
+		std::lock_guard<std::mutex> lock(mtx_);
+		auto find = map_.find(id);
+		if (find == map_.end())
+			return nullptr;
+		Ptr session = std::move(find->second);
+		map_.erase(find);
+		return session;
+	}
+
+private:
+	std::mutex mtx_;
+	std::unordered_map<SessionId, Ptr> map_;
+};
+
+//the readers look up random sessions, a churn thread closes and reopens the sessions of a slot range meanwhile.
+template<typename Table>
+void test_lookup(const char* name, size_t readers) {
+	Table table;
+	std::vector<std::atomic<SessionId>> ids(SessionCount + 1);
+	for (uint32_t slot = 1; slot <= SessionCount; slot++) {
+		ids[slot] = table.MakeId(slot);
+		table.Insert(ids[slot], std::make_shared<FakeSession>(ids[slot]));
+	}
+
+	std::atomic_bool start{ false }, stop{ false };
+	std::atomic<size_t> found{ 0 }, bad{ 0 }, churn{ 0 };
+	std::thread churner([&] {
+		while (!start)
+			std::this_thread::yield();
+		size_t n{ 0 };
+		while (!stop) {
+			const uint32_t slot = 1 + n++ % (SessionCount / 10);
+			const SessionId id = ids[slot];
+			if (table.Remove(id)) {
+				const SessionId new_id = table.MakeId(slot);
+				table.Insert(new_id, std::make_shared<FakeSession>(new_id));
+				ids[slot] = new_id;
+			}
+		}
+		churn = n;
+		});
+
+	std::vector<std::thread> threads;
+	for (size_t r = 0; r < readers; r++) {
+		threads.emplace_back([&, r] {
+			while (!start)
+				std::this_thread::yield();
+			size_t n_found{ 0 }, n_bad{ 0 };
+			uint32_t seed = static_cast<uint32_t>(r * 7919 + 1);
+			for (size_t i = 0; i < LookupCount / readers; i++) {
+				seed = seed * 1103515245 + 12345;
+				const uint32_t slot = 1 + (seed >> 8) % SessionCount;
+				const SessionId id = ids[slot];
+				Ptr session = table.Find(id);
+				if (session) {
+					n_found++;
+					if (session->id_ != id)
+						n_bad++;
+				}
+			}
+			found += n_found;
+			bad += n_bad;
+			});
+	}
+	Timer timer;
+	start = true;
+	for (auto& var : threads)
+		var.join();
+	auto us = timer.elapsed_micro();
+	stop = true;
+	churner.join();
+	printf("%-14s readers=%2zu lookups=%d found=%zu bad=%zu churn=%zu time=%lldus %.2f Mops/s\n", name, readers, LookupCount, \
+		(size_t)found, (size_t)bad, (size_t)churn, (long long)us, us > 0 ? LookupCount / (double)us : 0.0);
+}
+
+//the id of a closed session must not find the session which reuses its slot.
+void test_stale() {
+	SessionTable<FakeSession> table;
+	const SessionId id = table.MakeId(7);
+	table.Insert(id, std::make_shared<FakeSession>(id));
+	table.Remove(id);
+	const SessionId new_id = table.MakeId(7);
+	table.Insert(new_id, std::make_shared<FakeSession>(new_id));
+	const bool ok = id != new_id && !table.Find(id) && table.Find(new_id) && !table.Remove(id) && table.Size() == 1 \
+		&& !table.Insert(id, std::make_shared<FakeSession>(id));
+	printf("[stale] old id=%lld new id=%lld slot=%u %s\n", (long long)id, (long long)new_id, SessionTable<FakeSession>::SlotOf(new_id), ok ? "ok" : "FAILED");
+}
+
+int main(int argc, char** argv) {
+	test_stale();
+	for (size_t readers : { 1, 4, 8 }) {
+		test_lookup<MapTable>("map+mutex", readers);
+		test_lookup<SessionTable<FakeSession>>("SessionTable", readers);
+	}
+	return 0;
+}
@@ -0,0 +1,102 @@
+//========================================================================
+//[File Name]:test_syncServer.cpp
+//[Description]: a test of the sync server on its workers, thousands of
+//               connections echoed by the blocking receive callback with
+//               a fixed number of threads(it was a thread per connection).
+//[Author]:Nico Hu
+//[Date]:2020-08-10
+//[Other]:Copyright (c) 2020-2050 Nico Hu
+//========================================================================
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cstdio>
+
+#include "../stream/Server.h"
+#include "Timer.h"
+
+using namespace Net;
+using namespace Net::Stream;
+
+#define ConnCount (5000)
+#define Rounds (20)
+#define MsgSize (32)
+#define WorkerNum (4)
+
+//the threads of the process, -1 where it is unknown.
+int thread_count() {
+#ifdef __linux__
+	std::ifstream status("/proc/self/status");
+	std::string line;
+	while (std::getline(status, line)) {
+		if (line.compare(0, 8, "Threads:") == 0)
+			return std::stoi(line.substr(8));
+	}
+#endif
+	return -1;
+}
+
+void test_sync_server() {
+	io_context io_c;
+	std::shared_ptr<ServerTcp> server(new ServerTcp(io_c, "127.0.0.1", 9910, 0, Codec(E_CODEC_T::e_Raw)));
+	server->SetSyncWorkers(WorkerNum);
+	std::weak_ptr<ServerTcp> wk_server = server;
+	server->SetReceiveCB([wk_server](SessionId id, const char* data, size_t len, uint8_t ec) {
+		auto server = wk_server.lock();
+		uint8_t err_code{ 0 };
+		if (server && data && len > 0)
+			server->Send(id, data, (unsigned)len, err_code);
+		});
+	server->Start();
+
+	//one client thread, a round writes to all the connections and then reads all the echoes.
+	io_context io_client;
+	std::vector<std::unique_ptr<tcp::socket>> sockets;
+	Timer timer;
+	try
+	{
+		for (int i = 0; i < ConnCount; i++) {
+			sockets.emplace_back(new tcp::socket(io_client));
+			sockets.back()->connect(tcp::endpoint(asio::ip::make_address("127.0.0.1"), 9910));
+		}
+	}
+	catch (const std::exception& e)
+	{
+		printf("connect raise ex:%s, connected=%zu\n", e.what(), sockets.size());
+	}
+	auto us_connect = timer.elapsed_micro();
+
+	char msg[MsgSize], echo[MsgSize];
+	memset(msg, 'a', sizeof(msg));
+	size_t echoed{ 0 };
+	timer.reset();
+	try
+	{
+		for (int r = 0; r < Rounds; r++) {
+			for (auto& var : sockets)
+				asio::write(*var, asio::buffer(msg, sizeof(msg)));
+			for (auto& var : sockets) {
+				asio::read(*var, asio::buffer(echo, sizeof(echo)));
+				echoed++;
+			}
+		}
+	}
+	catch (const std::exception& e)
+	{
+		printf("echo raise ex:%s\n", e.what());
+	}
+	auto us_echo = timer.elapsed_micro();
+	const int threads = thread_count();
+	const bool ok = echoed == sockets.size() * Rounds && sockets.size() == ConnCount;
+	printf("[sync  ] conns=%zu workers=%d threads=%d connect=%lldus echoes=%zu time=%lldus %.0f echo/s %s\n", sockets.size(), WorkerNum, \
+		threads, (long long)us_connect, echoed, (long long)us_echo, us_echo > 0 ? echoed * 1000000.0 / us_echo : 0.0, ok ? "ok" : "FAILED");
+
+	sockets.clear();
+	server->Stop();
+}
+
+int main(int argc, char** argv) {
+	test_sync_server();
+	return 0;
+}
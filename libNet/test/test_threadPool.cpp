@@ -0,0 +1,161 @@
+//========================================================================
+//[File Name]:test_threadPool.cpp
+//[Description]: a test of the lanes of ThreadPool: the tasks queued while
+//               the worker is held run by priority with strict weights,
+//               the bulk ones get their share with the default weights
+//               while realtime ones keep coming, the depth and the waits by
+//               lane, and the tasks added with a priority by a member
+//               function or from a worker.
+//[Author]:Nico Hu
+//[Date]:2020-08-10
+//[Other]:Copyright (c) 2020-2050 Nico Hu
+//========================================================================
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "../com/ThreadPool.h"
+
+using namespace Thread;
+
+#define LaneTasks (400)
+
+//the worker of a pool of one is held by a task until Release, the tasks queued meanwhile are all there when it goes on.
+class Gate {
+public:
+	void Hold(ThreadPool& pool) {
+		pool.AddTask(E_TASK_PRI_T::e_Realtime, [this] {
+			bHeld_ = true;
+			while (!bOpen_)
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			});
+		while (!bHeld_)
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	void Release() { bOpen_ = true; }
+
+protected:
+	std::atomic_bool bHeld_{ false };
+	std::atomic_bool bOpen_{ false };
+};
+
+//the lanes of the tasks in the order they ran.
+class Recorder {
+public:
+	void Add(ThreadPool& pool, E_TASK_PRI_T pri, size_t num) {
+		for (size_t i = 0; i < num; i++)
+			pool.AddTask(pri, [this, pri] { Record(pri); });
+	}
+	void Record(E_TASK_PRI_T pri) {
+		std::lock_guard<std::mutex> lock(mtx_);
+		order_.emplace_back(pri);
+	}
+	std::vector<E_TASK_PRI_T> Wait(size_t num) {
+		for (int i = 0; i < 5000 && Size() < num; i++)
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		std::lock_guard<std::mutex> lock(mtx_);
+		return order_;
+	}
+	size_t Size() {
+		std::lock_guard<std::mutex> lock(mtx_);
+		return order_.size();
+	}
+
+protected:
+	std::mutex mtx_;
+	std::vector<E_TASK_PRI_T> order_;
+};
+
+size_t count_in(const std::vector<E_TASK_PRI_T>& order, size_t first, size_t last, E_TASK_PRI_T pri) {
+	size_t n{ 0 };
+	for (size_t i = first; i < last && i < order.size(); i++)
+		n += order[i] == pri ? 1 : 0;
+	return n;
+}
+
+void test_strict() {
+	ThreadPoolInfo_t info;
+	info.laneWeights[0] = 1;
+	info.laneWeights[1] = 0;
+	info.laneWeights[2] = 0;
+	ThreadPool pool(info);
+	pool.Start(1);
+	Gate gate;
+	Recorder recorder;
+	gate.Hold(pool);
+	recorder.Add(pool, E_TASK_PRI_T::e_Bulk, 10);
+	recorder.Add(pool, E_TASK_PRI_T::e_Normal, 10);
+	recorder.Add(pool, E_TASK_PRI_T::e_Realtime, 10);
+	const std::vector<LaneInfo_t> held = pool.GetLaneInfo();
+	gate.Release();
+	const auto order = recorder.Wait(30);
+	const bool ok = order.size() == 30 && count_in(order, 0, 10, E_TASK_PRI_T::e_Realtime) == 10 && \
+		count_in(order, 10, 20, E_TASK_PRI_T::e_Normal) == 10 && count_in(order, 20, 30, E_TASK_PRI_T::e_Bulk) == 10 && \
+		held[0].depth == 10 && held[1].depth == 10 && held[2].depth == 10;
+	printf("[strict] depth while held=%zu/%zu/%zu, realtime then normal then bulk %s\n", held[0].depth, held[1].depth, held[2].depth, \
+		ok ? "ok" : "FAILED");
+}
+
+//{32, 8, 1}: a bulk task in each cycle of 41 while the normal lane is empty and the realtime one full.
+void test_weighted() {
+	ThreadPoolInfo_t info;
+	info.waitSample = 1;
+	ThreadPool pool(info);
+	pool.Start(1);
+	Gate gate;
+	Recorder recorder;
+	gate.Hold(pool);
+	recorder.Add(pool, E_TASK_PRI_T::e_Bulk, LaneTasks);
+	recorder.Add(pool, E_TASK_PRI_T::e_Realtime, LaneTasks);
+	gate.Release();
+	const auto order = recorder.Wait(2 * LaneTasks);
+	//the first one of the realtime lane is the gate's
+	const size_t bulk_first = count_in(order, 0, 41 * 5, E_TASK_PRI_T::e_Bulk);
+	const std::vector<LaneInfo_t> lanes = pool.GetLaneInfo();
+	bool ok = order.size() == 2 * LaneTasks && bulk_first >= 4 && bulk_first <= 6 && \
+		lanes[0].run == LaneTasks + 1 && lanes[1].run == 0 && lanes[2].run == LaneTasks && \
+		lanes[0].depth == 0 && lanes[2].depth == 0 && lanes[0].sampled == LaneTasks + 1 && lanes[0].p99 < lanes[2].p99;
+	printf("[weighted] bulk run in the first 5 cycles=%zu, wait p99 realtime=%lluus bulk=%lluus %s\n", bulk_first, \
+		(unsigned long long)lanes[0].p99 / 1000, (unsigned long long)lanes[2].p99 / 1000, ok ? "ok" : "FAILED");
+}
+
+class Job {
+public:
+	void Run(int n) { sum_ += n; }
+	void Peek() const { peeks_++; }
+
+	std::atomic<int> sum_{ 0 };
+	mutable std::atomic<int> peeks_{ 0 };
+};
+
+//by a member function, and from a worker into its own lane.
+void test_add() {
+	ThreadPool pool;
+	pool.Start(2);
+	Job job;
+	pool.AddTask(E_TASK_PRI_T::e_Bulk, &Job::Run, &job, 5);
+	pool.AddTask(E_TASK_PRI_T::e_Realtime, &Job::Peek, &job);
+	pool.AddTask(&Job::Run, &job, 7);
+	pool.AddTask(E_TASK_PRI_T::e_Normal, [&pool, &job] {
+		for (int i = 0; i < 10; i++)
+			pool.AddTask(E_TASK_PRI_T::e_Bulk, [&job] { job.Run(1); });
+		});
+	std::vector<ThreadPool::Task> tasks(5, [&job] { job.Run(100); });
+	pool.AddTasks(std::move(tasks), E_TASK_PRI_T::e_Bulk);
+	for (int i = 0; i < 5000 && (job.sum_ != 522 || job.peeks_ != 1); i++)
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	const std::vector<LaneInfo_t> lanes = pool.GetLaneInfo();
+	const bool ok = job.sum_ == 522 && job.peeks_ == 1 && lanes[0].run == 1 && lanes[1].run == 2 && lanes[2].run == 16 && tasks.empty();
+	printf("[add] run by lane=%llu/%llu/%llu %s\n", (unsigned long long)lanes[0].run, (unsigned long long)lanes[1].run, \
+		(unsigned long long)lanes[2].run, ok ? "ok" : "FAILED");
+}
+
+int main(int argc, char** argv) {
+	test_strict();
+	test_weighted();
+	test_add();
+	return 0;
+}
@@ -0,0 +1,89 @@
+//========================================================================
+//[File Name]:test_timingWheel.cpp
+//[Description]: a test of the timing wheel, the fire times of timers on
+//               every level, and the cost of arming/re-arming/cancelling
+//               many timers as the sessions do on each read and write.
+//[Author]:Nico Hu
+//[Date]:2020-08-10
+//[Other]:Copyright (c) 2020-2050 Nico Hu
+//========================================================================
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <cstdio>
+
+#include "../core/TimingWheel.h"
+#include "Timer.h"
+
+using namespace Net;
+using namespace Net::Core;
+
+#define NodeCount (1024 * 100)
+#define RearmCount (10)
+
+//arm timers of a few timeouts and check that each one fires once, not before its time and within a tick after.
+void test_fire() {
+	asio::io_context io_c;
+	auto work = asio::make_work_guard(io_c);
+	std::thread t([&io_c] { io_c.run(); });
+	TimingWheel& wheel = TimingWheel::Of(io_c);
+
+	const int timeouts[] = { 50, 100, 350, 1000, 2500, 30000 };
+	const size_t count = sizeof(timeouts) / sizeof(timeouts[0]);
+	std::vector<std::unique_ptr<TimerNode>> nodes;
+	std::atomic<int> fired[count]{};
+	std::atomic<long long> elapsed[count]{};
+	Timer timer;
+	for (size_t i = 0; i < count; i++) {
+		nodes.emplace_back(new TimerNode([&, i] {
+			fired[i]++;
+			elapsed[i] = timer.elapsed();
+			}));
+		wheel.Arm(*nodes[i], std::chrono::milliseconds(timeouts[i]));
+	}
+	//the last one is cancelled before it fires
+	std::this_thread::sleep_for(std::chrono::milliseconds(3000));
+	wheel.Cancel(*nodes[count - 1]);
+
+	for (size_t i = 0; i < count; i++) {
+		const bool ok = i == count - 1 ? fired[i] == 0 : fired[i] == 1 && elapsed[i] >= timeouts[i] && \
+			elapsed[i] < timeouts[i] + TimerTick * 2;
+		printf("[fire  ] timeout=%5dms fired=%d elapsed=%4lldms %s\n", timeouts[i], (int)fired[i], (long long)elapsed[i], ok ? "ok" : "FAILED");
+	}
+	printf("[fire  ] armed=%zu\n", wheel.ArmedCount());
+	work.reset();
+	t.join();
+}
+
+//the sessions re-arm their timers on every read/write, and most never fire.
+void test_arm() {
+	asio::io_context io_c;
+	TimingWheel& wheel = TimingWheel::Of(io_c);
+	std::vector<TimerNode> nodes(NodeCount);
+
+	Timer timer;
+	for (auto& var : nodes)
+		wheel.Arm(var, std::chrono::seconds(30));
+	auto us_arm = timer.elapsed_micro();
+	timer.reset();
+	for (int i = 0; i < RearmCount; i++) {
+		for (auto& var : nodes)
+			wheel.Arm(var, std::chrono::seconds(10 + i * 60));
+	}
+	auto us_rearm = timer.elapsed_micro();
+	timer.reset();
+	for (auto& var : nodes)
+		wheel.Cancel(var);
+	auto us_cancel = timer.elapsed_micro();
+
+	printf("[arm   ] nodes=%d arm=%lldus rearm(x%d)=%lldus cancel=%lldus %.2f Mops/s armed=%zu\n", NodeCount, (long long)us_arm, \
+		RearmCount, (long long)us_rearm, (long long)us_cancel, NodeCount * (RearmCount + 2) / (double)(us_arm + us_rearm + us_cancel), \
+		wheel.ArmedCount());
+}
+
+int main(int argc, char** argv) {
+	test_arm();
+	test_fire();
+	return 0;
+}